@@ -0,0 +1,409 @@
+/*
+ * Headless render benchmark: draws a fixed set of scenes into a memory
+ * framebuffer, covering every draw mode of each layer type and sprites, blend
+ * modes, mosaic, windows, blend masks, priority tiles, sprite collision,
+ * rotating sprites, column offsets and palette animations. For each scene it reports frame time
+ * percentiles and cost per pixel, measured with a monotonic clock, and
+ * optionally writes them as JSON to track regressions across versions.
+ *
+ * usage: tilengine_bench [-frames n] [-json file] [-assets path]
+ */
+
+#include <SDL3/SDL_timer.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Tilengine.h"
+
+#define HRES 400
+#define VRES 240
+#define NUM_FRAMES 300
+#define WARMUP_FRAMES 10
+#define MAX_SCENES 64
+#define NUM_SPRITES 96
+#define NUM_ROTATING 500
+
+typedef struct {
+    char name[32];
+    double mean;      /* ns per frame */
+    double ns_pixel;  /* ns per framebuffer pixel */
+    double p50;       /* ns per frame at percentiles */
+    double p95;
+    double p99;
+} Result;
+
+static Result results[MAX_SCENES];
+static int num_results;
+static uint64_t *times;
+static int num_frames = NUM_FRAMES;
+static int column_offset[HRES / 8 + 2];
+static TLN_PixelMap *pixel_map;
+static void (*update)(int frame); /* per-frame scene animation, timed with the frame */
+
+/* assets */
+static TLN_Tilemap foreground;
+static TLN_Tilemap background;
+static TLN_Tilemap priority;
+static TLN_Spriteset spriteset;
+static TLN_Bitmap bitmap;
+static TLN_SequencePack sequences;
+static TLN_ObjectList objects;
+
+static int compare_times(void const *a, void const *b) {
+    const uint64_t t1 = *(uint64_t const *)a;
+    const uint64_t t2 = *(uint64_t const *)b;
+    return (t1 > t2) - (t1 < t2);
+}
+
+/* returns percentile of sorted frame times with the nearest-rank method */
+static double percentile(int p) {
+    int rank = (num_frames * p + 99) / 100;
+    if (rank < 1)
+        rank = 1;
+    return (double)times[rank - 1];
+}
+
+/* draws frames of current scene and records its statistics */
+static void Run(const char *name) {
+    Result *result = &results[num_results];
+    uint64_t total = 0;
+    int c;
+
+    for (c = 0; c < WARMUP_FRAMES; c++) {
+        if (update != NULL)
+            update(c);
+        TLN_UpdateFrame(0);
+    }
+
+    for (c = 0; c < num_frames; c++) {
+        const uint64_t t0 = SDL_GetTicksNS();
+        if (update != NULL)
+            update(WARMUP_FRAMES + c);
+        TLN_UpdateFrame(0);
+        times[c] = SDL_GetTicksNS() - t0;
+        total += times[c];
+    }
+
+    qsort(times, (size_t)num_frames, sizeof(uint64_t), compare_times);
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    result->mean = (double)total / num_frames;
+    result->ns_pixel = result->mean / (HRES * VRES);
+    result->p50 = percentile(50);
+    result->p95 = percentile(95);
+    result->p99 = percentile(99);
+    printf("%-24s %8.3f %10.1f %10.1f %10.1f\n", result->name, result->ns_pixel,
+           result->p50 / 1000.0, result->p95 / 1000.0, result->p99 / 1000.0);
+    if (num_results < MAX_SCENES - 1)
+        num_results += 1;
+}
+
+/* custom blend function, same as BLEND_MOD */
+static uint8_t CustomBlend(uint8_t src, uint8_t dst) {
+    return (uint8_t)((src * dst) / 255);
+}
+
+static bool LoadAssets(const char *path) {
+    char dir[256];
+
+    snprintf(dir, sizeof(dir), "%s/sonic", path);
+    TLN_SetLoadPath(dir);
+    foreground = TLN_LoadTilemap("Sonic_md_fg1.tmx", NULL);
+    background = TLN_LoadTilemap("Sonic_md_bg1.tmx", NULL);
+
+    snprintf(dir, sizeof(dir), "%s/tf4", path);
+    TLN_SetLoadPath(dir);
+    spriteset = TLN_LoadSpriteset("FireLeo");
+
+    snprintf(dir, sizeof(dir), "%s/color", path);
+    TLN_SetLoadPath(dir);
+    bitmap = TLN_LoadBitmap("beach.png");
+    sequences = TLN_LoadSequencePack("beach.sqx");
+
+    snprintf(dir, sizeof(dir), "%s/forest", path);
+    TLN_SetLoadPath(dir);
+    objects = TLN_LoadObjectList("map.tmx", "Object Layer");
+
+    if (!foreground || !background || !spriteset || !bitmap || !sequences || !objects)
+        return false;
+
+    /* copy of foreground with all tiles in front of sprites */
+    priority = TLN_CloneTilemap(foreground);
+    if (priority == NULL)
+        return false;
+    for (int row = 0; row < TLN_GetTilemapRows(priority); row++) {
+        for (int col = 0; col < TLN_GetTilemapCols(priority); col++) {
+            Tile tile;
+            TLN_GetTilemapTile(priority, row, col, &tile);
+            if (tile.index != 0) {
+                tile.flags |= FLAG_PRIORITY;
+                TLN_SetTilemapTile(priority, row, col, &tile);
+            }
+        }
+    }
+    return true;
+}
+
+static void SetupLayers(void) {
+    TLN_SetLayerTilemap(0, foreground);
+    TLN_SetLayerTilemap(1, background);
+    TLN_SetLayerPosition(0, 100, 48);
+    TLN_SetLayerPosition(1, 40, 0);
+}
+
+static void SetupSprites(bool scaling, bool collision) {
+    for (int c = 0; c < NUM_SPRITES; c++) {
+        TLN_SetSpriteSet(c, spriteset);
+        TLN_SetSpritePicture(c, c % 4);
+        TLN_SetSpritePosition(c, (c * 37) % (HRES + 40) - 20, (c * 53) % (VRES + 40) - 20);
+        TLN_SetSpriteScaling(c, scaling ? 1.5f : 1.0f, scaling ? 1.25f : 1.0f);
+        if (!scaling)
+            TLN_ResetSpriteScaling(c);
+        TLN_EnableSpriteCollision(c, collision);
+    }
+}
+
+static void DisableSprites(void) {
+    for (int c = 0; c < NUM_ROTATING; c++)
+        TLN_DisableSprite(c);
+}
+
+/* spins every sprite at its own speed, growing and shrinking */
+static void RotateSprites(int frame) {
+    for (int c = 0; c < NUM_ROTATING; c++) {
+        const float scale = 1.0f + (float)((frame + c) % 64) / 64.0f;
+        TLN_SetSpriteScaling(c, scale, scale);
+        TLN_SetSpriteRotation(c, (float)(frame * (c % 7 + 1)));
+    }
+}
+
+static void SetupRotatingSprites(void) {
+    for (int c = 0; c < NUM_ROTATING; c++) {
+        TLN_SetSpriteSet(c, spriteset);
+        TLN_SetSpritePicture(c, c % 4);
+        TLN_SetSpritePivot(c, 0.5f, 0.5f);
+        TLN_SetSpritePosition(c, (c * 37) % HRES, (c * 53) % VRES);
+        TLN_EnableSpriteCollision(c, false);
+    }
+}
+
+static void BenchTiled(void) {
+    static const char *const blend_names[] = {
+        "none", "mix25", "mix50", "mix75", "mix90", "add", "sub", "mod", "custom",
+    };
+    char name[32];
+    int c;
+
+    SetupLayers();
+    Run("tiled");
+
+    TLN_SetLayerScaling(0, 1.5f, 1.5f);
+    Run("tiled_scaling");
+
+    TLN_SetLayerTransform(0, 30.0f, HRES / 2, VRES / 2, 1.2f, 1.2f);
+    Run("tiled_affine");
+
+    TLN_SetLayerPixelMapping(0, pixel_map);
+    Run("tiled_pixel_mapping");
+    TLN_ResetLayerMode(0);
+
+    /* every blend mode, unscaled and scaled */
+    for (c = BLEND_MIX25; c < MAX_BLEND; c++) {
+        TLN_SetLayerBlendMode(0, (TLN_Blend)c);
+        snprintf(name, sizeof(name), "blend_%s", blend_names[c]);
+        Run(name);
+        TLN_SetLayerScaling(0, 1.5f, 1.5f);
+        snprintf(name, sizeof(name), "blend_%s_scaling", blend_names[c]);
+        Run(name);
+        TLN_ResetLayerMode(0);
+    }
+    TLN_SetLayerBlendMode(0, BLEND_NONE);
+
+    TLN_SetLayerMosaic(0, 4, 4);
+    Run("mosaic");
+    TLN_SetLayerBlendMode(0, BLEND_MIX50);
+    Run("mosaic_blend");
+    TLN_SetLayerBlendMode(0, BLEND_NONE);
+    TLN_DisableLayerMosaic(0);
+
+    TLN_SetLayerWindow(0, 80, 40, 320, 200, false);
+    Run("window");
+    TLN_SetLayerWindow(0, 80, 40, 320, 200, true);
+    Run("window_inverted");
+    TLN_SetLayerWindowColor(0, 0, 0, 128, BLEND_MIX50);
+    Run("window_color");
+    TLN_DisableLayerWindowColor(0);
+    TLN_DisableLayerWindow(0);
+
+    /* water: layer 0 blended only over layer 1 */
+    TLN_SetLayerBlendMode(0, BLEND_MIX50);
+    TLN_SetLayerBlendMask(0, 1);
+    Run("blend_mask");
+    TLN_ClearLayerBlendMask(0);
+    TLN_SetLayerBlendMode(0, BLEND_NONE);
+
+    for (c = 0; c < (int)(sizeof(column_offset) / sizeof(column_offset[0])); c++)
+        column_offset[c] = (c * 7) % 23 - 11;
+    TLN_SetLayerColumnOffset(0, column_offset);
+    Run("column_offset");
+    TLN_SetLayerColumnOffset(0, NULL);
+
+    TLN_DisableLayer(0);
+    TLN_DisableLayer(1);
+}
+
+static void BenchSprites(void) {
+    SetupLayers();
+
+    SetupSprites(false, false);
+    Run("sprites");
+
+    SetupSprites(true, false);
+    Run("sprites_scaling");
+
+    SetupSprites(false, true);
+    Run("sprites_collision");
+
+    TLN_SetLayerTilemap(0, priority);
+    SetupSprites(false, false);
+    Run("priority_tiles");
+
+    TLN_SetLayerPriority(0, true);
+    Run("priority_layer");
+    TLN_SetLayerPriority(0, false);
+    TLN_SetLayerTilemap(0, foreground);
+
+    SetupRotatingSprites();
+    update = RotateSprites;
+    Run("sprites_rotation");
+    update = NULL;
+    for (int c = 0; c < NUM_ROTATING; c++) {
+        TLN_ResetSpriteRotation(c);
+        TLN_ResetSpriteScaling(c);
+    }
+
+    DisableSprites();
+    TLN_DisableLayer(0);
+    TLN_DisableLayer(1);
+}
+
+static void BenchBitmap(void) {
+    TLN_SetLayerBitmap(0, bitmap);
+    TLN_SetLayerPosition(0, 16, 8);
+    Run("bitmap");
+
+    TLN_SetLayerScaling(0, 1.5f, 1.5f);
+    Run("bitmap_scaling");
+
+    TLN_SetLayerTransform(0, 20.0f, HRES / 2, VRES / 2, 1.0f, 1.0f);
+    Run("bitmap_affine");
+
+    TLN_SetLayerPixelMapping(0, pixel_map);
+    Run("bitmap_pixel_mapping");
+    TLN_ResetLayerMode(0);
+
+    TLN_SetPaletteAnimation(0, TLN_GetBitmapPalette(bitmap),
+                            TLN_FindSequence(sequences, "beach"), true);
+    Run("palette_animation");
+    TLN_DisablePaletteAnimation(0);
+
+    TLN_DisableLayer(0);
+}
+
+static void BenchObjects(void) {
+    TLN_SetLayerObjects(0, objects, NULL);
+    TLN_SetLayerPosition(0, 0, 0);
+    Run("objects");
+    TLN_DisableLayer(0);
+}
+
+static bool WriteJSON(const char *filename) {
+    const uint32_t version = TLN_GetVersion();
+    FILE *file = strcmp(filename, "-") ? fopen(filename, "wt") : stdout;
+    if (file == NULL)
+        return false;
+
+    fprintf(file, "{\n");
+    fprintf(file, "  \"version\": \"%d.%d.%d\",\n", (version >> 16) & 0xFF,
+            (version >> 8) & 0xFF, version & 0xFF);
+    fprintf(file, "  \"width\": %d,\n  \"height\": %d,\n  \"frames\": %d,\n", HRES, VRES,
+            num_frames);
+    fprintf(file, "  \"scenes\": [\n");
+    for (int c = 0; c < num_results; c++) {
+        Result const *result = &results[c];
+        fprintf(file,
+                "    {\"name\": \"%s\", \"ns_per_pixel\": %.4f, \"mean_ns\": %.0f, "
+                "\"p50_ns\": %.0f, \"p95_ns\": %.0f, \"p99_ns\": %.0f}%s\n",
+                result->name, result->ns_pixel, result->mean, result->p50, result->p95,
+                result->p99, c < num_results - 1 ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    if (file != stdout)
+        fclose(file);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    const char *assets = "assets";
+    const char *json = NULL;
+    uint8_t *framebuffer;
+    int c;
+
+    for (c = 1; c < argc - 1; c++) {
+        if (!strcmp(argv[c], "-frames"))
+            num_frames = atoi(argv[++c]);
+        else if (!strcmp(argv[c], "-json"))
+            json = argv[++c];
+        else if (!strcmp(argv[c], "-assets"))
+            assets = argv[++c];
+    }
+    if (num_frames < 1)
+        num_frames = 1;
+
+    /* setup engine */
+    TLN_Init(HRES, VRES, 2, NUM_ROTATING, 1);
+    framebuffer = malloc((size_t)HRES * VRES * 4);
+    times = malloc((size_t)num_frames * sizeof(uint64_t));
+    pixel_map = malloc((size_t)HRES * VRES * sizeof(TLN_PixelMap));
+    if (framebuffer == NULL || times == NULL || pixel_map == NULL) {
+        TLN_Deinit();
+        return 1;
+    }
+    TLN_SetRenderTarget(framebuffer, HRES * 4);
+    TLN_SetBGColor(0, 32, 64);
+
+    /* horizontal waves */
+    for (c = 0; c < HRES * VRES; c++) {
+        pixel_map[c].dx = (int16_t)(c % HRES + (c / HRES) % 16 - 8);
+        pixel_map[c].dy = (int16_t)(c / HRES);
+    }
+
+    if (!LoadAssets(assets)) {
+        printf("Cannot load assets from %s\n", assets);
+        TLN_Deinit();
+        return 1;
+    }
+    TLN_SetCustomBlendFunction(CustomBlend);
+
+    printf("%-24s %8s %10s %10s %10s\n", "scene", "ns/pixel", "p50 us", "p95 us", "p99 us");
+    BenchTiled();
+    BenchSprites();
+    BenchBitmap();
+    BenchObjects();
+
+    if (json != NULL && !WriteJSON(json))
+        printf("Cannot write %s\n", json);
+
+    TLN_DeleteTilemap(priority);
+    TLN_DeleteTilemap(foreground);
+    TLN_DeleteTilemap(background);
+    TLN_DeleteSpriteset(spriteset);
+    TLN_DeleteBitmap(bitmap);
+    TLN_DeleteSequencePack(sequences);
+    TLN_DeleteObjectList(objects);
+    TLN_Deinit();
+    free(pixel_map);
+    free(times);
+    free(framebuffer);
+    return 0;
+}
@@ -6,11 +6,16 @@
 #define HRES 400
 #define VRES 240
 #define NUM_SPRITES 250
+#define MAX_SPRITES 4000
 #define NUM_FRAMES 2000
+#define NUM_SCALING_FRAMES 200
 
 static int pixels;
 
 static uint32_t Profile(void);
+static uint32_t ProfileFrames(uint32_t num_frames);
+static uint32_t ProfileFrameRate(uint32_t num_frames);
+static void SetupSprites(TLN_Spriteset spriteset, int num_sprites);
 
 int main(void) {
     int c;
@@ -28,7 +33,7 @@ int main(void) {
     printf("http://www.tilengine.org\n\n");
 
     /* setup engine */
-    TLN_Init(HRES, VRES, 1, NUM_SPRITES, 0);
+    TLN_Init(HRES, VRES, 1, MAX_SPRITES, 0);
     framebuffer = malloc((size_t)HRES * VRES * 4);
     TLN_SetRenderTarget(framebuffer, HRES * 4);
     TLN_DisableBGColor();
@@ -45,6 +50,11 @@ int main(void) {
     printf("Normal layer..........");
     Profile();
 
+    printf("Cached layer..........");
+    TLN_SetTileCacheBudget(1 << 20);
+    Profile();
+    TLN_SetTileCacheBudget(0);
+
     printf("Scaling layer.........");
     TLN_SetLayerScaling(0, 2.0f, 2.0f);
     Profile();
@@ -87,6 +97,20 @@ int main(void) {
         TLN_EnableSpriteCollision(c, true);
     Profile();
 
+    /* scattered sprites: each scanline is covered by a small fraction of them */
+    for (c = NUM_SPRITES; c <= MAX_SPRITES; c *= 2) {
+        SetupSprites(spriteset, c);
+        pixels = c * sprite_info.w * sprite_info.h;
+        printf("%4d sprites..........", c);
+        ProfileFrames(NUM_SCALING_FRAMES);
+    }
+
+    /* sprites past the left margin: scanlines only test their coverage */
+    for (c = 0; c < MAX_SPRITES; c++)
+        TLN_SetSpritePosition(c, -HRES, (c * 53) % VRES);
+    printf("%4d hidden sprites...", MAX_SPRITES);
+    ProfileFrameRate(NUM_SCALING_FRAMES);
+
     free(framebuffer);
     TLN_DeleteTilemap(tilemap);
     TLN_Deinit();
@@ -94,7 +118,28 @@ int main(void) {
     return 0;
 }
 
-static uint32_t Profile(void) {
+static uint32_t Profile(void) { return ProfileFrames(NUM_FRAMES); }
+
+/* scatters the given number of sprites across the screen, disables the rest */
+static void SetupSprites(TLN_Spriteset spriteset, int num_sprites) {
+    TLN_SpriteInfo sprite_info;
+    int c;
+
+    TLN_GetSpriteInfo(spriteset, 0, &sprite_info);
+    for (c = 0; c < MAX_SPRITES; c++) {
+        if (c < num_sprites) {
+            TLN_SetSpriteSet(c, spriteset);
+            TLN_SetSpritePicture(c, 0);
+            TLN_EnableSpriteCollision(c, false);
+            TLN_SetSpritePosition(c, (c * 37) % (HRES - sprite_info.w),
+                                  (c * 53) % (VRES - sprite_info.h));
+        } else {
+            TLN_DisableSprite(c);
+        }
+    }
+}
+
+static uint32_t ProfileFrames(uint32_t num_frames) {
     uint32_t t0;
     uint32_t elapse;
     uint32_t frame = 0;
@@ -104,10 +149,28 @@ static uint32_t Profile(void) {
     do {
         TLN_UpdateFrame((int)frame);
         frame++;
-    } while (frame < NUM_FRAMES);
+    } while (frame < num_frames);
     elapse = TLN_GetTicks() - t0;
-    result = frame * pixels / elapse;
+    result = (uint32_t)((uint64_t)frame * (uint64_t)pixels / elapse);
 
     printf(" %3u.%03u Mpixels/s\n", result / 1000, result % 1000);
     return result;
 }
+
+static uint32_t ProfileFrameRate(uint32_t num_frames) {
+    uint32_t t0;
+    uint32_t elapse;
+    uint32_t frame = 0;
+    uint32_t result;
+
+    t0 = TLN_GetTicks();
+    do {
+        TLN_UpdateFrame((int)frame);
+        frame++;
+    } while (frame < num_frames);
+    elapse = TLN_GetTicks() - t0;
+    result = elapse > 0 ? frame * 1000 / elapse : 0;
+
+    printf(" %7u frames/s\n", result);
+    return result;
+}
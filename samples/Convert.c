@@ -0,0 +1,80 @@
+/*
+ * Asset converter: loads a source asset and saves it in precompiled binary
+ * format, to be loaded with TLN_LoadBinaryAsset(). The type of asset is
+ * chosen by the extension of the input file:
+ *
+ *   .tmx         tilemap, of the given layer or the first one
+ *   .tsx         tileset
+ *   .png .bmp    bitmap
+ *   .sqx         sequence pack
+ *   .json .txt   spriteset, with the image of the same name
+ *   .act .pal    palette
+ *
+ * Binary files depend on the build of the library, convert them with the same
+ * version and platform that loads them.
+ *
+ * usage: tilengine_convert input output [layer]
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Tilengine.h"
+
+#ifdef _MSC_VER
+#define strcasecmp _stricmp
+#else
+#include <strings.h>
+#endif
+
+/* loads an asset by the extension of its file */
+static void *LoadAsset(const char *filename, const char *layer) {
+    char name[256];
+    const char *ext = strrchr(filename, '.');
+    if (ext == NULL)
+        return NULL;
+
+    if (!strcasecmp(ext, ".tmx"))
+        return TLN_LoadTilemap(filename, layer);
+    if (!strcasecmp(ext, ".tsx"))
+        return TLN_LoadTileset(filename);
+    if (!strcasecmp(ext, ".png") || !strcasecmp(ext, ".bmp"))
+        return TLN_LoadBitmap(filename);
+    if (!strcasecmp(ext, ".sqx"))
+        return TLN_LoadSequencePack(filename);
+    if (!strcasecmp(ext, ".act") || !strcasecmp(ext, ".pal"))
+        return TLN_LoadPalette(filename);
+    if (!strcasecmp(ext, ".json") || !strcasecmp(ext, ".txt")) {
+        /* spritesets are loaded by name, without extension */
+        snprintf(name, sizeof(name), "%.*s", (int)(ext - filename), filename);
+        return TLN_LoadSpriteset(name);
+    }
+    return NULL;
+}
+
+int main(int argc, char *argv[]) {
+    void *asset;
+    bool ok;
+
+    if (argc < 3) {
+        printf("usage: tilengine_convert input output [layer]\n");
+        return 1;
+    }
+
+    TLN_Init(8, 8, 0, 0, 0);
+    TLN_SetLogLevel(TLN_LOG_ERRORS);
+
+    asset = LoadAsset(argv[1], argc > 3 ? argv[3] : NULL);
+    if (asset == NULL) {
+        printf("Cannot load %s: %s\n", argv[1], TLN_GetErrorString(TLN_GetLastError()));
+        TLN_Deinit();
+        return 1;
+    }
+
+    ok = TLN_SaveBinaryAsset(argv[2], asset);
+    if (!ok)
+        printf("Cannot save %s: %s\n", argv[2], TLN_GetErrorString(TLN_GetLastError()));
+
+    TLN_Deinit();
+    return ok ? 0 : 1;
+}
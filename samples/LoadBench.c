@@ -0,0 +1,253 @@
+/*
+ * Loader benchmark: writes a large synthetic TMX map with its tile layer
+ * encoded in every format Tiled supports, plus a dense object layer, and
+ * measures how fast each one parses and loads.
+ *
+ * usage: tilengine_loadbench [-size n] [-objects n] [-passes n]
+ */
+
+#include <SDL3/SDL_timer.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "Tilengine.h"
+
+#define MAP_FILE "loadbench.tmx"
+#define LAYER_NAME "Layer 1"
+#define OBJECTS_NAME "Objects"
+
+typedef enum {
+    ENCODING_CSV,
+    ENCODING_BASE64,
+    ENCODING_ZLIB,
+    ENCODING_GZIP,
+    ENCODING_OBJECTS,
+} Encoding;
+
+typedef struct {
+    const char *name;
+    Encoding encoding;
+} Config;
+
+static const Config configs[] = {
+    {"csv", ENCODING_CSV},
+    {"base64", ENCODING_BASE64},
+    {"base64+zlib", ENCODING_ZLIB},
+    {"base64+gzip", ENCODING_GZIP},
+    {"objects", ENCODING_OBJECTS},
+};
+
+static int map_size = 1000;
+static int num_objects = 20000;
+static int num_passes = 4;
+static uint32_t seed = 1;
+
+static uint32_t random_value(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+/* runs of tiles with random flip flags, as a real level has */
+static uint32_t *create_tiles(size_t count) {
+    uint32_t *tiles = malloc(count * sizeof(uint32_t));
+    uint32_t tile = 1;
+    if (tiles == NULL)
+        return NULL;
+    for (size_t c = 0; c < count; c++) {
+        if (random_value() % 8 == 0) {
+            tile = random_value() % 256;
+            if (tile != 0 && random_value() % 4 == 0)
+                tile |= 0x80000000;
+        }
+        tiles[c] = tile;
+    }
+    return tiles;
+}
+
+static void write_base64(FILE *pf, uint8_t const *data, size_t size) {
+    static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t c;
+    for (c = 0; c + 3 <= size; c += 3) {
+        const uint32_t value = (uint32_t)data[c] << 16 | (uint32_t)data[c + 1] << 8 | data[c + 2];
+        fputc(digits[value >> 18], pf);
+        fputc(digits[(value >> 12) & 63], pf);
+        fputc(digits[(value >> 6) & 63], pf);
+        fputc(digits[value & 63], pf);
+    }
+    if (c < size) {
+        const uint32_t value = (uint32_t)data[c] << 16 | (c + 1 < size ? (uint32_t)data[c + 1] << 8 : 0);
+        fputc(digits[value >> 18], pf);
+        fputc(digits[(value >> 12) & 63], pf);
+        fputc(c + 1 < size ? digits[(value >> 6) & 63] : '=', pf);
+        fputc('=', pf);
+    }
+}
+
+/* deflates with a zlib (window 15) or gzip (window 31) wrapper */
+static uint8_t *compress_tiles(uint32_t const *tiles, size_t count, int window, size_t *size) {
+    z_stream strm = {0};
+    uint8_t *buffer;
+    uLong bound;
+
+    if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED, window, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return NULL;
+    bound = deflateBound(&strm, (uLong)(count * sizeof(uint32_t)));
+    buffer = malloc(bound);
+    if (buffer == NULL) {
+        deflateEnd(&strm);
+        return NULL;
+    }
+    strm.next_in = (Bytef *)tiles;
+    strm.avail_in = (uInt)(count * sizeof(uint32_t));
+    strm.next_out = buffer;
+    strm.avail_out = (uInt)bound;
+    if (deflate(&strm, Z_FINISH) != Z_STREAM_END) {
+        deflateEnd(&strm);
+        free(buffer);
+        return NULL;
+    }
+    *size = strm.total_out;
+    deflateEnd(&strm);
+    return buffer;
+}
+
+static bool write_layer(FILE *pf, Encoding encoding) {
+    const size_t count = (size_t)map_size * map_size;
+    uint32_t *tiles = create_tiles(count);
+    if (tiles == NULL)
+        return false;
+
+    fprintf(pf, " <layer id=\"1\" name=\"" LAYER_NAME "\" width=\"%d\" height=\"%d\">\n", map_size,
+            map_size);
+    if (encoding == ENCODING_CSV) {
+        fprintf(pf, "  <data encoding=\"csv\">\n");
+        for (size_t c = 0; c < count; c++) {
+            fprintf(pf, "%u", tiles[c]);
+            if (c + 1 < count)
+                fputc(',', pf);
+            if ((c + 1) % map_size == 0)
+                fputc('\n', pf);
+        }
+    } else if (encoding == ENCODING_BASE64) {
+        fprintf(pf, "  <data encoding=\"base64\">\n   ");
+        write_base64(pf, (uint8_t *)tiles, count * sizeof(uint32_t));
+        fputc('\n', pf);
+    } else {
+        size_t size = 0;
+        uint8_t *data = compress_tiles(tiles, count, encoding == ENCODING_ZLIB ? 15 : 31, &size);
+        if (data == NULL) {
+            free(tiles);
+            return false;
+        }
+        fprintf(pf, "  <data encoding=\"base64\" compression=\"%s\">\n   ",
+                encoding == ENCODING_ZLIB ? "zlib" : "gzip");
+        write_base64(pf, data, size);
+        fputc('\n', pf);
+        free(data);
+    }
+    fprintf(pf, "  </data>\n </layer>\n");
+    free(tiles);
+    return true;
+}
+
+/* rectangles with a couple of properties each */
+static void write_objects(FILE *pf) {
+    fprintf(pf, " <objectgroup id=\"2\" name=\"" OBJECTS_NAME "\">\n");
+    for (int c = 0; c < num_objects; c++) {
+        fprintf(pf, "  <object id=\"%d\" name=\"item%d\" type=\"pickup\" x=\"%u\" y=\"%u\" "
+                    "width=\"16\" height=\"16\">\n", c + 1, c,
+                random_value() % (uint32_t)(map_size * 16), random_value() % (uint32_t)(map_size * 16));
+        fprintf(pf, "   <properties>\n");
+        fprintf(pf, "    <property name=\"value\" type=\"int\" value=\"%u\"/>\n", random_value() % 100);
+        fprintf(pf, "    <property name=\"label\" value=\"bonus &amp; points\"/>\n");
+        fprintf(pf, "   </properties>\n  </object>\n");
+    }
+    fprintf(pf, " </objectgroup>\n");
+}
+
+/* writes the map and returns its size in bytes, or 0 on error */
+static long CreateMap(Encoding encoding) {
+    FILE *pf = fopen(MAP_FILE, "wt");
+    long size;
+    bool ok = true;
+    if (pf == NULL)
+        return 0;
+
+    fprintf(pf, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf(pf, "<map version=\"1.10\" orientation=\"orthogonal\" renderorder=\"right-down\" "
+                "width=\"%d\" height=\"%d\" tilewidth=\"16\" tileheight=\"16\" infinite=\"0\">\n",
+            map_size, map_size);
+    if (encoding == ENCODING_OBJECTS)
+        write_objects(pf);
+    else
+        ok = write_layer(pf, encoding);
+    fprintf(pf, "</map>\n");
+    size = ftell(pf);
+    fclose(pf);
+    return ok ? size : 0;
+}
+
+/* loads the map with the given configuration */
+static bool Run(Config const *config) {
+    const long size = CreateMap(config->encoding);
+    uint64_t load_time = 0;
+    int loaded = 0;
+
+    if (size == 0)
+        return false;
+
+    for (int pass = 0; pass < num_passes; pass++) {
+        const uint64_t t0 = SDL_GetTicksNS();
+        if (config->encoding == ENCODING_OBJECTS) {
+            TLN_ObjectList list = TLN_LoadObjectList(MAP_FILE, OBJECTS_NAME);
+            load_time += SDL_GetTicksNS() - t0;
+            if (list != NULL && TLN_GetListNumObjects(list) == num_objects)
+                loaded += 1;
+            TLN_DeleteObjectList(list);
+        } else {
+            TLN_Tilemap tilemap = TLN_LoadTilemap(MAP_FILE, LAYER_NAME);
+            load_time += SDL_GetTicksNS() - t0;
+            if (tilemap != NULL && TLN_GetTilemapCols(tilemap) == map_size &&
+                TLN_GetTilemapRows(tilemap) == map_size)
+                loaded += 1;
+            TLN_DeleteTilemap(tilemap);
+        }
+    }
+    remove(MAP_FILE);
+
+    printf("%-14s %9.1f %10.2f %10.1f %7s\n", config->name, size / 1048576.0,
+           load_time / 1e6 / num_passes, (double)size * num_passes / 1048576.0 / (load_time / 1e9),
+           loaded == num_passes ? "ok" : "FAILED");
+    return loaded == num_passes;
+}
+
+int main(int argc, char *argv[]) {
+    bool ok = true;
+
+    for (int c = 1; c < argc - 1; c++) {
+        if (!strcmp(argv[c], "-size"))
+            map_size = atoi(argv[++c]);
+        else if (!strcmp(argv[c], "-objects"))
+            num_objects = atoi(argv[++c]);
+        else if (!strcmp(argv[c], "-passes"))
+            num_passes = atoi(argv[++c]);
+    }
+    if (map_size < 1)
+        map_size = 1;
+    if (num_objects < 1)
+        num_objects = 1;
+    if (num_passes < 1)
+        num_passes = 1;
+
+    TLN_Init(8, 8, 0, 0, 0);
+
+    printf("%dx%d tiles, %d objects\n", map_size, map_size, num_objects);
+    printf("%-14s %9s %10s %10s\n", "map", "size MB", "ms/load", "MB/s");
+    for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]) && ok; c++)
+        ok = Run(&configs[c]);
+
+    TLN_Deinit();
+    return ok ? 0 : 1;
+}
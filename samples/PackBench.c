@@ -0,0 +1,219 @@
+/*
+ * Resource pack benchmark: builds a large synthetic pack of compressible XML
+ * and indexed bitmap assets, stored and compressed, plain and encrypted, and
+ * measures how fast each one opens and loads all its assets in random order.
+ *
+ * usage: tilengine_packbench [-assets n] [-passes n]
+ */
+
+#include <SDL3/SDL_timer.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ResourcePacker.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#define mkdir(path) _mkdir(path)
+#define rmdir(path) _rmdir(path)
+#else
+#include <sys/stat.h>
+#include <unistd.h>
+#define mkdir(path) mkdir(path, 0755)
+#endif
+
+#define DIRECTORY "packbench"
+#define LIST_FILE DIRECTORY ".txt"
+#define PACK_FILE DIRECTORY ".dat"
+#define PASSPHRASE "benchmark"
+
+typedef struct {
+    const char *name;
+    bool compression;
+    const char *passphrase;
+} Config;
+
+static const Config configs[] = {
+    {"stored", false, NULL},
+    {"compressed", true, NULL},
+    {"stored+aes", false, PASSPHRASE},
+    {"compressed+aes", true, PASSPHRASE},
+};
+
+static int num_assets = 4000;
+static int num_passes = 4;
+static char (*names)[32];
+static size_t total_size;
+static uint32_t seed = 1;
+
+static uint32_t random_value(void) {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+}
+
+/* tileset-like XML with a csv layer */
+static size_t write_xml(FILE *pf) {
+    const int cols = 32 + (int)(random_value() % 96);
+    const int rows = 16 + (int)(random_value() % 48);
+    long start = ftell(pf);
+    int tile = (int)(random_value() % 64);
+
+    fprintf(pf, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf(pf, "<map version=\"1.2\" orientation=\"orthogonal\" width=\"%d\" height=\"%d\" "
+                "tilewidth=\"16\" tileheight=\"16\">\n", cols, rows);
+    fprintf(pf, " <layer name=\"Layer 1\" width=\"%d\" height=\"%d\">\n  <data encoding=\"csv\">\n",
+            cols, rows);
+    for (int y = 0; y < rows; y++) {
+        for (int x = 0; x < cols; x++) {
+            if (random_value() % 8 == 0)
+                tile = (int)(random_value() % 256);
+            fprintf(pf, "%d,", tile);
+        }
+        fputc('\n', pf);
+    }
+    fprintf(pf, "  </data>\n </layer>\n</map>\n");
+    return (size_t)(ftell(pf) - start);
+}
+
+/* 8 bpp bitmap-like runs of colors */
+static size_t write_bitmap(FILE *pf) {
+    const size_t size = 16384 + (random_value() % 49152);
+    size_t count = 0;
+    while (count < size) {
+        const int color = (int)(random_value() % 32);
+        size_t run = 1 + (random_value() % 24);
+        if (run > size - count)
+            run = size - count;
+        for (size_t c = 0; c < run; c++)
+            fputc(color, pf);
+        count += run;
+    }
+    return size;
+}
+
+/* writes synthetic assets and the list of files to pack */
+static bool CreateAssets(void) {
+    FILE *list = fopen(LIST_FILE, "wt");
+    if (list == NULL)
+        return false;
+
+    mkdir(DIRECTORY);
+    for (int c = 0; c < num_assets; c++) {
+        FILE *pf;
+        snprintf(names[c], sizeof(names[c]), DIRECTORY "/asset%05d.%s", c, c & 1 ? "bin" : "tmx");
+        pf = fopen(names[c], "wb");
+        if (pf == NULL) {
+            fclose(list);
+            return false;
+        }
+        total_size += c & 1 ? write_bitmap(pf) : write_xml(pf);
+        fclose(pf);
+        fprintf(list, "%s\n", names[c]);
+    }
+    fclose(list);
+    return true;
+}
+
+static void DeleteAssets(void) {
+    for (int c = 0; c < num_assets; c++)
+        remove(names[c]);
+    rmdir(DIRECTORY);
+    remove(LIST_FILE);
+    remove(PACK_FILE);
+}
+
+/* shuffles the order assets are loaded */
+static void Shuffle(int *order) {
+    for (int c = num_assets - 1; c > 0; c--) {
+        const int other = (int)(random_value() % (uint32_t)(c + 1));
+        const int tmp = order[c];
+        order[c] = order[other];
+        order[other] = tmp;
+    }
+}
+
+/* builds and loads a pack with the given configuration */
+static bool Run(Config const *config, int *order) {
+    ResPack respack;
+    FILE *pf;
+    long pack_size;
+    uint64_t t0;
+    uint64_t open_time;
+    uint64_t load_time = 0;
+    int loaded = 0;
+
+    if (ResPack_Build(LIST_FILE, config->passphrase, config->compression) != num_assets)
+        return false;
+    pf = fopen(PACK_FILE, "rb");
+    if (pf == NULL)
+        return false;
+    fseek(pf, 0, SEEK_END);
+    pack_size = ftell(pf);
+    fclose(pf);
+
+    t0 = SDL_GetTicksNS();
+    respack = ResPack_Open(PACK_FILE, config->passphrase);
+    open_time = SDL_GetTicksNS() - t0;
+    if (respack == NULL)
+        return false;
+
+    for (int pass = 0; pass < num_passes; pass++) {
+        Shuffle(order);
+        t0 = SDL_GetTicksNS();
+        for (int c = 0; c < num_assets; c++) {
+            void *asset = ResPack_LoadAsset(respack, names[order[c]], NULL);
+            if (asset != NULL) {
+                loaded += 1;
+                free(asset);
+            }
+        }
+        load_time += SDL_GetTicksNS() - t0;
+    }
+    ResPack_Close(respack);
+
+    printf("%-16s %9.1f %8.0f %10.2f %10.1f %7s\n", config->name, pack_size / 1048576.0,
+           open_time / 1000.0, load_time / 1000.0 / num_passes / num_assets,
+           (double)total_size * num_passes / 1048576.0 / (load_time / 1e9),
+           loaded == num_assets * num_passes ? "ok" : "FAILED");
+    return loaded == num_assets * num_passes;
+}
+
+int main(int argc, char *argv[]) {
+    int *order;
+    bool ok = true;
+
+    for (int c = 1; c < argc - 1; c++) {
+        if (!strcmp(argv[c], "-assets"))
+            num_assets = atoi(argv[++c]);
+        else if (!strcmp(argv[c], "-passes"))
+            num_passes = atoi(argv[++c]);
+    }
+    if (num_assets < 1)
+        num_assets = 1;
+    if (num_passes < 1)
+        num_passes = 1;
+
+    names = calloc((size_t)num_assets, sizeof(names[0]));
+    order = malloc((size_t)num_assets * sizeof(int));
+    if (names == NULL || order == NULL)
+        return 1;
+    for (int c = 0; c < num_assets; c++)
+        order[c] = c;
+
+    if (!CreateAssets()) {
+        printf("Cannot write assets to %s\n", DIRECTORY);
+        DeleteAssets();
+        return 1;
+    }
+
+    printf("%d assets, %.1f MB\n", num_assets, total_size / 1048576.0);
+    printf("%-16s %9s %8s %10s %10s\n", "pack", "size MB", "open us", "us/asset", "MB/s");
+    for (size_t c = 0; c < sizeof(configs) / sizeof(configs[0]) && ok; c++)
+        ok = Run(&configs[c], order);
+
+    DeleteAssets();
+    free(order);
+    free(names);
+    return ok ? 0 : 1;
+}
@@ -471,6 +471,7 @@ static void ColorCycle(struct Palette const *srcpalette, TLN_Palette dstpalette,
   int count = strip->count;
   int steps = strip->pos;
 
+  TouchPalette(dstpalette);
   if (strip->dir) {
     for (c = 0; c < count; c++) {
       dstptr[c] = srcptr[(c - steps + count) % count];
@@ -497,6 +498,7 @@ static void ColorCycleBlend(TLN_Palette srcpalette, TLN_Palette dstpalette,
   int f1 = lerp(t, t0, t1, 0, 255);
   int f0 = 255 - f1;
 
+  TouchPalette(dstpalette);
   for (int c = 0; c < count; c++) {
     if (strip->dir) {
       idx0 = (c - steps + count) % count;
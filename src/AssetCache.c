@@ -0,0 +1,518 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* asset cache: loading a file that is already loaded returns the same asset
+ * with one more reference, and deleting it drops a reference. Assets without
+ * references stay in the cache, in least recently used order, until their
+ * size exceeds the budget. Entries are keyed by asset type, resource pack and
+ * normalized path, and also chained by asset address so that TLN_DeleteXXX
+ * finds them. Assets are deleted outside the lock, as deleting one may release
+ * others */
+
+#include "AssetCache.h"
+
+#include <SDL3/SDL_atomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Bitmap.h"
+#include "LoadFile.h"
+#include "Palette.h"
+#include "Sequence.h"
+#include "SequencePack.h"
+#include "Spriteset.h"
+#include "Tilengine.h"
+#include "Tileset.h"
+
+#define NUM_BUCKETS 512
+#define MAX_ASSET_PATH 301         /* as LoadFile.c */
+#define DEFAULT_BUDGET (32 << 20) /* 32 MB of unused assets */
+
+typedef struct {
+    void *asset; /* NULL if the entry is free */
+    ObjectType type;
+    uint32_t pack; /* resource pack it was loaded from, 0 if none */
+    uint32_t hash;
+    int refs;
+    size_t size;
+    int next_key;   /* next entry in key hash chain, or free list */
+    int next_asset; /* next entry in address hash chain */
+    int newer;      /* unused list, most recently released first */
+    int older;
+    char path[MAX_ASSET_PATH];
+} AssetEntry;
+
+static struct {
+    AssetEntry *entries;
+    int max_entries;
+    int num_entries;
+    int free_entry;
+    int key_buckets[NUM_BUCKETS];
+    int asset_buckets[NUM_BUCKETS];
+    int newest; /* unused list ends, or -1 */
+    int oldest;
+    size_t budget;
+    size_t size;
+    size_t unused_size;
+    int num_assets;
+    int num_unused;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    bool init;
+} cache;
+
+static SDL_SpinLock cache_lock; /* assets may load in loader threads */
+
+static void init_cache(void) {
+    if (cache.init) {
+        return;
+    }
+    memset(cache.key_buckets, -1, sizeof(cache.key_buckets));
+    memset(cache.asset_buckets, -1, sizeof(cache.asset_buckets));
+    cache.free_entry = -1;
+    cache.newest = cache.oldest = -1;
+    cache.budget = DEFAULT_BUDGET;
+    cache.init = true;
+}
+
+/* FNV-1a of the key */
+static uint32_t hash_key(ObjectType type, uint32_t pack, const char *path) {
+    uint32_t hash = 2166136261U ^ (uint32_t)type;
+    hash = (hash ^ pack) * 16777619U;
+    while (*path != 0) {
+        hash = (hash ^ (uint8_t)*path++) * 16777619U;
+    }
+    return hash;
+}
+
+static inline int asset_bucket(void const *asset) {
+    return (int)((((uintptr_t)asset >> 4) * 2654435761U) & (NUM_BUCKETS - 1));
+}
+
+/* approximate memory used by an asset and the objects it owns */
+static size_t get_asset_size(void const *asset) {
+    size_t size = ObjectSize(asset);
+    switch (ObjectType(asset)) {
+    case OT_BITMAP: {
+        struct Bitmap const *bitmap = (struct Bitmap const *)asset;
+        if (bitmap->palette != NULL) {
+            size += ObjectSize(bitmap->palette);
+        }
+    } break;
+
+    case OT_TILESET: {
+        struct Tileset const *tileset = (struct Tileset const *)asset;
+        if (tileset->palette != NULL) {
+            size += ObjectSize(tileset->palette);
+        }
+        if (tileset->sp != NULL) {
+            size += get_asset_size(tileset->sp);
+        }
+        if (tileset->attributes != NULL) {
+            size += (size_t)tileset->numtiles * sizeof(TLN_TileAttributes);
+        }
+        if (tileset->color_key != NULL) {
+            size += (size_t)tileset->numtiles * (size_t)tileset->height;
+        }
+    } break;
+
+    case OT_SPRITESET: {
+        struct Spriteset const *spriteset = (struct Spriteset const *)asset;
+        if (spriteset->bitmap != NULL) {
+            size += get_asset_size(spriteset->bitmap);
+        }
+    } break;
+
+    case OT_SEQPACK: {
+        struct SequencePack const *sp = (struct SequencePack const *)asset;
+        for (TLN_Sequence sequence = sp->sequences; sequence != NULL;
+             sequence = sequence->next) {
+            size += ObjectSize(sequence);
+        }
+    } break;
+
+    default:
+        break;
+    }
+    return size;
+}
+
+/* the palette, sequences and images of a loaded tileset are created for it
+ * alone, unlike the ones passed to TLN_CreateTileset() */
+static void delete_tileset(TLN_Tileset tileset) {
+    if (tileset->tstype == TILESET_IMAGES) {
+        for (int c = 0; c < tileset->numtiles; c++) {
+            if (tileset->images[c].bitmap != NULL) {
+                TLN_DeleteBitmap(tileset->images[c].bitmap);
+            }
+        }
+    }
+    if (tileset->palette != NULL) {
+        TLN_DeletePalette(tileset->palette);
+    }
+    if (tileset->sp != NULL) {
+        TLN_DeleteSequencePack(tileset->sp);
+    }
+    TLN_DeleteTileset(tileset);
+}
+
+/* deletes an asset no longer in the cache */
+static void delete_asset(void *asset) {
+    switch (ObjectType(asset)) {
+    case OT_PALETTE:
+        TLN_DeletePalette((TLN_Palette)asset);
+        break;
+    case OT_TILESET:
+        delete_tileset((TLN_Tileset)asset);
+        break;
+    case OT_SPRITESET:
+        TLN_DeleteSpriteset((TLN_Spriteset)asset);
+        break;
+    case OT_BITMAP:
+        TLN_DeleteBitmap((TLN_Bitmap)asset);
+        break;
+    case OT_SEQPACK:
+        TLN_DeleteSequencePack((TLN_SequencePack)asset);
+        break;
+    default:
+        break;
+    }
+}
+
+static int find_key(ObjectType type, uint32_t pack, const char *path, uint32_t hash) {
+    int index = cache.key_buckets[hash & (NUM_BUCKETS - 1)];
+    while (index != -1) {
+        AssetEntry const *entry = &cache.entries[index];
+        if (entry->hash == hash && entry->type == type && entry->pack == pack &&
+            !strcmp(entry->path, path)) {
+            return index;
+        }
+        index = entry->next_key;
+    }
+    return -1;
+}
+
+static int find_asset(void const *asset) {
+    int index = cache.asset_buckets[asset_bucket(asset)];
+    while (index != -1 && cache.entries[index].asset != asset) {
+        index = cache.entries[index].next_asset;
+    }
+    return index;
+}
+
+static void unlink_unused(int index) {
+    AssetEntry *entry = &cache.entries[index];
+    if (entry->newer != -1) {
+        cache.entries[entry->newer].older = entry->older;
+    } else {
+        cache.newest = entry->older;
+    }
+    if (entry->older != -1) {
+        cache.entries[entry->older].newer = entry->newer;
+    } else {
+        cache.oldest = entry->newer;
+    }
+    cache.num_unused -= 1;
+    cache.unused_size -= entry->size;
+}
+
+static void link_unused(int index) {
+    AssetEntry *entry = &cache.entries[index];
+    entry->newer = -1;
+    entry->older = cache.newest;
+    if (cache.newest != -1) {
+        cache.entries[cache.newest].newer = index;
+    } else {
+        cache.oldest = index;
+    }
+    cache.newest = index;
+    cache.num_unused += 1;
+    cache.unused_size += entry->size;
+}
+
+/* removes an entry from the hash chains and the unused list, and frees it.
+ * Returns its asset */
+static void *remove_entry(int index) {
+    AssetEntry *entry = &cache.entries[index];
+    void *asset = entry->asset;
+    int *link = &cache.key_buckets[entry->hash & (NUM_BUCKETS - 1)];
+    while (*link != index) {
+        link = &cache.entries[*link].next_key;
+    }
+    *link = entry->next_key;
+    link = &cache.asset_buckets[asset_bucket(asset)];
+    while (*link != index) {
+        link = &cache.entries[*link].next_asset;
+    }
+    *link = entry->next_asset;
+
+    if (entry->refs == 0) {
+        unlink_unused(index);
+    }
+    cache.size -= entry->size;
+    cache.num_assets -= 1;
+    entry->asset = NULL;
+    entry->next_key = cache.free_entry;
+    cache.free_entry = index;
+    return asset;
+}
+
+/* returns an unused entry, or -1 */
+static int alloc_entry(void) {
+    if (cache.free_entry != -1) {
+        const int index = cache.free_entry;
+        cache.free_entry = cache.entries[index].next_key;
+        return index;
+    }
+    if (cache.num_entries == cache.max_entries) {
+        const int max_entries = cache.max_entries ? cache.max_entries * 2 : 64;
+        AssetEntry *entries =
+            (AssetEntry *)realloc(cache.entries, (size_t)max_entries * sizeof(AssetEntry));
+        if (entries == NULL) {
+            return -1;
+        }
+        cache.entries = entries;
+        cache.max_entries = max_entries;
+    }
+    return cache.num_entries++;
+}
+
+/* deletes the least recently used assets until the unused ones fit the
+ * budget */
+static void trim_cache(void) {
+    while (true) {
+        void *asset = NULL;
+        SDL_LockSpinlock(&cache_lock);
+        if (cache.unused_size > cache.budget && cache.oldest != -1) {
+            asset = remove_entry(cache.oldest);
+            cache.evictions += 1;
+        }
+        SDL_UnlockSpinlock(&cache_lock);
+        if (asset == NULL) {
+            return;
+        }
+        delete_asset(asset);
+    }
+}
+
+/* returns the asset loaded from filename with a new reference, or NULL if it
+ * must be loaded */
+void *GetCachedAsset(ObjectType type, const char *filename) {
+    char path[MAX_ASSET_PATH];
+    void *asset = NULL;
+    if (filename == NULL) {
+        return NULL;
+    }
+
+    const uint32_t pack = GetAssetPath(filename, path, sizeof(path));
+    const uint32_t hash = hash_key(type, pack, path);
+    SDL_LockSpinlock(&cache_lock);
+    init_cache();
+    const int index = find_key(type, pack, path, hash);
+    if (index != -1) {
+        AssetEntry *entry = &cache.entries[index];
+        if (entry->refs == 0) {
+            unlink_unused(index);
+        }
+        entry->refs += 1;
+        asset = entry->asset;
+        cache.hits += 1;
+    } else {
+        cache.misses += 1;
+    }
+    SDL_UnlockSpinlock(&cache_lock);
+
+    if (asset != NULL) {
+        TLN_SetLastError(TLN_ERR_OK);
+    }
+    return asset;
+}
+
+/* adds an asset just loaded from filename with one reference, and returns it.
+ * If another thread loaded the same file meanwhile, deletes this one and
+ * returns the other */
+void *AddCachedAsset(ObjectType type, const char *filename, void *asset) {
+    char path[MAX_ASSET_PATH];
+    void *loaded = NULL;
+    if (filename == NULL || asset == NULL) {
+        return asset;
+    }
+
+    /* tilemaps and object lists hold level state, they're not shared */
+    switch (ObjectType(asset)) {
+    case OT_PALETTE:
+    case OT_TILESET:
+    case OT_SPRITESET:
+    case OT_BITMAP:
+    case OT_SEQPACK:
+        break;
+    default:
+        return asset;
+    }
+
+    const uint32_t pack = GetAssetPath(filename, path, sizeof(path));
+    const uint32_t hash = hash_key(type, pack, path);
+    SDL_LockSpinlock(&cache_lock);
+    init_cache();
+    int index = find_key(type, pack, path, hash);
+    if (index != -1) {
+        AssetEntry *entry = &cache.entries[index];
+        if (entry->refs == 0) {
+            unlink_unused(index);
+        }
+        entry->refs += 1;
+        loaded = entry->asset;
+    } else {
+        index = alloc_entry();
+        if (index != -1) {
+            AssetEntry *entry = &cache.entries[index];
+            entry->asset = asset;
+            entry->type = type;
+            entry->pack = pack;
+            entry->hash = hash;
+            entry->refs = 1;
+            entry->size = get_asset_size(asset);
+            strcpy(entry->path, path);
+            entry->next_key = cache.key_buckets[hash & (NUM_BUCKETS - 1)];
+            cache.key_buckets[hash & (NUM_BUCKETS - 1)] = index;
+            entry->next_asset = cache.asset_buckets[asset_bucket(asset)];
+            cache.asset_buckets[asset_bucket(asset)] = index;
+            cache.size += entry->size;
+            cache.num_assets += 1;
+        }
+    }
+    SDL_UnlockSpinlock(&cache_lock);
+
+    /* untracked assets can't be shared, loaders must not get them */
+    if (index == -1) {
+        delete_asset(asset);
+        TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
+        return NULL;
+    }
+    if (loaded != NULL) {
+        delete_asset(asset);
+        asset = loaded;
+    }
+    return asset;
+}
+
+/* adds a reference to a cached asset, for objects that share the asset of
+ * another one */
+void RetainAsset(void *asset) {
+    if (asset == NULL) {
+        return;
+    }
+    SDL_LockSpinlock(&cache_lock);
+    const int index = cache.init ? find_asset(asset) : -1;
+    if (index != -1) {
+        AssetEntry *entry = &cache.entries[index];
+        if (entry->refs == 0) {
+            unlink_unused(index);
+        }
+        entry->refs += 1;
+    }
+    SDL_UnlockSpinlock(&cache_lock);
+}
+
+/* drops a reference to an asset, keeping it in the cache while it fits the
+ * budget. Returns false if the asset isn't cached and must be deleted */
+bool ReleaseAsset(void *asset) {
+    SDL_LockSpinlock(&cache_lock);
+    const int index = cache.init ? find_asset(asset) : -1;
+    if (index != -1) {
+        AssetEntry *entry = &cache.entries[index];
+        if (entry->refs > 0) {
+            entry->refs -= 1;
+            if (entry->refs == 0) {
+                link_unused(index);
+            }
+        }
+    }
+    SDL_UnlockSpinlock(&cache_lock);
+
+    if (index == -1) {
+        return false;
+    }
+    trim_cache();
+    return true;
+}
+
+/*!
+ * \brief
+ * Sets the memory budget of the asset cache
+ *
+ * \param size
+ * Maximum size in bytes of assets kept after being deleted, 32 MB by default.
+ * 0 deletes assets as soon as they aren't used
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * Palettes, bitmaps, tilesets, spritesets, sequence packs and binary assets
+ * of these types are cached: loading a file already loaded returns the same
+ * asset, shared by both loads, and deleting it only deletes it when all loads
+ * have been deleted. Files are identified by their path, relative to the
+ * path set with TLN_SetLoadPath(), and the resource pack they're loaded from.
+ * Deleted assets are kept, so loading them again costs nothing, until their
+ * size exceeds the budget and the least recently deleted ones are freed.
+ * Tilemaps and object lists aren't cached, as they're usually modified during
+ * gameplay, but the tilesets they reference are.
+ *
+ * \see
+ * TLN_GetAssetCacheStats()
+ */
+bool TLN_SetAssetCacheBudget(int size) {
+    if (size < 0) {
+        TLN_SetLastError(TLN_ERR_WRONG_SIZE);
+        return false;
+    }
+    SDL_LockSpinlock(&cache_lock);
+    init_cache();
+    cache.budget = (size_t)size;
+    SDL_UnlockSpinlock(&cache_lock);
+    trim_cache();
+    TLN_SetLastError(TLN_ERR_OK);
+    return true;
+}
+
+/*!
+ * \brief
+ * Returns the usage statistics of the asset cache
+ *
+ * \param stats
+ * Pointer to the structure that receives the statistics
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \see
+ * TLN_SetAssetCacheBudget()
+ */
+bool TLN_GetAssetCacheStats(TLN_AssetCacheStats *stats) {
+    if (stats == NULL) {
+        TLN_SetLastError(TLN_ERR_NULL_POINTER);
+        return false;
+    }
+    SDL_LockSpinlock(&cache_lock);
+    init_cache();
+    stats->hits = cache.hits;
+    stats->misses = cache.misses;
+    stats->evictions = cache.evictions;
+    stats->num_assets = (uint32_t)cache.num_assets;
+    stats->num_unused = (uint32_t)cache.num_unused;
+    stats->size = cache.size;
+    stats->unused_size = cache.unused_size;
+    stats->budget = cache.budget;
+    SDL_UnlockSpinlock(&cache_lock);
+    TLN_SetLastError(TLN_ERR_OK);
+    return true;
+}
@@ -0,0 +1,26 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+#ifndef ASSETCACHE_H
+#define ASSETCACHE_H
+
+#include <stdbool.h>
+
+#include "Object.h"
+
+/* assets loaded with TLN_LoadXXX, shared by all loads of the same file and
+ * released by the matching TLN_DeleteXXX, see AssetCache.c. Binary assets
+ * are keyed with OT_NONE */
+void *GetCachedAsset(ObjectType type, const char *filename);
+void *AddCachedAsset(ObjectType type, const char *filename, void *asset);
+void RetainAsset(void *asset);
+bool ReleaseAsset(void *asset);
+
+#endif
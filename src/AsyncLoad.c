@@ -0,0 +1,604 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* asynchronous asset loading: loads are queued to a pool of loader threads
+ * that run the regular TLN_LoadXXX functions, which keep their parser state
+ * on the stack. Errors set while loading go to the load instead of the engine,
+ * and completed loads with a callback wait in a ready list until the render
+ * thread dispatches them in TLN_UpdateFrame() */
+
+#include "AsyncLoad.h"
+
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_cpuinfo.h>
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Tilengine.h"
+
+#define DEFAULT_THREADS 2 /* started by the first load if not set */
+#define MAX_THREADS 64
+#define NAME_SIZE 200
+#define LAYER_NAME_SIZE 64
+
+typedef enum {
+    LOAD_TILEMAP,
+    LOAD_TILESET,
+    LOAD_SPRITESET,
+    LOAD_BITMAP,
+    LOAD_SEQUENCEPACK,
+    LOAD_JOB,
+} LoadType;
+
+typedef enum {
+    STATE_QUEUED,
+    STATE_RUNNING,
+    STATE_DONE,
+} LoadState;
+
+typedef struct AsyncLoad AsyncLoad;
+
+struct AsyncLoad {
+    LoadType type;
+    LoadState state;
+    bool released; /* handle released while running, asset deleted when done */
+    bool ready;    /* done and waiting in the ready list for its callback */
+    char filename[NAME_SIZE];
+    char layername[LAYER_NAME_SIZE]; /* tilemap layer, empty for the first one */
+    TLN_LoadCallback callback;
+    LoadJob job; /* function run by LOAD_JOB */
+    void *data;  /* user data for callback or job */
+    void *asset;
+    TLN_Error error;
+    AsyncLoad *next; /* next in queue or ready list */
+};
+
+/* singly linked list of loads */
+typedef struct {
+    AsyncLoad *first;
+    AsyncLoad *last;
+} LoadList;
+
+static struct {
+    SDL_Mutex *lock;     /* protects everything but num_ready */
+    SDL_Condition *wake; /* loads queued or quit requested */
+    SDL_Condition *done; /* some load completed */
+    SDL_Thread *threads[MAX_THREADS];
+    int num_threads;
+    LoadList queue;
+    LoadList ready;
+    SDL_AtomicInt num_ready; /* items in ready list, checked each frame without locking */
+    bool quit;
+} pool;
+
+static SDL_TLSID error_slot; /* error of the load run by a loader thread */
+
+static void add_load(LoadList *list, AsyncLoad *load) {
+    load->next = NULL;
+    if (list->last != NULL) {
+        list->last->next = load;
+    } else {
+        list->first = load;
+    }
+    list->last = load;
+}
+
+static void remove_load(LoadList *list, AsyncLoad *load) {
+    AsyncLoad *prev = NULL;
+    AsyncLoad *item = list->first;
+    while (item != NULL && item != load) {
+        prev = item;
+        item = item->next;
+    }
+    if (item == NULL) {
+        return;
+    }
+    if (prev != NULL) {
+        prev->next = load->next;
+    } else {
+        list->first = load->next;
+    }
+    if (list->last == load) {
+        list->last = prev;
+    }
+}
+
+static void *run_load(AsyncLoad const *load) {
+    switch (load->type) {
+    case LOAD_TILEMAP:
+        return TLN_LoadTilemap(load->filename, load->layername[0] ? load->layername : NULL);
+    case LOAD_TILESET:
+        return TLN_LoadTileset(load->filename);
+    case LOAD_SPRITESET:
+        return TLN_LoadSpriteset(load->filename);
+    case LOAD_BITMAP:
+        return TLN_LoadBitmap(load->filename);
+    case LOAD_SEQUENCEPACK:
+        return TLN_LoadSequencePack(load->filename);
+    case LOAD_JOB:
+        return load->job(load->data);
+    }
+    return NULL;
+}
+
+static void delete_asset(AsyncLoad const *load) {
+    if (load->asset == NULL) {
+        return;
+    }
+    switch (load->type) {
+    case LOAD_TILEMAP:
+        TLN_DeleteTilemap((TLN_Tilemap)load->asset);
+        break;
+    case LOAD_TILESET:
+        TLN_DeleteTileset((TLN_Tileset)load->asset);
+        break;
+    case LOAD_SPRITESET:
+        TLN_DeleteSpriteset((TLN_Spriteset)load->asset);
+        break;
+    case LOAD_BITMAP:
+        TLN_DeleteBitmap((TLN_Bitmap)load->asset);
+        break;
+    case LOAD_SEQUENCEPACK:
+        TLN_DeleteSequencePack((TLN_SequencePack)load->asset);
+        break;
+    case LOAD_JOB:
+        break;
+    }
+}
+
+static int LoaderThread(void *data [[maybe_unused]]) {
+    SDL_LockMutex(pool.lock);
+    while (true) {
+        while (pool.queue.first == NULL && !pool.quit) {
+            SDL_WaitCondition(pool.wake, pool.lock);
+        }
+        AsyncLoad *load = pool.queue.first;
+        if (load == NULL) {
+            break; /* quit once the queue is empty */
+        }
+        remove_load(&pool.queue, load);
+        load->state = STATE_RUNNING;
+        SDL_UnlockMutex(pool.lock);
+
+        SDL_SetTLS(&error_slot, &load->error, NULL);
+        load->asset = run_load(load);
+
+        SDL_LockMutex(pool.lock);
+        const bool released = load->released;
+        load->state = STATE_DONE;
+        if (!released && load->callback != NULL) {
+            load->ready = true;
+            add_load(&pool.ready, load);
+            SDL_AddAtomicInt(&pool.num_ready, 1);
+        }
+        SDL_BroadcastCondition(pool.done);
+        SDL_UnlockMutex(pool.lock);
+
+        if (released) {
+            delete_asset(load);
+            free(load);
+        }
+        SDL_SetTLS(&error_slot, NULL, NULL);
+        SDL_LockMutex(pool.lock);
+    }
+    SDL_UnlockMutex(pool.lock);
+    return 0;
+}
+
+/* stops loader threads after they finish queued loads */
+static void stop_threads(void) {
+    SDL_LockMutex(pool.lock);
+    pool.quit = true;
+    SDL_BroadcastCondition(pool.wake);
+    SDL_UnlockMutex(pool.lock);
+    for (int c = 0; c < pool.num_threads; c++) {
+        SDL_WaitThread(pool.threads[c], NULL);
+    }
+    pool.num_threads = 0;
+    pool.quit = false;
+}
+
+static bool start_threads(int num_threads) {
+    if (pool.lock == NULL) {
+        pool.lock = SDL_CreateMutex();
+        pool.wake = SDL_CreateCondition();
+        pool.done = SDL_CreateCondition();
+        if (pool.lock == NULL || pool.wake == NULL || pool.done == NULL) {
+            DeleteLoaderThreads();
+            return false;
+        }
+    }
+    for (int c = 0; c < num_threads; c++) {
+        pool.threads[c] = SDL_CreateThread(LoaderThread, "TLN_Loader", NULL);
+        if (pool.threads[c] == NULL) {
+            stop_threads();
+            return false;
+        }
+        pool.num_threads += 1;
+    }
+    return true;
+}
+
+/* returns where errors set by the calling thread go when it's loading an
+ * asset for a TLN_LoadXXXAsync() function, or NULL */
+TLN_Error *GetLoadError(void) { return (TLN_Error *)SDL_GetTLS(&error_slot); }
+
+/* calls the callbacks of completed loads, from the thread drawing frames */
+void DispatchLoadCallbacks(void) {
+    while (SDL_GetAtomicInt(&pool.num_ready) > 0) {
+        SDL_LockMutex(pool.lock);
+        AsyncLoad *load = pool.ready.first;
+        if (load != NULL) {
+            remove_load(&pool.ready, load);
+            load->ready = false;
+            SDL_AddAtomicInt(&pool.num_ready, -1);
+        }
+        SDL_UnlockMutex(pool.lock);
+        if (load == NULL) {
+            return;
+        }
+        /* may release the handle */
+        load->callback(load, load->asset, load->data);
+    }
+}
+
+/* stops loader threads after finishing queued loads, and frees the pool.
+ * Handles stay valid */
+void DeleteLoaderThreads(void) {
+    if (pool.num_threads > 0) {
+        stop_threads();
+    }
+    if (pool.done != NULL) {
+        SDL_DestroyCondition(pool.done);
+    }
+    if (pool.wake != NULL) {
+        SDL_DestroyCondition(pool.wake);
+    }
+    if (pool.lock != NULL) {
+        SDL_DestroyMutex(pool.lock);
+    }
+    pool.done = pool.wake = NULL;
+    pool.lock = NULL;
+}
+
+/* adds a load to the queue, starting the default loader threads if needed */
+static bool push_load(AsyncLoad *load) {
+    if (pool.num_threads == 0 && !start_threads(DEFAULT_THREADS)) {
+        free(load);
+        TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
+        return false;
+    }
+
+    SDL_LockMutex(pool.lock);
+    add_load(&pool.queue, load);
+    SDL_SignalCondition(pool.wake);
+    SDL_UnlockMutex(pool.lock);
+    TLN_SetLastError(TLN_ERR_OK);
+    return true;
+}
+
+/* queues the load of an asset */
+static AsyncLoad *queue_load(LoadType type, const char *filename, const char *layername,
+                             TLN_LoadCallback callback, void *data) {
+    if (filename == NULL) {
+        TLN_SetLastError(TLN_ERR_NULL_POINTER);
+        return NULL;
+    }
+    if (strlen(filename) >= NAME_SIZE ||
+        (layername != NULL && strlen(layername) >= LAYER_NAME_SIZE)) {
+        TLN_SetLastError(TLN_ERR_WRONG_SIZE);
+        return NULL;
+    }
+
+    AsyncLoad *load = (AsyncLoad *)calloc(1, sizeof(AsyncLoad));
+    if (load == NULL) {
+        TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
+        return NULL;
+    }
+    load->type = type;
+    strcpy(load->filename, filename);
+    if (layername != NULL) {
+        strcpy(load->layername, layername);
+    }
+    load->callback = callback;
+    load->data = data;
+    return push_load(load) ? load : NULL;
+}
+
+/* queues a job, used by loaders that split their own work like
+ * TLN_LoadWorld(). Jobs must not wait for jobs queued after them */
+TLN_AsyncLoad QueueLoadJob(LoadJob job, void *data) {
+    AsyncLoad *load = (AsyncLoad *)calloc(1, sizeof(AsyncLoad));
+    if (load == NULL) {
+        TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
+        return NULL;
+    }
+    load->type = LOAD_JOB;
+    load->job = job;
+    load->data = data;
+    return push_load(load) ? load : NULL;
+}
+
+/*!
+ * \brief
+ * Sets the number of threads that load assets asynchronously
+ *
+ * \param num_threads
+ * Number of loader threads, 0 for one per CPU core
+ *
+ * \returns
+ * true if success or false if threads couldn't be created
+ *
+ * \remarks
+ * Loader threads are started with 2 threads by the first TLN_LoadXXXAsync()
+ * call if this function wasn't called before. Changing the number of threads
+ * waits for queued loads to finish.
+ *
+ * \see
+ * TLN_LoadBitmapAsync()
+ */
+bool TLN_SetLoaderThreads(int num_threads) {
+    if (num_threads < 0) {
+        TLN_SetLastError(TLN_ERR_WRONG_SIZE);
+        return false;
+    }
+    if (num_threads == 0) {
+        num_threads = SDL_GetNumLogicalCPUCores();
+    }
+    if (num_threads > MAX_THREADS) {
+        num_threads = MAX_THREADS;
+    }
+
+    if (pool.num_threads > 0) {
+        stop_threads();
+    }
+    if (!start_threads(num_threads)) {
+        TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
+        return false;
+    }
+    TLN_SetLastError(TLN_ERR_OK);
+    return true;
+}
+
+/*!
+ * \brief
+ * Loads a tilemap layer from a Tiled .tmx file in a loader thread
+ *
+ * \param filename
+ * TMX file with the tilemap
+ *
+ * \param layername
+ * Optional name of the layer inside the tmx file to load. NULL to load the
+ * first layer
+ *
+ * \param callback
+ * Optional function called from TLN_UpdateFrame() when the load completes
+ *
+ * \param data
+ * User data passed to callback
+ *
+ * \returns
+ * Handle of the load or NULL if error
+ *
+ * \see
+ * TLN_LoadTilemap(), TLN_LoadBitmapAsync()
+ */
+TLN_AsyncLoad TLN_LoadTilemapAsync(const char *filename, const char *layername,
+                                   TLN_LoadCallback callback, void *data) {
+    return queue_load(LOAD_TILEMAP, filename, layername, callback, data);
+}
+
+/*!
+ * \brief
+ * Loads a tileset from a Tiled .tsx file in a loader thread
+ *
+ * \param filename
+ * TSX file to load
+ *
+ * \param callback
+ * Optional function called from TLN_UpdateFrame() when the load completes
+ *
+ * \param data
+ * User data passed to callback
+ *
+ * \returns
+ * Handle of the load or NULL if error
+ *
+ * \see
+ * TLN_LoadTileset(), TLN_LoadBitmapAsync()
+ */
+TLN_AsyncLoad TLN_LoadTilesetAsync(const char *filename, TLN_LoadCallback callback, void *data) {
+    return queue_load(LOAD_TILESET, filename, NULL, callback, data);
+}
+
+/*!
+ * \brief
+ * Loads a spriteset from an image png and its associated atlas descriptor in
+ * a loader thread
+ *
+ * \param name
+ * Base name of the files containing the spriteset, with or without .png
+ * extension
+ *
+ * \param callback
+ * Optional function called from TLN_UpdateFrame() when the load completes
+ *
+ * \param data
+ * User data passed to callback
+ *
+ * \returns
+ * Handle of the load or NULL if error
+ *
+ * \see
+ * TLN_LoadSpriteset(), TLN_LoadBitmapAsync()
+ */
+TLN_AsyncLoad TLN_LoadSpritesetAsync(const char *name, TLN_LoadCallback callback, void *data) {
+    return queue_load(LOAD_SPRITESET, name, NULL, callback, data);
+}
+
+/*!
+ * \brief
+ * Loads an image from a png or bmp file in a loader thread
+ *
+ * \param filename
+ * PNG or BMP file to load
+ *
+ * \param callback
+ * Optional function called from TLN_UpdateFrame() when the load completes
+ *
+ * \param data
+ * User data passed to callback
+ *
+ * \returns
+ * Handle of the load or NULL if error
+ *
+ * \remarks
+ * The load is queued and the function returns immediately. Completion can be
+ * polled with TLN_IsLoadDone() or awaited with TLN_WaitLoad(), which return
+ * the same asset and error as TLN_LoadBitmap(). When a callback is given,
+ * it's called from the next TLN_UpdateFrame() after the load completes, in
+ * the thread drawing frames, so it can attach the asset to layers or sprites.
+ * The handle must be released with TLN_DeleteAsyncLoad(), which can be done
+ * from the callback.
+ *
+ * \see
+ * TLN_LoadBitmap(), TLN_SetLoaderThreads()
+ */
+TLN_AsyncLoad TLN_LoadBitmapAsync(const char *filename, TLN_LoadCallback callback, void *data) {
+    return queue_load(LOAD_BITMAP, filename, NULL, callback, data);
+}
+
+/*!
+ * \brief
+ * Loads a sqx file containing one or more sequences in a loader thread
+ *
+ * \param filename
+ * SQX filename with the sequences to load
+ *
+ * \param callback
+ * Optional function called from TLN_UpdateFrame() when the load completes
+ *
+ * \param data
+ * User data passed to callback
+ *
+ * \returns
+ * Handle of the load or NULL if error
+ *
+ * \see
+ * TLN_LoadSequencePack(), TLN_LoadBitmapAsync()
+ */
+TLN_AsyncLoad TLN_LoadSequencePackAsync(const char *filename, TLN_LoadCallback callback,
+                                        void *data) {
+    return queue_load(LOAD_SEQUENCEPACK, filename, NULL, callback, data);
+}
+
+/*!
+ * \brief
+ * Checks if an asynchronous load has completed
+ *
+ * \param load
+ * Handle returned by a TLN_LoadXXXAsync() function
+ *
+ * \returns
+ * true if completed, successfully or not, or false if still loading
+ *
+ * \see
+ * TLN_WaitLoad()
+ */
+bool TLN_IsLoadDone(TLN_AsyncLoad load) {
+    if (load == NULL) {
+        TLN_SetLastError(TLN_ERR_NULL_POINTER);
+        return false;
+    }
+    SDL_LockMutex(pool.lock);
+    const bool done = load->state == STATE_DONE;
+    SDL_UnlockMutex(pool.lock);
+    TLN_SetLastError(TLN_ERR_OK);
+    return done;
+}
+
+/*!
+ * \brief
+ * Waits for an asynchronous load to complete and returns the loaded asset
+ *
+ * \param load
+ * Handle returned by a TLN_LoadXXXAsync() function
+ *
+ * \returns
+ * Reference to the loaded asset, to be cast to its type, or NULL if error
+ *
+ * \remarks
+ * The last error is set to the error of the load. Returns immediately when
+ * the load has completed, so it can also fetch the asset after
+ * TLN_IsLoadDone() returns true. Waiting doesn't call the load callback,
+ * which is still called from the next TLN_UpdateFrame().
+ *
+ * \see
+ * TLN_IsLoadDone()
+ */
+void *TLN_WaitLoad(TLN_AsyncLoad load) {
+    if (load == NULL) {
+        TLN_SetLastError(TLN_ERR_NULL_POINTER);
+        return NULL;
+    }
+    SDL_LockMutex(pool.lock);
+    while (load->state != STATE_DONE) {
+        SDL_WaitCondition(pool.done, pool.lock);
+    }
+    void *asset = load->asset;
+    const TLN_Error error = load->error;
+    SDL_UnlockMutex(pool.lock);
+    TLN_SetLastError(error);
+    return asset;
+}
+
+/*!
+ * \brief
+ * Releases the handle of an asynchronous load
+ *
+ * \param load
+ * Handle returned by a TLN_LoadXXXAsync() function
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * Releasing a completed load keeps the asset, which belongs to the
+ * application. Releasing a load that hasn't completed cancels it: its
+ * callback isn't called, and its asset is deleted when loaded.
+ *
+ * \see
+ * TLN_LoadBitmapAsync()
+ */
+bool TLN_DeleteAsyncLoad(TLN_AsyncLoad load) {
+    if (load == NULL) {
+        TLN_SetLastError(TLN_ERR_NULL_POINTER);
+        return false;
+    }
+    SDL_LockMutex(pool.lock);
+    bool release = true;
+    if (load->state == STATE_QUEUED) {
+        remove_load(&pool.queue, load);
+    } else if (load->state == STATE_RUNNING) {
+        load->released = true; /* freed by its loader thread */
+        release = false;
+    } else if (load->ready) {
+        remove_load(&pool.ready, load);
+        SDL_AddAtomicInt(&pool.num_ready, -1);
+    }
+    SDL_UnlockMutex(pool.lock);
+    if (release) {
+        free(load);
+    }
+    TLN_SetLastError(TLN_ERR_OK);
+    return true;
+}
@@ -0,0 +1,27 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* asynchronous asset loading (see TLN_LoadBitmapAsync) */
+
+#ifndef ASYNCLOAD_H
+#define ASYNCLOAD_H
+
+#include "Tilengine.h"
+
+TLN_Error *GetLoadError(void);
+void DispatchLoadCallbacks(void);
+void DeleteLoaderThreads(void);
+
+/* internal work run by loader threads, waited with TLN_WaitLoad(). Its result
+ * belongs to the caller and isn't deleted if the handle is released early */
+typedef void *(*LoadJob)(void *data);
+TLN_AsyncLoad QueueLoadJob(LoadJob job, void *data);
+
+#endif
@@ -17,64 +17,52 @@ static const unsigned char d[] = {
     66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66,
     66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66, 66};
 
-/* Accumulate one decoded character into buf; flush to out when full. */
-static int accumulate(unsigned char c, int *buf, unsigned char **out, int *len, int outLen) {
-    *buf = *buf << 6 | c;
-    if (!(*buf & 0x1000000)) {
-        return 0;
-    }
-    *len += 3;
-    if (*len > outLen) {
-        return 1; /* buffer overflow */
-    }
-    *(*out)++ = (unsigned char)(*buf >> 16);
-    *(*out)++ = (unsigned char)(*buf >> 8);
-    *(*out)++ = (unsigned char)(*buf);
-    *buf = 1;
-    return 0;
+void base64open(Base64Stream *stream, const unsigned char *in, int inLen) {
+    stream->in = in;
+    stream->end = in + inLen;
+    stream->buf = 1;
 }
 
-int base64decode(const unsigned char *in, int inLen, unsigned char *out, int *outLen) {
-    const unsigned char *end = in + inLen;
-    int buf = 1;
+/* decodes up to outLen bytes (at least 3) of the stream. Returns the number of
+ * bytes decoded, 0 at the end of the input or -1 if it is invalid */
+int base64read(Base64Stream *stream, unsigned char *out, int outLen) {
     int len = 0;
 
-    while (*in < 'A') {
-        in++;
-    }
-
-    while (in < end) {
-        unsigned char c = d[*in++];
+    while (stream->in < stream->end && len + 3 <= outLen) {
+        unsigned char c = *stream->in++;
+        if (c <= ' ') {
+            continue; /* skip line breaks and indentation */
+        }
 
+        c = d[c];
         switch (c) {
         case WHITESPACE:
             continue; /* skip whitespace */
         case INVALID:
-            return 1; /* invalid input, return error */
-        case EQUALS:  /* pad character, end of data */
-            in = end;
+            return -1; /* invalid input, return error */
+        case EQUALS:   /* pad character, end of data */
+            stream->in = stream->end;
             continue;
         default:
-            if (accumulate(c, &buf, &out, &len, *outLen)) {
-                return 1;
+            stream->buf = stream->buf << 6 | c;
+            if (stream->buf & 0x1000000) {
+                out[len++] = (unsigned char)(stream->buf >> 16);
+                out[len++] = (unsigned char)(stream->buf >> 8);
+                out[len++] = (unsigned char)(stream->buf);
+                stream->buf = 1;
             }
         }
     }
 
-    if (buf & 0x40000) {
-        len = len + 2;
-        if (len > *outLen) {
-            return 1; /* buffer overflow */
-        }
-        *out++ = (unsigned char)(buf >> 10);
-        *out++ = (unsigned char)(buf >> 2);
-    } else if (buf & 0x1000) {
-        if (++len > *outLen) {
-            return 1; /* buffer overflow */
+    /* trailing group of one or two bytes */
+    if (stream->in == stream->end && len + 2 <= outLen) {
+        if (stream->buf & 0x40000) {
+            out[len++] = (unsigned char)(stream->buf >> 10);
+            out[len++] = (unsigned char)(stream->buf >> 2);
+        } else if (stream->buf & 0x1000) {
+            out[len++] = (unsigned char)(stream->buf >> 4);
         }
-        *out++ = (unsigned char)(buf >> 4);
+        stream->buf = 1;
     }
-
-    *outLen = len; /* modify to reflect the actual output size */
-    return 0;
+    return len;
 }
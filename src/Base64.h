@@ -5,7 +5,15 @@
 extern "C" {
 #endif
 
-int base64decode(const unsigned char *in, int inLen, unsigned char *out, int *outLen);
+/* incremental decoder, see base64read() */
+typedef struct {
+    const unsigned char *in;
+    const unsigned char *end;
+    int buf;
+} Base64Stream;
+
+void base64open(Base64Stream *stream, const unsigned char *in, int inLen);
+int base64read(Base64Stream *stream, unsigned char *out, int outLen);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,806 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* precompiled binary assets: engine objects are saved as their memory image,
+ * so loading one is a copy and a few pointer fixups instead of decoding XML
+ * and PNG files. File layout, offsets from the start of the file:
+ *
+ *   BinaryHeader
+ *   BinaryEntry[num_objects], the first one is the saved asset
+ *   object images aligned to BINARY_ALIGN, each one followed by the arrays it
+ *   owns outside its block (tileset attributes, color keys and tile indexes)
+ *
+ * Pointers to other objects hold their entry index + 1, and pointers to owned
+ * data hold its offset from the start of the object + 1, so NULL stays 0.
+ * Struct layouts depend on the compiler and CPU, files made by a library with
+ * a different layout are rejected */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "AssetCache.h"
+#include "Bitmap.h"
+#include "LoadFile.h"
+#include "Palette.h"
+#include "Sequence.h"
+#include "SequencePack.h"
+#include "Spriteset.h"
+#include "TileCache.h"
+#include "Tilemap.h"
+#include "Tileset.h"
+#include "Tilengine.h"
+#include "Trace.h"
+
+#define BINARY_MAGIC "TLNBIN"
+#define BINARY_VERSION 1
+#define BINARY_ALIGN 16
+#define MAX_ASSET_PATH 301 /* as LoadFile.c */
+
+#define ALIGN(size) (((size) + (BINARY_ALIGN - 1)) & ~(size_t)(BINARY_ALIGN - 1))
+
+typedef struct {
+    char magic[6];
+    uint16_t version;
+    uint32_t layout; /* see get_layout() */
+    uint32_t num_objects;
+} BinaryHeader;
+
+typedef struct {
+    uint32_t type;   /* ObjectType */
+    uint32_t size;   /* size of the object */
+    uint32_t offset; /* object image */
+    uint32_t total;  /* size of the image and the arrays following it */
+} BinaryEntry;
+
+/* objects reachable from the saved asset */
+typedef struct {
+    void **objects;
+    uint32_t count;
+    uint32_t capacity;
+} ObjectTable;
+
+/* load manager */
+typedef struct {
+    BinaryEntry const *entries;
+    void **objects;
+    uint32_t num_objects;
+    bool ok; /* cleared by any invalid reference */
+} Loader;
+
+/* signature of the layout of saved structs */
+static uint32_t get_layout(void) {
+    const uint32_t sizes[] = {
+        (uint32_t)sizeof(void *),
+        (uint32_t)sizeof(int),
+        (uint32_t)sizeof(bool),
+        (uint32_t)sizeof(struct Palette),
+        (uint32_t)sizeof(struct Bitmap),
+        (uint32_t)sizeof(struct Tileset),
+        (uint32_t)sizeof(struct Tilemap),
+        (uint32_t)sizeof(struct Spriteset),
+        (uint32_t)sizeof(struct SequencePack),
+        (uint32_t)sizeof(struct Sequence),
+        (uint32_t)sizeof(SpriteEntry),
+        (uint32_t)sizeof(TLN_TileImage),
+        (uint32_t)sizeof(TLN_TileAttributes),
+        (uint32_t)sizeof(TLN_SequenceFrame),
+        (uint32_t)sizeof(struct Strip),
+        (uint32_t)sizeof(Tile),
+    };
+    uint32_t hash = 2166136261u;
+    for (size_t c = 0; c < sizeof(sizes) / sizeof(sizes[0]); c++) {
+        hash = (hash ^ sizes[c]) * 16777619u;
+    }
+    return hash;
+}
+
+/* sizes of the arrays a tileset owns outside its block */
+static size_t attributes_size(struct Tileset const *tileset) {
+    return (size_t)tileset->numtiles * sizeof(TLN_TileAttributes);
+}
+
+static size_t color_key_size(struct Tileset const *tileset) {
+    return (size_t)tileset->numtiles * (size_t)tileset->height;
+}
+
+static size_t tiles_size(struct Tileset const *tileset) {
+    return ((size_t)tileset->numtiles + 1) * sizeof(uint16_t);
+}
+
+/* returns index + 1 of an object in the table, or 0 if NULL or not found */
+static uintptr_t get_ref(ObjectTable const *table, const void *object) {
+    for (uint32_t c = 0; c < table->count && object != NULL; c++) {
+        if (table->objects[c] == object) {
+            return c + 1;
+        }
+    }
+    return 0;
+}
+
+/* adds an object and the objects it references to the table */
+static bool add_object(ObjectTable *table, void *object) {
+    if (object == NULL || get_ref(table, object) != 0) {
+        return true;
+    }
+    if (table->count == table->capacity) {
+        const uint32_t capacity = table->capacity ? table->capacity * 2 : 16;
+        void **objects = (void **)realloc(table->objects, capacity * sizeof(void *));
+        if (objects == NULL) {
+            return false;
+        }
+        table->objects = objects;
+        table->capacity = capacity;
+    }
+    table->objects[table->count++] = object;
+
+    bool ok = true;
+    switch (ObjectType(object)) {
+    case OT_BITMAP:
+        ok = add_object(table, ((TLN_Bitmap)object)->palette);
+        break;
+
+    case OT_TILESET: {
+        TLN_Tileset tileset = (TLN_Tileset)object;
+        ok = add_object(table, tileset->palette) && add_object(table, tileset->sp);
+        for (int c = 0; c < tileset->numtiles && ok && tileset->images != NULL; c++) {
+            ok = add_object(table, tileset->images[c].bitmap);
+        }
+    } break;
+
+    case OT_TILEMAP: {
+        TLN_Tilemap tilemap = (TLN_Tilemap)object;
+        for (int c = 0; c < MAX_TILESETS && ok; c++) {
+            ok = add_object(table, tilemap->tilesets[c]);
+        }
+    } break;
+
+    case OT_SPRITESET: {
+        TLN_Spriteset spriteset = (TLN_Spriteset)object;
+        ok = add_object(table, spriteset->bitmap) && add_object(table, spriteset->palette);
+    } break;
+
+    case OT_SEQPACK:
+        ok = add_object(table, ((TLN_SequencePack)object)->sequences);
+        break;
+
+    case OT_SEQUENCE:
+        ok = add_object(table, ((TLN_Sequence)object)->next);
+        break;
+
+    default:
+        break;
+    }
+    return ok;
+}
+
+/* total size of an object image and its arrays */
+static size_t get_image_size(void const *object) {
+    size_t size = ObjectSize(object);
+    if (ObjectType(object) == OT_TILESET) {
+        struct Tileset const *tileset = (struct Tileset const *)object;
+        if (tileset->attributes != NULL) {
+            size += attributes_size(tileset);
+        }
+        if (tileset->color_key != NULL) {
+            size += color_key_size(tileset);
+        }
+        if (tileset->tiles != NULL) {
+            size += tiles_size(tileset);
+        }
+    }
+    return size;
+}
+
+/* appends an array owned by a tileset to its image, returning the reference */
+static void *put_array(uint8_t *image, size_t *offset, const void *data, size_t size) {
+    if (data == NULL) {
+        return NULL;
+    }
+    memcpy(image + *offset, data, size);
+    const uintptr_t ref = *offset + 1;
+    *offset += size;
+    return (void *)ref;
+}
+
+/* builds the image of an object with its pointers replaced by references */
+static void build_image(ObjectTable const *table, void const *object, uint8_t *image) {
+    const size_t size = ObjectSize(object);
+    memcpy(image, object, size);
+
+#define REF(ptr) (void *)get_ref(table, ptr)
+    switch (ObjectType(object)) {
+    case OT_BITMAP: {
+        struct Bitmap *bitmap = (struct Bitmap *)image;
+        bitmap->palette = REF(bitmap->palette);
+    } break;
+
+    case OT_TILESET: {
+        struct Tileset const *src = (struct Tileset const *)object;
+        struct Tileset *tileset = (struct Tileset *)image;
+        size_t offset = size;
+        tileset->palette = REF(src->palette);
+        tileset->sp = REF(src->sp);
+        tileset->animations = NULL;
+        tileset->remap = NULL;
+        tileset->num_remap = 0;
+        tileset->attributes = put_array(image, &offset, src->attributes, attributes_size(src));
+        tileset->color_key = put_array(image, &offset, src->color_key, color_key_size(src));
+        tileset->tiles = put_array(image, &offset, src->tiles, tiles_size(src));
+        if (src->images != NULL) {
+            tileset->images = (TLN_TileImage *)(uintptr_t)((uint8_t *)src->images -
+                                                           (uint8_t *)src + 1);
+            TLN_TileImage *images = (TLN_TileImage *)(image + ((uint8_t *)src->images -
+                                                               (uint8_t *)src));
+            for (int c = 0; c < src->numtiles; c++) {
+                images[c].bitmap = REF(images[c].bitmap);
+            }
+        }
+    } break;
+
+    case OT_TILEMAP: {
+        struct Tilemap *tilemap = (struct Tilemap *)image;
+        for (int c = 0; c < MAX_TILESETS; c++) {
+            tilemap->tilesets[c] = REF(tilemap->tilesets[c]);
+        }
+    } break;
+
+    case OT_SPRITESET: {
+        struct Spriteset *spriteset = (struct Spriteset *)image;
+        spriteset->bitmap = REF(spriteset->bitmap);
+        spriteset->palette = REF(spriteset->palette);
+    } break;
+
+    case OT_SEQPACK: {
+        struct SequencePack *sp = (struct SequencePack *)image;
+        sp->sequences = REF(sp->sequences);
+        sp->last = REF(sp->last);
+    } break;
+
+    case OT_SEQUENCE: {
+        struct Sequence *sequence = (struct Sequence *)image;
+        sequence->next = REF(sequence->next);
+    } break;
+
+    default:
+        break;
+    }
+#undef REF
+}
+
+/* writes the table of objects */
+static bool write_objects(FILE *pf, ObjectTable const *table) {
+    BinaryHeader header = {0};
+    memcpy(header.magic, BINARY_MAGIC, sizeof(header.magic));
+    header.version = BINARY_VERSION;
+    header.layout = get_layout();
+    header.num_objects = table->count;
+
+    BinaryEntry *entries = (BinaryEntry *)calloc(table->count, sizeof(BinaryEntry));
+    if (entries == NULL) {
+        return false;
+    }
+
+    size_t offset = ALIGN(sizeof(BinaryHeader) + (table->count * sizeof(BinaryEntry)));
+    size_t max_total = 0;
+    for (uint32_t c = 0; c < table->count; c++) {
+        void const *object = table->objects[c];
+        const size_t total = get_image_size(object);
+        entries[c].type = (uint32_t)ObjectType(object);
+        entries[c].size = ObjectSize(object);
+        entries[c].offset = (uint32_t)offset;
+        entries[c].total = (uint32_t)total;
+        offset = ALIGN(offset + total);
+        if (total > max_total) {
+            max_total = total;
+        }
+    }
+
+    bool ok = offset <= UINT32_MAX;
+    uint8_t *image = ok ? (uint8_t *)calloc(1, ALIGN(max_total)) : NULL;
+    if (image != NULL) {
+        ok = fwrite(&header, sizeof(header), 1, pf) == 1 &&
+             fwrite(entries, sizeof(BinaryEntry), table->count, pf) == table->count;
+        for (uint32_t c = 0; c < table->count && ok; c++) {
+            const size_t padded = ALIGN(entries[c].total);
+            memset(image, 0, padded);
+            build_image(table, table->objects[c], image);
+            ok = fseek(pf, entries[c].offset, SEEK_SET) == 0 &&
+                 fwrite(image, padded, 1, pf) == 1;
+        }
+    } else {
+        ok = false;
+    }
+
+    free(image);
+    free(entries);
+    return ok;
+}
+
+/*!
+ * \brief
+ * Saves an asset in precompiled binary format
+ *
+ * \param filename
+ * File to write, with .tlb extension by convention
+ *
+ * \param asset
+ * Tilemap, tileset, spriteset, bitmap, palette, sequence pack or sequence to
+ * save
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * The objects referenced by the asset are saved with it, like the tilesets of
+ * a tilemap and their palettes. The file is tied to the build of the library
+ * that saved it, it's meant to be generated by the build process of a game
+ * from the source assets, with the tilengine_convert tool.
+ *
+ * \see
+ * TLN_LoadBinaryAsset()
+ */
+bool TLN_SaveBinaryAsset(const char *filename, void *asset) {
+    if (filename == NULL || asset == NULL) {
+        TLN_SetLastError(TLN_ERR_NULL_POINTER);
+        return false;
+    }
+
+    const ObjectType type = ObjectType(asset);
+    if (!CheckBaseObject(asset, type)) {
+        return false;
+    }
+    if (type == OT_NONE || type == OT_OBJECTLIST) {
+        TLN_SetLastError(TLN_ERR_UNSUPPORTED);
+        return false;
+    }
+
+    ObjectTable table = {0};
+    if (!add_object(&table, asset)) {
+        free(table.objects);
+        TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
+        return false;
+    }
+
+    FILE *pf = fopen(filename, "wb");
+    if (pf == NULL) {
+        free(table.objects);
+        TLN_SetLastError(TLN_ERR_FILE_NOT_FOUND);
+        return false;
+    }
+    const bool ok = write_objects(pf, &table);
+    fclose(pf);
+    free(table.objects);
+
+    TLN_SetLastError(ok ? TLN_ERR_OK : TLN_ERR_OUT_OF_MEMORY);
+    return ok;
+}
+
+/* checks that an object image holds the data its fields describe */
+static bool check_object(ObjectType type, void const *image, size_t size) {
+    size_t expected;
+    switch (type) {
+    case OT_PALETTE: {
+        struct Palette const *palette = (struct Palette const *)image;
+        if (size < sizeof(struct Palette) || palette->entries < 0) {
+            return false;
+        }
+        expected = sizeof(struct Palette) + ((size_t)palette->entries * sizeof(uint32_t));
+    } break;
+
+    case OT_BITMAP: {
+        struct Bitmap const *bitmap = (struct Bitmap const *)image;
+        if (size < sizeof(struct Bitmap) || bitmap->pitch < 0 || bitmap->height < 0) {
+            return false;
+        }
+        expected = sizeof(struct Bitmap) + ((size_t)bitmap->pitch * (size_t)bitmap->height);
+    } break;
+
+    case OT_TILESET: {
+        struct Tileset const *tileset = (struct Tileset const *)image;
+        if (size < sizeof(struct Tileset) || tileset->numtiles < 0 || tileset->width < 0 ||
+            tileset->height < 0) {
+            return false;
+        }
+        if (tileset->tstype == TILESET_IMAGES) {
+            expected = sizeof(struct Tileset) + ((size_t)tileset->numtiles * sizeof(TLN_TileImage));
+        } else {
+            expected = sizeof(struct Tileset) + ((size_t)tileset->width * (size_t)tileset->height *
+                                                 (size_t)tileset->numtiles);
+        }
+    } break;
+
+    case OT_TILEMAP: {
+        struct Tilemap const *tilemap = (struct Tilemap const *)image;
+        if (size < sizeof(struct Tilemap) || tilemap->rows < 0 || tilemap->cols < 0 ||
+            tilemap->occupancy_pitch != (tilemap->cols + 31) >> 5 || tilemap->num_tilesets < 0 ||
+            tilemap->num_tilesets > MAX_TILESETS) {
+            return false;
+        }
+        const size_t cells = (size_t)tilemap->rows * (size_t)tilemap->cols;
+        expected = sizeof(struct Tilemap) + (cells * sizeof(Tile)) +
+                   ((size_t)tilemap->rows * (size_t)tilemap->occupancy_pitch * sizeof(uint32_t));
+    } break;
+
+    case OT_SPRITESET: {
+        struct Spriteset const *spriteset = (struct Spriteset const *)image;
+        if (size < sizeof(struct Spriteset) || spriteset->entries < 0) {
+            return false;
+        }
+        expected = sizeof(struct Spriteset) + ((size_t)spriteset->entries * sizeof(SpriteEntry));
+    } break;
+
+    case OT_SEQPACK:
+        expected = sizeof(struct SequencePack);
+        break;
+
+    case OT_SEQUENCE: {
+        /* frames are the smallest items a sequence holds */
+        struct Sequence const *sequence = (struct Sequence const *)image;
+        if (size < sizeof(struct Sequence) || sequence->count < 0) {
+            return false;
+        }
+        expected = sizeof(struct Sequence) + ((size_t)sequence->count * sizeof(TLN_SequenceFrame));
+    } break;
+
+    default:
+        return false;
+    }
+    return size >= expected;
+}
+
+/* resolves a reference to another object, checking its type */
+static void *get_object(Loader *loader, const void *ref, ObjectType type) {
+    const uintptr_t index = (uintptr_t)ref;
+    if (index == 0) {
+        return NULL;
+    }
+    if (index > loader->num_objects || ObjectType(loader->objects[index - 1]) != type) {
+        loader->ok = false;
+        return NULL;
+    }
+    return loader->objects[index - 1];
+}
+
+/* copies an array owned by a tileset out of its image */
+static void *get_array(Loader *loader, uint8_t const *image, size_t total, const void *ref,
+                       size_t size) {
+    const uintptr_t offset = (uintptr_t)ref;
+    if (offset == 0) {
+        return NULL;
+    }
+    if (offset - 1 > total || size > total - (offset - 1)) {
+        loader->ok = false;
+        return NULL;
+    }
+    void *data = malloc(size ? size : 1);
+    if (data == NULL) {
+        loader->ok = false;
+        return NULL;
+    }
+    memcpy(data, image + offset - 1, size);
+    return data;
+}
+
+/* creates an object from its image, references are resolved later */
+static void *create_object(Loader *loader, BinaryEntry const *entry, uint8_t const *image) {
+    const ObjectType type = (ObjectType)entry->type;
+    const size_t size = entry->size;
+    if (!check_object(type, image, size)) {
+        loader->ok = false;
+        return NULL;
+    }
+
+    object_t *object = (object_t *)CreateBaseObject(type, size);
+    if (object == NULL) {
+        loader->ok = false;
+        return NULL;
+    }
+    memcpy(object->data, image + sizeof(object_t), size - sizeof(object_t));
+
+    if (type == OT_PALETTE) {
+        ((TLN_Palette)object)->version = NewTileCacheVersion();
+    } else if (type == OT_TILESET) {
+        TLN_Tileset tileset = (TLN_Tileset)object;
+        struct Tileset const *src = (struct Tileset const *)image;
+        tileset->version = NewTileCacheVersion();
+        tileset->animations = NULL;
+        tileset->remap = NULL;
+        tileset->num_remap = 0;
+        tileset->attributes = (TLN_TileAttributes *)get_array(
+            loader, image, entry->total, src->attributes, attributes_size(src));
+        tileset->color_key =
+            (bool *)get_array(loader, image, entry->total, src->color_key, color_key_size(src));
+        tileset->tiles =
+            (uint16_t *)get_array(loader, image, entry->total, src->tiles, tiles_size(src));
+        if (src->images != NULL) {
+            const uintptr_t offset = (uintptr_t)src->images - 1;
+            const size_t images_size = (size_t)src->numtiles * sizeof(TLN_TileImage);
+            if (offset < sizeof(struct Tileset) || offset + images_size > size) {
+                loader->ok = false;
+            } else {
+                tileset->images = (TLN_TileImage *)((uint8_t *)tileset + offset);
+            }
+        }
+    }
+    return object;
+}
+
+/* replaces references with the loaded objects */
+static void resolve_object(Loader *loader, void *object) {
+    switch (ObjectType(object)) {
+    case OT_BITMAP: {
+        TLN_Bitmap bitmap = (TLN_Bitmap)object;
+        bitmap->palette = (TLN_Palette)get_object(loader, bitmap->palette, OT_PALETTE);
+    } break;
+
+    case OT_TILESET: {
+        TLN_Tileset tileset = (TLN_Tileset)object;
+        tileset->palette = (TLN_Palette)get_object(loader, tileset->palette, OT_PALETTE);
+        tileset->sp = (TLN_SequencePack)get_object(loader, tileset->sp, OT_SEQPACK);
+        for (int c = 0; c < tileset->numtiles && tileset->images != NULL; c++) {
+            TLN_TileImage *image = &tileset->images[c];
+            image->bitmap = (TLN_Bitmap)get_object(loader, image->bitmap, OT_BITMAP);
+        }
+    } break;
+
+    case OT_TILEMAP: {
+        TLN_Tilemap tilemap = (TLN_Tilemap)object;
+        for (int c = 0; c < MAX_TILESETS; c++) {
+            tilemap->tilesets[c] =
+                (TLN_Tileset)get_object(loader, tilemap->tilesets[c], OT_TILESET);
+        }
+    } break;
+
+    case OT_SPRITESET: {
+        TLN_Spriteset spriteset = (TLN_Spriteset)object;
+        spriteset->bitmap = (TLN_Bitmap)get_object(loader, spriteset->bitmap, OT_BITMAP);
+        spriteset->palette = (TLN_Palette)get_object(loader, spriteset->palette, OT_PALETTE);
+    } break;
+
+    case OT_SEQPACK: {
+        TLN_SequencePack sp = (TLN_SequencePack)object;
+        sp->sequences = (TLN_Sequence)get_object(loader, sp->sequences, OT_SEQUENCE);
+        sp->last = (TLN_Sequence)get_object(loader, sp->last, OT_SEQUENCE);
+    } break;
+
+    case OT_SEQUENCE: {
+        TLN_Sequence sequence = (TLN_Sequence)object;
+        sequence->next = (TLN_Sequence)get_object(loader, sequence->next, OT_SEQUENCE);
+    } break;
+
+    default:
+        break;
+    }
+}
+
+/* checks that a sequence pack holds the sequences it counts, once linked */
+static bool check_sequences(Loader const *loader, TLN_SequencePack sp) {
+    TLN_Sequence sequence = sp->sequences;
+    TLN_Sequence last = NULL;
+    int count = 0;
+    while (sequence != NULL && count < (int)loader->num_objects) {
+        last = sequence;
+        sequence = sequence->next;
+        count += 1;
+    }
+    return sequence == NULL && count == sp->num_sequences && last == sp->last;
+}
+
+/* checks that every tile of a linked tilemap points into its tilesets */
+static bool check_tiles(TLN_Tilemap tilemap) {
+    const int num_tiles = tilemap->rows * tilemap->cols;
+    for (int c = 0; c < num_tiles; c++) {
+        Tile const *tile = &tilemap->tiles[c];
+        if (tile->index == 0) {
+            continue;
+        }
+        TLN_Tileset tileset = tilemap->tilesets[tile->tileset];
+        if (tileset == NULL || tile->index > tileset->numtiles) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* creates the runtime state of a linked object */
+static void finish_object(Loader *loader, void *object) {
+    if (ObjectType(object) == OT_SEQPACK) {
+        loader->ok = check_sequences(loader, (TLN_SequencePack)object);
+    } else if (ObjectType(object) == OT_TILESET) {
+        TLN_Tileset tileset = (TLN_Tileset)object;
+        if (tileset->sp != NULL && check_sequences(loader, tileset->sp) &&
+            tileset->sp->num_sequences > 0) {
+            tileset->animations =
+                (Animation *)calloc((size_t)tileset->sp->num_sequences, sizeof(Animation));
+            loader->ok = tileset->animations != NULL;
+        }
+    } else if (ObjectType(object) == OT_TILEMAP) {
+        /* the stored occupancy bits aren't trusted, they're rebuilt from the tiles */
+        TLN_Tilemap tilemap = (TLN_Tilemap)object;
+        loader->ok = check_tiles(tilemap);
+        UpdateTilemapOccupancy(tilemap, 0, tilemap->rows * tilemap->cols);
+        tilemap->occupancy_valid = true;
+    }
+}
+
+/* frees objects created by a failed load, without following references */
+static void delete_objects(Loader *loader) {
+    for (uint32_t c = 0; c < loader->num_objects; c++) {
+        void *object = loader->objects[c];
+        if (object != NULL && ObjectType(object) == OT_TILESET) {
+            TLN_Tileset tileset = (TLN_Tileset)object;
+            free(tileset->attributes);
+            free(tileset->color_key);
+            free(tileset->tiles);
+            free(tileset->animations);
+        }
+        DeleteBaseObject(object);
+    }
+}
+
+/* checks the header and table of a file */
+static bool check_file(MappedFile const *file) {
+    BinaryHeader const *header = (BinaryHeader const *)file->data;
+    if (file->size < sizeof(BinaryHeader) ||
+        memcmp(header->magic, BINARY_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != BINARY_VERSION || header->layout != get_layout() ||
+        header->num_objects == 0 ||
+        header->num_objects > (file->size - sizeof(BinaryHeader)) / sizeof(BinaryEntry)) {
+        return false;
+    }
+
+    BinaryEntry const *entries = (BinaryEntry const *)(header + 1);
+    for (uint32_t c = 0; c < header->num_objects; c++) {
+        BinaryEntry const *entry = &entries[c];
+        if (entry->offset % BINARY_ALIGN != 0 || entry->size < sizeof(object_t) ||
+            entry->total < entry->size || entry->offset > file->size ||
+            entry->total > file->size - entry->offset) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* returns the table index of a loaded object */
+static uint32_t get_object_index(Loader const *loader, void const *object) {
+    uint32_t index = 0;
+    while (index < loader->num_objects && loader->objects[index] != object) {
+        index += 1;
+    }
+    return index;
+}
+
+/* gives the tilesets of a loaded tilemap the ownership of tilesets loaded
+ * from .tmx: each one is cached under the file name and its index, and the
+ * tilemap holds a reference per slot released by TLN_DeleteTilemap(), so they
+ * are deleted with their palette, sequences and images */
+static bool share_tilesets(Loader const *loader, const char *filename, TLN_Tilemap tilemap) {
+    TLN_Tileset loaded[MAX_TILESETS];
+    bool ok = true;
+    for (int c = 0; c < MAX_TILESETS; c++) {
+        TLN_Tileset tileset = tilemap->tilesets[c];
+        loaded[c] = tileset;
+        if (tileset == NULL) {
+            continue;
+        }
+
+        /* a tileset in several slots is added once, with a reference per slot */
+        const bool owned = c == 0 || c < tilemap->num_tilesets;
+        int prev = 0;
+        while (prev < c && loaded[prev] != tileset) {
+            prev += 1;
+        }
+        if (prev < c) {
+            tilemap->tilesets[c] = tilemap->tilesets[prev];
+            if (owned) {
+                RetainAsset(tilemap->tilesets[c]);
+            }
+            continue;
+        }
+
+        char name[MAX_ASSET_PATH];
+        snprintf(name, sizeof(name), "%s#%u", filename, get_object_index(loader, tileset));
+        tilemap->tilesets[c] = (TLN_Tileset)AddCachedAsset(OT_TILESET, name, tileset);
+        ok &= tilemap->tilesets[c] != NULL;
+    }
+    return ok;
+}
+
+/* loads a binary asset, traced by TLN_LoadBinaryAsset() */
+static void *load_binary_asset(const char *filename) {
+    MappedFile file;
+    if (!MapFile(filename, &file)) {
+        TLN_SetLastError(TLN_ERR_FILE_NOT_FOUND);
+        return NULL;
+    }
+    if (!check_file(&file)) {
+        UnmapFile(&file);
+        TLN_SetLastError(TLN_ERR_WRONG_FORMAT);
+        return NULL;
+    }
+
+    BinaryHeader const *header = (BinaryHeader const *)file.data;
+    Loader loader = {0};
+    loader.entries = (BinaryEntry const *)(header + 1);
+    loader.num_objects = header->num_objects;
+    loader.objects = (void **)calloc(loader.num_objects, sizeof(void *));
+    loader.ok = loader.objects != NULL;
+
+    /* create all objects, then link them and build their runtime state */
+    for (uint32_t c = 0; c < loader.num_objects && loader.ok; c++) {
+        BinaryEntry const *entry = &loader.entries[c];
+        loader.objects[c] = create_object(&loader, entry, file.data + entry->offset);
+    }
+    for (uint32_t c = 0; c < loader.num_objects && loader.ok; c++) {
+        resolve_object(&loader, loader.objects[c]);
+    }
+    for (uint32_t c = 0; c < loader.num_objects && loader.ok; c++) {
+        finish_object(&loader, loader.objects[c]);
+    }
+    UnmapFile(&file);
+
+    void *asset = NULL;
+    if (loader.ok) {
+        asset = loader.objects[0];
+        TLN_SetLastError(TLN_ERR_OK);
+        if (ObjectType(asset) == OT_TILEMAP && !share_tilesets(&loader, filename, asset)) {
+            TLN_DeleteTilemap((TLN_Tilemap)asset);
+            asset = NULL;
+            TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
+        }
+    } else if (loader.objects != NULL) {
+        delete_objects(&loader);
+        TLN_SetLastError(TLN_ERR_WRONG_FORMAT);
+    } else {
+        TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
+    }
+    free(loader.objects);
+    return asset;
+}
+
+/*!
+ * \brief
+ * Loads an asset saved with TLN_SaveBinaryAsset()
+ *
+ * \param filename
+ * Binary asset file to load
+ *
+ * \returns
+ * Reference to the loaded asset, to be cast to the type that was saved, or
+ * NULL if error
+ *
+ * \remarks
+ * The file is mapped in memory and each object is copied in a single block,
+ * without decoding, so loading takes about as long as reading the file. The
+ * asset is deleted with the function matching its type, like an asset loaded
+ * from its source files. Files saved by a library built for another CPU or
+ * with another version of the engine structures are rejected with
+ * TLN_ERR_WRONG_FORMAT, and must be converted again. Assets other than
+ * tilemaps are shared by all loads of the same file, see
+ * TLN_SetAssetCacheBudget(). Tilemaps aren't, but their tilesets are.
+ *
+ * \see
+ * TLN_SaveBinaryAsset()
+ */
+void *TLN_LoadBinaryAsset(const char *filename) {
+    if (filename == NULL) {
+        TLN_SetLastError(TLN_ERR_NULL_POINTER);
+        return NULL;
+    }
+    const uint64_t trace = TraceBegin(TRACE_ALWAYS, 0);
+    void *asset = GetCachedAsset(OT_NONE, filename);
+    if (asset == NULL) {
+        asset = AddCachedAsset(OT_NONE, filename, load_binary_asset(filename));
+    }
+    TraceEndFile(trace, "LoadBinaryAsset", filename);
+    return asset;
+}
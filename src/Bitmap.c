@@ -16,6 +16,7 @@
 
 #include <string.h>
 
+#include "AssetCache.h"
 #include "Object.h"
 #include "Tilengine.h"
 
@@ -97,6 +98,10 @@ TLN_Bitmap TLN_CloneBitmap(TLN_Bitmap src) {
  */
 bool TLN_DeleteBitmap(TLN_Bitmap bitmap) {
     if (CheckBaseObject(bitmap, OT_BITMAP)) {
+        if (ReleaseAsset(bitmap)) {
+            TLN_SetLastError(TLN_ERR_OK);
+            return true;
+        }
         if (ObjectOwner(bitmap) && bitmap->palette) {
             TLN_DeletePalette(bitmap->palette);
         }
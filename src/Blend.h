@@ -0,0 +1,125 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* arithmetic blending: computes the same results as the blend tables built in
+ * Tables.c without memory lookups. Only BLEND_CUSTOM goes through its table.
+ * Pixels are blended on their RGB channels, keeping the destination alpha */
+
+#ifndef BLEND_H
+#define BLEND_H
+
+#include <stdint.h>
+
+#include "Tables.h"
+#include "Tilengine.h"
+
+#define RGB_MASK 0x00FFFFFFU
+#define ALPHA_MASK 0xFF000000U
+#define LOW_BITS 0x00010101U
+#define HIGH_BITS 0x00808080U
+
+/* exact x / 3 for x <= 765 */
+static inline uint32_t div3(uint32_t x) { return (x * 683) >> 11; }
+
+/* exact x / 10 for x <= 2550 */
+static inline uint32_t div10(uint32_t x) { return (x * 6554) >> 16; }
+
+/* exact x / 255 for x <= 65025 */
+static inline uint32_t div255(uint32_t x) { return (x + 1 + (x >> 8)) >> 8; }
+
+/* returns channel of a pixel */
+static inline uint32_t channel(uint32_t pixel, int shift) { return (pixel >> shift) & 0xFF; }
+
+/* returns blend of a channel for the modes without a SWAR formula */
+static inline uint32_t blend_channel(TLN_Blend mode, uint32_t a, uint32_t b) {
+    switch (mode) {
+    case BLEND_MIX25:
+        return div3(a + b + b);
+    case BLEND_MIX75:
+        return div3(a + a + b);
+    case BLEND_MIX90:
+        return div10(a * 9 + b);
+    default:
+        return div255(a * b);
+    }
+}
+
+/* blends src over dst with the given mode. table is only used with
+ * BLEND_CUSTOM */
+static inline uint32_t BlendPixel(TLN_Blend mode, uint8_t const *table, uint32_t src,
+                                  uint32_t dst) {
+    const uint32_t alpha = dst & ALPHA_MASK;
+    src &= RGB_MASK;
+    dst &= RGB_MASK;
+
+    switch (mode) {
+    /* (a + b) >> 1 without carries between channels */
+    case BLEND_MIX50:
+        return (((src >> 1) & 0x7F7F7F) + ((dst >> 1) & 0x7F7F7F) + (src & dst & LOW_BITS)) |
+               alpha;
+
+    /* add the low 7 bits, then saturate channels that carried out of bit 7 */
+    case BLEND_ADD: {
+        const uint32_t sum = ((src & ~HIGH_BITS) + (dst & ~HIGH_BITS)) ^ ((src ^ dst) & HIGH_BITS);
+        const uint32_t carry = ((src & dst) | ((src | dst) & ~sum)) & HIGH_BITS;
+        return sum | ((carry >> 7) * 0xFF) | alpha;
+    }
+
+    /* subtract with the high bits set so no channel borrows from the next, then
+     * clear channels that went below 0 */
+    case BLEND_SUB: {
+        const uint32_t diff = ((src | HIGH_BITS) - (dst & ~HIGH_BITS)) ^ ((src ^ ~dst) & HIGH_BITS);
+        const uint32_t borrow = ((~src & dst) | (~(src ^ dst) & diff)) & HIGH_BITS;
+        return (diff & ~((borrow >> 7) * 0xFF) & RGB_MASK) | alpha;
+    }
+
+    case BLEND_CUSTOM:
+        return (uint32_t)blendfunc(table, channel(src, 0), channel(dst, 0)) |
+               (uint32_t)blendfunc(table, channel(src, 8), channel(dst, 8)) << 8 |
+               (uint32_t)blendfunc(table, channel(src, 16), channel(dst, 16)) << 16 | alpha;
+
+    default:
+        return blend_channel(mode, channel(src, 0), channel(dst, 0)) |
+               blend_channel(mode, channel(src, 8), channel(dst, 8)) << 8 |
+               blend_channel(mode, channel(src, 16), channel(dst, 16)) << 16 | alpha;
+    }
+}
+
+/* calls func(mode, ...) with mode as a constant, so that BlendPixel() inlined
+ * in a loop doesn't test the mode on each pixel */
+#define BLEND_DISPATCH(mode, func, ...)                                                        \
+    switch (mode) {                                                                            \
+    case BLEND_MIX25:                                                                          \
+        func(BLEND_MIX25, __VA_ARGS__);                                                        \
+        break;                                                                                 \
+    case BLEND_MIX50:                                                                          \
+        func(BLEND_MIX50, __VA_ARGS__);                                                        \
+        break;                                                                                 \
+    case BLEND_MIX75:                                                                          \
+        func(BLEND_MIX75, __VA_ARGS__);                                                        \
+        break;                                                                                 \
+    case BLEND_MIX90:                                                                          \
+        func(BLEND_MIX90, __VA_ARGS__);                                                        \
+        break;                                                                                 \
+    case BLEND_ADD:                                                                            \
+        func(BLEND_ADD, __VA_ARGS__);                                                          \
+        break;                                                                                 \
+    case BLEND_SUB:                                                                            \
+        func(BLEND_SUB, __VA_ARGS__);                                                          \
+        break;                                                                                 \
+    case BLEND_MOD:                                                                            \
+        func(BLEND_MOD, __VA_ARGS__);                                                          \
+        break;                                                                                 \
+    default:                                                                                   \
+        func(BLEND_CUSTOM, __VA_ARGS__);                                                       \
+        break;                                                                                 \
+    }
+
+#endif
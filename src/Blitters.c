@@ -10,17 +10,70 @@
 
 #include "Blitters.h"
 
+#include <SDL3/SDL_cpuinfo.h>
 #include <stddef.h>
+#include <string.h>
 
+#include "Blend.h"
 #include "Math2D.h"
 #include "Palette.h"
 #include "Tables.h"
 #include "Tilengine.h"
 
-/* indexes for blitter array table */
-#define BLIT_BLEND 0
-#define BLIT_SCALING 1
-#define BLIT_KEY 2
+/* blending loops, called through BLEND_DISPATCH() ------------------------ */
+
+/* blends palette colors, skipping index 0 if key is set */
+static inline void blend_indexed(TLN_Blend mode, const uint8_t *srcpixel, uint32_t const *color,
+                                 uint32_t *dstpixel, int width, int dx, bool key,
+                                 const uint8_t *blend) {
+    while (width) {
+        const uint8_t item = *srcpixel;
+        if (!key || item) {
+            *dstpixel = BlendPixel(mode, blend, color[item], *dstpixel);
+        }
+        srcpixel += dx;
+        dstpixel++;
+        width--;
+    }
+}
+
+/* blends palette colors with scaling, skipping index 0 if key is set */
+static inline void blend_indexed_scaling(TLN_Blend mode, const uint8_t *srcpixel,
+                                         uint32_t const *color, uint32_t *dstpixel, int width,
+                                         int dx, int offset, bool key, const uint8_t *blend) {
+    while (width) {
+        const uint8_t item = *(srcpixel + (offset >> FIXED_BITS));
+        if (!key || item) {
+            *dstpixel = BlendPixel(mode, blend, color[item], *dstpixel);
+        }
+        offset += dx;
+        dstpixel++;
+        width--;
+    }
+}
+
+/* blends constant color */
+static inline void blend_color(TLN_Blend mode, uint32_t *dstpixel, uint32_t color, int width,
+                               const uint8_t *blend) {
+    while (width) {
+        *dstpixel = BlendPixel(mode, blend, color, *dstpixel);
+        dstpixel++;
+        width--;
+    }
+}
+
+/* blends 32 bpp pixels, skipping the ones with alpha 0 */
+static inline void blend_32(TLN_Blend mode, uint32_t const *src, uint32_t *dst, int width,
+                            const uint8_t *blend) {
+    while (width > 0) {
+        if ((*src & ALPHA_MASK) != 0) {
+            *dst = BlendPixel(mode, blend, *src, *dst);
+        }
+        src++;
+        dst++;
+        width--;
+    }
+}
 
 /* 8 to 32 BPP blitters ----------------------------------------------------- */
 
@@ -41,18 +94,8 @@ static void blitFast_8_32(const uint8_t *srcpixel, TLN_Palette palette, void *ds
 static void blitFastBlend_8_32(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr,
                                int width, int dx, int offset [[maybe_unused]],
                                const uint8_t *blend) {
-    uint8_t *dst;
-    uint32_t *color = (uint32_t *)palette->data;
-    dst = (uint8_t *)dstptr;
-    while (width) {
-        uint8_t const *src = (uint8_t *)&color[*srcpixel];
-        dst[0] = blendfunc(blend, src[0], dst[0]);
-        dst[1] = blendfunc(blend, src[1], dst[1]);
-        dst[2] = blendfunc(blend, src[2], dst[2]);
-        srcpixel += dx;
-        dst += sizeof(uint32_t);
-        width--;
-    }
+    BLEND_DISPATCH(GetBlendMode(blend), blend_indexed, srcpixel, palette->data,
+                   (uint32_t *)dstptr, width, dx, false, blend);
 }
 
 /* paints scanline without checking color key (always solid) with scaling */
@@ -73,19 +116,8 @@ static void blitFastScaling_8_32(const uint8_t *srcpixel, TLN_Palette palette, v
  * blending */
 static void blitFastBlendScaling_8_32(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr,
                                       int width, int dx, int offset, const uint8_t *blend) {
-    uint8_t *dst;
-    uint32_t *color = (uint32_t *)palette->data;
-    dst = (uint8_t *)dstptr;
-    while (width) {
-        uint32_t item = *(srcpixel + (offset >> FIXED_BITS));
-        uint8_t const *src = (uint8_t *)&color[item];
-        dst[0] = blendfunc(blend, src[0], dst[0]);
-        dst[1] = blendfunc(blend, src[1], dst[1]);
-        dst[2] = blendfunc(blend, src[2], dst[2]);
-        offset += dx;
-        dst += sizeof(uint32_t);
-        width--;
-    }
+    BLEND_DISPATCH(GetBlendMode(blend), blend_indexed_scaling, srcpixel, palette->data,
+                   (uint32_t *)dstptr, width, dx, offset, false, blend);
 }
 
 /* paints scanline skipping empty pixels */
@@ -106,21 +138,8 @@ static void blitKey_8_32(const uint8_t *srcpixel, TLN_Palette palette, void *dst
 /* paints scanline skipping empty pixels with blending */
 static void blitKeyBlend_8_32(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr, int width,
                               int dx, int offset [[maybe_unused]], const uint8_t *blend) {
-    uint8_t const *src;
-    uint8_t *dst;
-    uint32_t *color = (uint32_t *)palette->data;
-    dst = (uint8_t *)dstptr;
-    while (width) {
-        if (*srcpixel) {
-            src = (uint8_t *)&color[*srcpixel];
-            dst[0] = blendfunc(blend, src[0], dst[0]);
-            dst[1] = blendfunc(blend, src[1], dst[1]);
-            dst[2] = blendfunc(blend, src[2], dst[2]);
-        }
-        srcpixel += dx;
-        dst += sizeof(uint32_t);
-        width--;
-    }
+    BLEND_DISPATCH(GetBlendMode(blend), blend_indexed, srcpixel, palette->data,
+                   (uint32_t *)dstptr, width, dx, true, blend);
 }
 
 /* paints scanline skipping empty pixels with scaling */
@@ -141,49 +160,15 @@ static void blitKeyScaling_8_32(const uint8_t *srcpixel, TLN_Palette palette, vo
 /* paints scanline skipping empty pixels with scaling and blending */
 static void blitKeyBlendScaling_8_32(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr,
                                      int width, int dx, int offset, const uint8_t *blend) {
-    uint8_t const *src;
-    uint8_t *dst;
-    uint32_t *color = (uint32_t *)palette->data;
-    dst = (uint8_t *)dstptr;
-    while (width) {
-        uint32_t item = *(srcpixel + (offset >> FIXED_BITS));
-        if (item) {
-            src = (uint8_t *)&color[item];
-            dst[0] = blendfunc(blend, src[0], dst[0]);
-            dst[1] = blendfunc(blend, src[1], dst[1]);
-            dst[2] = blendfunc(blend, src[2], dst[2]);
-        }
-        offset += dx;
-        dst += sizeof(uint32_t);
-        width--;
-    }
-}
-
-/* blitter table selector */
-static const ScanBlitPtr blitters[] = {
-    blitFast_8_32, blitFastBlend_8_32, blitFastScaling_8_32, blitFastBlendScaling_8_32,
-    blitKey_8_32,  blitKeyBlend_8_32,  blitKeyScaling_8_32,  blitKeyBlendScaling_8_32};
-
-/* returns suitable blitter for specified conditions */
-ScanBlitPtr SelectBlitter(bool key, bool scaling, bool blend) {
-    int index =
-        ((int)key << BLIT_KEY) + ((int)scaling << BLIT_SCALING) + ((int)blend << BLIT_BLEND);
-    return blitters[index];
+    BLEND_DISPATCH(GetBlendMode(blend), blend_indexed_scaling, srcpixel, palette->data,
+                   (uint32_t *)dstptr, width, dx, offset, true, blend);
 }
 
 /* paints constant color */
-void BlitColor(void *dstptr, uint32_t color, int width, const uint8_t *blend) {
+static void blitColor_32(void *dstptr, uint32_t color, int width, const uint8_t *blend) {
     /* blend */
     if (blend != NULL) {
-        uint8_t const *src = (uint8_t *)&color;
-        uint8_t *dst = (uint8_t *)dstptr;
-        while (width) {
-            dst[0] = blendfunc(blend, src[0], dst[0]);
-            dst[1] = blendfunc(blend, src[1], dst[1]);
-            dst[2] = blendfunc(blend, src[2], dst[2]);
-            dst += sizeof(uint32_t);
-            width--;
-        }
+        BLEND_DISPATCH(GetBlendMode(blend), blend_color, (uint32_t *)dstptr, color, width, blend);
     }
 
     /* regular*/
@@ -196,23 +181,48 @@ void BlitColor(void *dstptr, uint32_t color, int width, const uint8_t *blend) {
     }
 }
 
+/* copies colors resolved by the tile cache, solid lines are a plain copy */
+void BlitCachedTile(uint32_t const *src, uint8_t const *mask, uint32_t *dst, int width, int dx) {
+    if (mask == NULL) {
+        if (dx == 1) {
+            memcpy(dst, src, (size_t)width * sizeof(uint32_t));
+            return;
+        }
+        while (width > 0) {
+            *dst++ = *src;
+            src += dx;
+            width -= 1;
+        }
+        return;
+    }
+
+    /* branchless select, vectorizes on forward rows */
+    if (dx == 1) {
+        for (int c = 0; c < width; c++) {
+            const uint32_t select = 0U - mask[c];
+            dst[c] = (src[c] & select) | (dst[c] & ~select);
+        }
+        return;
+    }
+    while (width > 0) {
+        if (*mask != 0) {
+            *dst = *src;
+        }
+        src += dx;
+        mask += dx;
+        dst += 1;
+        width -= 1;
+    }
+}
+
 /* perfoms direct 32 -> 32 bpp blit with opcional blend */
-void Blit32_32(uint32_t *src, uint32_t *dst, int width, const uint8_t *blend) {
+static void blit_32_32(uint32_t *src, uint32_t *dst, int width, const uint8_t *blend) {
     Color const *srcpixel = (Color *)src;
     Color *dstpixel = (Color *)dst;
 
     /* blending */
     if (blend != NULL) {
-        while (width > 0) {
-            if (srcpixel->a != 0) {
-                dstpixel->r = blendfunc(blend, srcpixel->r, dstpixel->r);
-                dstpixel->g = blendfunc(blend, srcpixel->g, dstpixel->g);
-                dstpixel->b = blendfunc(blend, srcpixel->b, dstpixel->b);
-            }
-            srcpixel += 1;
-            dstpixel += 1;
-            width -= 1;
-        }
+        BLEND_DISPATCH(GetBlendMode(blend), blend_32, src, dst, width, blend);
     }
 
     /* regular */
@@ -229,113 +239,72 @@ void Blit32_32(uint32_t *src, uint32_t *dst, int width, const uint8_t *blend) {
 
 /* per-pixel masked blit: src pixels rendered over mask[i]!=0 positions use
  * blend; all other non-transparent src pixels are written directly. */
-void Blit32_32_Masked(uint32_t const *src, uint32_t *dst, uint8_t const *mask, const uint8_t *blend,
-                      int width) {
-    /* Fast path for MIX50: (src+dst)/2 per RGB byte via SWAR bit-arithmetic.
-     * Avoids all 64-KB blend-table lookups and the resulting L1-cache thrash.
-     * Formula per packed byte: (a>>1) + (b>>1) + (a & b & 1)
-     * Using 0x00010101 keeps alpha (byte 3) out of the arithmetic entirely. */
-    if (blend == SelectBlendTable(BLEND_MIX50)) {
-        while (width > 0) {
-            if ((*src & 0xFF000000u) != 0) {
-                if (*mask) {
-                    *dst = (((*src >> 1) & 0x007F7F7Fu) + ((*dst >> 1) & 0x007F7F7Fu) +
-                            (*src & *dst & 0x00010101u)) |
-                           (*dst & 0xFF000000u); /* preserve destination alpha */
-                } else {
-                    *dst = *src;
-                }
-            }
-            src++;
-            dst++;
-            mask++;
-            width--;
-        }
-        return;
-    }
-
-    Color const *srcpixel = (Color const *)src;
-    Color *dstpixel = (Color *)dst;
+static inline void blend_masked(TLN_Blend mode, uint32_t const *src, uint32_t *dst,
+                                uint8_t const *mask, const uint8_t *blend, int width) {
     while (width > 0) {
-        if (srcpixel->a != 0) {
-            if (*mask && blend != NULL) {
-                dstpixel->r = blendfunc(blend, srcpixel->r, dstpixel->r);
-                dstpixel->g = blendfunc(blend, srcpixel->g, dstpixel->g);
-                dstpixel->b = blendfunc(blend, srcpixel->b, dstpixel->b);
+        if ((*src & ALPHA_MASK) != 0) {
+            if (*mask && mode != BLEND_NONE) {
+                *dst = BlendPixel(mode, blend, *src, *dst);
             } else {
-                dstpixel->value = srcpixel->value;
+                *dst = *src;
             }
         }
-        srcpixel += 1;
-        dstpixel += 1;
-        mask += 1;
-        width -= 1;
+        src++;
+        dst++;
+        mask++;
+        width--;
     }
 }
 
-void Blit32_32_Masked_src(uint32_t const *src, uint32_t const *src_blend, uint32_t *dst,
-                          uint8_t const *mask, const uint8_t *blend, int width) {
-    if (blend == SelectBlendTable(BLEND_MIX50)) {
-        while (width > 0) {
-            if ((*src & 0xFF000000u) != 0) {
-                if (*mask) {
-                    /* opaque top-layer pixel over water: blend them together */
-                    *dst = (((*src >> 1) & 0x007F7F7Fu) + ((*src_blend >> 1) & 0x007F7F7Fu) +
-                            (*src & *src_blend & 0x00010101u)) |
-                           (*dst & 0xFF000000u);
-                } else {
-                    /* opaque top-layer pixel, no water beneath: copy as-is */
-                    *dst = *src;
-                }
-            } else if (*mask && (*src_blend & 0xFF000000u) != 0) {
-                /* transparent top-layer pixel but water beneath: show water */
-                *dst = *src_blend;
-            }
-            src++;
-            src_blend++;
-            dst++;
-            mask++;
-            width--;
-        }
+void Blit32_32_Masked(uint32_t const *src, uint32_t *dst, uint8_t const *mask, const uint8_t *blend,
+                      int width) {
+    if (blend == NULL) {
+        blend_masked(BLEND_NONE, src, dst, mask, blend, width);
         return;
     }
+    BLEND_DISPATCH(GetBlendMode(blend), blend_masked, src, dst, mask, blend, width);
+}
 
-    Color const *srcpixel = (Color const *)src;
-    Color const *blendpixel = (Color const *)src_blend;
-    Color *dstpixel = (Color *)dst;
+static inline void blend_masked_src(TLN_Blend mode, uint32_t const *src,
+                                    uint32_t const *src_blend, uint32_t *dst,
+                                    uint8_t const *mask, const uint8_t *blend, int width) {
     while (width > 0) {
-        if (srcpixel->a != 0) {
-            if (*mask && blend != NULL) {
+        if ((*src & ALPHA_MASK) != 0) {
+            if (*mask && mode != BLEND_NONE) {
                 /* opaque top-layer pixel over water: blend them together */
-                dstpixel->r = blendfunc(blend, srcpixel->r, blendpixel->r);
-                dstpixel->g = blendfunc(blend, srcpixel->g, blendpixel->g);
-                dstpixel->b = blendfunc(blend, srcpixel->b, blendpixel->b);
+                *dst = (BlendPixel(mode, blend, *src, *src_blend) & RGB_MASK) |
+                       (*dst & ALPHA_MASK);
             } else {
                 /* opaque top-layer pixel, no water: copy as-is */
-                dstpixel->value = srcpixel->value;
+                *dst = *src;
             }
-        } else if (*mask && blendpixel->a != 0) {
+        } else if (*mask && (*src_blend & ALPHA_MASK) != 0) {
             /* transparent top-layer pixel but water beneath: show water */
-            dstpixel->value = blendpixel->value;
+            *dst = *src_blend;
         }
-        srcpixel++;
-        blendpixel++;
-        dstpixel++;
+        src++;
+        src_blend++;
+        dst++;
         mask++;
         width--;
     }
 }
 
+void Blit32_32_Masked_src(uint32_t const *src, uint32_t const *src_blend, uint32_t *dst,
+                          uint8_t const *mask, const uint8_t *blend, int width) {
+    if (blend == NULL) {
+        blend_masked_src(BLEND_NONE, src, src_blend, dst, mask, blend, width);
+        return;
+    }
+    BLEND_DISPATCH(GetBlendMode(blend), blend_masked_src, src, src_blend, dst, mask, blend,
+                   width);
+}
+
 /* helper: paint mosaic block with blending */
 static void PaintMosaicBlockBlend(Color const *srcpixel, Color *dstpixel, int block,
                                   const uint8_t *blend) {
-    while (block != 0) {
-        dstpixel->r = blendfunc(blend, srcpixel->r, dstpixel->r);
-        dstpixel->g = blendfunc(blend, srcpixel->g, dstpixel->g);
-        dstpixel->b = blendfunc(blend, srcpixel->b, dstpixel->b);
-        dstpixel += 1;
-        block -= 1;
-    }
+    BLEND_DISPATCH(GetBlendMode(blend), blend_color, &dstpixel->value, srcpixel->value, block,
+                   blend);
 }
 
 /* helper: paint mosaic block without blending */
@@ -348,7 +317,8 @@ static void PaintMosaicBlockRegular(Color const *srcpixel, Color *dstpixel, int
 }
 
 /* performs mosaic effect with optional blend */
-void BlitMosaic(uint32_t *src, uint32_t *dst, int width, int size, const uint8_t *blend) {
+static void blitMosaic_32(uint32_t *src, uint32_t *dst, int width, int size,
+                          const uint8_t *blend) {
     Color const *srcpixel = (Color *)src;
     Color *dstpixel = (Color *)dst;
 
@@ -380,3 +350,75 @@ void BlitMosaic(uint32_t *src, uint32_t *dst, int width, int size, const uint8_t
         }
     }
 }
+
+/* reference implementations, also used where no SIMD version exists */
+static const BlitterSet scalar_set = {
+    .blitters = {blitFast_8_32, blitFastBlend_8_32, blitFastScaling_8_32,
+                 blitFastBlendScaling_8_32, blitKey_8_32, blitKeyBlend_8_32,
+                 blitKeyScaling_8_32, blitKeyBlendScaling_8_32},
+    .color = blitColor_32,
+    .blit32 = blit_32_32,
+    .mosaic = blitMosaic_32,
+};
+
+static BlitterSet blitter_sets[MAX_SIMD];
+static bool supported[MAX_SIMD] = {true};
+static simd_t active = SIMD_NONE;
+
+/* selects the blitters for the best instruction set supported by the CPU.
+ * Each set builds on the previous one, so functions without a version for an
+ * instruction set keep the best older one */
+void InitBlitters(void) {
+    static bool initialized = false;
+    if (initialized) {
+        return;
+    }
+
+    blitter_sets[SIMD_NONE] = scalar_set;
+    blitter_sets[SIMD_SSE2] = scalar_set;
+    supported[SIMD_SSE2] = SDL_HasSSE2() && GetBlittersSSE2(&blitter_sets[SIMD_SSE2]);
+    blitter_sets[SIMD_AVX2] = blitter_sets[SIMD_SSE2];
+    supported[SIMD_AVX2] = supported[SIMD_SSE2] && SDL_HasAVX2() &&
+                           GetBlittersAVX2(&blitter_sets[SIMD_AVX2]);
+
+    for (int c = SIMD_NONE; c < MAX_SIMD; c++) {
+        if (supported[c]) {
+            active = (simd_t)c;
+        }
+    }
+    initialized = true;
+}
+
+/* returns blitters for an instruction set, or NULL if the CPU doesn't
+ * support it */
+BlitterSet const *GetBlitterSet(simd_t simd) {
+    if (simd < SIMD_NONE || simd >= MAX_SIMD || !supported[simd]) {
+        return NULL;
+    }
+    return simd == SIMD_NONE ? &scalar_set : &blitter_sets[simd];
+}
+
+/* returns instruction set of the blitters in use */
+simd_t GetBlitterSIMD(void) { return active; }
+
+/* returns suitable blitter for specified conditions */
+ScanBlitPtr SelectBlitter(bool key, bool scaling, bool blend) {
+    int index =
+        ((int)key << BLIT_KEY) + ((int)scaling << BLIT_SCALING) + ((int)blend << BLIT_BLEND);
+    return GetBlitterSet(active)->blitters[index];
+}
+
+/* paints constant color */
+void BlitColor(void *dstptr, uint32_t color, int width, const uint8_t *blend) {
+    blitter_sets[active].color(dstptr, color, width, blend);
+}
+
+/* perfoms direct 32 -> 32 bpp blit with opcional blend */
+void Blit32_32(uint32_t *src, uint32_t *dst, int width, const uint8_t *blend) {
+    blitter_sets[active].blit32(src, dst, width, blend);
+}
+
+/* performs mosaic effect with optional blend */
+void BlitMosaic(uint32_t *src, uint32_t *dst, int width, int size, const uint8_t *blend) {
+    blitter_sets[active].mosaic(src, dst, width, size, blend);
+}
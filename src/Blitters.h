@@ -16,11 +16,46 @@
 /* blitter callback signature */
 typedef void (*ScanBlitPtr)(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr, int width,
                             int dx, int offset, const uint8_t *blend);
+typedef void (*BlitColorPtr)(void *dstptr, uint32_t color, int width, const uint8_t *blend);
+typedef void (*Blit32Ptr)(uint32_t *src, uint32_t *dst, int width, const uint8_t *blend);
+typedef void (*BlitMosaicPtr)(uint32_t *src, uint32_t *dst, int width, int size,
+                              const uint8_t *blend);
+
+/* indexes for blitter array table */
+#define BLIT_BLEND 0
+#define BLIT_SCALING 1
+#define BLIT_KEY 2
+
+/* instruction sets with blitter implementations */
+typedef enum { SIMD_NONE, SIMD_SSE2, SIMD_AVX2, MAX_SIMD } simd_t;
+
+/* blitter implementations for an instruction set */
+typedef struct {
+    ScanBlitPtr blitters[8]; /* indexed by BLIT_* flags */
+    BlitColorPtr color;
+    Blit32Ptr blit32;
+    BlitMosaicPtr mosaic;
+} BlitterSet;
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* selects the blitters for the best instruction set supported by the CPU */
+void InitBlitters(void);
+
+/* returns blitters for an instruction set, or NULL if the CPU doesn't
+ * support it */
+BlitterSet const *GetBlitterSet(simd_t simd);
+
+/* returns instruction set of the blitters in use */
+simd_t GetBlitterSIMD(void);
+
+/* SIMD blitter sets: replace entries of set with faster versions, falling
+ * back to the replaced ones for row tails. Return false if not built */
+bool GetBlittersSSE2(BlitterSet *set);
+bool GetBlittersAVX2(BlitterSet *set);
+
 /* returns suitable blitter for specified conditions */
 ScanBlitPtr SelectBlitter(bool key, bool scaling, bool blend);
 
@@ -40,6 +75,10 @@ void Blit32_32_Masked(uint32_t const *src, uint32_t *dst, uint8_t const *mask, c
 void Blit32_32_Masked_src(uint32_t const *src, uint32_t const *src_blend, uint32_t *dst,
                           uint8_t const *mask, const uint8_t *blend, int width);
 
+/* copies colors resolved by the tile cache. Only pixels with non-zero mask are
+ * copied, all of them when mask is NULL */
+void BlitCachedTile(uint32_t const *src, uint8_t const *mask, uint32_t *dst, int width, int dx);
+
 /* performs mosaic blit */
 void BlitMosaic(uint32_t *src, uint32_t *dst, int width, int size, const uint8_t *blend);
 
@@ -0,0 +1,366 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* AVX2 blitters: 8 pixels at a time. Palette colors are fetched with a gather
+ * and blending is computed like BlendPixel(), except BLEND_CUSTOM that gathers
+ * each channel from its table, so the output is identical to the scalar
+ * versions, that are used for row tails. This file is built with AVX2 enabled
+ * and must only be reached after checking the CPU */
+
+#include "Blitters.h"
+
+#if defined(__AVX2__) || (defined(_MSC_VER) && defined(_M_X64))
+
+#include <immintrin.h>
+
+#include "Blend.h"
+#include "Math2D.h"
+#include "Palette.h"
+
+/* gather setup doesn't pay off on short runs such as tile rows */
+#define MIN_WIDTH 24
+
+static BlitterSet base;
+
+/* blends RGB channels of 8 pixels through a blend table, keeping the
+ * destination alpha */
+static inline __m256i blend_table_pixels(__m256i src, __m256i dst, const uint8_t *blend) {
+    const __m256i byte = _mm256_set1_epi32(0xFF);
+    const __m256i high = _mm256_set1_epi32(0xFF00);
+    int const *table = (int const *)blend;
+
+    const __m256i index_b =
+        _mm256_or_si256(_mm256_slli_epi32(_mm256_and_si256(src, byte), 8),
+                        _mm256_and_si256(dst, byte));
+    const __m256i index_g = _mm256_or_si256(_mm256_and_si256(src, high),
+                                            _mm256_and_si256(_mm256_srli_epi32(dst, 8), byte));
+    const __m256i index_r =
+        _mm256_or_si256(_mm256_and_si256(_mm256_srli_epi32(src, 8), high),
+                        _mm256_and_si256(_mm256_srli_epi32(dst, 16), byte));
+
+    const __m256i b = _mm256_and_si256(_mm256_i32gather_epi32(table, index_b, 1), byte);
+    const __m256i g = _mm256_and_si256(_mm256_i32gather_epi32(table, index_g, 1), byte);
+    const __m256i r = _mm256_and_si256(_mm256_i32gather_epi32(table, index_r, 1), byte);
+    const __m256i a = _mm256_and_si256(dst, _mm256_set1_epi32((int)ALPHA_MASK));
+    return _mm256_or_si256(_mm256_or_si256(b, _mm256_slli_epi32(g, 8)),
+                           _mm256_or_si256(_mm256_slli_epi32(r, 16), a));
+}
+
+/* blends 16-bit channels for the modes that need a division */
+static inline __m256i blend_words(TLN_Blend mode, __m256i a, __m256i b) {
+    switch (mode) {
+    case BLEND_MIX25:
+        return _mm256_mulhi_epu16(_mm256_add_epi16(a, _mm256_add_epi16(b, b)),
+                                  _mm256_set1_epi16(21846));
+    case BLEND_MIX75:
+        return _mm256_mulhi_epu16(_mm256_add_epi16(_mm256_add_epi16(a, a), b),
+                                  _mm256_set1_epi16(21846));
+    case BLEND_MIX90: {
+        const __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(a, _mm256_set1_epi16(9)), b);
+        return _mm256_mulhi_epu16(sum, _mm256_set1_epi16(6554));
+    }
+    default: {
+        const __m256i product = _mm256_mullo_epi16(a, b);
+        const __m256i sum = _mm256_add_epi16(_mm256_add_epi16(product, _mm256_set1_epi16(1)),
+                                             _mm256_srli_epi16(product, 8));
+        return _mm256_srli_epi16(sum, 8);
+    }
+    }
+}
+
+/* blends RGB channels of 8 pixels like BlendPixel(), keeping the destination
+ * alpha */
+static inline __m256i blend_pixels(TLN_Blend mode, __m256i src, __m256i dst,
+                                   const uint8_t *blend) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i rgb = _mm256_set1_epi32(RGB_MASK);
+    __m256i result;
+    switch (mode) {
+    case BLEND_MIX50:
+        result = _mm256_sub_epi8(_mm256_avg_epu8(src, dst),
+                                 _mm256_and_si256(_mm256_xor_si256(src, dst), _mm256_set1_epi8(1)));
+        break;
+    case BLEND_ADD:
+        result = _mm256_adds_epu8(src, dst);
+        break;
+    case BLEND_SUB:
+        result = _mm256_subs_epu8(src, dst);
+        break;
+    case BLEND_CUSTOM:
+        return blend_table_pixels(src, dst, blend);
+    default: {
+        /* unpack and pack work within 128-bit lanes, so pixels keep their order */
+        const __m256i low = blend_words(mode, _mm256_unpacklo_epi8(src, zero),
+                                        _mm256_unpacklo_epi8(dst, zero));
+        const __m256i high = blend_words(mode, _mm256_unpackhi_epi8(src, zero),
+                                         _mm256_unpackhi_epi8(dst, zero));
+        result = _mm256_packus_epi16(low, high);
+        break;
+    }
+    }
+    return _mm256_blendv_epi8(dst, result, rgb);
+}
+
+/* loads 8 color indexes stepping dx pixels */
+static inline __m256i load_indexes(const uint8_t *src, int dx) {
+    if (dx == 1) {
+        return _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const *)src));
+    }
+    if (dx == -1) {
+        const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+        const __m256i index = _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const *)(src - 7)));
+        return _mm256_permutevar8x32_epi32(index, reverse);
+    }
+    return _mm256_setr_epi32(src[0], src[dx], src[dx * 2], src[dx * 3], src[dx * 4], src[dx * 5],
+                             src[dx * 6], src[dx * 7]);
+}
+
+/* loads 8 color indexes at fixed point offsets stepping dx */
+static inline __m256i load_scaled_indexes(const uint8_t *src, int offset, int dx) {
+    return _mm256_setr_epi32(
+        src[offset >> FIXED_BITS], src[(offset + dx) >> FIXED_BITS],
+        src[(offset + dx * 2) >> FIXED_BITS], src[(offset + dx * 3) >> FIXED_BITS],
+        src[(offset + dx * 4) >> FIXED_BITS], src[(offset + dx * 5) >> FIXED_BITS],
+        src[(offset + dx * 6) >> FIXED_BITS], src[(offset + dx * 7) >> FIXED_BITS]);
+}
+
+/* paints 8 pixels from color indexes, index 0 is skipped when key is set */
+static inline void put_pixels(uint32_t *dst, __m256i index, uint32_t const *palette, bool key,
+                              TLN_Blend mode, const uint8_t *blend) {
+    __m256i skip = _mm256_setzero_si256();
+    int mask = 0;
+    if (key) {
+        skip = _mm256_cmpeq_epi32(index, skip);
+        mask = _mm256_movemask_epi8(skip);
+        if (mask == -1) {
+            return;
+        }
+    }
+
+    __m256i colors = _mm256_i32gather_epi32((int const *)palette, index, 4);
+    if (mode != BLEND_NONE || mask != 0) {
+        const __m256i back = _mm256_loadu_si256((__m256i const *)dst);
+        if (mode != BLEND_NONE) {
+            colors = blend_pixels(mode, colors, back, blend);
+        }
+        if (mask != 0) {
+            colors = _mm256_blendv_epi8(colors, back, skip);
+        }
+    }
+    _mm256_storeu_si256((__m256i *)dst, colors);
+}
+
+/* common loop of the blitters without scaling */
+static void blit_indexed(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr, int width,
+                         int dx, bool key, const uint8_t *blend, ScanBlitPtr tail) {
+    uint32_t *dst = (uint32_t *)dstptr;
+    const TLN_Blend mode = blend != NULL ? GetBlendMode(blend) : BLEND_NONE;
+    while (width >= 8) {
+        put_pixels(dst, load_indexes(srcpixel, dx), palette->data, key, mode, blend);
+        srcpixel += dx * 8;
+        dst += 8;
+        width -= 8;
+    }
+    if (width > 0) {
+        tail(srcpixel, palette, dst, width, dx, 0, blend);
+    }
+}
+
+/* common loop of the blitters with scaling */
+static void blit_indexed_scaling(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr,
+                                 int width, int dx, int offset, bool key, const uint8_t *blend,
+                                 ScanBlitPtr tail) {
+    uint32_t *dst = (uint32_t *)dstptr;
+    const TLN_Blend mode = blend != NULL ? GetBlendMode(blend) : BLEND_NONE;
+    while (width >= 8) {
+        put_pixels(dst, load_scaled_indexes(srcpixel, offset, dx), palette->data, key, mode,
+                   blend);
+        offset += dx * 8;
+        dst += 8;
+        width -= 8;
+    }
+    if (width > 0) {
+        tail(srcpixel, palette, dst, width, dx, offset, blend);
+    }
+}
+
+static void blitFast_AVX2(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr, int width,
+                          int dx, int offset, const uint8_t *blend) {
+    const ScanBlitPtr tail = base.blitters[0];
+    if (width < MIN_WIDTH) {
+        tail(srcpixel, palette, dstptr, width, dx, offset, blend);
+        return;
+    }
+    blit_indexed(srcpixel, palette, dstptr, width, dx, false, NULL, tail);
+}
+
+static void blitFastBlend_AVX2(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr,
+                               int width, int dx, int offset, const uint8_t *blend) {
+    const ScanBlitPtr tail = base.blitters[1 << BLIT_BLEND];
+    if (width < MIN_WIDTH) {
+        tail(srcpixel, palette, dstptr, width, dx, offset, blend);
+        return;
+    }
+    blit_indexed(srcpixel, palette, dstptr, width, dx, false, blend, tail);
+}
+
+static void blitFastScaling_AVX2(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr,
+                                 int width, int dx, int offset, const uint8_t *blend) {
+    const ScanBlitPtr tail = base.blitters[1 << BLIT_SCALING];
+    if (width < MIN_WIDTH) {
+        tail(srcpixel, palette, dstptr, width, dx, offset, blend);
+        return;
+    }
+    blit_indexed_scaling(srcpixel, palette, dstptr, width, dx, offset, false, NULL, tail);
+}
+
+static void blitFastBlendScaling_AVX2(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr,
+                                      int width, int dx, int offset, const uint8_t *blend) {
+    const ScanBlitPtr tail = base.blitters[(1 << BLIT_SCALING) + (1 << BLIT_BLEND)];
+    if (width < MIN_WIDTH) {
+        tail(srcpixel, palette, dstptr, width, dx, offset, blend);
+        return;
+    }
+    blit_indexed_scaling(srcpixel, palette, dstptr, width, dx, offset, false, blend, tail);
+}
+
+static void blitKey_AVX2(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr, int width,
+                         int dx, int offset, const uint8_t *blend) {
+    const ScanBlitPtr tail = base.blitters[1 << BLIT_KEY];
+    if (width < MIN_WIDTH) {
+        tail(srcpixel, palette, dstptr, width, dx, offset, blend);
+        return;
+    }
+    blit_indexed(srcpixel, palette, dstptr, width, dx, true, NULL, tail);
+}
+
+static void blitKeyBlend_AVX2(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr,
+                              int width, int dx, int offset, const uint8_t *blend) {
+    const ScanBlitPtr tail = base.blitters[(1 << BLIT_KEY) + (1 << BLIT_BLEND)];
+    if (width < MIN_WIDTH) {
+        tail(srcpixel, palette, dstptr, width, dx, offset, blend);
+        return;
+    }
+    blit_indexed(srcpixel, palette, dstptr, width, dx, true, blend, tail);
+}
+
+static void blitKeyScaling_AVX2(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr,
+                                int width, int dx, int offset, const uint8_t *blend) {
+    const ScanBlitPtr tail = base.blitters[(1 << BLIT_KEY) + (1 << BLIT_SCALING)];
+    if (width < MIN_WIDTH) {
+        tail(srcpixel, palette, dstptr, width, dx, offset, blend);
+        return;
+    }
+    blit_indexed_scaling(srcpixel, palette, dstptr, width, dx, offset, true, NULL, tail);
+}
+
+static void blitKeyBlendScaling_AVX2(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr,
+                                     int width, int dx, int offset, const uint8_t *blend) {
+    const ScanBlitPtr tail =
+        base.blitters[(1 << BLIT_KEY) + (1 << BLIT_SCALING) + (1 << BLIT_BLEND)];
+    if (width < MIN_WIDTH) {
+        tail(srcpixel, palette, dstptr, width, dx, offset, blend);
+        return;
+    }
+    blit_indexed_scaling(srcpixel, palette, dstptr, width, dx, offset, true, blend, tail);
+}
+
+/* paints constant color with optional blend */
+static void blitColor_AVX2(void *dstptr, uint32_t color, int width, const uint8_t *blend) {
+    uint32_t *dst = (uint32_t *)dstptr;
+    const TLN_Blend mode = blend != NULL ? GetBlendMode(blend) : BLEND_NONE;
+    const __m256i value = _mm256_set1_epi32((int)color);
+    while (width >= 8) {
+        if (mode != BLEND_NONE) {
+            const __m256i back = _mm256_loadu_si256((__m256i const *)dst);
+            _mm256_storeu_si256((__m256i *)dst, blend_pixels(mode, value, back, blend));
+        } else {
+            _mm256_storeu_si256((__m256i *)dst, value);
+        }
+        dst += 8;
+        width -= 8;
+    }
+    if (width > 0) {
+        base.color(dst, color, width, blend);
+    }
+}
+
+/* perfoms direct 32 -> 32 bpp blit with optional blend, skipping pixels with
+ * alpha 0 */
+static void blit32_AVX2(uint32_t *src, uint32_t *dst, int width, const uint8_t *blend) {
+    const TLN_Blend mode = blend != NULL ? GetBlendMode(blend) : BLEND_NONE;
+    const __m256i alpha = _mm256_set1_epi32((int)ALPHA_MASK);
+    while (width >= 8) {
+        __m256i pixels = _mm256_loadu_si256((__m256i const *)src);
+        const __m256i clear =
+            _mm256_cmpeq_epi32(_mm256_and_si256(pixels, alpha), _mm256_setzero_si256());
+        const int mask = _mm256_movemask_epi8(clear);
+        if (mask != -1) {
+            if (mode != BLEND_NONE || mask != 0) {
+                const __m256i back = _mm256_loadu_si256((__m256i const *)dst);
+                if (mode != BLEND_NONE) {
+                    pixels = blend_pixels(mode, pixels, back, blend);
+                }
+                pixels = _mm256_blendv_epi8(pixels, back, clear);
+            }
+            _mm256_storeu_si256((__m256i *)dst, pixels);
+        }
+        src += 8;
+        dst += 8;
+        width -= 8;
+    }
+    if (width > 0) {
+        base.blit32(src, dst, width, blend);
+    }
+}
+
+/* performs mosaic effect with optional blend, each block painted with the
+ * color of its first pixel */
+static void blitMosaic_AVX2(uint32_t *src, uint32_t *dst, int width, int size,
+                            const uint8_t *blend) {
+    if (size < 8) {
+        base.mosaic(src, dst, width, size, blend);
+        return;
+    }
+
+    while (width > 0) {
+        const int block = size > width ? width : size;
+        if ((*src & ALPHA_MASK) != 0) {
+            blitColor_AVX2(dst, *src, block, blend);
+        }
+        src += block;
+        dst += block;
+        width -= block;
+    }
+}
+
+/* replaces entries of set with AVX2 versions */
+bool GetBlittersAVX2(BlitterSet *set) {
+    base = *set;
+    set->blitters[0] = blitFast_AVX2;
+    set->blitters[1 << BLIT_BLEND] = blitFastBlend_AVX2;
+    set->blitters[1 << BLIT_SCALING] = blitFastScaling_AVX2;
+    set->blitters[(1 << BLIT_SCALING) + (1 << BLIT_BLEND)] = blitFastBlendScaling_AVX2;
+    set->blitters[1 << BLIT_KEY] = blitKey_AVX2;
+    set->blitters[(1 << BLIT_KEY) + (1 << BLIT_BLEND)] = blitKeyBlend_AVX2;
+    set->blitters[(1 << BLIT_KEY) + (1 << BLIT_SCALING)] = blitKeyScaling_AVX2;
+    set->blitters[(1 << BLIT_KEY) + (1 << BLIT_SCALING) + (1 << BLIT_BLEND)] =
+        blitKeyBlendScaling_AVX2;
+    set->color = blitColor_AVX2;
+    set->blit32 = blit32_AVX2;
+    set->mosaic = blitMosaic_AVX2;
+    return true;
+}
+
+#else
+
+bool GetBlittersAVX2(BlitterSet *set [[maybe_unused]]) { return false; }
+
+#endif
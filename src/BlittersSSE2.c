@@ -0,0 +1,254 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* SSE2 blitters: 4 pixels at a time for the 32 bpp copies and fills, and for
+ * blending. SSE2 has no gather, so palette colors are loaded one by one and
+ * unblended palette blitters keep the previous versions. BLEND_CUSTOM needs
+ * table lookups and also keeps them. Previous versions handle row tails */
+
+#include "Blitters.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+
+#include <emmintrin.h>
+
+#include "Blend.h"
+#include "Math2D.h"
+#include "Palette.h"
+
+static BlitterSet base;
+
+/* blends 16-bit channels for the modes that need a division */
+static inline __m128i blend_words(TLN_Blend mode, __m128i a, __m128i b) {
+    switch (mode) {
+    case BLEND_MIX25:
+        return _mm_mulhi_epu16(_mm_add_epi16(a, _mm_add_epi16(b, b)), _mm_set1_epi16(21846));
+    case BLEND_MIX75:
+        return _mm_mulhi_epu16(_mm_add_epi16(_mm_add_epi16(a, a), b), _mm_set1_epi16(21846));
+    case BLEND_MIX90: {
+        const __m128i sum = _mm_add_epi16(_mm_mullo_epi16(a, _mm_set1_epi16(9)), b);
+        return _mm_mulhi_epu16(sum, _mm_set1_epi16(6554));
+    }
+    default: {
+        const __m128i product = _mm_mullo_epi16(a, b);
+        const __m128i sum = _mm_add_epi16(_mm_add_epi16(product, _mm_set1_epi16(1)),
+                                          _mm_srli_epi16(product, 8));
+        return _mm_srli_epi16(sum, 8);
+    }
+    }
+}
+
+/* blends RGB channels of 4 pixels like BlendPixel(), keeping the destination
+ * alpha. Not valid for BLEND_CUSTOM */
+static inline __m128i blend_pixels(TLN_Blend mode, __m128i src, __m128i dst) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i rgb = _mm_set1_epi32(RGB_MASK);
+    __m128i result;
+    switch (mode) {
+    case BLEND_MIX50:
+        result = _mm_sub_epi8(_mm_avg_epu8(src, dst),
+                              _mm_and_si128(_mm_xor_si128(src, dst), _mm_set1_epi8(1)));
+        break;
+    case BLEND_ADD:
+        result = _mm_adds_epu8(src, dst);
+        break;
+    case BLEND_SUB:
+        result = _mm_subs_epu8(src, dst);
+        break;
+    default: {
+        const __m128i low = blend_words(mode, _mm_unpacklo_epi8(src, zero),
+                                        _mm_unpacklo_epi8(dst, zero));
+        const __m128i high = blend_words(mode, _mm_unpackhi_epi8(src, zero),
+                                         _mm_unpackhi_epi8(dst, zero));
+        result = _mm_packus_epi16(low, high);
+        break;
+    }
+    }
+    return _mm_or_si128(_mm_and_si128(result, rgb), _mm_andnot_si128(rgb, dst));
+}
+
+/* paints 4 colors, blended and skipping index 0 when key is set */
+static inline void put_pixels(uint32_t *dst, __m128i colors, __m128i index, bool key,
+                              TLN_Blend mode) {
+    const __m128i back = _mm_loadu_si128((__m128i const *)dst);
+    colors = blend_pixels(mode, colors, back);
+    if (key) {
+        const __m128i skip = _mm_cmpeq_epi32(index, _mm_setzero_si128());
+        colors = _mm_or_si128(_mm_and_si128(skip, back), _mm_andnot_si128(skip, colors));
+    }
+    _mm_storeu_si128((__m128i *)dst, colors);
+}
+
+/* common loop of the blending blitters without scaling */
+static void blit_indexed(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr, int width,
+                         int dx, bool key, const uint8_t *blend, ScanBlitPtr tail) {
+    uint32_t const *color = palette->data;
+    uint32_t *dst = (uint32_t *)dstptr;
+    const TLN_Blend mode = GetBlendMode(blend);
+    if (mode != BLEND_CUSTOM) {
+        while (width >= 4) {
+            const uint8_t p0 = srcpixel[0];
+            const uint8_t p1 = srcpixel[dx];
+            const uint8_t p2 = srcpixel[dx * 2];
+            const uint8_t p3 = srcpixel[dx * 3];
+            const __m128i colors = _mm_setr_epi32((int)color[p0], (int)color[p1],
+                                                  (int)color[p2], (int)color[p3]);
+            put_pixels(dst, colors, _mm_setr_epi32(p0, p1, p2, p3), key, mode);
+            srcpixel += dx * 4;
+            dst += 4;
+            width -= 4;
+        }
+    }
+    tail(srcpixel, palette, dst, width, dx, 0, blend);
+}
+
+/* common loop of the blending blitters with scaling */
+static void blit_indexed_scaling(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr,
+                                 int width, int dx, int offset, bool key, const uint8_t *blend,
+                                 ScanBlitPtr tail) {
+    uint32_t const *color = palette->data;
+    uint32_t *dst = (uint32_t *)dstptr;
+    const TLN_Blend mode = GetBlendMode(blend);
+    if (mode != BLEND_CUSTOM) {
+        while (width >= 4) {
+            const uint8_t p0 = srcpixel[offset >> FIXED_BITS];
+            const uint8_t p1 = srcpixel[(offset + dx) >> FIXED_BITS];
+            const uint8_t p2 = srcpixel[(offset + dx * 2) >> FIXED_BITS];
+            const uint8_t p3 = srcpixel[(offset + dx * 3) >> FIXED_BITS];
+            const __m128i colors = _mm_setr_epi32((int)color[p0], (int)color[p1],
+                                                  (int)color[p2], (int)color[p3]);
+            put_pixels(dst, colors, _mm_setr_epi32(p0, p1, p2, p3), key, mode);
+            offset += dx * 4;
+            dst += 4;
+            width -= 4;
+        }
+    }
+    tail(srcpixel, palette, dst, width, dx, offset, blend);
+}
+
+static void blitFastBlend_SSE2(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr,
+                               int width, int dx, int offset [[maybe_unused]],
+                               const uint8_t *blend) {
+    blit_indexed(srcpixel, palette, dstptr, width, dx, false, blend,
+                 base.blitters[1 << BLIT_BLEND]);
+}
+
+static void blitFastBlendScaling_SSE2(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr,
+                                      int width, int dx, int offset, const uint8_t *blend) {
+    blit_indexed_scaling(srcpixel, palette, dstptr, width, dx, offset, false, blend,
+                         base.blitters[(1 << BLIT_SCALING) + (1 << BLIT_BLEND)]);
+}
+
+static void blitKeyBlend_SSE2(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr,
+                              int width, int dx, int offset [[maybe_unused]],
+                              const uint8_t *blend) {
+    blit_indexed(srcpixel, palette, dstptr, width, dx, true, blend,
+                 base.blitters[(1 << BLIT_KEY) + (1 << BLIT_BLEND)]);
+}
+
+static void blitKeyBlendScaling_SSE2(const uint8_t *srcpixel, TLN_Palette palette, void *dstptr,
+                                     int width, int dx, int offset, const uint8_t *blend) {
+    blit_indexed_scaling(srcpixel, palette, dstptr, width, dx, offset, true, blend,
+                         base.blitters[(1 << BLIT_KEY) + (1 << BLIT_SCALING) + (1 << BLIT_BLEND)]);
+}
+
+/* paints constant color with optional blend */
+static void blitColor_SSE2(void *dstptr, uint32_t color, int width, const uint8_t *blend) {
+    uint32_t *dst = (uint32_t *)dstptr;
+    const TLN_Blend mode = blend != NULL ? GetBlendMode(blend) : BLEND_NONE;
+    const __m128i value = _mm_set1_epi32((int)color);
+    if (mode == BLEND_NONE) {
+        while (width >= 4) {
+            _mm_storeu_si128((__m128i *)dst, value);
+            dst += 4;
+            width -= 4;
+        }
+    } else if (mode != BLEND_CUSTOM) {
+        while (width >= 4) {
+            const __m128i back = _mm_loadu_si128((__m128i const *)dst);
+            _mm_storeu_si128((__m128i *)dst, blend_pixels(mode, value, back));
+            dst += 4;
+            width -= 4;
+        }
+    }
+    base.color(dst, color, width, blend);
+}
+
+/* perfoms direct 32 -> 32 bpp blit with optional blend, skipping pixels with
+ * alpha 0 */
+static void blit32_SSE2(uint32_t *src, uint32_t *dst, int width, const uint8_t *blend) {
+    const TLN_Blend mode = blend != NULL ? GetBlendMode(blend) : BLEND_NONE;
+    const __m128i alpha = _mm_set1_epi32((int)ALPHA_MASK);
+    const __m128i zero = _mm_setzero_si128();
+    if (mode == BLEND_CUSTOM) {
+        base.blit32(src, dst, width, blend);
+        return;
+    }
+
+    while (width >= 4) {
+        __m128i pixels = _mm_loadu_si128((__m128i const *)src);
+        const __m128i clear = _mm_cmpeq_epi32(_mm_and_si128(pixels, alpha), zero);
+        const int mask = _mm_movemask_epi8(clear);
+        if (mask != 0xFFFF) {
+            if (mode != BLEND_NONE || mask != 0) {
+                const __m128i back = _mm_loadu_si128((__m128i const *)dst);
+                if (mode != BLEND_NONE) {
+                    pixels = blend_pixels(mode, pixels, back);
+                }
+                pixels = _mm_or_si128(_mm_and_si128(clear, back), _mm_andnot_si128(clear, pixels));
+            }
+            _mm_storeu_si128((__m128i *)dst, pixels);
+        }
+        src += 4;
+        dst += 4;
+        width -= 4;
+    }
+    base.blit32(src, dst, width, blend);
+}
+
+/* performs mosaic effect with optional blend, each block painted with the
+ * color of its first pixel */
+static void blitMosaic_SSE2(uint32_t *src, uint32_t *dst, int width, int size,
+                            const uint8_t *blend) {
+    if (size < 4) {
+        base.mosaic(src, dst, width, size, blend);
+        return;
+    }
+
+    while (width > 0) {
+        const int block = size > width ? width : size;
+        if ((*src & ALPHA_MASK) != 0) {
+            blitColor_SSE2(dst, *src, block, blend);
+        }
+        src += block;
+        dst += block;
+        width -= block;
+    }
+}
+
+/* replaces entries of set with SSE2 versions */
+bool GetBlittersSSE2(BlitterSet *set) {
+    base = *set;
+    set->blitters[1 << BLIT_BLEND] = blitFastBlend_SSE2;
+    set->blitters[(1 << BLIT_SCALING) + (1 << BLIT_BLEND)] = blitFastBlendScaling_SSE2;
+    set->blitters[(1 << BLIT_KEY) + (1 << BLIT_BLEND)] = blitKeyBlend_SSE2;
+    set->blitters[(1 << BLIT_KEY) + (1 << BLIT_SCALING) + (1 << BLIT_BLEND)] =
+        blitKeyBlendScaling_SSE2;
+    set->color = blitColor_SSE2;
+    set->blit32 = blit32_SSE2;
+    set->mosaic = blitMosaic_SSE2;
+    return true;
+}
+
+#else
+
+bool GetBlittersSSE2(BlitterSet *set [[maybe_unused]]) { return false; }
+
+#endif
@@ -0,0 +1,300 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* AES decryption with 32-bit lookup tables, a word per column instead of the
+ * byte-oriented rounds of aes.c, used when the CPU lacks AES-NI. Blocks of CBC
+ * only depend on the previous ciphertext block, so large assets are split in
+ * chunks decrypted by several threads */
+
+#include "Crypto.h"
+
+#include <SDL3/SDL_cpuinfo.h>
+#include <SDL3/SDL_thread.h>
+
+#include "zlib.h"
+
+#define PARALLEL_SIZE (1 << 20) /* smaller assets don't pay off starting threads */
+#define MAX_THREADS 8
+
+/* InvSubBytes and InvMixColumns of a byte in the first row, the rest of rows
+ * are the same rotated. Td4 is the inverse S-box for the last round */
+static const uint32_t Td0[256] = {
+    0x51f4a750, 0x7e416553, 0x1a17a4c3, 0x3a275e96, 0x3bab6bcb, 0x1f9d45f1,
+    0xacfa58ab, 0x4be30393, 0x2030fa55, 0xad766df6, 0x88cc7691, 0xf5024c25,
+    0x4fe5d7fc, 0xc52acbd7, 0x26354480, 0xb562a38f, 0xdeb15a49, 0x25ba1b67,
+    0x45ea0e98, 0x5dfec0e1, 0xc32f7502, 0x814cf012, 0x8d4697a3, 0x6bd3f9c6,
+    0x038f5fe7, 0x15929c95, 0xbf6d7aeb, 0x955259da, 0xd4be832d, 0x587421d3,
+    0x49e06929, 0x8ec9c844, 0x75c2896a, 0xf48e7978, 0x99583e6b, 0x27b971dd,
+    0xbee14fb6, 0xf088ad17, 0xc920ac66, 0x7dce3ab4, 0x63df4a18, 0xe51a3182,
+    0x97513360, 0x62537f45, 0xb16477e0, 0xbb6bae84, 0xfe81a01c, 0xf9082b94,
+    0x70486858, 0x8f45fd19, 0x94de6c87, 0x527bf8b7, 0xab73d323, 0x724b02e2,
+    0xe31f8f57, 0x6655ab2a, 0xb2eb2807, 0x2fb5c203, 0x86c57b9a, 0xd33708a5,
+    0x302887f2, 0x23bfa5b2, 0x02036aba, 0xed16825c, 0x8acf1c2b, 0xa779b492,
+    0xf307f2f0, 0x4e69e2a1, 0x65daf4cd, 0x0605bed5, 0xd134621f, 0xc4a6fe8a,
+    0x342e539d, 0xa2f355a0, 0x058ae132, 0xa4f6eb75, 0x0b83ec39, 0x4060efaa,
+    0x5e719f06, 0xbd6e1051, 0x3e218af9, 0x96dd063d, 0xdd3e05ae, 0x4de6bd46,
+    0x91548db5, 0x71c45d05, 0x0406d46f, 0x605015ff, 0x1998fb24, 0xd6bde997,
+    0x894043cc, 0x67d99e77, 0xb0e842bd, 0x07898b88, 0xe7195b38, 0x79c8eedb,
+    0xa17c0a47, 0x7c420fe9, 0xf8841ec9, 0x00000000, 0x09808683, 0x322bed48,
+    0x1e1170ac, 0x6c5a724e, 0xfd0efffb, 0x0f853856, 0x3daed51e, 0x362d3927,
+    0x0a0fd964, 0x685ca621, 0x9b5b54d1, 0x24362e3a, 0x0c0a67b1, 0x9357e70f,
+    0xb4ee96d2, 0x1b9b919e, 0x80c0c54f, 0x61dc20a2, 0x5a774b69, 0x1c121a16,
+    0xe293ba0a, 0xc0a02ae5, 0x3c22e043, 0x121b171d, 0x0e090d0b, 0xf28bc7ad,
+    0x2db6a8b9, 0x141ea9c8, 0x57f11985, 0xaf75074c, 0xee99ddbb, 0xa37f60fd,
+    0xf701269f, 0x5c72f5bc, 0x44663bc5, 0x5bfb7e34, 0x8b432976, 0xcb23c6dc,
+    0xb6edfc68, 0xb8e4f163, 0xd731dcca, 0x42638510, 0x13972240, 0x84c61120,
+    0x854a247d, 0xd2bb3df8, 0xaef93211, 0xc729a16d, 0x1d9e2f4b, 0xdcb230f3,
+    0x0d8652ec, 0x77c1e3d0, 0x2bb3166c, 0xa970b999, 0x119448fa, 0x47e96422,
+    0xa8fc8cc4, 0xa0f03f1a, 0x567d2cd8, 0x223390ef, 0x87494ec7, 0xd938d1c1,
+    0x8ccaa2fe, 0x98d40b36, 0xa6f581cf, 0xa57ade28, 0xdab78e26, 0x3fadbfa4,
+    0x2c3a9de4, 0x5078920d, 0x6a5fcc9b, 0x547e4662, 0xf68d13c2, 0x90d8b8e8,
+    0x2e39f75e, 0x82c3aff5, 0x9f5d80be, 0x69d0937c, 0x6fd52da9, 0xcf2512b3,
+    0xc8ac993b, 0x10187da7, 0xe89c636e, 0xdb3bbb7b, 0xcd267809, 0x6e5918f4,
+    0xec9ab701, 0x834f9aa8, 0xe6956e65, 0xaaffe67e, 0x21bccf08, 0xef15e8e6,
+    0xbae79bd9, 0x4a6f36ce, 0xea9f09d4, 0x29b07cd6, 0x31a4b2af, 0x2a3f2331,
+    0xc6a59430, 0x35a266c0, 0x744ebc37, 0xfc82caa6, 0xe090d0b0, 0x33a7d815,
+    0xf104984a, 0x41ecdaf7, 0x7fcd500e, 0x1791f62f, 0x764dd68d, 0x43efb04d,
+    0xccaa4d54, 0xe49604df, 0x9ed1b5e3, 0x4c6a881b, 0xc12c1fb8, 0x4665517f,
+    0x9d5eea04, 0x018c355d, 0xfa877473, 0xfb0b412e, 0xb3671d5a, 0x92dbd252,
+    0xe9105633, 0x6dd64713, 0x9ad7618c, 0x37a10c7a, 0x59f8148e, 0xeb133c89,
+    0xcea927ee, 0xb761c935, 0xe11ce5ed, 0x7a47b13c, 0x9cd2df59, 0x55f2733f,
+    0x1814ce79, 0x73c737bf, 0x53f7cdea, 0x5ffdaa5b, 0xdf3d6f14, 0x7844db86,
+    0xcaaff381, 0xb968c43e, 0x3824342c, 0xc2a3405f, 0x161dc372, 0xbce2250c,
+    0x283c498b, 0xff0d9541, 0x39a80171, 0x080cb3de, 0xd8b4e49c, 0x6456c190,
+    0x7bcb8461, 0xd532b670, 0x486c5c74, 0xd0b85742,
+};
+
+static const uint8_t Td4[256] = {
+    0x52, 0x09, 0x6a, 0xd5, 0x30, 0x36, 0xa5, 0x38, 0xbf, 0x40, 0xa3, 0x9e,
+    0x81, 0xf3, 0xd7, 0xfb, 0x7c, 0xe3, 0x39, 0x82, 0x9b, 0x2f, 0xff, 0x87,
+    0x34, 0x8e, 0x43, 0x44, 0xc4, 0xde, 0xe9, 0xcb, 0x54, 0x7b, 0x94, 0x32,
+    0xa6, 0xc2, 0x23, 0x3d, 0xee, 0x4c, 0x95, 0x0b, 0x42, 0xfa, 0xc3, 0x4e,
+    0x08, 0x2e, 0xa1, 0x66, 0x28, 0xd9, 0x24, 0xb2, 0x76, 0x5b, 0xa2, 0x49,
+    0x6d, 0x8b, 0xd1, 0x25, 0x72, 0xf8, 0xf6, 0x64, 0x86, 0x68, 0x98, 0x16,
+    0xd4, 0xa4, 0x5c, 0xcc, 0x5d, 0x65, 0xb6, 0x92, 0x6c, 0x70, 0x48, 0x50,
+    0xfd, 0xed, 0xb9, 0xda, 0x5e, 0x15, 0x46, 0x57, 0xa7, 0x8d, 0x9d, 0x84,
+    0x90, 0xd8, 0xab, 0x00, 0x8c, 0xbc, 0xd3, 0x0a, 0xf7, 0xe4, 0x58, 0x05,
+    0xb8, 0xb3, 0x45, 0x06, 0xd0, 0x2c, 0x1e, 0x8f, 0xca, 0x3f, 0x0f, 0x02,
+    0xc1, 0xaf, 0xbd, 0x03, 0x01, 0x13, 0x8a, 0x6b, 0x3a, 0x91, 0x11, 0x41,
+    0x4f, 0x67, 0xdc, 0xea, 0x97, 0xf2, 0xcf, 0xce, 0xf0, 0xb4, 0xe6, 0x73,
+    0x96, 0xac, 0x74, 0x22, 0xe7, 0xad, 0x35, 0x85, 0xe2, 0xf9, 0x37, 0xe8,
+    0x1c, 0x75, 0xdf, 0x6e, 0x47, 0xf1, 0x1a, 0x71, 0x1d, 0x29, 0xc5, 0x89,
+    0x6f, 0xb7, 0x62, 0x0e, 0xaa, 0x18, 0xbe, 0x1b, 0xfc, 0x56, 0x3e, 0x4b,
+    0xc6, 0xd2, 0x79, 0x20, 0x9a, 0xdb, 0xc0, 0xfe, 0x78, 0xcd, 0x5a, 0xf4,
+    0x1f, 0xdd, 0xa8, 0x33, 0x88, 0x07, 0xc7, 0x31, 0xb1, 0x12, 0x10, 0x59,
+    0x27, 0x80, 0xec, 0x5f, 0x60, 0x51, 0x7f, 0xa9, 0x19, 0xb5, 0x4a, 0x0d,
+    0x2d, 0xe5, 0x7a, 0x9f, 0x93, 0xc9, 0x9c, 0xef, 0xa0, 0xe0, 0x3b, 0x4d,
+    0xae, 0x2a, 0xf5, 0xb0, 0xc8, 0xeb, 0xbb, 0x3c, 0x83, 0x53, 0x99, 0x61,
+    0x17, 0x2b, 0x04, 0x7e, 0xba, 0x77, 0xd6, 0x26, 0xe1, 0x69, 0x14, 0x63,
+    0x55, 0x21, 0x0c, 0x7d,
+};
+
+typedef struct {
+    CryptoSet const *set;
+    DecryptKey const *key;
+    const uint8_t *iv;
+    const uint8_t *in;
+    uint8_t *out;
+    size_t num_blocks;
+} DecryptJob;
+
+static inline uint32_t ror(uint32_t value, int bits) {
+    return (value >> bits) | (value << (32 - bits));
+}
+
+static inline uint32_t get_word(const uint8_t *ptr) {
+    return (uint32_t)ptr[0] << 24 | (uint32_t)ptr[1] << 16 | (uint32_t)ptr[2] << 8 | ptr[3];
+}
+
+static inline void put_word(uint8_t *ptr, uint32_t value) {
+    ptr[0] = (uint8_t)(value >> 24);
+    ptr[1] = (uint8_t)(value >> 16);
+    ptr[2] = (uint8_t)(value >> 8);
+    ptr[3] = (uint8_t)value;
+}
+
+/* multiplication in GF(2^8) */
+static uint8_t gf_mul(uint8_t a, uint8_t b) {
+    uint8_t result = 0;
+    while (b != 0) {
+        if (b & 1) {
+            result ^= a;
+        }
+        a = (uint8_t)((a << 1) ^ (a & 0x80 ? 0x1b : 0));
+        b >>= 1;
+    }
+    return result;
+}
+
+/* converts the key schedule of aes_key_setup() for the equivalent inverse
+ * cipher: reverse order, with InvMixColumns applied to inner round keys */
+void SetupDecryptKey(DecryptKey *key, const uint32_t *schedule, int keysize) {
+    key->rounds = keysize / 32 + 6;
+    for (int round = 0; round <= key->rounds; round++) {
+        const uint32_t *words = &schedule[(key->rounds - round) * 4];
+        uint8_t *round_key = key->round_keys[round];
+        for (int c = 0; c < 4; c++) {
+            put_word(&round_key[c * 4], words[c]);
+        }
+        if (round == 0 || round == key->rounds) {
+            continue;
+        }
+        for (int c = 0; c < 16; c += 4) {
+            const uint8_t a0 = round_key[c];
+            const uint8_t a1 = round_key[c + 1];
+            const uint8_t a2 = round_key[c + 2];
+            const uint8_t a3 = round_key[c + 3];
+            round_key[c] = gf_mul(a0, 14) ^ gf_mul(a1, 11) ^ gf_mul(a2, 13) ^ gf_mul(a3, 9);
+            round_key[c + 1] = gf_mul(a0, 9) ^ gf_mul(a1, 14) ^ gf_mul(a2, 11) ^ gf_mul(a3, 13);
+            round_key[c + 2] = gf_mul(a0, 13) ^ gf_mul(a1, 9) ^ gf_mul(a2, 14) ^ gf_mul(a3, 11);
+            round_key[c + 3] = gf_mul(a0, 11) ^ gf_mul(a1, 13) ^ gf_mul(a2, 9) ^ gf_mul(a3, 14);
+        }
+    }
+}
+
+/* decrypts CBC blocks with lookup tables */
+static void decrypt_cbc_tables(DecryptKey const *key, const uint8_t *iv, const uint8_t *in,
+                               uint8_t *out, size_t num_blocks) {
+    uint32_t round_keys[(AES_MAX_ROUNDS + 1) * 4];
+    uint32_t prev[4];
+    const int rounds = key->rounds;
+
+    for (int c = 0; c < (rounds + 1) * 4; c++) {
+        round_keys[c] = get_word(&key->round_keys[c / 4][(c % 4) * 4]);
+    }
+    for (int c = 0; c < 4; c++) {
+        prev[c] = get_word(&iv[c * 4]);
+    }
+
+    for (size_t block = 0; block < num_blocks; block++, in += 16, out += 16) {
+        const uint32_t *rk = round_keys;
+        const uint32_t c0 = get_word(in);
+        const uint32_t c1 = get_word(in + 4);
+        const uint32_t c2 = get_word(in + 8);
+        const uint32_t c3 = get_word(in + 12);
+        uint32_t s0 = c0 ^ rk[0];
+        uint32_t s1 = c1 ^ rk[1];
+        uint32_t s2 = c2 ^ rk[2];
+        uint32_t s3 = c3 ^ rk[3];
+        uint32_t t0, t1, t2, t3;
+
+        for (int round = 1; round < rounds; round++) {
+            rk += 4;
+            t0 = Td0[s0 >> 24] ^ ror(Td0[(s3 >> 16) & 0xFF], 8) ^
+                 ror(Td0[(s2 >> 8) & 0xFF], 16) ^ ror(Td0[s1 & 0xFF], 24) ^ rk[0];
+            t1 = Td0[s1 >> 24] ^ ror(Td0[(s0 >> 16) & 0xFF], 8) ^
+                 ror(Td0[(s3 >> 8) & 0xFF], 16) ^ ror(Td0[s2 & 0xFF], 24) ^ rk[1];
+            t2 = Td0[s2 >> 24] ^ ror(Td0[(s1 >> 16) & 0xFF], 8) ^
+                 ror(Td0[(s0 >> 8) & 0xFF], 16) ^ ror(Td0[s3 & 0xFF], 24) ^ rk[2];
+            t3 = Td0[s3 >> 24] ^ ror(Td0[(s2 >> 16) & 0xFF], 8) ^
+                 ror(Td0[(s1 >> 8) & 0xFF], 16) ^ ror(Td0[s0 & 0xFF], 24) ^ rk[3];
+            s0 = t0;
+            s1 = t1;
+            s2 = t2;
+            s3 = t3;
+        }
+
+        rk += 4;
+        t0 = (uint32_t)Td4[s0 >> 24] << 24 | (uint32_t)Td4[(s3 >> 16) & 0xFF] << 16 |
+             (uint32_t)Td4[(s2 >> 8) & 0xFF] << 8 | Td4[s1 & 0xFF];
+        t1 = (uint32_t)Td4[s1 >> 24] << 24 | (uint32_t)Td4[(s0 >> 16) & 0xFF] << 16 |
+             (uint32_t)Td4[(s3 >> 8) & 0xFF] << 8 | Td4[s2 & 0xFF];
+        t2 = (uint32_t)Td4[s2 >> 24] << 24 | (uint32_t)Td4[(s1 >> 16) & 0xFF] << 16 |
+             (uint32_t)Td4[(s0 >> 8) & 0xFF] << 8 | Td4[s3 & 0xFF];
+        t3 = (uint32_t)Td4[s3 >> 24] << 24 | (uint32_t)Td4[(s2 >> 16) & 0xFF] << 16 |
+             (uint32_t)Td4[(s1 >> 8) & 0xFF] << 8 | Td4[s0 & 0xFF];
+
+        /* output may overwrite input, chain with the saved ciphertext */
+        put_word(out, t0 ^ rk[0] ^ prev[0]);
+        put_word(out + 4, t1 ^ rk[1] ^ prev[1]);
+        put_word(out + 8, t2 ^ rk[2] ^ prev[2]);
+        put_word(out + 12, t3 ^ rk[3] ^ prev[3]);
+        prev[0] = c0;
+        prev[1] = c1;
+        prev[2] = c2;
+        prev[3] = c3;
+    }
+}
+
+static uint32_t crc32_zlib(uint32_t crc, const uint8_t *data, size_t size) {
+    return (uint32_t)crc32_z(crc, data, size);
+}
+
+/* returns the best implementations supported by the CPU */
+static CryptoSet get_crypto_set(void) {
+    CryptoSet set = {decrypt_cbc_tables, crc32_zlib};
+    GetCryptoAESNI(&set);
+    return set;
+}
+
+static int DecryptThread(void *data) {
+    DecryptJob const *job = (DecryptJob const *)data;
+    job->set->decrypt_cbc(job->key, job->iv, job->in, job->out, job->num_blocks);
+    return 0;
+}
+
+/* decrypts whole 16-byte blocks of a CBC stream. Output must not overlap input
+ * when large enough to be split in threads */
+void DecryptCBC(DecryptKey const *key, const uint8_t *iv, const uint8_t *in, uint8_t *out,
+                size_t size) {
+    const CryptoSet set = get_crypto_set();
+    const size_t num_blocks = size / 16;
+    DecryptJob jobs[MAX_THREADS];
+    SDL_Thread *threads[MAX_THREADS] = {NULL};
+    int num_jobs = 1;
+
+    if (size >= PARALLEL_SIZE) {
+        num_jobs = SDL_GetNumLogicalCPUCores();
+        if (num_jobs > MAX_THREADS) {
+            num_jobs = MAX_THREADS;
+        } else if (num_jobs < 1) {
+            num_jobs = 1;
+        }
+    }
+
+    /* each chunk chains from the last ciphertext block of the previous one */
+    const size_t chunk = (num_blocks + (size_t)num_jobs - 1) / (size_t)num_jobs;
+    for (int c = 0; c < num_jobs; c++) {
+        const size_t first = chunk * (size_t)c;
+        DecryptJob *job = &jobs[c];
+        job->set = &set;
+        job->key = key;
+        job->iv = c == 0 ? iv : in + (first - 1) * 16;
+        job->in = in + first * 16;
+        job->out = out + first * 16;
+        job->num_blocks = first < num_blocks ? num_blocks - first : 0;
+        if (job->num_blocks > chunk) {
+            job->num_blocks = chunk;
+        }
+        if (c > 0 && job->num_blocks > 0) {
+            threads[c] = SDL_CreateThread(DecryptThread, "TLN_Decrypt", job);
+        }
+    }
+
+    /* first chunk in this thread, along with any that couldn't get a thread */
+    for (int c = 0; c < num_jobs; c++) {
+        if (threads[c] != NULL) {
+            continue;
+        }
+        if (jobs[c].num_blocks > 0) {
+            DecryptThread(&jobs[c]);
+        }
+    }
+    for (int c = 1; c < num_jobs; c++) {
+        if (threads[c] != NULL) {
+            SDL_WaitThread(threads[c], NULL);
+        }
+    }
+}
+
+/* CRC32 compatible with zlib crc32() */
+uint32_t Crc32(uint32_t crc, const void *data, size_t size) {
+    return get_crypto_set().crc32(crc, (const uint8_t *)data, size);
+}
@@ -0,0 +1,43 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* AES CBC decryption and CRC32 of resource packs, using AES-NI and PCLMULQDQ
+ * when the CPU supports them */
+
+#ifndef CRYPTO_H
+#define CRYPTO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define AES_MAX_ROUNDS 14
+
+/* round keys of the equivalent inverse cipher, in the order they're applied */
+typedef struct {
+    uint8_t round_keys[AES_MAX_ROUNDS + 1][16];
+    int rounds;
+} DecryptKey;
+
+/* implementations for an instruction set */
+typedef struct {
+    void (*decrypt_cbc)(DecryptKey const *key, const uint8_t *iv, const uint8_t *in, uint8_t *out,
+                        size_t num_blocks);
+    uint32_t (*crc32)(uint32_t crc, const uint8_t *data, size_t size);
+} CryptoSet;
+
+bool GetCryptoAESNI(CryptoSet *set);
+
+void SetupDecryptKey(DecryptKey *key, const uint32_t *schedule, int keysize);
+void DecryptCBC(DecryptKey const *key, const uint8_t *iv, const uint8_t *in, uint8_t *out,
+                size_t size);
+uint32_t Crc32(uint32_t crc, const void *data, size_t size);
+
+#endif
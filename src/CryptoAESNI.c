@@ -0,0 +1,190 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* AES-NI decryption, 8 CBC blocks interleaved to hide the latency of AESDEC,
+ * and CRC32 folding 64 bytes at a time with carry-less multiplication, as
+ * described in Intel's "Fast CRC Computation for Generic Polynomials Using
+ * PCLMULQDQ Instruction". This file is built with AES and PCLMUL enabled, and
+ * its functions are only returned after checking the CPU */
+
+#include "Crypto.h"
+
+#if (defined(__AES__) && defined(__PCLMUL__)) || (defined(_MSC_VER) && defined(_M_X64))
+
+#include <immintrin.h>
+
+#include "zlib.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#define INTERLEAVE 8
+
+/* decrypts CBC blocks with AES-NI */
+static void decrypt_cbc_aesni(DecryptKey const *key, const uint8_t *iv, const uint8_t *in,
+                              uint8_t *out, size_t num_blocks) {
+    __m128i round_keys[AES_MAX_ROUNDS + 1];
+    const int rounds = key->rounds;
+    __m128i prev = _mm_loadu_si128((const __m128i *)iv);
+
+    for (int c = 0; c <= rounds; c++) {
+        round_keys[c] = _mm_loadu_si128((const __m128i *)key->round_keys[c]);
+    }
+
+    for (; num_blocks >= INTERLEAVE; num_blocks -= INTERLEAVE) {
+        const __m128i *src = (const __m128i *)in;
+        __m128i s0 = _mm_xor_si128(_mm_loadu_si128(src), round_keys[0]);
+        __m128i s1 = _mm_xor_si128(_mm_loadu_si128(src + 1), round_keys[0]);
+        __m128i s2 = _mm_xor_si128(_mm_loadu_si128(src + 2), round_keys[0]);
+        __m128i s3 = _mm_xor_si128(_mm_loadu_si128(src + 3), round_keys[0]);
+        __m128i s4 = _mm_xor_si128(_mm_loadu_si128(src + 4), round_keys[0]);
+        __m128i s5 = _mm_xor_si128(_mm_loadu_si128(src + 5), round_keys[0]);
+        __m128i s6 = _mm_xor_si128(_mm_loadu_si128(src + 6), round_keys[0]);
+        __m128i s7 = _mm_xor_si128(_mm_loadu_si128(src + 7), round_keys[0]);
+        for (int round = 1; round < rounds; round++) {
+            const __m128i round_key = round_keys[round];
+            s0 = _mm_aesdec_si128(s0, round_key);
+            s1 = _mm_aesdec_si128(s1, round_key);
+            s2 = _mm_aesdec_si128(s2, round_key);
+            s3 = _mm_aesdec_si128(s3, round_key);
+            s4 = _mm_aesdec_si128(s4, round_key);
+            s5 = _mm_aesdec_si128(s5, round_key);
+            s6 = _mm_aesdec_si128(s6, round_key);
+            s7 = _mm_aesdec_si128(s7, round_key);
+        }
+
+        /* ciphertext is loaded again for chaining, output may overwrite it */
+        const __m128i last_key = round_keys[rounds];
+        const __m128i c0 = _mm_loadu_si128(src);
+        const __m128i c1 = _mm_loadu_si128(src + 1);
+        const __m128i c2 = _mm_loadu_si128(src + 2);
+        const __m128i c3 = _mm_loadu_si128(src + 3);
+        const __m128i c4 = _mm_loadu_si128(src + 4);
+        const __m128i c5 = _mm_loadu_si128(src + 5);
+        const __m128i c6 = _mm_loadu_si128(src + 6);
+        const __m128i c7 = _mm_loadu_si128(src + 7);
+        __m128i *dst = (__m128i *)out;
+        _mm_storeu_si128(dst, _mm_xor_si128(_mm_aesdeclast_si128(s0, last_key), prev));
+        _mm_storeu_si128(dst + 1, _mm_xor_si128(_mm_aesdeclast_si128(s1, last_key), c0));
+        _mm_storeu_si128(dst + 2, _mm_xor_si128(_mm_aesdeclast_si128(s2, last_key), c1));
+        _mm_storeu_si128(dst + 3, _mm_xor_si128(_mm_aesdeclast_si128(s3, last_key), c2));
+        _mm_storeu_si128(dst + 4, _mm_xor_si128(_mm_aesdeclast_si128(s4, last_key), c3));
+        _mm_storeu_si128(dst + 5, _mm_xor_si128(_mm_aesdeclast_si128(s5, last_key), c4));
+        _mm_storeu_si128(dst + 6, _mm_xor_si128(_mm_aesdeclast_si128(s6, last_key), c5));
+        _mm_storeu_si128(dst + 7, _mm_xor_si128(_mm_aesdeclast_si128(s7, last_key), c6));
+        prev = c7;
+        in += INTERLEAVE * 16;
+        out += INTERLEAVE * 16;
+    }
+
+    for (; num_blocks > 0; num_blocks--) {
+        const __m128i cipher = _mm_loadu_si128((const __m128i *)in);
+        __m128i state = _mm_xor_si128(cipher, round_keys[0]);
+        for (int round = 1; round < rounds; round++) {
+            state = _mm_aesdec_si128(state, round_keys[round]);
+        }
+        state = _mm_aesdeclast_si128(state, round_keys[rounds]);
+        _mm_storeu_si128((__m128i *)out, _mm_xor_si128(state, prev));
+        prev = cipher;
+        in += 16;
+        out += 16;
+    }
+}
+
+/* folds 128 bits of remainder over the next 128 bits of data */
+static inline __m128i fold(__m128i value, __m128i data, __m128i constants) {
+    const __m128i low = _mm_clmulepi64_si128(value, constants, 0x00);
+    const __m128i high = _mm_clmulepi64_si128(value, constants, 0x11);
+    return _mm_xor_si128(_mm_xor_si128(low, high), data);
+}
+
+/* CRC32 of multiples of 16 bytes, at least 64, over a non-inverted crc.
+ * Constants are powers of x modulo the bit-reflected polynomial */
+static uint32_t crc32_fold(uint32_t crc, const uint8_t *data, size_t size) {
+    const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596, 0x0154442bd4);
+    const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e, 0x01751997d0);
+    const __m128i k5 = _mm_set_epi64x(0, 0x0163cd6124);
+    const __m128i poly = _mm_set_epi64x(0x01f7011641, 0x01db710641);
+    const __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+    const __m128i *ptr = (const __m128i *)data;
+
+    /* four parallel remainders over 64-byte blocks */
+    __m128i x1 = _mm_xor_si128(_mm_loadu_si128(ptr), _mm_cvtsi32_si128((int)crc));
+    __m128i x2 = _mm_loadu_si128(ptr + 1);
+    __m128i x3 = _mm_loadu_si128(ptr + 2);
+    __m128i x4 = _mm_loadu_si128(ptr + 3);
+    for (ptr += 4, size -= 64; size >= 64; ptr += 4, size -= 64) {
+        x1 = fold(x1, _mm_loadu_si128(ptr), k1k2);
+        x2 = fold(x2, _mm_loadu_si128(ptr + 1), k1k2);
+        x3 = fold(x3, _mm_loadu_si128(ptr + 2), k1k2);
+        x4 = fold(x4, _mm_loadu_si128(ptr + 3), k1k2);
+    }
+
+    /* merge them, then fold the remaining 16-byte blocks */
+    x1 = fold(x1, x2, k3k4);
+    x1 = fold(x1, x3, k3k4);
+    x1 = fold(x1, x4, k3k4);
+    for (; size >= 16; ptr++, size -= 16) {
+        x1 = fold(x1, _mm_loadu_si128(ptr), k3k4);
+    }
+
+    /* reduce 128 to 64 bits */
+    x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+    x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), k5, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    /* Barrett reduction to 32 bits */
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x1, mask32), poly, 0x10);
+    x2 = _mm_clmulepi64_si128(_mm_and_si128(x2, mask32), poly, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+    return (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+
+/* folds the bulk of the data, zlib computes the tail */
+static uint32_t crc32_pclmul(uint32_t crc, const uint8_t *data, size_t size) {
+    if (size >= 64) {
+        const size_t bulk = size & ~(size_t)15;
+        crc = ~crc32_fold(~crc, data, bulk);
+        data += bulk;
+        size -= bulk;
+    }
+    return (uint32_t)crc32_z(crc, data, size);
+}
+
+static bool has_aesni(void) {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    return (info[2] & (1 << 25)) != 0 && (info[2] & (1 << 1)) != 0;
+#else
+    return __builtin_cpu_supports("aes") && __builtin_cpu_supports("pclmul");
+#endif
+}
+
+bool GetCryptoAESNI(CryptoSet *set) {
+    if (!has_aesni()) {
+        return false;
+    }
+    set->decrypt_cbc = decrypt_cbc_aesni;
+    set->crc32 = crc32_pclmul;
+    return true;
+}
+
+#else
+
+bool GetCryptoAESNI(CryptoSet *set) {
+    (void)set;
+    return false;
+}
+
+#endif
@@ -10,104 +10,304 @@
 
 #include "Draw.h"
 
-#include <SDL3/SDL_timer.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "Bitmap.h"
 #include "Engine.h"
 #include "ObjectList.h"
+#include "Occlusion.h"
 #include "Palette.h"
 #include "Sprite.h"
 #include "Tilemap.h"
 #include "Tilengine.h"
 #include "Tileset.h"
+#include "Trace.h"
 
 /* private prototypes */
-static void DrawSpriteCollision(int nsprite, uint8_t const *srcpixel, uint16_t *dstpixel, int width,
-                                int dx);
-static void DrawSpriteCollisionScaling(int nsprite, uint8_t const *srcpixel, uint16_t *dstpixel,
-                                       int width, int dx, int srcx);
-
-/* blend-mask render-path profiling counters (accumulated per frame) */
-uint64_t g_prof_linebuf_ticks = 0;
-uint64_t g_prof_fillmask_ticks = 0;
-uint64_t g_prof_blit_ticks = 0;
-uint64_t g_prof_layers_ticks = 0;
-uint64_t g_prof_sprites_ticks = 0;
-uint64_t g_prof_per_layer_ticks[8] = {0};
-
-static bool check_sprite_coverage(Sprite const *sprite, int nscan) {
+static void DrawSpriteCollision(ScanContext *ctx, int nsprite, uint8_t const *srcpixel,
+                                uint16_t *dstpixel, int width, int dx);
+static void DrawSpriteCollisionScaling(ScanContext *ctx, int nsprite, uint8_t const *srcpixel,
+                                       uint16_t *dstpixel, int width, int dx, int srcx);
+
+/* allocates scratch buffers for drawing the given engine context */
+bool CreateScanContext(ScanContext *ctx, Engine *context) {
+    const int width = context->framebuffer.width;
+    const int numlayers = context->numlayers;
+    const int numsprites = context->numsprites;
+
+    memset(ctx, 0, sizeof(ScanContext));
+    ctx->view = context;
+    if (!CreateFrameCounters(&ctx->stats, numlayers) ||
+        !CreateScanOverdraw(&ctx->overdraw, 1 + numlayers + numsprites)) {
+        return false;
+    }
+
+    /* engine copy followed by its layers */
+    ctx->replay = (Engine *)malloc(sizeof(Engine) + ((size_t)numlayers * sizeof(Layer)));
+    if (!ctx->replay) {
+        return false;
+    }
+    if (numlayers > 0) {
+        ctx->linebuffer = (uint32_t *)calloc((size_t)width, sizeof(uint32_t));
+        ctx->water_render = (uint32_t *)calloc((size_t)width, sizeof(uint32_t));
+        ctx->priority = (uint32_t *)malloc((size_t)width * sizeof(uint32_t));
+        ctx->blend_mask = (uint8_t *)calloc((size_t)width, sizeof(uint8_t));
+        ctx->mosaic = (uint32_t **)calloc((size_t)numlayers, sizeof(uint32_t *));
+
+        /* disjoint spans are at least one pixel apart */
+        ctx->max_spans = (width / 2) + 2;
+        ctx->cover = (Span *)malloc((size_t)ctx->max_spans * sizeof(Span));
+        ctx->spans = (Span *)malloc((size_t)3 * (size_t)ctx->max_spans * sizeof(Span));
+        ctx->visible =
+            (Span *)malloc((size_t)(numlayers + 1) * (size_t)ctx->max_spans * sizeof(Span));
+        ctx->num_visible = (int *)malloc((size_t)(numlayers + 1) * sizeof(int));
+        if (!ctx->linebuffer || !ctx->water_render || !ctx->priority || !ctx->blend_mask ||
+            !ctx->mosaic || !ctx->cover || !ctx->spans || !ctx->visible || !ctx->num_visible) {
+            DeleteScanContext(ctx);
+            return false;
+        }
+
+        /* one block shared by all layers, rows indexed by layer */
+        ctx->mosaic[0] = (uint32_t *)calloc((size_t)numlayers * (size_t)width, sizeof(uint32_t));
+        if (!ctx->mosaic[0]) {
+            DeleteScanContext(ctx);
+            return false;
+        }
+        for (int c = 1; c < numlayers; c++) {
+            ctx->mosaic[c] = ctx->mosaic[0] + ((ptrdiff_t)c * width);
+        }
+    }
+
+    if (numsprites > 0) {
+        ctx->collision = (uint16_t *)calloc((size_t)width, sizeof(uint16_t));
+        ctx->sprite_line = (uint8_t *)malloc((size_t)width * sizeof(uint8_t));
+        ctx->hits = (uint8_t *)calloc((size_t)numsprites, sizeof(uint8_t));
+        ctx->hit_list = (int *)malloc((size_t)numsprites * sizeof(int));
+        if (!ctx->collision || !ctx->sprite_line || !ctx->hits || !ctx->hit_list) {
+            DeleteScanContext(ctx);
+            return false;
+        }
+    }
+    return true;
+}
+
+/* frees scratch buffers allocated by CreateScanContext() */
+void DeleteScanContext(ScanContext *ctx) {
+    if (ctx->mosaic) {
+        free(ctx->mosaic[0]);
+        free(ctx->mosaic);
+    }
+    free(ctx->linebuffer);
+    free(ctx->water_render);
+    free(ctx->priority);
+    free(ctx->blend_mask);
+    free(ctx->cover);
+    free(ctx->spans);
+    free(ctx->visible);
+    free(ctx->num_visible);
+    free(ctx->collision);
+    free(ctx->sprite_line);
+    free(ctx->hits);
+    free(ctx->hit_list);
+    free(ctx->replay);
+    SetTileCacheBudget(&ctx->tile_cache, 0);
+    DeleteFrameCounters(&ctx->stats);
+    DeleteScanOverdraw(&ctx->overdraw);
+    memset(ctx, 0, sizeof(ScanContext));
+}
+
+/* flushes sprite collisions, frame statistics and overdraw costs gathered by
+ * a scan context into shared engine state. Collisions are ORed, so merge order is irrelevant */
+void MergeScanContext(ScanContext *ctx) {
+    for (int c = 0; c < ctx->num_hits; c++) {
+        const int nsprite = ctx->hit_list[c];
+        SetSpriteFlag(&engine->sprites[nsprite], SPRITE_FLAG_COLLISION, true);
+        ctx->hits[nsprite] = 0;
+    }
+    ctx->num_hits = 0;
+
+    MergeFrameCounters(&engine->stats.current, &ctx->stats, engine->numlayers);
+    MergeScanOverdraw(&ctx->overdraw);
+}
+
+/* records a sprite collision to be merged by MergeScanContext() */
+static inline void add_collision_hit(ScanContext *ctx, int nsprite) {
+    if (ctx->hits[nsprite] == 0) {
+        ctx->hits[nsprite] = 1;
+        ctx->hit_list[ctx->num_hits++] = nsprite;
+    }
+}
+
+/* returns render pipeline for a layer, honoring blend mask override */
+static inline LayerRender const *get_layer_render(ScanContext const *ctx, Layer const *layer) {
+    return ctx->render != NULL ? ctx->render : &layer->render;
+}
+
+static bool check_sprite_coverage(ScanContext const *ctx, SpriteRender const *sprite,
+                                  int nscan) {
     /* check sprite coverage */
     if (nscan < sprite->dstrect.y1 || nscan >= sprite->dstrect.y2) {
         return false;
     }
-    if (sprite->dstrect.x2 < 0 || sprite->srcrect.x2 < 0) {
+    if (sprite->clipped) {
         return false;
     }
-    if ((sprite->flags & FLAG_MASKED) && nscan >= engine->sprite_mask.top &&
-        nscan <= engine->sprite_mask.bottom) {
+    if ((sprite->flags & FLAG_MASKED) && nscan >= ctx->view->sprite_mask.top &&
+        nscan <= ctx->view->sprite_mask.bottom) {
         return false;
     }
     return true;
 }
 
 /* selects target scan buffer and sets build_mosaic flag */
-static uint32_t *select_scan_buffer(Layer const *layer, int line, bool *build_mosaic) {
+static uint32_t *select_scan_buffer(ScanContext *ctx, Layer const *layer, int line,
+                                    bool *build_mosaic) {
     *build_mosaic = false;
     if (layer->mosaic.h != 0) {
         if (line % layer->mosaic.h == 0) {
             *build_mosaic = true;
-            return engine->linebuffer;
+            return ctx->linebuffer;
         }
         return NULL;
     }
     if (layer->render.mode >= MODE_TRANSFORM) {
-        return engine->linebuffer;
+        return ctx->linebuffer;
     }
     return GetFramebufferLine(line);
 }
 
+/* draws [x1, x2) of a layer scanline, limited to the spans left visible by
+ * occlusion culling */
+static bool draw_layer_span(ScanContext *ctx, int nlayer, uint32_t *scan, int line, int x1,
+                            int x2) {
+    Layer const *layer = &ctx->view->layers[nlayer];
+    if (!ctx->culling || ctx->num_visible[nlayer] < 0) {
+        PROFILE_LAYER(ctx, nlayer, pixels, x2 > x1 ? x2 - x1 : 0);
+        return layer->render.draw(ctx, nlayer, scan, line, x1, x2);
+    }
+
+    Span const *span = &ctx->visible[nlayer * ctx->max_spans];
+    bool priority = false;
+    int drawn = 0;
+    for (int c = 0; c < ctx->num_visible[nlayer]; c++, span++) {
+        const int sx1 = span->x1 > x1 ? span->x1 : x1;
+        const int sx2 = span->x2 < x2 ? span->x2 : x2;
+        if (sx1 < sx2) {
+            priority |= layer->render.draw(ctx, nlayer, scan, line, sx1, sx2);
+            drawn += sx2 - sx1;
+        }
+    }
+    if (x2 > x1) {
+        PROFILE_LAYER(ctx, nlayer, pixels, drawn);
+        PROFILE_LAYER(ctx, nlayer, culled_pixels, x2 - x1 - drawn);
+    }
+    return priority;
+}
+
 /* draws the regular (non-mosaic) region respecting window invert and inside */
-static bool draw_window_region(int nlayer, uint32_t *scan, int line, LayerWindow const *window,
-                               bool inside, int framewidth) {
-    Layer const *layer = &engine->layers[nlayer];
+static bool draw_window_region(ScanContext *ctx, int nlayer, uint32_t *scan, int line,
+                               LayerWindow const *window, bool inside, int framewidth) {
+    Layer const *layer = &ctx->view->layers[nlayer];
     bool priority = false;
     if (!window->invert) {
         if (inside) {
-            priority |= layer->render.draw(nlayer, scan, line, window->x1, window->x2);
+            priority |= draw_layer_span(ctx, nlayer, scan, line, window->x1, window->x2);
         }
     } else {
         if (inside) {
-            priority |= layer->render.draw(nlayer, scan, line, 0, layer->window.x1);
-            priority |= layer->render.draw(nlayer, scan, line, layer->window.x2, framewidth);
+            priority |= draw_layer_span(ctx, nlayer, scan, line, 0, layer->window.x1);
+            priority |= draw_layer_span(ctx, nlayer, scan, line, layer->window.x2, framewidth);
         } else {
-            priority |= layer->render.draw(nlayer, scan, line, 0, framewidth);
+            priority |= draw_layer_span(ctx, nlayer, scan, line, 0, framewidth);
         }
     }
     return priority;
 }
 
+/* renders the given line of a mosaic layer into its mosaic buffer */
+static bool build_mosaic_line(ScanContext *ctx, int nlayer, int line) {
+    Layer const *layer = &ctx->view->layers[nlayer];
+    LayerWindow const *window = &layer->window;
+    uint32_t *mosaic = ctx->mosaic[nlayer];
+    const bool inside = (line >= window->y1 && line <= window->y2) != 0;
+    const int framewidth = engine->framebuffer.width;
+
+    memset(ctx->linebuffer, 0, (size_t)framewidth * sizeof(uint32_t));
+    bool priority = draw_window_region(ctx, nlayer, ctx->linebuffer, line, window, inside,
+                                       framewidth);
+    memset(mosaic, 0, (size_t)framewidth * sizeof(uint32_t));
+    BlitMosaic(ctx->linebuffer, mosaic, framewidth, layer->mosaic.w, NULL);
+    CountOverdraw(&ctx->overdraw, OVERDRAW_LAYER(nlayer), 0, framewidth);
+    return priority;
+}
+
+/* mosaic buffers carry pixels across scanlines: returns the first line of the
+ * mosaic block containing line when rendering must rebuild it to start there,
+ * or -1 */
+static int get_mosaic_base(ScanContext const *ctx, int nlayer, int line) {
+    Layer const *layer = &ctx->view->layers[nlayer];
+    if (!layer->flags.ok || layer->flags.is_blend_source || layer->mosaic.h == 0) {
+        return -1;
+    }
+    if (layer->blend_mask_layer >= 0 && ctx->blend_mask != NULL) {
+        return -1;
+    }
+    if (line % layer->mosaic.h == 0) {
+        return -1;
+    }
+    return line - (line % layer->mosaic.h);
+}
+
+/* rebuilds the mosaic buffers required to start rendering at line */
+static void prime_mosaic_lines(ScanContext *ctx, int line) {
+    for (int c = 0; c < engine->numlayers; c++) {
+        const int base = get_mosaic_base(ctx, c, line);
+        if (base >= 0) {
+            build_mosaic_line(ctx, c, base);
+        }
+    }
+}
+
+/* like prime_mosaic_lines() for state that changes between scanlines: called
+ * for each line above band_line, rebuilds the mosaic buffers whose block
+ * starts at line */
+void PrimeMosaicLines(ScanContext *ctx, int line, int band_line) {
+    for (int c = 0; c < engine->numlayers; c++) {
+        if (get_mosaic_base(ctx, c, band_line) == line) {
+            build_mosaic_line(ctx, c, line);
+        }
+    }
+}
+
 /* blits the mosaic linebuffer to the framebuffer respecting window settings */
-static void blit_mosaic_window(uint32_t *mosaic, uint32_t *scan, LayerWindow const *window,
-                               bool inside, int framewidth, int windowwidth, uint8_t const *blend) {
+static void blit_mosaic_window(ScanContext *ctx, int nlayer, uint32_t *mosaic, uint32_t *scan,
+                               LayerWindow const *window, bool inside, int framewidth,
+                               int windowwidth, uint8_t const *blend) {
+    const int source = OVERDRAW_LAYER(nlayer);
     if (!window->invert) {
         if (inside) {
             Blit32_32(mosaic + window->x1, scan + window->x1, windowwidth, blend);
+            CountOverdraw(&ctx->overdraw, source, window->x1, windowwidth);
         }
     } else {
         if (inside) {
             Blit32_32(mosaic, scan, windowwidth, blend);
             Blit32_32(mosaic + window->x2, scan + window->x2, framewidth - window->x2, blend);
+            CountOverdraw(&ctx->overdraw, source, 0, windowwidth);
+            CountOverdraw(&ctx->overdraw, source, window->x2, framewidth - window->x2);
         } else {
             Blit32_32(mosaic, scan, framewidth, blend);
+            CountOverdraw(&ctx->overdraw, source, 0, framewidth);
         }
     }
 }
 
 /* fills the clipped (outside-window) region with the window color */
-static void blit_clipped_window(uint32_t *scan, LayerWindow const *window, bool inside,
-                                int framewidth, int windowwidth) {
+static void blit_clipped_window(ScanContext *ctx, int nlayer, uint32_t *scan,
+                                LayerWindow const *window, bool inside, int framewidth,
+                                int windowwidth) {
+    const int source = OVERDRAW_LAYER(nlayer);
     if (window->color == 0) {
         return;
     }
@@ -115,15 +315,19 @@ static void blit_clipped_window(uint32_t *scan, LayerWindow const *window, bool
         if (inside) {
             BlitColor(scan, window->color, window->x1, window->blend);
             BlitColor(scan + window->x2, window->color, framewidth - window->x2, window->blend);
+            CountOverdraw(&ctx->overdraw, source, 0, window->x1);
+            CountOverdraw(&ctx->overdraw, source, window->x2, framewidth - window->x2);
         } else {
             BlitColor(scan, window->color, framewidth, window->blend);
+            CountOverdraw(&ctx->overdraw, source, 0, framewidth);
         }
     } else if (inside) {
         BlitColor(scan + window->x1, window->color, windowwidth, window->blend);
+        CountOverdraw(&ctx->overdraw, source, window->x1, windowwidth);
     }
 }
 
-/* fills engine->blend_mask for the given scanline by sampling the actual
+/* fills ctx->blend_mask for the given scanline by sampling the actual
  * tileset pixel index of each screen column from layer nmask: positions where
  * the tileset pixel is non-zero (opaque) are set to 1, transparent pixels
  * (palette index 0) or empty tiles leave the mask at 0.
@@ -132,11 +336,11 @@ static void blit_clipped_window(uint32_t *scan, LayerWindow const *window, bool
  * per tile (rather than recalculating the full index inside a per-pixel loop)
  * and walk it forward (or backward for FLIPX), removing the multiply+shift
  * from every inner-loop iteration. */
-static void fill_blend_mask_scanline(int nmask, int nscan) {
-    Layer const *layer = &engine->layers[nmask];
+static void fill_blend_mask_scanline(ScanContext *ctx, int nmask, int nscan) {
+    Layer const *layer = &ctx->view->layers[nmask];
     int framewidth = engine->framebuffer.width;
-    memset(engine->blend_mask, 0, framewidth);
-    memset(engine->water_render, 0, framewidth * sizeof(uint32_t));
+    memset(ctx->blend_mask, 0, (size_t)framewidth);
+    memset(ctx->water_render, 0, (size_t)framewidth * sizeof(uint32_t));
 
     if (!layer->flags.ok || layer->tilemap == NULL) {
         return;
@@ -171,8 +375,8 @@ static void fill_blend_mask_scanline(int nmask, int nscan) {
             /* pointer to the first pixel of this tile's row in the data array */
             const uint8_t *row =
                 &ts->data[((((ptrdiff_t)tile_index << ts->vshift) + srcy) << ts->hshift)];
-            uint8_t *out = &engine->blend_mask[x];
-            uint32_t *wr = engine->water_render + x;
+            uint8_t *out = &ctx->blend_mask[x];
+            uint32_t *wr = ctx->water_render + x;
             uint32_t const *color = (uint32_t *)ts->palette->data;
             if (tile->flags & FLAG_FLIPX) {
                 /* walk backward: first sample column is (width-1 - srcx_offset) from right */
@@ -194,6 +398,17 @@ static void fill_blend_mask_scanline(int nmask, int nscan) {
                     }
                 }
             }
+        } else {
+            /* skip the whole run of empty tiles */
+            const int run = GetTilemapEmptyRun(tilemap, ytile, xtile);
+            if (run > 1) {
+                x1 += (run - 1) * tileset->width;
+                if (x1 > framewidth) {
+                    x1 = framewidth;
+                }
+                width = x1 - x;
+                xtile += run - 1;
+            }
         }
 
         x += width;
@@ -205,8 +420,8 @@ static void fill_blend_mask_scanline(int nmask, int nscan) {
 }
 
 /* draw background scanline taking into account mosaic and windowing effects */
-static bool draw_background_scanline(int nlayer, int line) {
-    Layer *layer = &engine->layers[nlayer];
+static bool draw_background_scanline(ScanContext *ctx, int nlayer, int line) {
+    Layer const *layer = &ctx->view->layers[nlayer];
 
     /* blend-source layers supply their pixels via fill_blend_mask_scanline;
      * skip the normal framebuffer render to avoid the expensive full-screen blit. */
@@ -215,7 +430,6 @@ static bool draw_background_scanline(int nlayer, int line) {
     }
 
     LayerWindow const *window = &layer->window;
-    uint32_t *mosaic = layer->mosaic.buffer;
     const bool inside = (line >= window->y1 && line <= window->y2) != 0;
     const int framewidth = engine->framebuffer.width;
     const int windowwidth = layer->window.x2 - layer->window.x1;
@@ -224,87 +438,107 @@ static bool draw_background_scanline(int nlayer, int line) {
 
     /* per-pixel blend mask path: render layer to linebuffer without blend,
      * then composite onto framebuffer using the mask layer's tile coverage. */
-    if (layer->blend_mask_layer >= 0 && engine->blend_mask != NULL) {
-        uint8_t *saved_blend = layer->render.blend;
-        ScanBlitPtr saved_blitters[2] = {layer->render.blitters[0], layer->render.blitters[1]};
-        uint32_t *lb = engine->linebuffer;
+    if (layer->blend_mask_layer >= 0 && ctx->blend_mask != NULL) {
+        uint32_t *lb = ctx->linebuffer;
         uint32_t *fb = GetFramebufferLine(line);
 
-        /* temporarily switch to non-blend blitters so pixels land in linebuffer
-         * as plain RGBA values ready for the masked composite below. */
+        /* draw through non-blend blitters so pixels land in linebuffer as
+         * plain RGBA values ready for the masked composite below. The layer
+         * itself is shared between threads and must not be modified. */
         bool scaling = layer->render.mode == MODE_SCALING;
-        layer->render.blend = NULL;
-        layer->render.blitters[0] = SelectBlitter(false, scaling, false);
-        layer->render.blitters[1] = SelectBlitter(true, scaling, false);
+        LayerRender plain = layer->render;
+        plain.blend = NULL;
+        plain.blitters[0] = SelectBlitter(false, scaling, false);
+        plain.blitters[1] = SelectBlitter(true, scaling, false);
 
         memset(lb, 0, framewidth * sizeof(uint32_t));
-        uint64_t t0 = SDL_GetPerformanceCounter();
-        priority |= draw_window_region(nlayer, lb, line, window, inside, framewidth);
-        uint64_t t1 = SDL_GetPerformanceCounter();
-
-        layer->render.blend = saved_blend;
-        layer->render.blitters[0] = saved_blitters[0];
-        layer->render.blitters[1] = saved_blitters[1];
-
-        engine->blend_mask_blend = saved_blend;
-        fill_blend_mask_scanline(layer->blend_mask_layer, line);
-        uint64_t t2 = SDL_GetPerformanceCounter();
-        Blit32_32_Masked_src(lb, engine->water_render, fb, engine->blend_mask, saved_blend,
+        ctx->render = &plain;
+        priority |= draw_window_region(ctx, nlayer, lb, line, window, inside, framewidth);
+        ctx->render = NULL;
+
+        PROFILE_TICKS(t0);
+        ctx->blend_mask_blend = layer->render.blend;
+        fill_blend_mask_scanline(ctx, layer->blend_mask_layer, line);
+        Blit32_32_Masked_src(lb, ctx->water_render, fb, ctx->blend_mask, layer->render.blend,
                              framewidth);
-        uint64_t t3 = SDL_GetPerformanceCounter();
-
-        g_prof_linebuf_ticks += t1 - t0;
-        g_prof_fillmask_ticks += t2 - t1;
-        g_prof_blit_ticks += t3 - t2;
+        CountOverdraw(&ctx->overdraw, OVERDRAW_LAYER(nlayer), 0, framewidth);
+        PROFILE_TICKS(t1);
+        PROFILE_COUNT(ctx, blend_mask_ns, t1 - t0);
+        PROFILE_LAYER(ctx, nlayer, blits, 1);
         return priority;
     }
 
-    uint32_t *scan = select_scan_buffer(layer, line, &build_mosaic);
-    if (scan == engine->linebuffer && scan != NULL) {
-        memset(scan, 0, framewidth * sizeof(uint32_t));
-    }
-
-    if (scan != NULL) {
-        priority |= draw_window_region(nlayer, scan, line, window, inside, framewidth);
-    }
-
-    scan = GetFramebufferLine(line);
-
-    /* build mosaic to linebuffer */
+    uint32_t *scan = select_scan_buffer(ctx, layer, line, &build_mosaic);
     if (build_mosaic) {
-        if (mosaic != NULL) {
-            memset(mosaic, 0, framewidth * sizeof(uint32_t));
+        priority |= build_mosaic_line(ctx, nlayer, line);
+    } else if (scan != NULL) {
+        if (scan == ctx->linebuffer) {
+            memset(scan, 0, (size_t)framewidth * sizeof(uint32_t));
         }
-        BlitMosaic(engine->linebuffer, mosaic, framewidth, layer->mosaic.w, NULL);
+        priority |= draw_window_region(ctx, nlayer, scan, line, window, inside, framewidth);
     }
 
+    scan = GetFramebufferLine(line);
+
     if (layer->mosaic.h != 0) {
-        blit_mosaic_window(mosaic, scan, window, inside, framewidth, windowwidth,
-                           layer->render.blend);
+        blit_mosaic_window(ctx, nlayer, ctx->mosaic[nlayer], scan, window, inside, framewidth,
+                           windowwidth, layer->render.blend);
+        PROFILE_LAYER(ctx, nlayer, blits, 1);
     } else if (layer->render.mode >= MODE_TRANSFORM) {
-        Blit32_32(engine->linebuffer, scan, framewidth, layer->render.blend);
+        Blit32_32(ctx->linebuffer, scan, framewidth, layer->render.blend);
+        CountOverdraw(&ctx->overdraw, OVERDRAW_LAYER(nlayer), 0, framewidth);
+        PROFILE_LAYER(ctx, nlayer, blits, 1);
     }
 
-    blit_clipped_window(scan, window, inside, framewidth, windowwidth);
+    blit_clipped_window(ctx, nlayer, scan, window, inside, framewidth, windowwidth);
 
     return priority;
 }
 
-/* Draws the next scanline of the frame started with TLN_BeginFrame() or
- * TLN_BeginWindowFrame() */
-/* fills the background with bitmap or solid color */
-static void fill_background(uint32_t *scan, int size, int line) {
-    if (engine->bg.bitmap && engine->bg.palette) {
-        if (size > engine->bg.bitmap->width) {
-            size = engine->bg.bitmap->width;
+/* fills the background with bitmap or solid color, skipping the spans hidden
+ * by occlusion culling */
+static void fill_background(ScanContext *ctx, uint32_t *scan, int size, int line) {
+    EngineBackground const *bg = &ctx->view->bg;
+    Span const full = {0, size};
+    Span const *spans = &full;
+    int num_spans = 1;
+    int drawn = 0;
+
+    if (ctx->culling) {
+        spans = &ctx->visible[engine->numlayers * ctx->max_spans];
+        num_spans = ctx->num_visible[engine->numlayers];
+    }
+
+    if (bg->bitmap && bg->palette) {
+        if (size > bg->bitmap->width) {
+            size = bg->bitmap->width;
         }
-        if (line < engine->bg.bitmap->height) {
-            engine->bg.blit_fast(TLN_GetBitmapPtr(engine->bg.bitmap, 0, line), engine->bg.palette,
-                                 scan, size, 1, 0, NULL);
+        if (line >= bg->bitmap->height) {
+            return;
         }
-    } else if (engine->bg.color) {
-        BlitColor(scan, engine->bg.color, size, NULL);
+        for (int c = 0; c < num_spans; c++) {
+            const int x1 = spans[c].x1;
+            const int x2 = spans[c].x2 < size ? spans[c].x2 : size;
+            if (x1 < x2) {
+                bg->blit_fast(get_bitmap_ptr(bg->bitmap, x1, line), bg->palette, scan + x1,
+                              x2 - x1, 1, 0, NULL);
+                CountOverdraw(&ctx->overdraw, OVERDRAW_BACKGROUND, x1, x2 - x1);
+                drawn += x2 - x1;
+            }
+        }
+    } else if (bg->color) {
+        for (int c = 0; c < num_spans; c++) {
+            BlitColor(scan + spans[c].x1, bg->color, spans[c].x2 - spans[c].x1, NULL);
+            CountOverdraw(&ctx->overdraw, OVERDRAW_BACKGROUND, spans[c].x1,
+                          spans[c].x2 - spans[c].x1);
+            drawn += spans[c].x2 - spans[c].x1;
+        }
+    } else {
+        return;
     }
+    PROFILE_COUNT(ctx, pixels, drawn);
+    PROFILE_COUNT(ctx, culled_pixels, size - drawn);
+    PROFILE_COUNT(ctx, blits, num_spans);
 }
 
 /* updates layer scroll position when world or layer is dirty */
@@ -321,23 +555,23 @@ static void update_layer_if_dirty(int c) {
 
 /* draws all non-priority background layers; returns true if any have priority
  * tiles */
-static bool draw_regular_layers(int line) {
+static bool draw_regular_layers(ScanContext *ctx, int line) {
     bool priority = false;
     if (engine->numlayers == 0) {
         return priority;
     }
-    if (engine->priority != NULL) {
-        memset(engine->priority, 0, engine->framebuffer.width * sizeof(uint32_t));
+    if (ctx->priority != NULL) {
+        memset(ctx->priority, 0, (size_t)engine->framebuffer.width * sizeof(uint32_t));
     }
     for (int c = engine->numlayers - 1; c >= 0; c--) {
-        update_layer_if_dirty(c);
-        Layer const *layer = &engine->layers[c];
+        Layer const *layer = &ctx->view->layers[c];
         if ((int)layer->flags.ok && !layer->flags.priority) {
-            uint64_t tPL0 = SDL_GetPerformanceCounter();
-            priority |= draw_background_scanline(c, line);
-            uint64_t tPL1 = SDL_GetPerformanceCounter();
-            if (c < 8)
-                g_prof_per_layer_ticks[c] += tPL1 - tPL0;
+            const uint64_t trace = TraceBegin(TRACE_LINE, line);
+            PROFILE_TICKS(t0);
+            priority |= draw_background_scanline(ctx, c, line);
+            PROFILE_TICKS(t1);
+            PROFILE_LAYER(ctx, c, time_ns, t1 - t0);
+            TraceEnd(trace, "Layer", "layer", c);
         }
     }
     return priority;
@@ -357,86 +591,124 @@ static void update_sprite_if_dirty(Sprite *sprite) {
     SetSpriteFlag(sprite, SPRITE_FLAG_DIRTY, false);
 }
 
+/* returns the sprites of a class that may cover a scanline, in draw order */
+static inline int const *get_sprite_span(int line, span_t type, int *count) {
+    EngineSpriteSpans const *spans = &engine->sprite_spans;
+    if (spans->overflow) {
+        *count = spans->count;
+        return spans->order;
+    }
+    const int bucket = (line * MAX_SPAN_CLASS) + (int)type;
+    *count = spans->offsets[bucket + 1] - spans->offsets[bucket];
+    return spans->entries + spans->offsets[bucket];
+}
+
+/* returns width of a sprite clipped to the framebuffer */
+static inline int get_sprite_width(SpriteRender const *sprite) {
+    const int x1 = sprite->dstrect.x1 > 0 ? sprite->dstrect.x1 : 0;
+    const int x2 = sprite->dstrect.x2 < engine->framebuffer.width ? sprite->dstrect.x2
+                                                                   : engine->framebuffer.width;
+    return x2 > x1 ? x2 - x1 : 0;
+}
+
+/* counts a sprite scanline drawn in frame statistics and overdraw */
+static inline void count_sprite(ScanContext *ctx, int index, SpriteRender const *sprite) {
+    PROFILE_COUNT(ctx, sprites_drawn, 1);
+    PROFILE_COUNT(ctx, blits, 1);
+    PROFILE_COUNT(ctx, pixels, get_sprite_width(sprite));
+    const int x1 = sprite->dstrect.x1 > 0 ? sprite->dstrect.x1 : 0;
+    CountOverdraw(&ctx->overdraw, OVERDRAW_SPRITE(index), x1, get_sprite_width(sprite));
+}
+
 /* draws all background sprites (FLAG_BACKGROUND) — rendered below every layer
  */
-static void draw_background_sprites(uint32_t *scan, int line) {
+static void draw_background_sprites(ScanContext *ctx, uint32_t *scan, int line) {
     if (engine->numsprites == 0) {
         return;
     }
-    List const *list = &engine->list_sprites;
-    int index = list->first;
-    while (index != -1) {
-        Sprite *sprite = &engine->sprites[index];
-        update_sprite_if_dirty(sprite);
-        if ((int)check_sprite_coverage(sprite, line) && (sprite->flags & FLAG_BACKGROUND)) {
-            sprite->funcs.draw(index, scan, line, 0, 0);
+    int count;
+    int const *span = get_sprite_span(line, SPAN_BACKGROUND, &count);
+    PROFILE_COUNT(ctx, sprites_tested, count);
+    for (int c = 0; c < count; c++) {
+        const int index = span[c];
+        SpriteRender const *sprite = &engine->sprite_render[index];
+        if ((int)check_sprite_coverage(ctx, sprite, line) && (sprite->flags & FLAG_BACKGROUND)) {
+            sprite->draw(ctx, index, scan, line, 0, 0);
+            count_sprite(ctx, index, sprite);
         }
-        index = sprite->list_node.next;
     }
 }
 
 /* draws a single sprite scanline via the blend mask when the sprite has
  * SPRITE_FLAG_BLEND_MASK set; otherwise draws it directly onto scan. */
-static void draw_sprite_with_blend_mask(int index, Sprite const *sprite, uint32_t *scan, int line) {
-    if (GetSpriteFlag(sprite, SPRITE_FLAG_BLEND_MASK) && engine->blend_mask &&
-        engine->blend_mask_blend) {
+static void draw_sprite_with_blend_mask(ScanContext *ctx, int index, SpriteRender const *sprite,
+                                        uint32_t *scan, int line) {
+    count_sprite(ctx, index, sprite);
+    if (GetSpriteFlag(sprite, SPRITE_FLAG_BLEND_MASK) && ctx->blend_mask &&
+        ctx->blend_mask_blend) {
         const int fw = engine->framebuffer.width;
         int x1 = sprite->dstrect.x1 > 0 ? sprite->dstrect.x1 : 0;
         int x2 = sprite->dstrect.x2 < fw ? sprite->dstrect.x2 : fw;
         if (x1 < x2) {
-            uint32_t *lb = engine->linebuffer;
+            uint32_t *lb = ctx->linebuffer;
             memset(lb + x1, 0, (x2 - x1) * sizeof(uint32_t));
-            sprite->funcs.draw(index, lb, line, 0, 0);
-            Blit32_32_Masked(lb + x1, scan + x1, engine->blend_mask + x1, engine->blend_mask_blend,
+            sprite->draw(ctx, index, lb, line, 0, 0);
+            Blit32_32_Masked(lb + x1, scan + x1, ctx->blend_mask + x1, ctx->blend_mask_blend,
                              x2 - x1);
+            CountOverdraw(&ctx->overdraw, OVERDRAW_SPRITE(index), x1, x2 - x1);
         }
     } else {
-        sprite->funcs.draw(index, scan, line, 0, 0);
+        sprite->draw(ctx, index, scan, line, 0, 0);
     }
 }
 
 /* draws all non-priority sprites; returns true if any priority sprites exist */
-static bool draw_regular_sprites(uint32_t *scan, int line) {
+static bool draw_regular_sprites(ScanContext *ctx, uint32_t *scan, int line) {
     bool sprite_priority = false;
     if (engine->numsprites == 0) {
         return sprite_priority;
     }
-    if (engine->collision != NULL) {
-        memset(engine->collision, -1, engine->framebuffer.width * sizeof(uint16_t));
-    }
-    List const *list = &engine->list_sprites;
-    int index = list->first;
-    while (index != -1) {
-        Sprite *sprite = &engine->sprites[index];
-        update_sprite_if_dirty(sprite);
-        bool has_coverage = check_sprite_coverage(sprite, line);
-        bool has_background = (sprite->flags & FLAG_BACKGROUND) != 0;
-        bool has_priority = (sprite->flags & FLAG_PRIORITY) != 0;
-        if (has_background) {
-            /* already drawn before layers — skip */
-        } else if ((int)has_coverage && !has_priority) {
-            draw_sprite_with_blend_mask(index, sprite, scan, line);
-        } else if ((int)has_coverage && (int)has_priority) {
-            sprite_priority = true;
+    int count;
+    int const *span = get_sprite_span(line, SPAN_REGULAR, &count);
+    PROFILE_COUNT(ctx, sprites_tested, count);
+    for (int c = 0; c < count; c++) {
+        const int index = span[c];
+        SpriteRender const *sprite = &engine->sprite_render[index];
+        if ((sprite->flags & (FLAG_BACKGROUND | FLAG_PRIORITY)) == 0 &&
+            (int)check_sprite_coverage(ctx, sprite, line)) {
+            draw_sprite_with_blend_mask(ctx, index, sprite, scan, line);
         }
-        index = sprite->list_node.next;
+    }
+
+    /* background sprites with FLAG_PRIORITY are drawn again in the priority
+     * pass, but don't trigger it by themselves */
+    span = get_sprite_span(line, SPAN_PRIORITY, &count);
+    for (int c = 0; c < count && !sprite_priority; c++) {
+        SpriteRender const *sprite = &engine->sprite_render[span[c]];
+        sprite_priority = (sprite->flags & (FLAG_BACKGROUND | FLAG_PRIORITY)) == FLAG_PRIORITY &&
+                          check_sprite_coverage(ctx, sprite, line);
     }
     return sprite_priority;
 }
 
 /* draws all priority background layers */
-static void draw_priority_layers(int line) {
+static void draw_priority_layers(ScanContext *ctx, int line) {
     for (int c = engine->numlayers - 1; c >= 0; c--) {
-        Layer const *layer = &engine->layers[c];
+        Layer const *layer = &ctx->view->layers[c];
         if ((int)layer->flags.ok && (int)layer->flags.priority) {
-            draw_background_scanline(c, line);
+            const uint64_t trace = TraceBegin(TRACE_LINE, line);
+            PROFILE_TICKS(t0);
+            draw_background_scanline(ctx, c, line);
+            PROFILE_TICKS(t1);
+            PROFILE_LAYER(ctx, c, time_ns, t1 - t0);
+            TraceEnd(trace, "Layer", "layer", c);
         }
     }
 }
 
 /* overlays the priority tile buffer onto the framebuffer scanline */
-static void overlay_priority_pixels(uint32_t *scan) {
-    uint32_t const *src = engine->priority;
+static void overlay_priority_pixels(ScanContext const *ctx, uint32_t *scan) {
+    uint32_t const *src = ctx->priority;
     uint32_t *dst = scan;
     for (int c = 0; c < engine->framebuffer.width; c++) {
         if (*src) {
@@ -448,51 +720,229 @@ static void overlay_priority_pixels(uint32_t *scan) {
 }
 
 /* draws all priority sprites */
-static void draw_priority_sprites(uint32_t *scan, int line) {
-    List const *list = &engine->list_sprites;
-    int index = list->first;
-    while (index != -1) {
-        Sprite const *sprite = &engine->sprites[index];
-        if ((int)check_sprite_coverage(sprite, line) && (sprite->flags & FLAG_PRIORITY)) {
-            draw_sprite_with_blend_mask(index, sprite, scan, line);
+static void draw_priority_sprites(ScanContext *ctx, uint32_t *scan, int line) {
+    int count;
+    int const *span = get_sprite_span(line, SPAN_PRIORITY, &count);
+    PROFILE_COUNT(ctx, sprites_tested, count);
+    for (int c = 0; c < count; c++) {
+        const int index = span[c];
+        SpriteRender const *sprite = &engine->sprite_render[index];
+        if ((int)check_sprite_coverage(ctx, sprite, line) && (sprite->flags & FLAG_PRIORITY)) {
+            draw_sprite_with_blend_mask(ctx, index, sprite, scan, line);
         }
-        index = sprite->list_node.next;
     }
 }
 
-/* Draws the next scanline of the frame started with TLN_BeginFrame() or
- * TLN_BeginWindowFrame() */
-bool DrawScanline(void) {
-    int line = engine->timing.line;
+/* composes a full scanline using the scratch buffers of ctx */
+void ComposeScanline(ScanContext *ctx, int line) {
     uint32_t *scan = GetFramebufferLine(line);
 
-    if (engine->callbacks.raster) {
-        engine->callbacks.raster(line);
-    }
-
-    fill_background(scan, engine->framebuffer.width, line);
-    draw_background_sprites(scan, line); /* behind all layers */
+    /* blend mask only applies on lines where its layer was composited */
+    ctx->blend_mask_blend = NULL;
 
-    uint64_t tL0 = SDL_GetPerformanceCounter();
-    bool background_priority = draw_regular_layers(line);
-    uint64_t tL1 = SDL_GetPerformanceCounter();
-    bool sprite_priority = draw_regular_sprites(scan, line);
-    uint64_t tL2 = SDL_GetPerformanceCounter();
-    g_prof_layers_ticks += tL1 - tL0;
-    g_prof_sprites_ticks += tL2 - tL1;
+    if (ctx->tile_cache.budget != engine->tile_cache_budget) {
+        SetTileCacheBudget(&ctx->tile_cache, engine->tile_cache_budget);
+    }
 
+    /* collision buffer must not carry over from another scanline: cleared
+     * before background sprites so they collide with the regular ones */
+    if (ctx->collision != NULL) {
+        memset(ctx->collision, -1, (size_t)engine->framebuffer.width * sizeof(uint16_t));
+    }
+    BeginOverdrawLine(ctx, line);
+
+    PROFILE_TICKS(t0);
+    uint64_t trace = TraceBegin(TRACE_LINE, line);
+    ctx->culling = engine->occlusion_culling && CullScanline(ctx, line);
+    fill_background(ctx, scan, engine->framebuffer.width, line);
+    draw_background_sprites(ctx, scan, line); /* behind all layers */
+    TraceEnd(trace, "Background", "line", line);
+
+    PROFILE_TICKS(t1);
+    trace = TraceBegin(TRACE_LINE, line);
+    bool background_priority = draw_regular_layers(ctx, line);
+    TraceEnd(trace, "Layers", "line", line);
+    PROFILE_TICKS(t2);
+    trace = TraceBegin(TRACE_LINE, line);
+    bool sprite_priority = draw_regular_sprites(ctx, scan, line);
+    TraceEnd(trace, "Sprites", "line", line);
+    PROFILE_TICKS(t3);
+
+    trace = TraceBegin(TRACE_LINE, line);
     if (background_priority) {
-        overlay_priority_pixels(scan);
+        overlay_priority_pixels(ctx, scan);
     }
 
     if (sprite_priority) {
-        draw_priority_sprites(scan, line);
+        draw_priority_sprites(ctx, scan, line);
     }
 
     /* Priority layers are drawn last so they appear above all sprites. */
     if (engine->numlayers > 0) {
-        draw_priority_layers(line);
+        draw_priority_layers(ctx, line);
+    }
+    TraceEnd(trace, "Priority", "line", line);
+
+    PROFILE_TICKS(t4);
+    PROFILE_COUNT(ctx, background_ns, t1 - t0);
+    PROFILE_COUNT(ctx, layers_ns, t2 - t1);
+    PROFILE_COUNT(ctx, sprites_ns, t3 - t2);
+    PROFILE_COUNT(ctx, priority_ns, t4 - t3);
+    EndOverdrawLine(ctx, line);
+}
+
+/* returns the span class a sprite is drawn in by the regular pass */
+static inline span_t get_sprite_class(SpriteRender const *sprite) {
+    if (sprite->flags & FLAG_BACKGROUND) {
+        return SPAN_BACKGROUND;
+    }
+    return (sprite->flags & FLAG_PRIORITY) ? SPAN_PRIORITY : SPAN_REGULAR;
+}
+
+/* adds a sprite to the [line][class] counts of its visible rows, as a
+ * difference array later integrated by build_sprite_spans() */
+static inline void count_sprite_span(int *counts, int line1, int line2, span_t type) {
+    counts[(line1 * MAX_SPAN_CLASS) + (int)type] += 1;
+    counts[(line2 * MAX_SPAN_CLASS) + (int)type] -= 1;
+}
+
+/* buckets active sprites by the scanlines they cover, from line downwards.
+ * Each bucket keeps draw order so the per-line passes only visit sprites
+ * that may cover them. Background sprites with FLAG_PRIORITY go to both the
+ * background and priority buckets, as they're drawn by both passes */
+static void build_sprite_spans(int line) {
+    EngineSpriteSpans *spans = &engine->sprite_spans;
+    const int height = engine->framebuffer.height;
+    const int num_buckets = height * MAX_SPAN_CLASS;
+    int *offsets = spans->offsets;
+
+    /* count bucket sizes */
+    memset(offsets, 0, (size_t)(height + 1) * MAX_SPAN_CLASS * sizeof(int));
+    spans->count = 0;
+    int index = engine->list_sprites.first;
+    while (index != -1) {
+        SpriteRender const *sprite = &engine->sprite_render[index];
+        const int line1 = sprite->dstrect.y1 > line ? sprite->dstrect.y1 : line;
+        const int line2 = sprite->dstrect.y2 < height ? sprite->dstrect.y2 : height;
+        spans->order[spans->count++] = index;
+        if (line1 < line2) {
+            const span_t type = get_sprite_class(sprite);
+            count_sprite_span(offsets, line1, line2, type);
+            if (type == SPAN_BACKGROUND && (sprite->flags & FLAG_PRIORITY)) {
+                count_sprite_span(offsets, line1, line2, SPAN_PRIORITY);
+            }
+        }
+        index = engine->sprites[index].list_node.next;
+    }
+
+    /* integrate counts per class, then turn them into bucket offsets */
+    int total = 0;
+    for (int c = MAX_SPAN_CLASS; c < num_buckets; c++) {
+        offsets[c] += offsets[c - MAX_SPAN_CLASS];
+    }
+    for (int c = 0; c < num_buckets; c++) {
+        const int size = offsets[c];
+        offsets[c] = total;
+        total += size;
+    }
+
+    spans->dirty = false;
+    spans->first_line = line;
+    if (total > spans->capacity) {
+        int *entries = (int *)realloc(spans->entries, (size_t)total * sizeof(int));
+        if (entries == NULL) {
+            spans->overflow = true;
+            return;
+        }
+        spans->entries = entries;
+        spans->capacity = total;
+    }
+
+    /* fill buckets in list order, using offsets as write cursors. Afterwards
+     * each offset points to the start of the next bucket */
+    for (int c = 0; c < spans->count; c++) {
+        index = spans->order[c];
+        SpriteRender const *sprite = &engine->sprite_render[index];
+        const int line1 = sprite->dstrect.y1 > line ? sprite->dstrect.y1 : line;
+        const int line2 = sprite->dstrect.y2 < height ? sprite->dstrect.y2 : height;
+        const span_t type = get_sprite_class(sprite);
+        const bool priority = type == SPAN_BACKGROUND && (sprite->flags & FLAG_PRIORITY);
+        for (int y = line1; y < line2; y++) {
+            int *bucket = &offsets[y * MAX_SPAN_CLASS];
+            spans->entries[bucket[type]++] = index;
+            if (priority) {
+                spans->entries[bucket[SPAN_PRIORITY]++] = index;
+            }
+        }
+    }
+    memmove(offsets + 1, offsets, (size_t)num_buckets * sizeof(int));
+    offsets[0] = 0;
+    spans->overflow = false;
+}
+
+/* applies pending world-space layer updates */
+static void prepare_layers(void) {
+    for (int c = 0; c < engine->numlayers; c++) {
+        update_layer_if_dirty(c);
+    }
+}
+
+/* applies pending world-space sprite updates and rebuilds sprite spans when
+ * sprites changed since the given scanline was last drawn */
+static void prepare_sprites(int line) {
+    EngineSpriteSpans const *spans = &engine->sprite_spans;
+    if (engine->numsprites == 0) {
+        return;
+    }
+    if (engine->world.dirty || spans->dirty) {
+        int index = engine->list_sprites.first;
+        while (index != -1) {
+            Sprite *sprite = &engine->sprites[index];
+            update_sprite_if_dirty(sprite);
+            index = sprite->list_node.next;
+        }
+    }
+    if (spans->dirty || line < spans->first_line) {
+        build_sprite_spans(line);
+    }
+}
+
+/* applies pending world, layer and sprite position updates ahead of a frame
+ * drawn with DrawScanlines(), so that scanlines only read shared state */
+void PrepareScanlines(void) {
+    prepare_layers();
+    prepare_sprites(0);
+    engine->world.dirty = false;
+}
+
+/* draws scanlines [line1, line2) without raster callbacks. Safe to call
+ * concurrently on disjoint ranges with distinct contexts after
+ * PrepareScanlines() */
+void DrawScanlines(ScanContext *ctx, int line1, int line2) {
+    prime_mosaic_lines(ctx, line1);
+    for (int line = line1; line < line2; line++) {
+        ComposeScanline(ctx, line);
+    }
+}
+
+/* Draws the next scanline of the frame started with TLN_BeginFrame() or
+ * TLN_BeginWindowFrame() */
+bool DrawScanline(void) {
+    int line = engine->timing.line;
+
+    if (engine->callbacks.raster) {
+        const uint64_t trace = TraceBegin(TRACE_LINE, line);
+        PROFILE_TICKS(t0);
+        engine->callbacks.raster(line);
+        PROFILE_TICKS(t1);
+        PROFILE_COUNT(&engine->scan, raster_ns, t1 - t0);
+        TraceEnd(trace, "RasterCallback", "line", line);
     }
+    prepare_layers();
+    prepare_sprites(line);
+
+    ComposeScanline(&engine->scan, line);
+    MergeScanContext(&engine->scan);
 
     engine->world.dirty = false;
     engine->timing.line++;
@@ -549,8 +999,10 @@ static inline void process_flip_rotation(uint16_t flags, Tilescan *scan) {
 }
 
 /* draw scanline of tiled background */
-static bool DrawTiledScanline(int nlayer, uint32_t *dstpixel, int nscan, int tx1, int tx2) {
-    const Layer *layer = (const Layer *)&engine->layers[nlayer];
+static bool DrawTiledScanline(ScanContext *ctx, int nlayer, uint32_t *dstpixel, int nscan, int tx1,
+                              int tx2) {
+    const Layer *layer = (const Layer *)&ctx->view->layers[nlayer];
+    LayerRender const *render = get_layer_render(ctx, layer);
     bool priority = false;
     Tilescan scan = {0};
 
@@ -604,8 +1056,8 @@ static bool DrawTiledScanline(int nlayer, uint32_t *dstpixel, int nscan, int tx1
             TLN_Palette palette = tileset2->palette;
             if (layer_palette != NULL) {
                 palette = layer_palette;
-            } else if (engine->palettes[tile->palette] != NULL) {
-                palette = engine->palettes[tile->palette];
+            } else if (ctx->view->palettes[tile->palette] != NULL) {
+                palette = ctx->view->palettes[tile->palette];
             }
 
             /* process rotate & flip flags */
@@ -615,15 +1067,46 @@ static bool DrawTiledScanline(int nlayer, uint32_t *dstpixel, int nscan, int tx1
             }
 
             /* paint tile scanline */
-            const uint8_t *srcpixel = &GetTilesetPixel(tileset2, tile_index, scan.srcx, scan.srcy);
             uint32_t *dst = dstpixel;
             if (tile->flags & FLAG_PRIORITY) {
-                dst = engine->priority;
+                dst = ctx->priority;
                 priority = true;
             }
 
-            layer->render.blitters[1](srcpixel, palette, dst + x, width, scan.dx, 0,
-                                      layer->render.blend);
+            PROFILE_LAYER(ctx, nlayer, tiles, 1);
+            PROFILE_LAYER(ctx, nlayer, blits, 1);
+            TileCacheEntry const *cached = NULL;
+            if (render->blend == NULL) {
+                cached = GetCachedTile(&ctx->tile_cache, tileset2, tile_index, palette);
+            }
+            if (cached != NULL) {
+                const int offset = (scan.srcy << tileset2->hshift) + scan.srcx;
+                uint8_t const *mask = cached->mask + offset;
+                if (!(tile->flags & FLAG_ROTATE) &&
+                    !tileset2->color_key[GetTilesetLine(tileset2, tile_index, scan.srcy)]) {
+                    mask = NULL;
+                }
+                BlitCachedTile(cached->pixels + offset, mask, dst + x, width, scan.dx);
+            } else {
+                const uint8_t *srcpixel =
+                    &GetTilesetPixel(tileset2, tile_index, scan.srcx, scan.srcy);
+                render->blitters[1](srcpixel, palette, dst + x, width, scan.dx, 0,
+                                    render->blend);
+            }
+            CountOverdraw(&ctx->overdraw, OVERDRAW_LAYER(nlayer), x, width);
+        } else {
+            /* skip the whole run of empty tiles */
+            const int run = layer->column == NULL ? GetTilemapEmptyRun(tilemap, ytile, xtile) : 1;
+            PROFILE_LAYER(ctx, nlayer, empty_tiles, run > 1 ? run : 1);
+            if (run > 1) {
+                x1 += (run - 1) * tileset->width;
+                if (x1 > tx2) {
+                    x1 = tx2;
+                }
+                width = x1 - x;
+                xtile += run - 1;
+                column += run - 1;
+            }
         }
 
         /* next tile */
@@ -638,8 +1121,10 @@ static bool DrawTiledScanline(int nlayer, uint32_t *dstpixel, int nscan, int tx1
 }
 
 /* draw scanline of tiled background with scaling */
-static bool DrawTiledScanlineScaling(int nlayer, uint32_t *dstpixel, int nscan, int tx1, int tx2) {
-    const Layer *layer = (const Layer *)&engine->layers[nlayer];
+static bool DrawTiledScanlineScaling(ScanContext *ctx, int nlayer, uint32_t *dstpixel, int nscan,
+                                     int tx1, int tx2) {
+    const Layer *layer = (const Layer *)&ctx->view->layers[nlayer];
+    LayerRender const *render = get_layer_render(ctx, layer);
     bool priority = false;
     Tilescan scan = {0};
 
@@ -708,8 +1193,8 @@ static bool DrawTiledScanlineScaling(int nlayer, uint32_t *dstpixel, int nscan,
             TLN_Palette palette = tileset2->palette;
             if (layer_palette != NULL) {
                 palette = layer_palette;
-            } else if (engine->palettes[tile->palette] != NULL) {
-                palette = engine->palettes[tile->palette];
+            } else if (ctx->view->palettes[tile->palette] != NULL) {
+                palette = ctx->view->palettes[tile->palette];
             }
 
             /* process flip flags */
@@ -722,14 +1207,30 @@ static bool DrawTiledScanlineScaling(int nlayer, uint32_t *dstpixel, int nscan,
             const uint8_t *srcpixel = &GetTilesetPixel(tileset2, tile_index, scan.srcx, scan.srcy);
             uint32_t *dst = dstpixel;
             if (tile->flags & FLAG_PRIORITY) {
-                dst = engine->priority;
+                dst = ctx->priority;
                 priority = true;
             }
 
             int line = GetTilesetLine(tileset2, tile_index, scan.srcy);
             bool color_key = *(tileset2->color_key + line);
-            layer->render.blitters[color_key](srcpixel, palette, dst + x, width, scan.dx, 0,
-                                              layer->render.blend);
+            PROFILE_LAYER(ctx, nlayer, tiles, 1);
+            PROFILE_LAYER(ctx, nlayer, blits, 1);
+            render->blitters[color_key](srcpixel, palette, dst + x, width, scan.dx, 0,
+                                        render->blend);
+            CountOverdraw(&ctx->overdraw, OVERDRAW_LAYER(nlayer), x, width);
+        } else {
+            /* skip the whole run of empty tiles */
+            const int run = layer->column == NULL ? GetTilemapEmptyRun(tilemap, ytile, xtile) : 1;
+            PROFILE_LAYER(ctx, nlayer, empty_tiles, run > 1 ? run : 1);
+            if (run > 1) {
+                fix_x += (run - 1) * tileset->width * xfactor;
+                x1 = fix2int(fix_x);
+                if (x1 > tx2) {
+                    x1 = tx2;
+                }
+                xtile += run - 1;
+                column += run - 1;
+            }
         }
 
         /* next tile */
@@ -744,8 +1245,9 @@ static bool DrawTiledScanlineScaling(int nlayer, uint32_t *dstpixel, int nscan,
 }
 
 /* draw scanline of tiled background with affine transform */
-static bool DrawTiledScanlineAffine(int nlayer, uint32_t *dstpixel, int nscan, int tx1, int tx2) {
-    const Layer *layer = (const Layer *)&engine->layers[nlayer];
+static bool DrawTiledScanlineAffine(ScanContext *ctx, int nlayer, uint32_t *dstpixel, int nscan,
+                                    int tx1, int tx2) {
+    const Layer *layer = (const Layer *)&ctx->view->layers[nlayer];
     bool priority = false;
     Tilescan scan = {0};
 
@@ -771,8 +1273,9 @@ static bool DrawTiledScanlineAffine(int nlayer, uint32_t *dstpixel, int nscan, i
     const int dy = (y2 - y1) / twidth;
 
     scan.width = scan.height = scan.stride = tileset->width;
+    CountOverdraw(&ctx->overdraw, OVERDRAW_LAYER(nlayer), tx1, twidth);
     dstpixel += tx1;
-    uint32_t *prioritypixel = engine->priority + tx1;
+    uint32_t *prioritypixel = ctx->priority + tx1;
 
     while (tx1 < tx2) {
         xpos = abs(fix2int(x1) + layer->width) % layer->width;
@@ -818,9 +1321,9 @@ static bool DrawTiledScanlineAffine(int nlayer, uint32_t *dstpixel, int nscan, i
 }
 
 /* draw scanline of tiled background with per-pixel mapping */
-static bool DrawTiledScanlinePixelMapping(int nlayer, uint32_t *dstpixel, int nscan, int tx1,
-                                          int tx2) {
-    const Layer *layer = (const Layer *)&engine->layers[nlayer];
+static bool DrawTiledScanlinePixelMapping(ScanContext *ctx, int nlayer, uint32_t *dstpixel,
+                                          int nscan, int tx1, int tx2) {
+    const Layer *layer = (const Layer *)&ctx->view->layers[nlayer];
     Tilescan scan = {0};
 
     /* target lines */
@@ -835,6 +1338,7 @@ static bool DrawTiledScanlinePixelMapping(int nlayer, uint32_t *dstpixel, int ns
         &layer->pixel_map[((ptrdiff_t)nscan * engine->framebuffer.width) + x];
 
     scan.width = scan.height = scan.stride = tileset->width;
+    CountOverdraw(&ctx->overdraw, OVERDRAW_LAYER(nlayer), tx1, tx2 - tx1);
 
     while (x < tx2) {
         int xpos = abs(hstart + pixel_map->dx) % layer->width;
@@ -872,8 +1376,8 @@ static bool DrawTiledScanlinePixelMapping(int nlayer, uint32_t *dstpixel, int ns
 }
 
 /* draw sprite scanline */
-static bool DrawSpriteScanline(int nsprite, uint32_t *dstscan, int nscan, int tx1 [[maybe_unused]],
-                               int tx2 [[maybe_unused]]) {
+static bool DrawSpriteScanline(ScanContext *ctx, int nsprite, uint32_t *dstscan, int nscan,
+                               int tx1 [[maybe_unused]], int tx2 [[maybe_unused]]) {
     Sprite *sprite = &engine->sprites[nsprite];
 
     Tilescan scan = {0};
@@ -904,14 +1408,14 @@ static bool DrawSpriteScanline(int nsprite, uint32_t *dstscan, int nscan, int tx
     sprite->funcs.blitter(srcpixel, sprite->palette, dstpixel, w, scan.dx, 0, sprite->blend);
 
     if (GetSpriteFlag(sprite, SPRITE_FLAG_DO_COLLISION)) {
-        uint16_t *collision_pixel = engine->collision + sprite->dstrect.x1;
-        DrawSpriteCollision(nsprite, srcpixel, collision_pixel, w, scan.dx);
+        uint16_t *collision_pixel = ctx->collision + sprite->dstrect.x1;
+        DrawSpriteCollision(ctx, nsprite, srcpixel, collision_pixel, w, scan.dx);
     }
     return true;
 }
 
 /* draw sprite scanline with scaling */
-static bool DrawScalingSpriteScanline(int nsprite, uint32_t *dstscan, int nscan,
+static bool DrawScalingSpriteScanline(ScanContext *ctx, int nsprite, uint32_t *dstscan, int nscan,
                                       int tx1 [[maybe_unused]], int tx2 [[maybe_unused]]) {
     Sprite *sprite = &engine->sprites[nsprite];
 
@@ -938,20 +1442,109 @@ static bool DrawScalingSpriteScanline(int nsprite, uint32_t *dstscan, int nscan,
     sprite->funcs.blitter(srcpixel, sprite->palette, dstpixel, dstw, dx, srcx, sprite->blend);
 
     if (GetSpriteFlag(sprite, SPRITE_FLAG_DO_COLLISION)) {
-        uint16_t *collision_pixel = engine->collision + sprite->dstrect.x1;
-        DrawSpriteCollisionScaling(nsprite, srcpixel, collision_pixel, dstw, dx, srcx);
+        uint16_t *collision_pixel = ctx->collision + sprite->dstrect.x1;
+        DrawSpriteCollisionScaling(ctx, nsprite, srcpixel, collision_pixel, dstw, dx, srcx);
+    }
+    return true;
+}
+
+/* floor of a / b, with b > 0 */
+static inline int64_t floor_div(int64_t a, int64_t b) {
+    return a >= 0 ? a / b : -((b - 1 - a) / b);
+}
+
+/* narrows [x1, x2) to the steps of a DDA starting at pos and advancing delta
+ * that stay inside [0, limit) */
+static void clip_affine_span(fix_t pos, fix_t delta, fix_t limit, int *x1, int *x2) {
+    int64_t lo;
+    int64_t hi;
+    if (delta == 0) {
+        if (pos < 0 || pos >= limit) {
+            *x2 = *x1;
+        }
+        return;
+    }
+    if (delta > 0) {
+        lo = -floor_div(pos, delta);
+        hi = floor_div((int64_t)limit - 1 - pos, delta);
+    } else {
+        lo = -floor_div((int64_t)limit - 1 - pos, -delta);
+        hi = floor_div(pos, -delta);
+    }
+    if (lo > *x1) {
+        *x1 = lo < *x2 ? (int)lo : *x2;
+    }
+    if (hi + 1 < *x2) {
+        *x2 = hi + 1 > *x1 ? (int)(hi + 1) : *x1;
+    }
+}
+
+/* draw rotated and scaled sprite scanline: inverse maps each target pixel
+ * into the sprite with a fixed-point DDA, then blits the sampled indices */
+static bool DrawAffineSpriteScanline(ScanContext *ctx, int nsprite, uint32_t *dstscan, int nscan,
+                                     int tx1 [[maybe_unused]], int tx2 [[maybe_unused]]) {
+    Sprite *sprite = &engine->sprites[nsprite];
+    SpriteAffine const *affine = &sprite->affine;
+    const int line = nscan - sprite->dstrect.y1;
+    const fix_t width = int2fix(sprite->info->w);
+    const fix_t height = int2fix(sprite->info->h);
+
+    fix_t u = affine->u + (line * affine->dudy);
+    fix_t v = affine->v + (line * affine->dvdy);
+    fix_t dudx = affine->dudx;
+    fix_t dvdx = affine->dvdx;
+
+    /* H/V flip */
+    if (sprite->flags & FLAG_FLIPX) {
+        u = width - 1 - u;
+        dudx = -dudx;
+    }
+    if (sprite->flags & FLAG_FLIPY) {
+        v = height - 1 - v;
+        dvdx = -dvdx;
+    }
+
+    /* keep the pixels that land inside the sprite */
+    int x1 = 0;
+    int x2 = sprite->dstrect.x2 - sprite->dstrect.x1;
+    clip_affine_span(u, dudx, width, &x1, &x2);
+    clip_affine_span(v, dvdx, height, &x1, &x2);
+    if (x1 == x2) {
+        return true;
+    }
+
+    /* sample */
+    uint8_t const *pixels = sprite->pixel_data.pixels;
+    const int pitch = sprite->pixel_data.pitch;
+    uint8_t *srcpixel = ctx->sprite_line;
+    u += x1 * dudx;
+    v += x1 * dvdx;
+    for (int x = x1; x < x2; x++) {
+        *srcpixel++ = pixels[((ptrdiff_t)fix2int(v) * pitch) + fix2int(u)];
+        u += dudx;
+        v += dvdx;
+    }
+
+    /* blit scanline */
+    uint32_t *dstpixel = dstscan + sprite->dstrect.x1 + x1;
+    sprite->funcs.blitter(ctx->sprite_line, sprite->palette, dstpixel, x2 - x1, 1, 0,
+                          sprite->blend);
+
+    if (GetSpriteFlag(sprite, SPRITE_FLAG_DO_COLLISION)) {
+        uint16_t *collision_pixel = ctx->collision + sprite->dstrect.x1 + x1;
+        DrawSpriteCollision(ctx, nsprite, ctx->sprite_line, collision_pixel, x2 - x1, 1);
     }
     return true;
 }
 
 /* updates per-pixel sprite collision buffer */
-static void DrawSpriteCollision(int nsprite, uint8_t const *srcpixel, uint16_t *dstpixel, int width,
-                                int dx) {
+static void DrawSpriteCollision(ScanContext *ctx, int nsprite, uint8_t const *srcpixel,
+                                uint16_t *dstpixel, int width, int dx) {
     while (width) {
         if (*srcpixel) {
             if (*dstpixel != 0xFFFF) {
-                SetSpriteFlag(&engine->sprites[nsprite], SPRITE_FLAG_COLLISION, true);
-                SetSpriteFlag(&engine->sprites[*dstpixel], SPRITE_FLAG_COLLISION, true);
+                add_collision_hit(ctx, nsprite);
+                add_collision_hit(ctx, *dstpixel);
             }
             *dstpixel = (uint16_t)nsprite;
         }
@@ -962,14 +1555,14 @@ static void DrawSpriteCollision(int nsprite, uint8_t const *srcpixel, uint16_t *
 }
 
 /* updates per-pixel sprite collision buffer for scaled sprite */
-static void DrawSpriteCollisionScaling(int nsprite, uint8_t const *srcpixel, uint16_t *dstpixel,
-                                       int width, int dx, int srcx) {
+static void DrawSpriteCollisionScaling(ScanContext *ctx, int nsprite, uint8_t const *srcpixel,
+                                       uint16_t *dstpixel, int width, int dx, int srcx) {
     while (width) {
         uint32_t src = *(srcpixel + (srcx / (1 << FIXED_BITS)));
         if (src) {
             if (*dstpixel != 0xFFFF) {
-                SetSpriteFlag(&engine->sprites[nsprite], SPRITE_FLAG_COLLISION, true);
-                SetSpriteFlag(&engine->sprites[*dstpixel], SPRITE_FLAG_COLLISION, true);
+                add_collision_hit(ctx, nsprite);
+                add_collision_hit(ctx, *dstpixel);
             }
             *dstpixel = (uint16_t)nsprite;
         }
@@ -982,8 +1575,10 @@ static void DrawSpriteCollisionScaling(int nsprite, uint8_t const *srcpixel, uin
 }
 
 /* draws regular bitmap scanline for bitmap-based layer */
-static bool DrawBitmapScanline(int nlayer, uint32_t *dstpixel, int nscan, int tx1, int tx2) {
-    const Layer *layer = (const Layer *)&engine->layers[nlayer];
+static bool DrawBitmapScanline(ScanContext *ctx, int nlayer, uint32_t *dstpixel, int nscan, int tx1,
+                               int tx2) {
+    const Layer *layer = (const Layer *)&ctx->view->layers[nlayer];
+    LayerRender const *render = get_layer_render(ctx, layer);
 
     /* target lines */
     int x = tx1;
@@ -1004,7 +1599,9 @@ static bool DrawBitmapScanline(int nlayer, uint32_t *dstpixel, int nscan, int tx
         width = x1 - x;
 
         uint8_t const *srcpixel = get_bitmap_ptr(bitmap, xpos, ypos);
-        layer->render.blitters[1](srcpixel, palette, dstpixel, width, 1, 0, layer->render.blend);
+        render->blitters[1](srcpixel, palette, dstpixel, width, 1, 0, render->blend);
+        CountOverdraw(&ctx->overdraw, OVERDRAW_LAYER(nlayer), x, width);
+        PROFILE_LAYER(ctx, nlayer, blits, 1);
         x += width;
         dstpixel += width;
         xpos = 0;
@@ -1013,8 +1610,10 @@ static bool DrawBitmapScanline(int nlayer, uint32_t *dstpixel, int nscan, int tx
 }
 
 /* draws regular bitmap scanline for bitmap-based layer with scaling */
-static bool DrawBitmapScanlineScaling(int nlayer, uint32_t *dstpixel, int nscan, int tx1, int tx2) {
-    const Layer *layer = (const Layer *)&engine->layers[nlayer];
+static bool DrawBitmapScanlineScaling(ScanContext *ctx, int nlayer, uint32_t *dstpixel, int nscan,
+                                      int tx1, int tx2) {
+    const Layer *layer = (const Layer *)&ctx->view->layers[nlayer];
+    LayerRender const *render = get_layer_render(ctx, layer);
 
     /* target line */
     int x = tx1;
@@ -1054,7 +1653,9 @@ static bool DrawBitmapScanlineScaling(int nlayer, uint32_t *dstpixel, int nscan,
 
         /* draw bitmap scanline */
         uint8_t const *srcpixel = (uint8_t *)get_bitmap_ptr(bitmap, xpos, ypos);
-        layer->render.blitters[1](srcpixel, palette, dstpixel, width, dx, 0, layer->render.blend);
+        render->blitters[1](srcpixel, palette, dstpixel, width, dx, 0, render->blend);
+        CountOverdraw(&ctx->overdraw, OVERDRAW_LAYER(nlayer), x, width);
+        PROFILE_LAYER(ctx, nlayer, blits, 1);
 
         /* next */
         dstpixel += width;
@@ -1065,8 +1666,9 @@ static bool DrawBitmapScanlineScaling(int nlayer, uint32_t *dstpixel, int nscan,
 }
 
 /* draws regular bitmap scanline for bitmap-based layer with affine transform */
-static bool DrawBitmapScanlineAffine(int nlayer, uint32_t *dstpixel, int nscan, int tx1, int tx2) {
-    const Layer *layer = (const Layer *)&engine->layers[nlayer];
+static bool DrawBitmapScanlineAffine(ScanContext *ctx, int nlayer, uint32_t *dstpixel, int nscan,
+                                     int tx1, int tx2) {
+    const Layer *layer = (const Layer *)&ctx->view->layers[nlayer];
     bool priority = false;
 
     int xpos = layer->hstart;
@@ -1090,6 +1692,7 @@ static bool DrawBitmapScanlineAffine(int nlayer, uint32_t *dstpixel, int nscan,
 
     const struct Bitmap *bitmap = layer->bitmap;
     const struct Palette *palette = layer->palette != NULL ? layer->palette : bitmap->palette;
+    CountOverdraw(&ctx->overdraw, OVERDRAW_LAYER(nlayer), tx1, twidth);
     while (tx1 < tx2) {
         xpos = abs(fix2int(x1) + layer->width) % layer->width;
         ypos = abs(fix2int(y1) + layer->height) % layer->height;
@@ -1106,9 +1709,9 @@ static bool DrawBitmapScanlineAffine(int nlayer, uint32_t *dstpixel, int nscan,
 
 /* draws regular bitmap scanline for bitmap-based layer with per-pixel mapping
  */
-static bool DrawBitmapScanlinePixelMapping(int nlayer, uint32_t *dstpixel, int nscan, int tx1,
-                                           int tx2) {
-    const Layer *layer = (const Layer *)&engine->layers[nlayer];
+static bool DrawBitmapScanlinePixelMapping(ScanContext *ctx, int nlayer, uint32_t *dstpixel,
+                                           int nscan, int tx1, int tx2) {
+    const Layer *layer = (const Layer *)&ctx->view->layers[nlayer];
     bool priority = false;
 
     /* target lines */
@@ -1118,12 +1721,14 @@ static bool DrawBitmapScanlinePixelMapping(int nlayer, uint32_t *dstpixel, int n
     const int hstart = layer->hstart + layer->width;
     const int vstart = layer->vstart + layer->height;
     const struct Bitmap *bitmap = layer->bitmap;
+    const struct Palette *palette = layer->palette != NULL ? layer->palette : bitmap->palette;
     const TLN_PixelMap *pixel_map =
         &layer->pixel_map[((ptrdiff_t)nscan * engine->framebuffer.width) + x];
+    CountOverdraw(&ctx->overdraw, OVERDRAW_LAYER(nlayer), tx1, tx2 - tx1);
     while (x < tx2) {
         int xpos = abs(hstart + pixel_map->dx) % layer->width;
         int ypos = abs(vstart + pixel_map->dy) % layer->height;
-        *dstpixel = layer->palette->data[*get_bitmap_ptr(bitmap, xpos, ypos)];
+        *dstpixel = palette->data[*get_bitmap_ptr(bitmap, xpos, ypos)];
 
         /* next pixel */
         x += 1;
@@ -1134,8 +1739,10 @@ static bool DrawBitmapScanlinePixelMapping(int nlayer, uint32_t *dstpixel, int n
 }
 
 /* draws regular object layer scanline */
-static bool DrawObjectScanline(int nlayer, uint32_t *dstpixel, int nscan, int tx1, int tx2) {
-    const Layer *layer = (const Layer *)&engine->layers[nlayer];
+static bool DrawObjectScanline(ScanContext *ctx, int nlayer, uint32_t *dstpixel, int nscan, int tx1,
+                               int tx2) {
+    const Layer *layer = (const Layer *)&ctx->view->layers[nlayer];
+    LayerRender const *render = get_layer_render(ctx, layer);
     struct Object *object = layer->objects->list;
     struct Object tmpobject = {0};
 
@@ -1186,11 +1793,13 @@ static bool DrawObjectScanline(int nlayer, uint32_t *dstpixel, int nscan, int tx
             uint8_t const *srcpixel = get_bitmap_ptr(bitmap, scan.srcx, scan.srcy);
             uint32_t *target = dstscan;
             if (tmpobject.flags & FLAG_PRIORITY) {
-                target = engine->priority;
+                target = ctx->priority;
                 priority = true;
             }
-            layer->render.blitters[1](srcpixel, bitmap->palette, target + dstx1, w, scan.dx, 0,
-                                      layer->render.blend);
+            render->blitters[1](srcpixel, bitmap->palette, target + dstx1, w, scan.dx, 0,
+                                render->blend);
+            CountOverdraw(&ctx->overdraw, OVERDRAW_LAYER(nlayer), dstx1, w);
+            PROFILE_LAYER(ctx, nlayer, blits, 1);
         }
         object = object->next;
     }
@@ -1209,7 +1818,7 @@ enum {
 
 /* table of function pointers to draw procedures */
 static const ScanDrawPtr draw_delegates[MAX_DRAW_TYPE][MAX_DRAW_MODE] = {
-    {&DrawSpriteScanline, &DrawScalingSpriteScanline, NULL, NULL},
+    {&DrawSpriteScanline, &DrawScalingSpriteScanline, &DrawAffineSpriteScanline, NULL},
     {&DrawTiledScanline, &DrawTiledScanlineScaling, &DrawTiledScanlineAffine,
      &DrawTiledScanlinePixelMapping},
     {&DrawBitmapScanline, &DrawBitmapScanlineScaling, &DrawBitmapScanlineAffine,
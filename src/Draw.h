@@ -14,25 +14,64 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "Overdraw.h"
+#include "Profile.h"
+#include "TileCache.h"
+
 /* render modes */
 typedef enum { MODE_NORMAL, MODE_SCALING, MODE_TRANSFORM, MODE_PIXEL_MAP, MAX_DRAW_MODE } draw_t;
 
-typedef bool (*ScanDrawPtr)(int, uint32_t *, int, int, int);
+struct Engine;
+typedef struct ScanContext ScanContext;
+typedef bool (*ScanDrawPtr)(ScanContext *, int, uint32_t *, int, int, int);
 typedef struct Layer Layer;
+typedef struct LayerRender LayerRender;
+
+/* horizontal span of pixels [x1, x2) */
+typedef struct {
+    int x1;
+    int x2;
+} Span;
+
+/* scratch state used while composing scanlines. The calling thread uses
+ * engine->scan, each render worker owns a private one (see RenderThreads.c) */
+struct ScanContext {
+    struct Engine *view;       /* engine state to draw: the engine, or a replay copy */
+    struct Engine *replay;     /* private engine state for raster replay (see RasterCapture.c) */
+    uint32_t *linebuffer;      /* buffer for intermediate scanline output */
+    uint32_t *priority;        /* buffer receiving tiles with priority */
+    uint16_t *collision;       /* buffer with sprite coverage IDs for per-pixel collision */
+    uint8_t *sprite_line;      /* color indices sampled from a transformed sprite */
+    uint32_t *water_render;    /* per-scanline water tile pixels for blend-source layers */
+    uint8_t *blend_mask;       /* per-pixel blend mask: non-zero = apply blend */
+    uint8_t *blend_mask_blend; /* blend table used with blend_mask (set per-scanline) */
+    uint32_t **mosaic;         /* per-layer mosaic line buffers */
+    LayerRender const *render; /* replaces layer render pipeline while drawing to blend mask */
+    uint8_t *hits;             /* per-sprite collision flags pending merge */
+    int *hit_list;             /* sprite indices set in hits */
+    int num_hits;              /* number of entries in hit_list */
+    Span *cover;               /* spans covered by solid layers (see Occlusion.c) */
+    Span *spans;               /* scratch span lists used by occlusion culling */
+    Span *visible;             /* per-layer visible spans, then the background ones */
+    int *num_visible;          /* spans in each visible row, -1 if the layer isn't culled */
+    int max_spans;             /* capacity of each span list */
+    bool culling;              /* current scanline is drawn through visible spans */
+    TileCache tile_cache;      /* tiles resolved to RGBA (see TileCache.c) */
+    FrameCounters stats;       /* frame statistics pending merge (see Profile.c) */
+    ScanOverdraw overdraw;     /* overdraw counters of the line (see Overdraw.c) */
+};
 
 ScanDrawPtr GetLayerDraw(Layer const *layer);
 ScanDrawPtr GetSpriteDraw(draw_t mode);
 
-extern bool DrawScanline(void);
+bool CreateScanContext(ScanContext *scan, struct Engine *context);
+void DeleteScanContext(ScanContext *scan);
+void PrepareScanlines(void);
+void ComposeScanline(ScanContext *scan, int line);
+void PrimeMosaicLines(ScanContext *scan, int line, int band_line);
+void DrawScanlines(ScanContext *scan, int line1, int line2);
+void MergeScanContext(ScanContext *scan);
 
-/* Per-frame profiling accumulators for the blend-mask render path.
- * Counted in SDL_GetPerformanceCounter ticks; reset to 0 each frame by
- * the caller (see prof_draw_reset / prof_draw_read in Intro.c). */
-extern uint64_t g_prof_linebuf_ticks;      /* MAIN_LAYER → linebuffer          */
-extern uint64_t g_prof_fillmask_ticks;     /* fill_blend_mask_scanline          */
-extern uint64_t g_prof_blit_ticks;         /* Blit32_32_Masked composite        */
-extern uint64_t g_prof_layers_ticks;       /* entire draw_regular_layers pass   */
-extern uint64_t g_prof_sprites_ticks;      /* entire draw_regular_sprites pass  */
-extern uint64_t g_prof_per_layer_ticks[8]; /* per-layer breakdown            */
+extern bool DrawScanline(void);
 
 #endif
@@ -18,6 +18,8 @@
 #include "Blitters.h"
 #include "Layer.h"
 #include "List.h"
+#include "Overdraw.h"
+#include "Profile.h"
 #include "Sprite.h"
 #include "Tilengine.h"
 
@@ -56,6 +58,26 @@ typedef struct {
     bool dirty; /* world position updated since last draw */
 } EngineWorld;
 
+/* sprite classes bucketed per scanline, in the order they're drawn */
+typedef enum {
+    SPAN_BACKGROUND, /* FLAG_BACKGROUND sprites, drawn below all layers */
+    SPAN_REGULAR,    /* sprites drawn above regular layers */
+    SPAN_PRIORITY,   /* FLAG_PRIORITY sprites, drawn above priority tiles */
+    MAX_SPAN_CLASS
+} span_t;
+
+/* per-scanline active sprite lists sub-struct (see Draw.c) */
+typedef struct {
+    bool dirty;     /* sprite list, flags or rectangles changed since last build */
+    bool overflow;  /* entries couldn't grow: every line uses the whole list */
+    int first_line; /* first scanline covered by the last build */
+    int *offsets;   /* start of each [line][class] bucket in entries, plus end sentinel */
+    int *entries;   /* sprite indexes grouped by line and class, keeping list order */
+    int capacity;   /* allocated number of entries */
+    int *order;     /* active sprite indexes in list order */
+    int count;      /* number of items in order */
+} EngineSpriteSpans;
+
 /* animation collection sub-struct */
 typedef struct {
     int num;          /* number of animations */
@@ -63,19 +85,26 @@ typedef struct {
     List list;        /* linked list of active animations */
 } EngineAnimations;
 
+/* frame statistics sub-struct (see Profile.c) */
+typedef struct {
+    FrameCounters current; /* frame being drawn, times in ticks */
+    FrameCounters last;    /* last complete frame, times in ns */
+    uint64_t start;        /* ticks at start of the frame being drawn */
+} EngineStats;
+
 typedef struct Engine {
-    uint32_t header;           /* object signature to identify as engine context */
-    uint32_t *priority;        /* buffer receiving tiles with priority */
-    uint16_t *collision;       /* buffer with sprite coverage IDs for per-pixel collision */
-    uint32_t *linebuffer;      /* buffer for intermediate scanline output */
-    uint32_t *water_render;    /* per-scanline water tile pixels for blend-source layers */
-    uint8_t *blend_mask;       /* per-pixel blend mask: non-zero = apply blend */
-    uint8_t *blend_mask_blend; /* blend table used with blend_mask (set per-scanline) */
-    int blend_source_layer;    /* index of layer providing water_render pixels, or -1 */
-    int numsprites;            /* number of sprites */
-    Sprite *sprites;           /* pointer to sprite buffer */
-    int numlayers;             /* number of layers */
-    Layer *layers;             /* pointer to layer buffer */
+    uint32_t header;               /* object signature to identify as engine context */
+    ScanContext scan;              /* scanline scratch buffers of the calling thread */
+    struct RenderPool *pool;       /* optional band render worker pool */
+    struct RasterCapture *capture; /* optional raster callback capture */
+    int blend_source_layer;        /* index of layer providing water_render pixels, or -1 */
+    bool occlusion_culling;        /* skip pixels hidden by solid layers (see Occlusion.c) */
+    size_t tile_cache_budget;      /* bytes of each ScanContext tile cache, 0 = disabled */
+    int numsprites;                /* number of sprites */
+    Sprite *sprites;               /* pointer to sprite buffer */
+    SpriteRender *sprite_render;   /* packed scanline state of sprites, same indexes */
+    int numlayers;                 /* number of layers */
+    Layer *layers;                 /* pointer to layer buffer */
     EngineAnimations anim;
     bool dopriority;        /* there is some data in "priority" buffer that need blitting
                              */
@@ -86,8 +115,11 @@ typedef struct Engine {
     EngineCallbacks callbacks;
     EngineTiming timing;
     List list_sprites; /* linked list of active sprites */
+    EngineSpriteSpans sprite_spans;
     EngineSpriteMask sprite_mask;
     EngineWorld world;
+    EngineStats stats;
+    EngineOverdraw overdraw;
 
     struct {
         int width;
@@ -27,7 +27,7 @@ typedef struct {
 } LayerWindow;
 
 /* render pipeline sub-struct */
-typedef struct {
+typedef struct LayerRender {
     ScanDrawPtr draw;
     ScanBlitPtr blitters[2];
     draw_t mode;
@@ -85,7 +85,6 @@ typedef struct Layer {
     struct {
         int w; /* virtual pixel size */
         int h;
-        uint32_t *buffer; /* line buffer */
     } mosaic;
 } Layer;
 
@@ -11,156 +11,292 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "AssetCache.h"
 #include "Bitmap.h"
 #include "DIB.h"
+#include "LoadBitmap.h"
 #include "LoadFile.h"
 #include "Palette.h"
 #include "Tilengine.h"
+#include "Trace.h"
 #include "png.h"
 
-static TLN_Bitmap LoadPNG(const char *filename);
-static TLN_Bitmap LoadBMP(const char *filename);
+static TLN_Bitmap LoadPNG(Stream *stream);
+static TLN_Bitmap LoadBMP(Stream *stream);
 
+#define SET_SLOTS 512   /* hash slots, twice the maximum colors */
+#define QUANT_BITS 5     /* bits per channel of the quantizer histogram */
+#define QUANT_SIZE (1 << (QUANT_BITS * 3))
+
+/* unique colors of an image, hashed. Images with more than 255 colors are
+ * quantized and colors are then looked up in lut[] */
 typedef struct {
     uint32_t items[255];
+    uint32_t keys[SET_SLOTS]; /* color of each slot, 0 when empty */
+    uint8_t slots[SET_SLOTS]; /* index in items[] of each slot */
     uint16_t count;
+    uint8_t *lut; /* palette index of each quantized color, or NULL */
 } Set;
 
-static void set_init(Set *set) { set->count = 0; }
+/* median cut box of quantized colors */
+typedef struct {
+    uint8_t lo[3];
+    uint8_t hi[3];
+    uint32_t count;
+} Box;
+
+static void set_init(Set *set) {
+    memset(set->keys, 0, sizeof(set->keys));
+    set->count = 0;
+    set->lut = NULL;
+}
+
+static int set_slot(uint32_t value) { return (int)((value * 2654435761u) >> 23); }
+
+/* quantized color of a value, as 5 bits of r, g and b */
+static int quant_key(uint32_t value) {
+    RGBQUAD color;
+    color.value = value;
+    return ((color.r >> 3) << 10) | ((color.g >> 3) << 5) | (color.b >> 3);
+}
 
+/* palette index of a color, minus one */
 static int set_get_index(Set const *set, uint32_t value) {
-    for (int c = 0; c < set->count; c += 1) {
-        if (set->items[c] == value) {
-            return c;
+    if (set->lut != NULL) {
+        return set->lut[quant_key(value)];
+    }
+    for (int slot = set_slot(value); set->keys[slot] != 0; slot = (slot + 1) & (SET_SLOTS - 1)) {
+        if (set->keys[slot] == value) {
+            return set->slots[slot];
         }
     }
     return -1;
 }
 
 static bool set_add(Set *set, uint32_t value) {
-    int index;
+    int slot = set_slot(value);
+    while (set->keys[slot] != 0) {
+        if (set->keys[slot] == value) {
+            return true;
+        }
+        slot = (slot + 1) & (SET_SLOTS - 1);
+    }
     if (set->count == 255) {
         return false;
     }
 
-    index = set_get_index(set, value);
-    if (index == -1) {
-        set->items[set->count] = value;
-        set->count += 1;
-    }
+    set->keys[slot] = value;
+    set->slots[slot] = (uint8_t)set->count;
+    set->items[set->count] = value;
+    set->count += 1;
     return true;
 }
 
-/* Normalizes alpha and registers the color in the set.
- * Returns false if the color set is full (>255 unique colors). */
-static bool classify_pixel(RGBQUAD *color, Set *colors) {
-    if (color->a >= 128) {
-        color->a = 255;
-        return set_add(colors, color->value);
+/* color of a pixel of a 24 or 32 bpp bitmap, 0 if transparent */
+static inline uint32_t get_pixel_color(uint8_t const *scan, int x, int bpp) {
+    if (bpp == 24) {
+        RGBTRIPLE const *color = (RGBTRIPLE const *)scan + x;
+        return PackRGB32(color->r, color->g, color->b);
     }
-    color->a = 0;
-    return true;
+
+    RGBQUAD color = ((RGBQUAD const *)scan)[x];
+    if (color.a < 128) {
+        return 0;
+    }
+    color.a = 255;
+    return color.value;
 }
 
-static TLN_Palette BuildPaletteFromSet(Set const *colors) {
-    RGBQUAD srccolor;
+/* adds up the histogram of a box on each channel, returns the total */
+static uint32_t box_histogram(Box const *box, uint32_t const *histogram,
+                              uint32_t sums[3][1 << QUANT_BITS]) {
+    uint32_t total = 0;
+    memset(sums, 0, sizeof(uint32_t) * 3 * (1 << QUANT_BITS));
+    for (int r = box->lo[0]; r <= box->hi[0]; r++) {
+        for (int g = box->lo[1]; g <= box->hi[1]; g++) {
+            for (int b = box->lo[2]; b <= box->hi[2]; b++) {
+                const uint32_t count = histogram[(r << 10) | (g << 5) | b];
+                sums[0][r] += count;
+                sums[1][g] += count;
+                sums[2][b] += count;
+                total += count;
+            }
+        }
+    }
+    return total;
+}
 
-    TLN_Palette palette = TLN_CreatePalette(colors->count + 1);
-    uint32_t *dstcolor = (uint32_t *)palette->data;
+/* splits the box along its longest side at the median, returns false if it
+ * holds a single color */
+static bool split_box(Box *box, Box *other, uint32_t const *histogram) {
+    uint32_t sums[3][1 << QUANT_BITS];
+    int axis = 0;
+    for (int c = 1; c < 3; c++) {
+        if (box->hi[c] - box->lo[c] > box->hi[axis] - box->lo[axis]) {
+            axis = c;
+        }
+    }
+    if (box->hi[axis] == box->lo[axis]) {
+        return false;
+    }
 
-    *dstcolor = 0xFFFF00FF; /* pink */
-    dstcolor += 1;
-    for (int c = 0; c < colors->count; c += 1) {
-        srccolor.value = colors->items[c];
-        *dstcolor = PackRGB32(srccolor.b, srccolor.g, srccolor.r);
-        dstcolor += 1;
+    box_histogram(box, histogram, sums);
+    uint32_t count = 0;
+    int cut = box->lo[axis];
+    while (cut < box->hi[axis] - 1 && count + sums[axis][cut] < box->count / 2) {
+        count += sums[axis][cut];
+        cut += 1;
     }
-    return palette;
+    count += sums[axis][cut];
+
+    *other = *box;
+    box->hi[axis] = (uint8_t)cut;
+    other->lo[axis] = (uint8_t)(cut + 1);
+    other->count = box->count - count;
+    box->count = count;
+    return true;
 }
 
-static TLN_Bitmap Convert24ToIndexed(TLN_Bitmap source) {
-    TLN_Bitmap bitmap = NULL;
-    Set colors;
-    uint8_t *srcscan;
-    uint8_t *dstscan;
+/* builds up to 255 colors by median cut over a histogram of the quantized
+ * colors, so that images with many colors can be indexed */
+static bool quantize_colors(Set *set, TLN_Bitmap source) {
+    Box boxes[255];
+    int num_boxes = 1;
+    uint32_t *histogram = (uint32_t *)calloc(QUANT_SIZE, sizeof(uint32_t));
+    set->lut = (uint8_t *)calloc(QUANT_SIZE, sizeof(uint8_t));
+    if (histogram == NULL || set->lut == NULL) {
+        free(histogram);
+        free(set->lut);
+        set->lut = NULL;
+        return false;
+    }
 
-    /* count unique colors up to 255 */
-    set_init(&colors);
-    srcscan = source->data;
+    boxes[0] = (Box){{31, 31, 31}, {0, 0, 0}, 0};
     for (int y = 0; y < source->height; y += 1) {
-        RGBTRIPLE const *color = (RGBTRIPLE *)srcscan;
+        uint8_t const *scan = source->data + (ptrdiff_t)y * source->pitch;
         for (int x = 0; x < source->width; x += 1) {
-            uint32_t value = PackRGB32(color->r, color->g, color->b);
-            if (!set_add(&colors, value)) {
-                return NULL;
+            const uint32_t value = get_pixel_color(scan, x, source->bpp);
+            if (value != 0) {
+                const int key = quant_key(value);
+                const uint8_t channels[3] = {(uint8_t)(key >> 10), (uint8_t)((key >> 5) & 31),
+                                             (uint8_t)(key & 31)};
+                for (int c = 0; c < 3; c++) {
+                    if (channels[c] < boxes[0].lo[c]) {
+                        boxes[0].lo[c] = channels[c];
+                    }
+                    if (channels[c] > boxes[0].hi[c]) {
+                        boxes[0].hi[c] = channels[c];
+                    }
+                }
+                histogram[key] += 1;
+                boxes[0].count += 1;
             }
-            color += 1;
         }
-        srcscan += source->pitch;
     }
 
-    /* create new bitmap at 8 bpp */
-    bitmap = TLN_CreateBitmap(source->width, source->height, 8);
-    srcscan = source->data;
-    dstscan = bitmap->data;
-
-    /* set colors with palette indexes */
-    for (int y = 0; y < source->height; y += 1) {
-        RGBTRIPLE const *srccolor = (RGBTRIPLE *)srcscan;
-        uint8_t *dstcolor = dstscan;
-        for (int x = 0; x < source->width; x += 1) {
-            uint32_t value = PackRGB32(srccolor->r, srccolor->g, srccolor->b);
-            *dstcolor = (uint8_t)set_get_index(&colors, value) + 1;
-            srccolor += 1;
-            dstcolor += 1;
+    /* always split the most populated box */
+    while (num_boxes < 255) {
+        int largest = -1;
+        for (int c = 0; c < num_boxes; c++) {
+            const bool single = boxes[c].lo[0] == boxes[c].hi[0] &&
+                                boxes[c].lo[1] == boxes[c].hi[1] &&
+                                boxes[c].lo[2] == boxes[c].hi[2];
+            if (!single && (largest == -1 || boxes[c].count > boxes[largest].count)) {
+                largest = c;
+            }
         }
+        if (largest == -1 || !split_box(&boxes[largest], &boxes[num_boxes], histogram)) {
+            break;
+        }
+        num_boxes += 1;
+    }
 
-        srcscan += source->pitch;
-        dstscan += bitmap->pitch;
+    /* each box becomes the average of its colors */
+    for (int c = 0; c < num_boxes; c++) {
+        Box const *box = &boxes[c];
+        uint64_t total[3] = {0, 0, 0};
+        uint64_t count = 0;
+        for (int r = box->lo[0]; r <= box->hi[0]; r++) {
+            for (int g = box->lo[1]; g <= box->hi[1]; g++) {
+                for (int b = box->lo[2]; b <= box->hi[2]; b++) {
+                    const int key = (r << 10) | (g << 5) | b;
+                    const uint32_t weight = histogram[key];
+                    total[0] += (uint64_t)weight * (uint64_t)((r << 3) | 4);
+                    total[1] += (uint64_t)weight * (uint64_t)((g << 3) | 4);
+                    total[2] += (uint64_t)weight * (uint64_t)((b << 3) | 4);
+                    count += weight;
+                    set->lut[key] = (uint8_t)c;
+                }
+            }
+        }
+        RGBQUAD color = {.value = 0};
+        if (count > 0) {
+            color.r = (uint8_t)(total[0] / count);
+            color.g = (uint8_t)(total[1] / count);
+            color.b = (uint8_t)(total[2] / count);
+        }
+        color.a = 255;
+        set->items[c] = color.value;
     }
+    set->count = (uint16_t)num_boxes;
+    free(histogram);
+    return true;
+}
 
-    /* create attached palette and set actual colors */
-    bitmap->palette = BuildPaletteFromSet(&colors);
+static TLN_Palette BuildPaletteFromSet(Set const *colors) {
+    RGBQUAD srccolor;
 
-    return bitmap;
+    TLN_Palette palette = TLN_CreatePalette(colors->count + 1);
+    uint32_t *dstcolor = (uint32_t *)palette->data;
+
+    *dstcolor = 0xFFFF00FF; /* pink */
+    dstcolor += 1;
+    for (int c = 0; c < colors->count; c += 1) {
+        srccolor.value = colors->items[c];
+        *dstcolor = PackRGB32(srccolor.b, srccolor.g, srccolor.r);
+        dstcolor += 1;
+    }
+    return palette;
 }
 
-static TLN_Bitmap Convert32ToIndexed(TLN_Bitmap source) {
+/* converts a 24 or 32 bpp bitmap to 8 bpp. Pixels with alpha below 128 get
+ * the transparent index 0. Beyond 255 unique colors, the colors are quantized */
+static TLN_Bitmap ConvertToIndexed(TLN_Bitmap source) {
     TLN_Bitmap bitmap = NULL;
     Set colors;
     uint8_t *srcscan;
     uint8_t *dstscan;
+    bool quantize = false;
 
     /* count unique colors up to 255 */
     set_init(&colors);
     srcscan = source->data;
-    for (int y = 0; y < source->height; y += 1) {
-        RGBQUAD *color = (RGBQUAD *)srcscan;
-        for (int x = 0; x < source->width; x += 1) {
-            if (!classify_pixel(color, &colors)) {
-                return NULL;
-            }
-            color += 1;
+    for (int y = 0; y < source->height && !quantize; y += 1) {
+        for (int x = 0; x < source->width && !quantize; x += 1) {
+            const uint32_t value = get_pixel_color(srcscan, x, source->bpp);
+            quantize = value != 0 && !set_add(&colors, value);
         }
         srcscan += source->pitch;
     }
+    if (quantize && !quantize_colors(&colors, source)) {
+        return NULL;
+    }
 
     /* create new bitmap at 8 bpp */
     bitmap = TLN_CreateBitmap(source->width, source->height, 8);
+    if (bitmap == NULL) {
+        free(colors.lut);
+        return NULL;
+    }
     srcscan = source->data;
     dstscan = bitmap->data;
 
     /* set colors with palette indexes */
     for (int y = 0; y < source->height; y += 1) {
-        RGBQUAD const *srccolor = (RGBQUAD *)srcscan;
         uint8_t *dstcolor = dstscan;
         for (int x = 0; x < source->width; x += 1) {
-            if (srccolor->a == 0) {
-                *dstcolor = 0;
-            } else {
-                *dstcolor = (uint8_t)set_get_index(&colors, srccolor->value) + 1;
-            }
-            srccolor += 1;
+            const uint32_t value = get_pixel_color(srcscan, x, source->bpp);
+            *dstcolor = value != 0 ? (uint8_t)(set_get_index(&colors, value) + 1) : 0;
             dstcolor += 1;
         }
 
@@ -170,50 +306,35 @@ static TLN_Bitmap Convert32ToIndexed(TLN_Bitmap source) {
 
     /* create attached palette and set actual colors */
     bitmap->palette = BuildPaletteFromSet(&colors);
+    free(colors.lut);
 
     return bitmap;
 }
 
-/*!
- * \brief
- * Load image file (8-bit BMP or PNG)
- *
- * \param filename
- * File name with the image
- *
- * \returns
- * Handler to the loaded image or NULL if error
- *
- * \see
- * TLN_DeleteBitmap()
- */
-TLN_Bitmap TLN_LoadBitmap(const char *filename) {
+/* loads a bitmap, traced by TLN_LoadBitmap() */
+static TLN_Bitmap load_bitmap(const char *filename) {
     TLN_Bitmap bitmap;
+    Stream stream;
 
-    if (!CheckFile(filename)) {
+    if (!OpenStream(filename, &stream)) {
         TLN_SetLastError(TLN_ERR_FILE_NOT_FOUND);
         return NULL;
     }
 
     /* try png, else bmp*/
-    bitmap = LoadPNG(filename);
+    bitmap = LoadPNG(&stream);
     if (bitmap == NULL) {
-        bitmap = LoadBMP(filename);
+        SeekStream(&stream, 0);
+        bitmap = LoadBMP(&stream);
     }
+    CloseStream(&stream);
 
     /* bitmap loaded */
     if (bitmap) {
         /* accept only 8 bpp */
         int bpp = TLN_GetBitmapDepth(bitmap);
-        if (bpp == 24) {
-            TLN_Bitmap indexed = Convert24ToIndexed(bitmap);
-            if (indexed != NULL) {
-                TLN_DeleteBitmap(bitmap);
-                bitmap = indexed;
-                bpp = 8;
-            }
-        } else if (bpp == 32) {
-            TLN_Bitmap indexed = Convert32ToIndexed(bitmap);
+        if (bpp == 24 || bpp == 32) {
+            TLN_Bitmap indexed = ConvertToIndexed(bitmap);
             if (indexed != NULL) {
                 TLN_DeleteBitmap(bitmap);
                 bitmap = indexed;
@@ -236,10 +357,44 @@ TLN_Bitmap TLN_LoadBitmap(const char *filename) {
     return bitmap;
 }
 
+/*!
+ * \brief
+ * Load image file (8-bit BMP or PNG)
+ *
+ * \param filename
+ * File name with the image
+ *
+ * \returns
+ * Handler to the loaded image or NULL if error
+ *
+ * \remarks
+ * Loading a file again returns the same bitmap, which is freed after being
+ * deleted as many times as loaded. See TLN_SetAssetCacheBudget()
+ *
+ * \see
+ * TLN_DeleteBitmap()
+ */
+TLN_Bitmap TLN_LoadBitmap(const char *filename) {
+    const uint64_t trace = TraceBegin(TRACE_ALWAYS, 0);
+    TLN_Bitmap bitmap = (TLN_Bitmap)GetCachedAsset(OT_BITMAP, filename);
+    if (bitmap == NULL) {
+        bitmap = (TLN_Bitmap)AddCachedAsset(OT_BITMAP, filename, load_bitmap(filename));
+    }
+    TraceEndFile(trace, "LoadBitmap", filename);
+    return bitmap;
+}
+
+/* libpng read callback over a stream */
+static void read_png(png_struct *png, png_bytep data, size_t size) {
+    Stream *stream = (Stream *)png_get_io_ptr(png);
+    if (ReadStream(stream, data, size) != size) {
+        png_error(png, "Read Error");
+    }
+}
+
 /* Loads PNG using libpng 1.2 */
-static TLN_Bitmap LoadPNG(const char *filename) {
+static TLN_Bitmap LoadPNG(Stream *stream) {
     TLN_Bitmap bitmap = NULL;
-    FILE *fp;
     png_struct *png;
     png_info *info;
     int width;
@@ -250,14 +405,7 @@ static TLN_Bitmap LoadPNG(const char *filename) {
     png_byte header[8];
     int channels;
 
-    fp = FileOpen(filename);
-    if (!fp) {
-        return NULL;
-    }
-
-    fread(header, 8, 1, fp);
-    if (png_sig_cmp(header, 0, 8)) {
-        FileClose(fp);
+    if (ReadStream(stream, header, 8) != 8 || png_sig_cmp(header, 0, 8)) {
         return NULL;
     }
 
@@ -265,7 +413,7 @@ static TLN_Bitmap LoadPNG(const char *filename) {
     info = png_create_info_struct(png);
 
     setjmp(png_jmpbuf(png));
-    png_init_io(png, fp);
+    png_set_read_fn(png, stream, read_png);
     png_set_sig_bytes(png, 8);
     png_read_info(png, info);
 
@@ -316,53 +464,133 @@ static TLN_Bitmap LoadPNG(const char *filename) {
         TLN_SetBitmapPalette(bitmap, palette);
     }
 
-    FileClose(fp);
     png_destroy_read_struct(&png, &info, NULL);
     return bitmap;
 }
 
+struct PNGReader {
+    Stream stream;
+    png_struct *png;
+    png_info *info;
+};
+
+/* reads the header of an image being opened by OpenIndexedPNG(), false if it
+ * isn't a non-interlaced indexed image. The caller has no locals live across
+ * setjmp this way */
+static bool read_indexed_info(PNGReader *reader, png_colorp *png_palette, int *palette_entries) {
+    if (setjmp(png_jmpbuf(reader->png))) {
+        return false;
+    }
+
+    png_set_read_fn(reader->png, &reader->stream, read_png);
+    png_set_sig_bytes(reader->png, 8);
+    png_read_info(reader->png, reader->info);
+    if (png_get_color_type(reader->png, reader->info) != PNG_COLOR_TYPE_PALETTE ||
+        png_get_interlace_type(reader->png, reader->info) != PNG_INTERLACE_NONE ||
+        !png_get_PLTE(reader->png, reader->info, png_palette, palette_entries)) {
+        return false;
+    }
+    if (png_get_bit_depth(reader->png, reader->info) < 8) {
+        png_set_packing(reader->png);
+    }
+    png_read_update_info(reader->png, reader->info);
+    return true;
+}
+
+/* opens a non-interlaced indexed PNG to read its rows at 8 bpp with
+ * ReadPNGRow(). Returns NULL for other images, that must be loaded whole */
+PNGReader *OpenIndexedPNG(const char *filename, int *width, int *height, TLN_Palette *palette) {
+    png_byte header[8];
+    png_colorp png_palette = NULL;
+    int palette_entries = 0;
+    PNGReader *reader = (PNGReader *)calloc(1, sizeof(PNGReader));
+    if (reader == NULL) {
+        return NULL;
+    }
+
+    if (!OpenStream(filename, &reader->stream)) {
+        free(reader);
+        return NULL;
+    }
+    if (ReadStream(&reader->stream, header, 8) != 8 || png_sig_cmp(header, 0, 8)) {
+        ClosePNG(reader);
+        return NULL;
+    }
+
+    reader->png = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    reader->info = reader->png != NULL ? png_create_info_struct(reader->png) : NULL;
+    if (reader->info == NULL || !read_indexed_info(reader, &png_palette, &palette_entries)) {
+        ClosePNG(reader);
+        return NULL;
+    }
+
+    *palette = TLN_CreatePalette(palette_entries);
+    if (*palette == NULL) {
+        ClosePNG(reader);
+        return NULL;
+    }
+    for (int c = 0; c < palette_entries; c++) {
+        TLN_SetPaletteColor(*palette, c, png_palette[c].red, png_palette[c].green,
+                            png_palette[c].blue);
+    }
+    *width = (int)png_get_image_width(reader->png, reader->info);
+    *height = (int)png_get_image_height(reader->png, reader->info);
+    return reader;
+}
+
+/* decodes the next row of an image opened with OpenIndexedPNG(), one byte per
+ * pixel */
+bool ReadPNGRow(PNGReader *reader, uint8_t *row) {
+    if (setjmp(png_jmpbuf(reader->png))) {
+        return false;
+    }
+    png_read_row(reader->png, row, NULL);
+    return true;
+}
+
+void ClosePNG(PNGReader *reader) {
+    if (reader->png != NULL) {
+        png_destroy_read_struct(&reader->png, reader->info != NULL ? &reader->info : NULL, NULL);
+    }
+    CloseStream(&reader->stream);
+    free(reader);
+}
+
 /* loads BMP */
-static TLN_Bitmap LoadBMP(const char *filename) {
+static TLN_Bitmap LoadBMP(Stream *stream) {
     BITMAPFILEHEADER bfh;
     BITMAPV5HEADER bv5;
-    uint32_t StructSize;
-    FILE *pf;
+    uint32_t StructSize = 0;
     TLN_Bitmap bitmap = NULL;
     unsigned int c;
     int pitch;
 
-    /* open file */
-    pf = FileOpen(filename);
-    if (!pf) {
-        return NULL;
-    }
-
     /* read BMP header */
-    fread(&bfh, sizeof(bfh), 1, pf);
-    if (bfh.Type != 0x4D42) {
-        FileClose(pf);
+    if (ReadStream(stream, &bfh, sizeof(bfh)) != sizeof(bfh) || bfh.Type != 0x4D42) {
         return NULL;
     }
 
     /* load info structure */
     memset(&bv5, 0, sizeof(bv5));
-    fread(&StructSize, 4, 1, pf);
-    fseek(pf, sizeof(bfh), SEEK_SET);
-    fread(&bv5, StructSize, 1, pf);
+    ReadStream(stream, &StructSize, 4);
+    if (StructSize > sizeof(bv5)) {
+        StructSize = sizeof(bv5);
+    }
+    SeekStream(stream, sizeof(bfh));
+    ReadStream(stream, &bv5, StructSize);
 
     /* create */
     bitmap = TLN_CreateBitmap((int)bv5.bV5Width, (int)bv5.bV5Height, (int)bv5.bV5BitCount);
     if (!bitmap) {
-        FileClose(pf);
         return NULL;
     }
 
     /* load scanlines */
     pitch = TLN_GetBitmapPitch(bitmap);
-    fseek(pf, (long)bfh.OffsetData, SEEK_SET);
+    SeekStream(stream, bfh.OffsetData);
     for (c = 0; c < bv5.bV5Height; c++) {
         uint8_t *line = TLN_GetBitmapPtr(bitmap, 0, (int)(bv5.bV5Height - c - 1));
-        fread(line, pitch, 1, pf);
+        ReadStream(stream, line, (size_t)pitch);
     }
 
     /* load palette */
@@ -374,16 +602,15 @@ static TLN_Bitmap LoadBMP(const char *filename) {
             bv5.bV5ClrUsed = (bfh.OffsetData - sizeof(bfh) - bv5.bV5Size) / sizeof(RGBQUAD);
         }
 
-        fseek(pf, (long)(sizeof(BITMAPFILEHEADER) + bv5.bV5Size), SEEK_SET);
+        SeekStream(stream, sizeof(BITMAPFILEHEADER) + bv5.bV5Size);
         palette = TLN_CreatePalette((int)bv5.bV5ClrUsed);
         for (c = 0; c < bv5.bV5ClrUsed; c++) {
             RGBQUAD color;
-            fread(&color, sizeof(RGBQUAD), 1, pf);
+            ReadStream(stream, &color, sizeof(RGBQUAD));
             TLN_SetPaletteColor(palette, (int)c, color.r, color.g, color.b);
         }
         TLN_SetBitmapPalette(bitmap, palette);
     }
 
-    FileClose(pf);
     return bitmap;
 }
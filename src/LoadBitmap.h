@@ -0,0 +1,25 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* row by row decoding of indexed PNG images, for loaders that convert them
+ * without keeping a whole bitmap (see LoadTileset.c) */
+
+#ifndef LOADBITMAP_H
+#define LOADBITMAP_H
+
+#include "Tilengine.h"
+
+typedef struct PNGReader PNGReader;
+
+PNGReader *OpenIndexedPNG(const char *filename, int *width, int *height, TLN_Palette *palette);
+bool ReadPNGRow(PNGReader *reader, uint8_t *row);
+void ClosePNG(PNGReader *reader);
+
+#endif
@@ -10,23 +10,31 @@
 
 #include "LoadFile.h"
 
+#include <SDL3/SDL_mutex.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "ResourcePacker.h"
 
+#if defined(_WIN32)
+#include <windows.h>
+#undef MAX_PATH /* redefined below */
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #define SLASH '/'
 #define BACKSLASH '\\'
 #define MAX_PATH 300
-#define MAX_ASSETS 8
 
 static char localpath[MAX_PATH] = ".";
 static ResPack respack = NULL;
-static struct {
-    ResAsset asset;
-    FILE *pf;
-} assets[MAX_ASSETS] = {0};
+static uint32_t respack_id = 0; /* identifies the current pack in asset cache keys */
+static SDL_Mutex *respack_lock = NULL; /* assets may load in loader threads */
 
 /*!
  * \brief
@@ -64,11 +72,20 @@ void TLN_SetLoadPath(const char *path) {
  * when they were plain files. As long as the structure used to build the
  * package matches the original structure of the assets, the TLN_SetLoadPath()
  * and the TLN_LoadXXX functions will work transparently, easing the migration
- * with minimal changes.
+ * with minimal changes. Assets are decoded straight from memory, packages
+ * without key are mapped and read in place.
  * \sa TLN_CloseResourcePack
  */
 bool TLN_OpenResourcePack(const char *filename, const char *key) {
+    static uint32_t last_id = 0;
+
     respack = ResPack_Open(filename, key);
+    if (respack != NULL && respack_lock == NULL) {
+        respack_lock = SDL_CreateMutex();
+    }
+    if (respack != NULL) {
+        respack_id = ++last_id;
+    }
     return respack != NULL;
 }
 
@@ -81,21 +98,19 @@ void TLN_CloseResourcePack(void) {
         ResPack_Close(respack);
     }
     respack = NULL;
+    respack_id = 0;
 }
 
-/* open file/packed asset */
-FILE *FileOpen(const char *filename) {
-    FILE *fp;
-    char path[MAX_PATH + 1];
+/* composes the path of a file inside the load path */
+static void build_path(char *path, size_t size, const char *filename) {
     char oldchar;
     char newchar;
     char *p;
-    ResAsset new_asset;
 
 #if (_MSC_VER) && (_MSC_VER < 1900)
     sprintf(path, "%s/%s", localpath, filename);
 #else
-    snprintf(path, sizeof(path), "%s/%s", localpath, filename);
+    snprintf(path, size, "%s/%s", localpath, filename);
 #endif
 
     /* replace correct path separator */
@@ -113,65 +128,99 @@ FILE *FileOpen(const char *filename) {
         }
         p++;
     }
+}
 
-    /* asset pack active? */
-    if (respack != NULL) {
-        /* search free slot */
-        int c;
-        for (c = 0; c < MAX_ASSETS; c++) {
-            if (assets[c].asset == NULL) {
-                break;
-            }
+/* removes empty and "." segments, and ".." segments with the one before */
+static void normalize_path(char *path) {
+    char const *src = path;
+    char *dst = path;
+    char *root;
+
+    if (*src == SLASH || *src == BACKSLASH) {
+        *dst++ = *src;
+    }
+    root = dst;
+    while (*src != 0) {
+        while (*src == SLASH || *src == BACKSLASH) {
+            src++;
         }
-        if (c == MAX_ASSETS) {
-            return NULL;
+        char const *end = src;
+        while (*end != 0 && *end != SLASH && *end != BACKSLASH) {
+            end++;
         }
-
-        /* open */
-        new_asset = ResPack_OpenAsset(respack, path);
-        fp = ResPack_GetAssetFile(new_asset);
-        if (fp != NULL) {
-            assets[c].asset = new_asset;
-            assets[c].pf = fp;
+        const size_t len = (size_t)(end - src);
+        if (len == 2 && src[0] == '.' && src[1] == '.' && dst > root) {
+            char *last = dst;
+            while (last > root && last[-1] != SLASH && last[-1] != BACKSLASH) {
+                last--;
+            }
+            if (dst - last != 2 || last[0] != '.' || last[1] != '.') {
+                dst = last > root ? last - 1 : root;
+                src = end;
+                continue;
+            }
         }
-    } else {
-        fp = fopen(path, "rb");
+        if (len > 0 && !(len == 1 && src[0] == '.')) {
+            if (dst > root) {
+                *dst++ = src[-1];
+            }
+            memmove(dst, src, len);
+            dst += len;
+        }
+        src = end;
     }
-
-    return fp;
-}
-
-/* closes file/packed asset */
-void FileClose(FILE *pf) {
-    if (pf == NULL) {
-        return;
+    if (dst == path) {
+        *dst++ = '.';
     }
+    *dst = 0;
 
-    /* asset pack active? */
-    if (respack != NULL) {
-        for (int c = 0; c < MAX_ASSETS; c++) {
-            if (assets[c].pf == pf) {
-                ResPack_CloseAsset(assets[c].asset);
-                assets[c].asset = NULL;
-                assets[c].pf = NULL;
-                return;
-            }
+#ifdef _WIN32
+    for (char *p = path; *p != 0; p++) {
+        if (*p >= 'A' && *p <= 'Z') {
+            *p += 'a' - 'A';
         }
-    } else {
-        fclose(pf);
     }
+#endif
+}
+
+/* composes the path a file is loaded from, normalized so that all names of the
+ * same file match. Returns the identity of the resource pack it's loaded from,
+ * or 0 if it's a plain file */
+uint32_t GetAssetPath(const char *filename, char *path, size_t size) {
+    build_path(path, size, filename);
+    normalize_path(path);
+    return respack != NULL ? respack_id : 0;
 }
 
 /* generic load file into RAM buffer */
 void *LoadFile(const char *filename, ssize_t *out_size) {
+    char path[MAX_PATH + 1];
     long file_size;
     FILE *fp;
     uint8_t *data;
 
+    build_path(path, sizeof(path), filename);
+    *out_size = 0;
+
+    /* asset pack active? decoded straight from the pack */
+    if (respack != NULL) {
+        uint32_t size = 0;
+        SDL_LockMutex(respack_lock);
+        data = (uint8_t *)ResPack_LoadAsset(respack, path, &size);
+        SDL_UnlockMutex(respack_lock);
+        if (data != NULL && size == 0) {
+            free(data);
+            data = NULL;
+        }
+        if (data != NULL) {
+            *out_size = (ssize_t)size;
+        }
+        return (void *)data;
+    }
+
     /* abre */
-    fp = FileOpen(filename);
+    fp = fopen(path, "rb");
     if (!fp) {
-        *out_size = 0;
         return NULL;
     }
 
@@ -181,8 +230,7 @@ void *LoadFile(const char *filename, ssize_t *out_size) {
 
     /* check for ftell error or empty file */
     if (file_size <= 0) {
-        FileClose(fp);
-        *out_size = 0;
+        fclose(fp);
         return NULL;
     }
 
@@ -196,23 +244,146 @@ void *LoadFile(const char *filename, ssize_t *out_size) {
         *out_size = -1;
     }
 
-    FileClose(fp);
+    fclose(fp);
     return (void *)data;
 }
 
-/* check if file exists */
-bool CheckFile(const char *filename) {
-    FILE *fp;
+/* gets a packed asset, in place when the pack is mapped */
+static bool map_packed_file(const char *path, MappedFile *file) {
+    uint32_t size = 0;
 
-    fp = FileOpen(filename);
-    if (!fp) {
+    SDL_LockMutex(respack_lock);
+    file->data = (const uint8_t *)ResPack_MapAsset(respack, path, &size);
+    if (file->data == NULL) {
+        file->buffer = ResPack_LoadAsset(respack, path, &size);
+        file->data = (const uint8_t *)file->buffer;
+    }
+    SDL_UnlockMutex(respack_lock);
+    file->size = size;
+    return file->data != NULL && size > 0;
+}
+
+/* maps a whole file read-only into memory */
+bool MapFile(const char *filename, MappedFile *file) {
+    char path[MAX_PATH + 1];
+
+    memset(file, 0, sizeof(MappedFile));
+    build_path(path, sizeof(path), filename);
+    if (respack != NULL) {
+        if (!map_packed_file(path, file)) {
+            UnmapFile(file);
+            return false;
+        }
+        return true;
+    }
+
+#if defined(_WIN32)
+    HANDLE hfile = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hfile == INVALID_HANDLE_VALUE) {
         return false;
     }
+    LARGE_INTEGER size;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(hfile, &size) && size.QuadPart > 0) {
+        mapping = CreateFileMappingA(hfile, NULL, PAGE_READONLY, 0, 0, NULL);
+    }
+    CloseHandle(hfile);
+    if (mapping == NULL) {
+        return false;
+    }
+    file->data = (const uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (file->data == NULL) {
+        CloseHandle(mapping);
+        return false;
+    }
+    file->size = (size_t)size.QuadPart;
+    file->handle = mapping;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        return false;
+    }
+    struct stat st;
+    void *data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    file->data = (const uint8_t *)data;
+    file->size = (size_t)st.st_size;
+    file->handle = data;
+#endif
+    return true;
+}
 
-    FileClose(fp);
+/* releases a file mapped by MapFile() */
+void UnmapFile(MappedFile *file) {
+    if (file->buffer != NULL) {
+        free(file->buffer);
+    } else if (file->handle != NULL) {
+#if defined(_WIN32)
+        UnmapViewOfFile(file->data);
+        CloseHandle(file->handle);
+#else
+        munmap(file->handle, file->size);
+#endif
+    }
+    memset(file, 0, sizeof(MappedFile));
+}
+
+/* opens a file/packed asset for sequential reading */
+bool OpenStream(const char *filename, Stream *stream) {
+    stream->pos = 0;
+    return MapFile(filename, &stream->file);
+}
+
+/* reads up to size bytes, returns number of bytes read */
+size_t ReadStream(Stream *stream, void *buffer, size_t size) {
+    const size_t available = stream->file.size - stream->pos;
+    if (size > available) {
+        size = available;
+    }
+    memcpy(buffer, stream->file.data + stream->pos, size);
+    stream->pos += size;
+    return size;
+}
+
+/* moves to an absolute position, fails past the end */
+bool SeekStream(Stream *stream, size_t pos) {
+    if (pos > stream->file.size) {
+        return false;
+    }
+    stream->pos = pos;
     return true;
 }
 
+/* reads a line like fgets(), returns NULL at the end */
+char *ReadStreamLine(Stream *stream, char *line, int size) {
+    int count = 0;
+    if (stream->pos >= stream->file.size || size <= 0) {
+        return NULL;
+    }
+    while (count < size - 1 && stream->pos < stream->file.size) {
+        const char c = (char)stream->file.data[stream->pos++];
+        line[count++] = c;
+        if (c == '\n') {
+            break;
+        }
+    }
+    line[count] = 0;
+    return line;
+}
+
+/* closes a stream opened with OpenStream() */
+void CloseStream(Stream *stream) {
+    UnmapFile(&stream->file);
+    stream->pos = 0;
+}
+
 /* returns file extension in lowercase */
 void SplitFilename(const char *filename, FileInfo *fileinfo) {
     if (filename == NULL || fileinfo == NULL) {
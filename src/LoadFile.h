@@ -8,6 +8,7 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  * */
 
+#include <stdint.h>
 #include <stdio.h>
 
 #ifndef LOAD_FILE_H
@@ -31,14 +32,33 @@ typedef struct {
   char ext[16];
 } FileInfo;
 
+/* read-only view of a whole file or packed asset, see MapFile() */
+typedef struct {
+  const uint8_t *data;
+  size_t size;
+  void *buffer; /* owned copy of data, for encrypted packed assets */
+  void *handle; /* platform mapping, NULL if not mapped or inside a mapped pack */
+} MappedFile;
+
+/* sequential reader over a mapped file, see OpenStream() */
+typedef struct {
+  MappedFile file;
+  size_t pos;
+} Stream;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 void *LoadFile(const char *filename, ssize_t *out_size);
-void FileClose(FILE *pf);
-FILE *FileOpen(const char *filename);
-bool CheckFile(const char *filename);
+bool MapFile(const char *filename, MappedFile *file);
+void UnmapFile(MappedFile *file);
+bool OpenStream(const char *filename, Stream *stream);
+size_t ReadStream(Stream *stream, void *buffer, size_t size);
+bool SeekStream(Stream *stream, size_t pos);
+char *ReadStreamLine(Stream *stream, char *line, int size);
+void CloseStream(Stream *stream);
+uint32_t GetAssetPath(const char *filename, char *path, size_t size);
 void SplitFilename(const char *filename, FileInfo *fileinfo);
 void BuildFilePath(char *full_path, int len, const char *path, const char *name, const char *ext);
 
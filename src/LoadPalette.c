@@ -10,8 +10,10 @@
 
 #include <stdio.h>
 
+#include "AssetCache.h"
 #include "LoadFile.h"
 #include "Tilengine.h"
+#include "Trace.h"
 
 #define SWAP(w) (((w) & 0xFF) << 8 | ((w) >> 8))
 
@@ -24,44 +26,25 @@ struct {
     short transparent; /* index of transparent color */
 } trailing;
 
-/*!
- * \brief
- * Loads a palette from a standard .act file
- *
- * \param filename
- * ACT file containing the palette to load
- *
- * \returns
- * A reference to the newly loaded palette, or NULL if error
- *
- * \remarks
- * Palettes are also automatically created when loading tilesets and spritesets.
- * Use the functions TLN_GetTilesetPalette() and TLN_GetSpritesetPalette() to
- * retrieve them.
- *
- * \see
- * TLN_GetTilesetPalette(), TLN_GetSpritesetPalette()
- */
-TLN_Palette TLN_LoadPalette(const char *filename) {
-    FILE *pf;
+/* loads a palette, traced by TLN_LoadPalette() */
+static TLN_Palette load_palette(const char *filename) {
+    Stream stream;
     TLN_Palette palette = NULL;
-    long size;
+    size_t size;
 
     /* open file */
-    pf = FileOpen(filename);
-    if (!pf) {
+    if (!OpenStream(filename, &stream)) {
         TLN_SetLastError(TLN_ERR_FILE_NOT_FOUND);
         return NULL;
     }
 
     /* check size */
-    fseek(pf, 0, SEEK_END);
-    size = ftell(pf);
+    size = stream.file.size;
 
     /* load trailing and get number of entries */
-    if (size > 0 && (size_t)size == ACT_SIZE) {
-        fseek(pf, -(int)sizeof(trailing), SEEK_END);
-        fread(&trailing, sizeof(trailing), 1, pf);
+    if (size == ACT_SIZE) {
+        SeekStream(&stream, size - sizeof(trailing));
+        ReadStream(&stream, &trailing, sizeof(trailing));
         trailing.entries = (short)(SWAP(trailing.entries));
         trailing.transparent = (short)(SWAP(trailing.transparent));
     } else {
@@ -70,14 +53,42 @@ TLN_Palette TLN_LoadPalette(const char *filename) {
 
     /* create palette and load from file */
     palette = TLN_CreatePalette(trailing.entries);
-    fseek(pf, 0, SEEK_SET);
+    SeekStream(&stream, 0);
     for (int c = 0; c < trailing.entries; c++) {
         uint8_t src[3];
-        fread(src, sizeof(src), 1, pf);
+        ReadStream(&stream, src, sizeof(src));
         TLN_SetPaletteColor(palette, c, src[0], src[1], src[2]);
     }
 
-    FileClose(pf);
+    CloseStream(&stream);
     TLN_SetLastError(TLN_ERR_OK);
     return palette;
 }
+
+/*!
+ * \brief
+ * Loads a palette from a standard .act file
+ *
+ * \param filename
+ * ACT file containing the palette to load
+ *
+ * \returns
+ * A reference to the newly loaded palette, or NULL if error
+ *
+ * \remarks
+ * Palettes are also automatically created when loading tilesets and spritesets.
+ * Use the functions TLN_GetTilesetPalette() and TLN_GetSpritesetPalette() to
+ * retrieve them. Loading a file already loaded returns the same palette.
+ *
+ * \see
+ * TLN_GetTilesetPalette(), TLN_GetSpritesetPalette()
+ */
+TLN_Palette TLN_LoadPalette(const char *filename) {
+    const uint64_t trace = TraceBegin(TRACE_ALWAYS, 0);
+    TLN_Palette palette = (TLN_Palette)GetCachedAsset(OT_PALETTE, filename);
+    if (palette == NULL) {
+        palette = (TLN_Palette)AddCachedAsset(OT_PALETTE, filename, load_palette(filename));
+    }
+    TraceEndFile(trace, "LoadPalette", filename);
+    return palette;
+}
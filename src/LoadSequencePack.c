@@ -12,14 +12,16 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "AssetCache.h"
 #include "LoadFile.h"
 #include "Tilengine.h"
-#include "simplexml.h"
+#include "Trace.h"
+#include "XmlReader.h"
 
 #define MAX_COLOR_STRIP 32
 
-/* load manager */
-static struct {
+/* load manager, passed to the parser as user data */
+typedef struct {
     TLN_SequencePack sp;
     char name[16];
     int target;
@@ -27,64 +29,80 @@ static struct {
     int delay;
     TLN_SequenceFrame frames[100];
     TLN_ColorStrip strips[MAX_COLOR_STRIP];
-} loader;
+} Loader;
 
 static bool ishex(char dat);
 
-static void handle_add_subtag(const char *szName) {
-    if (!strcasecmp(szName, "cycle")) {
-        loader.count = 0;
-        memset(loader.strips, 0, sizeof(loader.strips));
+static void handle_add_subtag(Loader *loader, XmlKey tag) {
+    if (tag == XML_CYCLE) {
+        loader->count = 0;
+        memset(loader->strips, 0, sizeof(loader->strips));
     }
 }
 
-static void handle_sequence_attribute(const char *szAttribute, const char *szValue) {
-    if (!strcasecmp(szAttribute, "name")) {
-        strncpy(loader.name, szValue, sizeof(loader.name));
-    } else if (!strcasecmp(szAttribute, "delay")) {
-        loader.delay = atoi(szValue);
-    } else if (!strcasecmp(szAttribute, "first") || !strcasecmp(szAttribute, "target")) {
-        loader.target = atoi(szValue);
-    } else if (!strcasecmp(szAttribute, "count")) {
-        loader.count = atoi(szValue);
+static void handle_sequence_attribute(Loader *loader, XmlKey attribute, const char *value) {
+    switch (attribute) {
+    case XML_NAME:
+        strncpy(loader->name, value, sizeof(loader->name));
+        break;
+    case XML_DELAY:
+        loader->delay = atoi(value);
+        break;
+    case XML_FIRST:
+    case XML_TARGET:
+        loader->target = atoi(value);
+        break;
+    case XML_COUNT:
+        loader->count = atoi(value);
+        break;
+    default:
+        break;
     }
 }
 
-static void handle_strip_attribute(const char *szAttribute, const char *szValue) {
-    if (!strcasecmp(szAttribute, "delay")) {
-        loader.strips[loader.count].delay = atoi(szValue);
-    } else if (!strcasecmp(szAttribute, "first")) {
-        loader.strips[loader.count].first = (uint8_t)atoi(szValue);
-    } else if (!strcasecmp(szAttribute, "count")) {
-        loader.strips[loader.count].count = (uint8_t)atoi(szValue);
-    } else if (!strcasecmp(szAttribute, "dir")) {
-        loader.strips[loader.count].dir = (uint8_t)atoi(szValue);
+static void handle_strip_attribute(Loader *loader, XmlKey attribute, const char *value) {
+    switch (attribute) {
+    case XML_DELAY:
+        loader->strips[loader->count].delay = atoi(value);
+        break;
+    case XML_FIRST:
+        loader->strips[loader->count].first = (uint8_t)atoi(value);
+        break;
+    case XML_COUNT:
+        loader->strips[loader->count].count = (uint8_t)atoi(value);
+        break;
+    case XML_DIR:
+        loader->strips[loader->count].dir = (uint8_t)atoi(value);
+        break;
+    default:
+        break;
     }
 }
 
-static void handle_add_attribute(const char *szName, const char *szAttribute, const char *szValue) {
-    if (!strcasecmp(szName, "sequence")) {
-        handle_sequence_attribute(szAttribute, szValue);
-    } else if (!strcasecmp(szName, "cycle")) {
-        if (!strcasecmp(szAttribute, "name")) {
-            strncpy(loader.name, szValue, sizeof(loader.name));
+static void handle_add_attribute(Loader *loader, XmlKey tag, XmlKey attribute,
+                                 const char *value) {
+    if (tag == XML_SEQUENCE) {
+        handle_sequence_attribute(loader, attribute, value);
+    } else if (tag == XML_CYCLE) {
+        if (attribute == XML_NAME) {
+            strncpy(loader->name, value, sizeof(loader->name));
         }
-    } else if (!strcasecmp(szName, "strip")) {
-        handle_strip_attribute(szAttribute, szValue);
+    } else if (tag == XML_STRIP) {
+        handle_strip_attribute(loader, attribute, value);
     }
 
-    loader.name[sizeof(loader.name) - 1] = '\0';
+    loader->name[sizeof(loader->name) - 1] = '\0';
 }
 
-static void handle_add_content(const char *szName, const char *szValue) {
-    if (strcasecmp(szName, "sequence") != 0) {
+static void handle_add_content(Loader *loader, XmlKey tag, const char *value) {
+    if (tag != XML_SEQUENCE) {
         return;
     }
 
-    char const *ptr = szValue;
-    loader.count = 0;
+    char const *ptr = value;
+    loader->count = 0;
     while (*ptr) {
-        unsigned int value;
+        unsigned int number;
 
         /* find number */
         while (*ptr && !ishex(*ptr) && *ptr != '#') {
@@ -97,82 +115,66 @@ static void handle_add_content(const char *szName, const char *szValue) {
         /* copy and find end of number */
         if (*ptr == '#') {
             ptr++;
-            sscanf(ptr, "%x", &value);
+            sscanf(ptr, "%x", &number);
         } else {
-            sscanf(ptr, "%u", &value);
+            sscanf(ptr, "%u", &number);
         }
 
-        loader.frames[loader.count].index = (int)value;
-        loader.frames[loader.count].delay = loader.delay;
-        loader.count++;
+        loader->frames[loader->count].index = (int)number;
+        loader->frames[loader->count].delay = loader->delay;
+        loader->count++;
         while (*ptr && (int)ishex(*ptr)) {
             ptr++;
         }
     }
 }
 
-static void handle_finish_tag(const char *szName) {
+static void handle_finish_tag(Loader *loader, XmlKey tag) {
     TLN_Sequence sequence = NULL;
-    if (!strcasecmp(szName, "sequence")) {
-        sequence = TLN_CreateSequence(loader.name, loader.target, loader.count, loader.frames);
-    } else if (!strcasecmp(szName, "cycle")) {
-        sequence = TLN_CreateCycle(loader.name, loader.count, loader.strips);
+    if (tag == XML_SEQUENCE) {
+        sequence = TLN_CreateSequence(loader->name, loader->target, loader->count, loader->frames);
+    } else if (tag == XML_CYCLE) {
+        sequence = TLN_CreateCycle(loader->name, loader->count, loader->strips);
     }
     if (sequence) {
-        TLN_AddSequenceToPack(loader.sp, sequence);
+        TLN_AddSequenceToPack(loader->sp, sequence);
     }
 }
 
 /* XML parser callback */
-static void *handler(SimpleXmlParser parser [[maybe_unused]], SimpleXmlEvent evt,
-                     const char *szName, const char *szAttribute, const char *szValue) {
-    switch (evt) {
-    case ADD_SUBTAG:
-        handle_add_subtag(szName);
+static void handler(void *data, XmlEvent event, XmlKey tag, XmlKey attribute,
+                    const char *value) {
+    Loader *loader = (Loader *)data;
+    switch (event) {
+    case XML_START_TAG:
+        handle_add_subtag(loader, tag);
         break;
-    case ADD_ATTRIBUTE:
-        handle_add_attribute(szName, szAttribute, szValue);
+    case XML_ATTRIBUTE:
+        handle_add_attribute(loader, tag, attribute, value);
         break;
-    case FINISH_ATTRIBUTES:
-        if (!strcasecmp(szName, "strip") && loader.strips[loader.count].delay != 0) {
-            loader.count++;
+    case XML_END_ATTRIBUTES:
+        if (tag == XML_STRIP && loader->strips[loader->count].delay != 0) {
+            loader->count++;
         }
         break;
-    case ADD_CONTENT:
-        handle_add_content(szName, szValue);
+    case XML_CONTENT:
+        handle_add_content(loader, tag, value);
         break;
-    case FINISH_TAG:
-        handle_finish_tag(szName);
+    case XML_END_TAG:
+        handle_finish_tag(loader, tag);
         break;
     }
-    return &handler;
 }
 
-/*!
- * \brief
- * Loads a sqx file containing one or more sequences
- *
- * \param filename
- * SQX filename with the sequences to load
- *
- * \returns
- * Reference to the newly created TLN_SequencePack() or NULL if error
- *
- * \remarks
- * A SQX file can contain many sequences. This function loads all of them
- * inside a single TLN_SequencePack(). Individual sequences can be later
- * queried with TLN_FindSequence()
- *
- * \see
- * TLN_FindSequence()
- */
-TLN_SequencePack TLN_LoadSequencePack(const char *filename) {
-    SimpleXmlParser parser;
+/* loads a sequence pack, traced by TLN_LoadSequencePack() */
+static TLN_SequencePack load_sequence_pack(const char *filename) {
+    XmlError error;
     ssize_t size;
-    uint8_t *data;
+    char *data;
+    Loader loader = {0};
 
     /* load file */
-    data = (uint8_t *)LoadFile(filename, &size);
+    data = (char *)LoadFile(filename, &size);
     if (!data) {
         if (size == 0) {
             TLN_SetLastError(TLN_ERR_FILE_NOT_FOUND);
@@ -190,26 +192,47 @@ TLN_SequencePack TLN_LoadSequencePack(const char *filename) {
     }
 
     /* parse */
-    parser = simpleXmlCreateParser((char *)data, (long)size);
-    if (parser != NULL) {
-        if (simpleXmlParse(parser, handler) != 0) {
-            printf("parse error on line %li:\n%s\n", simpleXmlGetLineNumber(parser),
-                   simpleXmlGetErrorDescription(parser));
-            simpleXmlDestroyParser(parser);
-            free(data);
-            TLN_SetLastError(TLN_ERR_WRONG_FORMAT);
-            return NULL;
-        }
-        TLN_SetLastError(TLN_ERR_OK);
-    } else {
-        TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
+    if (!XmlParse(data, (size_t)size, handler, &loader, &error)) {
+        printf("parse error on line %i:\n%s\n", error.line, error.description);
+        free(data);
+        TLN_SetLastError(TLN_ERR_WRONG_FORMAT);
+        return NULL;
     }
 
-    simpleXmlDestroyParser(parser);
+    TLN_SetLastError(TLN_ERR_OK);
     free(data);
     return loader.sp;
 }
 
+/*!
+ * \brief
+ * Loads a sqx file containing one or more sequences
+ *
+ * \param filename
+ * SQX filename with the sequences to load
+ *
+ * \returns
+ * Reference to the newly created TLN_SequencePack() or NULL if error
+ *
+ * \remarks
+ * A SQX file can contain many sequences. This function loads all of them
+ * inside a single TLN_SequencePack(). Individual sequences can be later
+ * queried with TLN_FindSequence(). Loading a file already loaded returns the
+ * same pack.
+ *
+ * \see
+ * TLN_FindSequence()
+ */
+TLN_SequencePack TLN_LoadSequencePack(const char *filename) {
+    const uint64_t trace = TraceBegin(TRACE_ALWAYS, 0);
+    TLN_SequencePack sp = (TLN_SequencePack)GetCachedAsset(OT_SEQPACK, filename);
+    if (sp == NULL) {
+        sp = (TLN_SequencePack)AddCachedAsset(OT_SEQPACK, filename, load_sequence_pack(filename));
+    }
+    TraceEndFile(trace, "LoadSequencePack", filename);
+    return sp;
+}
+
 static bool ishex(char dat) {
     if (dat >= '0' && dat <= '9') {
         return true;
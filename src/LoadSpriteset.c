@@ -12,8 +12,10 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "AssetCache.h"
 #include "LoadFile.h"
 #include "Tilengine.h"
+#include "Trace.h"
 #include "cJSON.h"
 
 /* loads txt format: name = x y w h */
@@ -21,25 +23,25 @@
 static TLN_SpriteData *load_txt_csv(const char *filename, int *num_entries) {
   TLN_SpriteData *data = NULL;
   char line[200];
-  FILE *pf = FileOpen(filename);
-  if (!pf)
+  Stream stream;
+  if (!OpenStream(filename, &stream))
     return NULL;
 
   /* count lines */
   *num_entries = 0;
-  while (fgets(line, sizeof(line), pf)) *num_entries += 1;
+  while (ReadStreamLine(&stream, line, sizeof(line))) *num_entries += 1;
 
   /* validate non-empty file */
   if (*num_entries == 0) {
-    FileClose(pf);
+    CloseStream(&stream);
     return NULL;
   }
 
-  fseek(pf, 0, SEEK_SET);
+  SeekStream(&stream, 0);
 
   data = (TLN_SpriteData *)calloc(*num_entries, sizeof(TLN_SpriteData));
   TLN_SpriteData *entry = data;
-  while (fgets(line, sizeof(line), pf)) {
+  while (ReadStreamLine(&stream, line, sizeof(line))) {
     char const *sep;
     char *p = NULL;
 
@@ -68,7 +70,7 @@ static TLN_SpriteData *load_txt_csv(const char *filename, int *num_entries) {
     }
     entry += 1;
   }
-  FileClose(pf);
+  CloseStream(&stream);
   return data;
 }
 
@@ -135,19 +137,8 @@ static TLN_SpriteData *load_json(const char *filename, int *num_entries) {
   return data;
 }
 
-/*!
- * \brief Loads a spriteset from an image png and its associated atlas
- * descriptor
- * \param name Base name of the files containing the spriteset, with or
- * without .png extension
- * \returns Reference to the newly loaded spriteset or NULL if error
- *
- * \remarks
- * The spriteset comes in a pair of files: an image file (bmp or png) and a
- * standarized atlas descriptor (json, csv or txt) The supported json format
- * is the array.
- */
-TLN_Spriteset TLN_LoadSpriteset(const char *name) {
+/* loads a spriteset, traced by TLN_LoadSpriteset() */
+static TLN_Spriteset load_spriteset(const char *name) {
   FileInfo fileinfo = {0};
   char filename[200] = {0};
   int entries = 0;
@@ -200,3 +191,24 @@ TLN_Spriteset TLN_LoadSpriteset(const char *name) {
   free(sprite_data);
   return spriteset;
 }
+
+/*!
+ * \brief Loads a spriteset from an image png and its associated atlas
+ * descriptor
+ * \param name Base name of the files containing the spriteset, with or
+ * without .png extension
+ * \returns Reference to the newly loaded spriteset or NULL if error
+ *
+ * \remarks
+ * The spriteset comes in a pair of files: an image file (bmp or png) and a
+ * standarized atlas descriptor (json, csv or txt) The supported json format
+ * is the array. Loading the same files again returns the same spriteset.
+ */
+TLN_Spriteset TLN_LoadSpriteset(const char *name) {
+  const uint64_t trace = TraceBegin(TRACE_ALWAYS, 0);
+  TLN_Spriteset spriteset = (TLN_Spriteset)GetCachedAsset(OT_SPRITESET, name);
+  if (spriteset == NULL)
+    spriteset = (TLN_Spriteset)AddCachedAsset(OT_SPRITESET, name, load_spriteset(name));
+  TraceEndFile(trace, "LoadSpriteset", name);
+  return spriteset;
+}
@@ -1,145 +1,405 @@
 #include "LoadTMX.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "LoadFile.h"
+#include "ObjectList.h"
 #include "Tileset.h"
-#include "simplexml.h"
+#include "XmlReader.h"
 
-static TMXInfo tmxinfo;
+/* load manager, passed to the parser as user data */
+typedef struct {
+  TMXDocument *doc;
+  struct Object object; /* current object */
+  bool priority;        /* current property is "priority" */
+} Loader;
 
-static void init_current_layer(TLN_LayerType type) {
-  TMXLayer *layer = &tmxinfo.layers[tmxinfo.num_layers];
+static void delete_layer_data(TMXLayerData *data) {
+  struct Object *object = data->objects;
+  while (object != NULL) {
+    struct Object *next = object->next;
+    free(object);
+    object = next;
+  }
+  free(data->chunks);
+  memset(data, 0, sizeof(TMXLayerData));
+}
+
+static void init_current_layer(TMXDocument *doc, TLN_LayerType type) {
+  TMXLayer *layer = &doc->info.layers[doc->info.num_layers];
   memset(layer, 0, sizeof(TMXLayer));
   layer->type = type;
   layer->visible = true;
   layer->parallaxx = layer->parallaxy = 1.0f;
+  delete_layer_data(&doc->layers[doc->info.num_layers]);
+}
+
+static int intvalue(const char *value) { return (int)strtol(value, NULL, 10); }
+
+static float floatvalue(const char *value) { return (float)strtod(value, NULL); }
+
+static void handle_map_attribute(TMXInfo *tmxinfo, XmlKey attribute,
+                                 const char *value) {
+  switch (attribute) {
+    case XML_WIDTH:
+      tmxinfo->width = intvalue(value);
+      break;
+    case XML_HEIGHT:
+      tmxinfo->height = intvalue(value);
+      break;
+    case XML_TILEWIDTH:
+      tmxinfo->tilewidth = intvalue(value);
+      break;
+    case XML_TILEHEIGHT:
+      tmxinfo->tileheight = intvalue(value);
+      break;
+    case XML_BACKGROUNDCOLOR:
+      tmxinfo->bgcolor = (uint32_t)strtoul(&value[1], NULL, 16);
+      tmxinfo->bgcolor += 0xFF000000;
+      break;
+    default:
+      break;
+  }
 }
 
-static void handle_map_attribute(const char *szAttribute, int intvalue,
-                                 const char *szValue) {
-  if (!strcasecmp(szAttribute, "width"))
-    tmxinfo.width = intvalue;
-  else if (!strcasecmp(szAttribute, "height"))
-    tmxinfo.height = intvalue;
-  else if (!strcasecmp(szAttribute, "tilewidth"))
-    tmxinfo.tilewidth = intvalue;
-  else if (!strcasecmp(szAttribute, "tileheight"))
-    tmxinfo.tileheight = intvalue;
-  else if (!strcasecmp(szAttribute, "backgroundcolor")) {
-    tmxinfo.bgcolor = (uint32_t)strtoul(&szValue[1], NULL, 16);
-    tmxinfo.bgcolor += 0xFF000000;
-  }
-}
-
-static void handle_tileset_attribute(const char *szAttribute, int intvalue,
-                                     const char *szValue) {
-  TMXTileset *tileset = &tmxinfo.tilesets[tmxinfo.num_tilesets];
-  if (!strcasecmp(szAttribute, "firstgid"))
-    tileset->firstgid = intvalue;
-  else if (!strcasecmp(szAttribute, "source"))
-    strncpy(tileset->source, szValue, sizeof(tileset->source) - 1);
+static void handle_tileset_attribute(TMXInfo *tmxinfo, XmlKey attribute,
+                                     const char *value) {
+  TMXTileset *tileset = &tmxinfo->tilesets[tmxinfo->num_tilesets];
+  if (attribute == XML_FIRSTGID)
+    tileset->firstgid = intvalue(value);
+  else if (attribute == XML_SOURCE)
+    strncpy(tileset->source, value, sizeof(tileset->source) - 1);
   tileset->source[sizeof(tileset->source) - 1] = '\0';
 }
 
-static void handle_layer_attribute(const char *szAttribute, int intvalue,
-                                   float floatvalue, const char *szValue) {
-  TMXLayer *layer = &tmxinfo.layers[tmxinfo.num_layers];
-  if (!strcasecmp(szAttribute, "name")) {
-    strncpy(layer->name, szValue, sizeof(layer->name) - 1);
-    layer->name[sizeof(layer->name) - 1] = '\0';
-  } else if (!strcasecmp(szAttribute, "id"))
-    layer->id = intvalue;
-  else if (!strcasecmp(szAttribute, "visible"))
-    layer->visible = (bool)intvalue;
-  else if (!strcasecmp(szAttribute, "width"))
-    layer->width = intvalue;
-  else if (!strcasecmp(szAttribute, "height"))
-    layer->height = intvalue;
-  else if (!strcasecmp(szAttribute, "parallaxx"))
-    layer->parallaxx = floatvalue;
-  else if (!strcasecmp(szAttribute, "parallaxy"))
-    layer->parallaxy = floatvalue;
-  else if (!strcasecmp(szAttribute, "offsetx"))
-    layer->offsetx = floatvalue;
-  else if (!strcasecmp(szAttribute, "offsety"))
-    layer->offsety = floatvalue;
-  else if (!strcasecmp(szAttribute, "opacity"))
-    layer->opacity = floatvalue;
-  else if (!strcasecmp(szAttribute, "tintcolor"))
-    layer->tintcolor = (uint32_t)strtoul(&szValue[1], NULL, 16);
-}
-
-static void handle_image_attribute(const char *szAttribute, int intvalue,
-                                   const char *szValue) {
-  TMXLayer *layer = &tmxinfo.layers[tmxinfo.num_layers];
-  if (!strcasecmp(szAttribute, "source")) {
-    strncpy(layer->image, szValue, sizeof(layer->image) - 1);
+static void handle_layer_attribute(TMXInfo *tmxinfo, XmlKey attribute,
+                                   const char *value) {
+  TMXLayer *layer = &tmxinfo->layers[tmxinfo->num_layers];
+  switch (attribute) {
+    case XML_NAME:
+      strncpy(layer->name, value, sizeof(layer->name) - 1);
+      layer->name[sizeof(layer->name) - 1] = '\0';
+      break;
+    case XML_ID:
+      layer->id = intvalue(value);
+      break;
+    case XML_VISIBLE:
+      layer->visible = (bool)intvalue(value);
+      break;
+    case XML_WIDTH:
+      layer->width = intvalue(value);
+      break;
+    case XML_HEIGHT:
+      layer->height = intvalue(value);
+      break;
+    case XML_PARALLAXX:
+      layer->parallaxx = floatvalue(value);
+      break;
+    case XML_PARALLAXY:
+      layer->parallaxy = floatvalue(value);
+      break;
+    case XML_OFFSETX:
+      layer->offsetx = floatvalue(value);
+      break;
+    case XML_OFFSETY:
+      layer->offsety = floatvalue(value);
+      break;
+    case XML_OPACITY:
+      layer->opacity = floatvalue(value);
+      break;
+    case XML_TINTCOLOR:
+      layer->tintcolor = (uint32_t)strtoul(&value[1], NULL, 16);
+      break;
+    default:
+      break;
+  }
+}
+
+static void handle_image_attribute(TMXInfo *tmxinfo, XmlKey attribute,
+                                   const char *value) {
+  TMXLayer *layer = &tmxinfo->layers[tmxinfo->num_layers];
+  if (attribute == XML_SOURCE) {
+    strncpy(layer->image, value, sizeof(layer->image) - 1);
     layer->image[sizeof(layer->image) - 1] = '\0';
-  } else if (!strcasecmp(szAttribute, "width"))
-    layer->width = intvalue;
-  else if (!strcasecmp(szAttribute, "height"))
-    layer->height = intvalue;
+  } else if (attribute == XML_WIDTH)
+    layer->width = intvalue(value);
+  else if (attribute == XML_HEIGHT)
+    layer->height = intvalue(value);
+}
+
+static void handle_data_attribute(TMXLayerData *data, XmlKey attribute,
+                                  const char *value) {
+  if (attribute == XML_ENCODING) {
+    if (!strcasecmp(value, "csv"))
+      data->encoding = ENCODING_CSV;
+    else if (!strcasecmp(value, "base64"))
+      data->encoding = ENCODING_BASE64;
+  } else if (attribute == XML_COMPRESSION) {
+    if (!strcasecmp(value, "gzip"))
+      data->compression = COMPRESSION_GZIP;
+    else if (!strcasecmp(value, "zlib"))
+      data->compression = COMPRESSION_ZLIB;
+  }
+}
+
+static void handle_object_attribute(struct Object *object, XmlKey attribute,
+                                    const char *value) {
+  switch (attribute) {
+    case XML_ID:
+      object->id = (uint16_t)intvalue(value);
+      break;
+    case XML_GID: {
+      Tile tile;
+      tile.value = strtoul(value, NULL, 0);
+      object->has_gid = true;
+      object->flags = tile.flags;
+      object->gid = tile.index;
+    } break;
+    case XML_X:
+      object->x = intvalue(value);
+      break;
+    case XML_Y:
+      object->y = intvalue(value);
+      break;
+    case XML_WIDTH:
+      object->width = intvalue(value);
+      break;
+    case XML_HEIGHT:
+      object->height = intvalue(value);
+      break;
+    case XML_TYPE:
+      object->type = (uint8_t)intvalue(value);
+      break;
+    case XML_VISIBLE:
+      object->visible = (bool)intvalue(value);
+      break;
+    case XML_NAME:
+      strncpy(object->name, value, sizeof(object->name) - 1);
+      object->name[sizeof(object->name) - 1] = '\0';
+      break;
+    default:
+      break;
+  }
+}
+
+static void handle_property_attribute(Loader *loader, XmlKey attribute,
+                                      const char *value) {
+  if (attribute == XML_NAME)
+    loader->priority = !strcasecmp(value, "priority");
+  else if (attribute == XML_VALUE && loader->priority &&
+           !strcasecmp(value, "true"))
+    loader->object.flags += FLAG_PRIORITY;
 }
 
-static bool is_layer_tag(const char *szName) {
-  return !strcasecmp(szName, "layer") || !strcasecmp(szName, "objectgroup") ||
-         !strcasecmp(szName, "imagelayer");
+/* appends the current object to the layer */
+static void add_object(Loader *loader) {
+  TMXLayerData *data = &loader->doc->layers[loader->doc->info.num_layers];
+  struct Object *object = (struct Object *)malloc(sizeof(struct Object));
+  if (object == NULL)
+    return;
+
+  if (loader->object.has_gid)
+    loader->object.y -= loader->object.height;
+  memcpy(object, &loader->object, sizeof(struct Object));
+  object->next = NULL;
+  if (data->objects == NULL)
+    data->objects = object;
+  else
+    data->last->next = object;
+  data->last = object;
 }
 
-static void handle_add_attribute(const char *szName, const char *szAttribute,
-                                 int intvalue, float floatvalue,
-                                 const char *szValue) {
-  if (!strcasecmp(szName, "map"))
-    handle_map_attribute(szAttribute, intvalue, szValue);
-  else if (!strcasecmp(szName, "tileset"))
-    handle_tileset_attribute(szAttribute, intvalue, szValue);
-  else if (is_layer_tag(szName))
-    handle_layer_attribute(szAttribute, intvalue, floatvalue, szValue);
-  else if (!strcasecmp(szName, "image"))
-    handle_image_attribute(szAttribute, intvalue, szValue);
+/* appends a chunk of tile data to the current layer */
+static TMXChunk *add_chunk(TMXDocument *doc) {
+  TMXLayerData *data = &doc->layers[doc->info.num_layers];
+  TMXChunk *chunks = (TMXChunk *)realloc(
+      data->chunks, (size_t)(data->num_chunks + 1) * sizeof(TMXChunk));
+  if (chunks == NULL)
+    return NULL;
+
+  data->chunks = chunks;
+  data->num_chunks += 1;
+  memset(&chunks[data->num_chunks - 1], 0, sizeof(TMXChunk));
+  return &chunks[data->num_chunks - 1];
 }
 
-static void handle_finish_tag(const char *szName) {
-  bool is_layer = is_layer_tag(szName);
-  if (!strcasecmp(szName, "tileset") &&
-      tmxinfo.num_tilesets < TMX_MAX_TILESET - 1)
-    tmxinfo.num_tilesets += 1;
-  else if (is_layer && tmxinfo.num_layers < TMX_MAX_LAYER - 1)
-    tmxinfo.num_layers += 1;
-  else if (!strcasecmp(szName, "object"))
-    tmxinfo.layers[tmxinfo.num_layers].num_objects += 1;
+static void handle_chunk_attribute(TMXLayerData *data, XmlKey attribute,
+                                   const char *value) {
+  if (data->num_chunks == 0)
+    return;
+  TMXChunk *chunk = &data->chunks[data->num_chunks - 1];
+  if (attribute == XML_X)
+    chunk->x = intvalue(value);
+  else if (attribute == XML_Y)
+    chunk->y = intvalue(value);
+  else if (attribute == XML_WIDTH)
+    chunk->width = intvalue(value);
+  else if (attribute == XML_HEIGHT)
+    chunk->height = intvalue(value);
+}
+
+/* keeps the encoded tile data of the current layer, decoded later. Data
+ * without chunks is a single chunk with the whole layer */
+static void handle_data_content(TMXDocument *doc, XmlKey tag,
+                                const char *value) {
+  TMXLayer const *layer = &doc->info.layers[doc->info.num_layers];
+  TMXLayerData *data = &doc->layers[doc->info.num_layers];
+  if (layer->type != LAYER_TILE)
+    return;
+
+  TMXChunk *chunk = NULL;
+  if (tag == XML_CHUNK && data->num_chunks > 0)
+    chunk = &data->chunks[data->num_chunks - 1];
+  else if (tag == XML_DATA) {
+    chunk = add_chunk(doc);
+    if (chunk != NULL) {
+      chunk->width = layer->width;
+      chunk->height = layer->height;
+    }
+  }
+  if (chunk != NULL)
+    chunk->content = value;
+}
+
+/* sizes the tile array to cover all the chunks, that may start at negative
+ * coordinates in infinite maps */
+static void handle_finish_data(TMXDocument *doc) {
+  TMXLayer *layer = &doc->info.layers[doc->info.num_layers];
+  TMXLayerData *data = &doc->layers[doc->info.num_layers];
+  if (layer->type != LAYER_TILE || data->num_chunks == 0)
+    return;
+
+  int x1 = data->chunks[0].x;
+  int y1 = data->chunks[0].y;
+  int x2 = x1 + data->chunks[0].width;
+  int y2 = y1 + data->chunks[0].height;
+  for (int c = 1; c < data->num_chunks; c += 1) {
+    TMXChunk const *chunk = &data->chunks[c];
+    if (chunk->x < x1)
+      x1 = chunk->x;
+    if (chunk->y < y1)
+      y1 = chunk->y;
+    if (chunk->x + chunk->width > x2)
+      x2 = chunk->x + chunk->width;
+    if (chunk->y + chunk->height > y2)
+      y2 = chunk->y + chunk->height;
+  }
+  for (int c = 0; c < data->num_chunks; c += 1) {
+    data->chunks[c].x -= x1;
+    data->chunks[c].y -= y1;
+  }
+  data->cols = x2 - x1;
+  data->rows = y2 - y1;
+  layer->width = data->cols;
+  layer->height = data->rows;
+}
+
+static bool is_layer_tag(XmlKey tag) {
+  return tag == XML_LAYER || tag == XML_OBJECTGROUP || tag == XML_IMAGELAYER;
+}
+
+static void handle_add_attribute(Loader *loader, XmlKey tag, XmlKey attribute,
+                                 const char *value) {
+  TMXInfo *tmxinfo = &loader->doc->info;
+  switch (tag) {
+    case XML_MAP:
+      handle_map_attribute(tmxinfo, attribute, value);
+      break;
+    case XML_TILESET:
+      handle_tileset_attribute(tmxinfo, attribute, value);
+      break;
+    case XML_LAYER:
+    case XML_OBJECTGROUP:
+    case XML_IMAGELAYER:
+      handle_layer_attribute(tmxinfo, attribute, value);
+      break;
+    case XML_IMAGE:
+      handle_image_attribute(tmxinfo, attribute, value);
+      break;
+    case XML_DATA:
+      handle_data_attribute(&loader->doc->layers[tmxinfo->num_layers],
+                            attribute, value);
+      break;
+    case XML_CHUNK:
+      handle_chunk_attribute(&loader->doc->layers[tmxinfo->num_layers],
+                             attribute, value);
+      break;
+    case XML_OBJECT:
+      handle_object_attribute(&loader->object, attribute, value);
+      break;
+    case XML_PROPERTY:
+      handle_property_attribute(loader, attribute, value);
+      break;
+    default:
+      break;
+  }
+}
+
+static void handle_start_tag(Loader *loader, XmlKey tag) {
+  TMXDocument *doc = loader->doc;
+  switch (tag) {
+    case XML_LAYER:
+      init_current_layer(doc, LAYER_TILE);
+      break;
+    case XML_OBJECTGROUP:
+      init_current_layer(doc, LAYER_OBJECT);
+      break;
+    case XML_IMAGELAYER:
+      init_current_layer(doc, LAYER_BITMAP);
+      break;
+    case XML_TILESET:
+      memset(&doc->info.tilesets[doc->info.num_tilesets], 0, sizeof(TMXTileset));
+      break;
+    case XML_OBJECT:
+      memset(&loader->object, 0, sizeof(struct Object));
+      loader->object.visible = true;
+      break;
+    case XML_CHUNK:
+      if (doc->info.layers[doc->info.num_layers].type == LAYER_TILE)
+        add_chunk(doc);
+      break;
+    default:
+      break;
+  }
+}
+
+static void handle_finish_tag(Loader *loader, XmlKey tag) {
+  TMXInfo *tmxinfo = &loader->doc->info;
+  if (tag == XML_TILESET && tmxinfo->num_tilesets < TMX_MAX_TILESET - 1)
+    tmxinfo->num_tilesets += 1;
+  else if (is_layer_tag(tag) && tmxinfo->num_layers < TMX_MAX_LAYER - 1)
+    tmxinfo->num_layers += 1;
+  else if (tag == XML_DATA)
+    handle_finish_data(loader->doc);
+  else if (tag == XML_OBJECT) {
+    tmxinfo->layers[tmxinfo->num_layers].num_objects += 1;
+    add_object(loader);
+  }
 }
 
 /* XML parser callback */
-static void *handler(SimpleXmlParser parser [[maybe_unused]],
-                     SimpleXmlEvent evt, const char *szName,
-                     const char *szAttribute, const char *szValue) {
-  switch (evt) {
-    case ADD_SUBTAG:
-      if (!strcasecmp(szName, "layer"))
-        init_current_layer(LAYER_TILE);
-      else if (!strcasecmp(szName, "objectgroup"))
-        init_current_layer(LAYER_OBJECT);
-      else if (!strcasecmp(szName, "imagelayer"))
-        init_current_layer(LAYER_BITMAP);
-      else if (!strcasecmp(szName, "tileset")) {
-        TMXTileset *tileset = &tmxinfo.tilesets[tmxinfo.num_tilesets];
-        memset(tileset, 0, sizeof(TMXTileset));
-      }
-      break;
-    case ADD_ATTRIBUTE:
-      handle_add_attribute(szName, szAttribute, (int)strtol(szValue, NULL, 10),
-                           (float)strtod(szValue, NULL), szValue);
-      break;
-    case FINISH_TAG:
-      handle_finish_tag(szName);
+static void handler(void *data, XmlEvent event, XmlKey tag, XmlKey attribute,
+                    const char *value) {
+  Loader *loader = (Loader *)data;
+  switch (event) {
+    case XML_START_TAG:
+      handle_start_tag(loader, tag);
+      break;
+    case XML_ATTRIBUTE:
+      handle_add_attribute(loader, tag, attribute, value);
+      break;
+    case XML_CONTENT:
+      if (tag == XML_DATA || tag == XML_CHUNK)
+        handle_data_content(loader->doc, tag, value);
+      break;
+    case XML_END_TAG:
+      handle_finish_tag(loader, tag);
       break;
     default:
       break;
   }
-  return &handler;
 }
 
 static int compare(void const *d1, void const *d2) {
@@ -148,21 +408,18 @@ static int compare(void const *d1, void const *d2) {
   return t1->firstgid > t2->firstgid;
 }
 
-/* loads common info about a .tmx file */
-bool TMXLoad(const char *filename, TMXInfo *info) {
-  SimpleXmlParser parser;
+/* loads a .tmx file with the contents of all its layers in a single parse.
+ * Delete with TMXDeleteDocument() */
+bool TMXLoadDocument(const char *filename, TMXDocument *doc) {
+  XmlError error;
   ssize_t size;
-  uint8_t *data;
+  char *data;
   bool retval = false;
 
-  /* already cached: return as is */
-  if (!strcasecmp(filename, tmxinfo.filename)) {
-    memcpy(info, &tmxinfo, sizeof(TMXInfo));
-    return true;
-  }
+  memset(doc, 0, sizeof(TMXDocument));
 
   /* load file */
-  data = (uint8_t *)LoadFile(filename, &size);
+  data = (char *)LoadFile(filename, &size);
   if (!data) {
     if (size == 0)
       TLN_SetLastError(TLN_ERR_FILE_NOT_FOUND);
@@ -172,39 +429,43 @@ bool TMXLoad(const char *filename, TMXInfo *info) {
   }
 
   /* parse */
-  memset(&tmxinfo, 0, sizeof(TMXInfo));
-  parser = simpleXmlCreateParser((char *)data, (long)size);
-  if (parser != NULL) {
-    if (simpleXmlParse(parser, handler) != 0) {
-      printf("parse error on line %li:\n%s\n", simpleXmlGetLineNumber(parser),
-             simpleXmlGetErrorDescription(parser));
-    } else {
-      strncpy(tmxinfo.filename, filename, sizeof(tmxinfo.filename) - 1);
-      tmxinfo.filename[sizeof(tmxinfo.filename) - 1] = '\0';
-      TLN_SetLastError(TLN_ERR_OK);
-      retval = true;
-    }
-  } else
-    TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
+  Loader loader = {.doc = doc};
+  TMXInfo *info = &doc->info;
+  doc->buffer = data;
+  if (!XmlParse(data, (size_t)size, handler, &loader, &error)) {
+    printf("parse error on line %i:\n%s\n", error.line, error.description);
+    TLN_SetLastError(TLN_ERR_WRONG_FORMAT);
+  } else {
+    strncpy(info->filename, filename, sizeof(info->filename) - 1);
+    info->filename[sizeof(info->filename) - 1] = '\0';
+    TLN_SetLastError(TLN_ERR_OK);
+    retval = true;
+  }
 
   /* sort tilesets by gid */
-  qsort(&tmxinfo.tilesets, tmxinfo.num_tilesets, sizeof(TMXTileset), compare);
+  qsort(&info->tilesets, info->num_tilesets, sizeof(TMXTileset), compare);
 
-  simpleXmlDestroyParser(parser);
-  free(data);
-  if (retval)
-    memcpy(info, &tmxinfo, sizeof(TMXInfo));
+  if (!retval)
+    TMXDeleteDocument(doc);
   return retval;
 }
 
+/* frees layer contents not taken by TMXCreateObjectList() */
+void TMXDeleteDocument(TMXDocument *doc) {
+  for (int c = 0; c < TMX_MAX_LAYER; c += 1)
+    delete_layer_data(&doc->layers[c]);
+  free(doc->buffer);
+  doc->buffer = NULL;
+}
+
 /* returns index of suitable tileset acoording to gid range, -1 if not valid
- * tileset found */
+ * tileset found. Gids count the tiles of deduplicated tilesets before merging */
 int TMXGetSuitableTileset(const TMXInfo *info, int gid, TLN_Tileset *tilesets) {
   for (int c = 0; c < info->num_tilesets; c += 1) {
     if (tilesets[c] == NULL)
       continue;
     const int first = info->tilesets[c].firstgid;
-    if (gid >= first && gid < first + tilesets[c]->numtiles)
+    if (gid >= first && gid < first + GetTilesetOriginalTiles(tilesets[c]))
       return c;
   }
   return -1;
@@ -226,4 +487,19 @@ TMXLayer *TMXGetLayer(TMXInfo *info, const char *name) {
       return &info->layers[c];
   }
   return NULL;
-}
\ No newline at end of file
+}
+
+/* composes the path of a tsx file, relative to its parent tmx */
+void TMXGetTilesetPath(TMXInfo const *info, int index, char *path,
+                       size_t size) {
+  FileInfo fi = {0};
+  TMXTileset const *tmxtileset = &info->tilesets[index];
+
+  SplitFilename(info->filename, &fi);
+  if (fi.path[0] != 0)
+    snprintf(path, size, "%s/%s", fi.path, tmxtileset->source);
+  else {
+    strncpy(path, tmxtileset->source, size - 1);
+    path[size - 1] = '\0';
+  }
+}
@@ -2,9 +2,12 @@
 #define LOAD_TMX_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include "Tilengine.h"
 
+struct Object;
+
 #define TMX_MAX_LAYER 32
 #define TMX_MAX_TILESET 32
 
@@ -45,9 +48,60 @@ typedef struct {
   TMXTileset tilesets[TMX_MAX_TILESET]; /* array of tilesets */
 } TMXInfo;
 
-bool TMXLoad(const char *filename, TMXInfo *info);
+/* encoding */
+typedef enum {
+  ENCODING_XML,
+  ENCODING_BASE64,
+  ENCODING_CSV,
+} encoding_t;
+
+/* compression */
+typedef enum {
+  COMPRESSION_NONE,
+  COMPRESSION_ZLIB,
+  COMPRESSION_GZIP,
+} compression_t;
+
+/* encoded tile data of a layer, or of a chunk of an infinite map */
+typedef struct {
+  int x;               /* column in the layer */
+  int y;               /* row in the layer */
+  int width;           /* width in tiles */
+  int height;          /* height in tiles */
+  char const *content; /* encoded tiles, inside the TMXDocument buffer */
+} TMXChunk;
+
+/* contents of a layer */
+typedef struct {
+  TMXChunk *chunks;          /* tile data of tile layers */
+  int num_chunks;            /* number of chunks, 1 unless infinite map */
+  encoding_t encoding;       /* encoding */
+  compression_t compression; /* compression */
+  int cols;                  /* layer width, covering all the chunks */
+  int rows;                  /* layer height, covering all the chunks */
+  struct Object *objects;    /* objects of object layers */
+  struct Object *last;       /* last object */
+} TMXLayerData;
+
+/* .tmx file parsed once with the contents of all its layers */
+typedef struct {
+  char *buffer; /* parsed file, holds the layer contents */
+  TMXInfo info;
+  TMXLayerData layers[TMX_MAX_LAYER]; /* same order as info.layers */
+} TMXDocument;
+
+bool TMXLoadDocument(const char *filename, TMXDocument *doc);
+void TMXDeleteDocument(TMXDocument *doc);
 int TMXGetSuitableTileset(const TMXInfo *info, int gid, TLN_Tileset *tilesets);
 TMXLayer *TMXGetFirstLayer(TMXInfo *info, TLN_LayerType type);
 TMXLayer *TMXGetLayer(TMXInfo *info, const char *name);
+void TMXGetTilesetPath(TMXInfo const *info, int index, char *path, size_t size);
+
+/* layer builders, in LoadTilemap.c and ObjectList.c */
+TLN_Tilemap TMXDecodeTiles(TMXLayerData const *data);
+TLN_Tilemap TMXCreateTilemap(TMXInfo const *info, TMXLayer const *layer,
+                             TLN_Tilemap tilemap, TLN_Tileset *tilesets);
+TLN_ObjectList TMXCreateObjectList(TMXInfo const *info, TMXLayer const *layer,
+                                   TMXLayerData *data, TLN_Tileset *tilesets);
 
 #endif
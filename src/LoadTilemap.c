@@ -8,147 +8,244 @@
  * file, You can obtain one at http://mozilla.org/MPL/2.0/.
  * */
 
-#include <assert.h>
-#include <stdio.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "AssetCache.h"
 #include "Base64.h"
-#include "LoadFile.h"
 #include "LoadTMX.h"
 #include "Tilemap.h"
 #include "Tilengine.h"
-#include "simplexml.h"
+#include "Trace.h"
 #include "zlib.h"
 
-static int csvdecode(char *in, uint32_t numtiles, uint32_t *data);
-static int decompress(uint8_t *in, int in_size, uint8_t *out, int out_size);
-static void handle_add_attribute(const char *szName, const char *szAttribute,
-                                 const char *szValue);
-static void handle_add_content(const char *szName, const char *szValue);
+#define DECODE_BUFFER 4096 /* base64 decoded per inflate() call */
+
 static void correct_tile_firstgid(Tile *tile, TMXInfo const *info,
                                   TLN_Tileset *tilesets);
+static void remap_tile(Tile *tile, TLN_Tileset *tilesets);
+
+/* writes decoded bytes straight into the rectangle of a chunk in the final
+ * tile array */
+typedef struct {
+  uint8_t *row; /* current row */
+  size_t pos;   /* bytes already written in current row */
+  size_t width; /* bytes per row */
+  size_t pitch; /* bytes between rows */
+  int rows;     /* rows left, including current */
+} TileWriter;
+
+static bool writer_init(TileWriter *writer, TLN_Tilemap tilemap,
+                        TMXChunk const *chunk) {
+  if (chunk->x < 0 || chunk->y < 0 || chunk->width <= 0 ||
+      chunk->height <= 0 || chunk->x + chunk->width > tilemap->cols ||
+      chunk->y + chunk->height > tilemap->rows)
+    return false;
+
+  writer->row = (uint8_t *)&tilemap->tiles[(ptrdiff_t)chunk->y * tilemap->cols + chunk->x];
+  writer->pos = 0;
+  writer->width = (size_t)chunk->width * sizeof(Tile);
+  writer->pitch = (size_t)tilemap->cols * sizeof(Tile);
+  writer->rows = chunk->height;
+  return true;
+}
 
-/* encoding */
-typedef enum {
-  ENCODING_XML,
-  ENCODING_BASE64,
-  ENCODING_CSV,
-} encoding_t;
-
-/* compression */
-typedef enum {
-  COMPRESSION_NONE,
-  COMPRESSION_ZLIB,
-  COMPRESSION_GZIP,
-} compression_t;
-
-/* load manager */
-static struct {
-  TMXLayer *layer; /* target layer */
-  bool state;
-  encoding_t encoding;       /* encoding */
-  compression_t compression; /* compression */
-  uint32_t *data;            /* map data (rows*cols) */
-  uint32_t numtiles;
-} loader;
+/* room left in the current row, 0 when the chunk is complete */
+static size_t writer_space(TileWriter const *writer, uint8_t **out) {
+  if (writer->rows == 0)
+    return 0;
+  *out = writer->row + writer->pos;
+  return writer->width - writer->pos;
+}
 
-static void handle_data_encoding(const char *szValue) {
-  if (!strcasecmp(szValue, "csv"))
-    loader.encoding = ENCODING_CSV;
-  else if (!strcasecmp(szValue, "base64"))
-    loader.encoding = ENCODING_BASE64;
-  else
-    loader.state = false;
+static void writer_advance(TileWriter *writer, size_t size) {
+  writer->pos += size;
+  if (writer->pos == writer->width) {
+    writer->row += writer->pitch;
+    writer->pos = 0;
+    writer->rows -= 1;
+  }
 }
 
-static void handle_data_compression(const char *szValue) {
-  if (!strcasecmp(szValue, "gzip"))
-    loader.state = false;
-  else if (!strcasecmp(szValue, "zlib"))
-    loader.compression = COMPRESSION_ZLIB;
+static void writer_write(TileWriter *writer, uint8_t const *data, size_t size) {
+  uint8_t *out;
+  size_t space;
+  while (size > 0 && (space = writer_space(writer, &out)) > 0) {
+    const size_t count = size < space ? size : space;
+    memcpy(out, data, count);
+    writer_advance(writer, count);
+    data += count;
+    size -= count;
+  }
 }
 
-static void handle_add_attribute(const char *szName, const char *szAttribute,
-                                 const char *szValue) {
-  if (!strcasecmp(szName, "layer") && !strcasecmp(szAttribute, "name")) {
-    loader.state = !strcasecmp(szValue, loader.layer->name);
-  } else if (!strcasecmp(szName, "data") && loader.state) {
-    if (!strcasecmp(szAttribute, "encoding"))
-      handle_data_encoding(szValue);
-    else if (!strcasecmp(szAttribute, "compression"))
-      handle_data_compression(szValue);
+/* parses comma separated gids without tokenizing a copy of the content */
+static bool decode_csv(char const *content, TileWriter *writer) {
+  uint32_t value = 0;
+  bool digits = false;
+  for (char const *c = content; writer->rows > 0; c += 1) {
+    if (*c >= '0' && *c <= '9') {
+      value = value * 10 + (uint32_t)(*c - '0');
+      digits = true;
+    } else {
+      if (digits) {
+        writer_write(writer, (uint8_t const *)&value, sizeof(value));
+        value = 0;
+        digits = false;
+      }
+      if (*c == 0)
+        break;
+    }
   }
+  return true;
 }
 
-static void decode_base64_content(const char *szValue, uint32_t *data,
-                                  int size) {
-  if (loader.compression == COMPRESSION_NONE) {
-    base64decode((const uint8_t *)szValue, (int)strlen(szValue),
-                 (uint8_t *)data, &size);
-  } else {
-    uint8_t *deflated = (uint8_t *)malloc(size);
-    int in_size = size;
-    base64decode((const uint8_t *)szValue, (int)strlen(szValue), deflated,
-                 &in_size);
-    decompress(deflated, in_size, (uint8_t *)data, size);
-    free(deflated);
+/* decodes base64 in small blocks, that are inflated straight into the tiles
+ * when compressed */
+static bool decode_base64(char const *content, compression_t compression,
+                          TileWriter *writer) {
+  uint8_t buffer[DECODE_BUFFER];
+  Base64Stream stream;
+  int size;
+
+  base64open(&stream, (const unsigned char *)content, (int)strlen(content));
+  if (compression == COMPRESSION_NONE) {
+    while ((size = base64read(&stream, buffer, sizeof(buffer))) > 0)
+      writer_write(writer, buffer, (size_t)size);
+    return size == 0;
   }
+
+  z_stream strm = {0};
+  const int window_bits = compression == COMPRESSION_GZIP ? 16 + MAX_WBITS : MAX_WBITS;
+  if (inflateInit2(&strm, window_bits) != Z_OK)
+    return false;
+
+  int ret = Z_OK;
+  uint8_t *out;
+  size_t space;
+  while (ret != Z_STREAM_END && (space = writer_space(writer, &out)) > 0) {
+    if (strm.avail_in == 0) {
+      size = base64read(&stream, buffer, sizeof(buffer));
+      if (size <= 0) {
+        ret = size == 0 ? Z_STREAM_END : Z_DATA_ERROR;
+        break;
+      }
+      strm.next_in = buffer;
+      strm.avail_in = (uInt)size;
+    }
+
+    strm.next_out = out;
+    strm.avail_out = (uInt)space;
+    ret = inflate(&strm, Z_NO_FLUSH);
+    if (ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR)
+      break;
+    writer_advance(writer, space - strm.avail_out);
+  }
+  inflateEnd(&strm);
+  return ret == Z_OK || ret == Z_STREAM_END || ret == Z_BUF_ERROR;
 }
 
-static void handle_add_content(const char *szName, const char *szValue) {
-  if (strcasecmp(szName, "data") != 0 || !loader.state)
-    return;
+/* decodes the tile data of a tile layer straight into a new tilemap with raw
+ * gids, or returns NULL if it has none or uses an unsupported format. Safe to
+ * call from several threads */
+TLN_Tilemap TMXDecodeTiles(TMXLayerData const *data) {
+  if (data->num_chunks == 0 || data->encoding == ENCODING_XML)
+    return NULL;
 
-  int size = (int)(loader.numtiles * sizeof(uint32_t));
-  uint32_t *map_data = (uint32_t *)malloc(size);
-  if (map_data == NULL)
-    return;
+  TLN_Tilemap tilemap = TLN_CreateTilemap(data->rows, data->cols, NULL, 0, NULL);
+  if (tilemap == NULL)
+    return NULL;
 
-  memset(map_data, 0, size);
-  if (loader.encoding == ENCODING_CSV) {
-    char *mutable_value = strdup(szValue);
-    if (mutable_value) {
-      csvdecode(mutable_value, loader.numtiles, map_data);
-      free(mutable_value);
-    }
-  } else if (loader.encoding == ENCODING_BASE64)
-    decode_base64_content(szValue, map_data, size);
-  loader.data = map_data;
+  bool ok = true;
+  for (int c = 0; c < data->num_chunks && ok; c += 1) {
+    TMXChunk const *chunk = &data->chunks[c];
+    TileWriter writer;
+    if (chunk->content == NULL || !writer_init(&writer, tilemap, chunk))
+      continue;
+    if (data->encoding == ENCODING_CSV)
+      ok = decode_csv(chunk->content, &writer);
+    else
+      ok = decode_base64(chunk->content, data->compression, &writer);
+  }
+
+  if (!ok) {
+    TLN_DeleteTilemap(tilemap);
+    return NULL;
+  }
+  return tilemap;
 }
 
-/* XML parser callback */
-static void *handler(SimpleXmlParser parser [[maybe_unused]],
-                     SimpleXmlEvent evt, const char *szName,
-                     const char *szAttribute, const char *szValue) {
-  switch (evt) {
-    case ADD_ATTRIBUTE:
-      handle_add_attribute(szName, szAttribute, szValue);
-      break;
-    case ADD_CONTENT:
-      handle_add_content(szName, szValue);
-      break;
-    default:
-      break;
+/* turns the raw gids of a tilemap decoded by TMXDecodeTiles() into tiles,
+ * referencing all the tilesets of the map. The tilemap takes its own reference
+ * to each tileset, released by TLN_DeleteTilemap() */
+TLN_Tilemap TMXCreateTilemap(TMXInfo const *info, TMXLayer const *layer,
+                             TLN_Tilemap tilemap, TLN_Tileset *tilesets) {
+  /* correct with firstgid */
+  const int numtiles = tilemap->rows * tilemap->cols;
+  Tile *tile = tilemap->tiles;
+  for (int c = 0; c < numtiles; c += 1, tile += 1) {
+    if (tile->index > 0)
+      correct_tile_firstgid(tile, info, tilesets);
+    if (tile->index > 0)
+      remap_tile(tile, tilesets);
   }
-  return &handler;
+  UpdateTilemapOccupancy(tilemap, 0, numtiles);
+
+  tilemap->id = layer->id;
+  tilemap->visible = layer->visible;
+  tilemap->bgcolor = (int)info->bgcolor;
+  tilemap->num_tilesets =
+      info->num_tilesets < MAX_TILESETS ? info->num_tilesets : MAX_TILESETS;
+  memcpy((void *)tilemap->tilesets, (const void *)tilesets,
+         sizeof(TLN_Tileset) * tilemap->num_tilesets);
+  for (int c = 0; c < tilemap->num_tilesets; c += 1)
+    RetainAsset(tilesets[c]);
+  return tilemap;
 }
 
-static TLN_Tileset load_tileset(TMXInfo const *info, const char *filename,
-                                int index) {
-  FileInfo fi = {0};
-  char tsxpath[200];
+/* loads a tilemap, traced by TLN_LoadTilemap() */
+static TLN_Tilemap load_tilemap(const char *filename, const char *layername) {
+  TMXDocument doc;
+  TLN_Tilemap tilemap = NULL;
 
-  /* composite tsx filename with relative path of parent tmx */
-  TMXTileset const *tmxtileset = &info->tilesets[index];
-  SplitFilename(filename, &fi);
-  if (fi.path[0] != 0)
-    snprintf(tsxpath, sizeof(tsxpath), "%s/%s", fi.path, tmxtileset->source);
-  else {
-    strncpy(tsxpath, tmxtileset->source, sizeof(tsxpath) - 1);
-    tsxpath[sizeof(tsxpath) - 1] = '\0';
+  /* load map */
+  if (!TMXLoadDocument(filename, &doc)) {
+    TLN_SetLastError(TLN_ERR_FILE_NOT_FOUND);
+    return NULL;
+  }
+
+  /* get target layer */
+  TMXLayer *layer;
+  if (layername)
+    layer = TMXGetLayer(&doc.info, layername);
+  else
+    layer = TMXGetFirstLayer(&doc.info, LAYER_TILE);
+  if (layer == NULL || layer->type != LAYER_TILE) {
+    TMXDeleteDocument(&doc);
+    TLN_SetLastError(TLN_ERR_FILE_NOT_FOUND);
+    return NULL;
   }
-  return TLN_LoadTileset(tsxpath);
+
+  tilemap = TMXDecodeTiles(&doc.layers[layer - doc.info.layers]);
+  if (tilemap != NULL) {
+    /* load referenced tilesets */
+    TLN_Tileset tilesets[TMX_MAX_TILESET] = {0};
+    for (int c = 0; c < doc.info.num_tilesets; c += 1) {
+      char tsxpath[200];
+      TMXGetTilesetPath(&doc.info, c, tsxpath, sizeof(tsxpath));
+      tilesets[c] = TLN_LoadTileset(tsxpath);
+    }
+    TMXCreateTilemap(&doc.info, layer, tilemap, tilesets);
+    for (int c = 0; c < doc.info.num_tilesets; c += 1) {
+      if (tilesets[c] != NULL)
+        TLN_DeleteTileset(tilesets[c]);
+    }
+  } else
+    TLN_SetLastError(TLN_ERR_WRONG_FORMAT);
+
+  TMXDeleteDocument(&doc);
+  return tilemap;
 }
 
 /*!
@@ -172,70 +269,9 @@ static TLN_Tileset load_tileset(TMXInfo const *info, const char *filename,
  * associated to the tilemap
  */
 TLN_Tilemap TLN_LoadTilemap(const char *filename, const char *layername) {
-  SimpleXmlParser parser;
-  ssize_t size;
-  uint8_t *xml_data;
-  TLN_Tilemap tilemap = NULL;
-  TMXInfo tmxinfo = {0};
-
-  /* load map info */
-  if (!TMXLoad(filename, &tmxinfo)) {
-    TLN_SetLastError(TLN_ERR_FILE_NOT_FOUND);
-    return NULL;
-  }
-
-  /* get target layer */
-  memset(&loader, 0, sizeof(loader));
-  if (layername)
-    loader.layer = TMXGetLayer(&tmxinfo, layername);
-  else
-    loader.layer = TMXGetFirstLayer(&tmxinfo, LAYER_TILE);
-  if (loader.layer == NULL) {
-    TLN_SetLastError(TLN_ERR_FILE_NOT_FOUND);
-    return NULL;
-  }
-
-  /* parse */
-  loader.numtiles = loader.layer->width * loader.layer->height;
-  xml_data = (uint8_t *)LoadFile(filename, &size);
-  parser = simpleXmlCreateParser((char *)xml_data, (long)size);
-  if (parser != NULL) {
-    if (simpleXmlParse(parser, handler) != 0) {
-      printf("parse error on line %li:\n%s\n", simpleXmlGetLineNumber(parser),
-             simpleXmlGetErrorDescription(parser));
-    } else
-      TLN_SetLastError(TLN_ERR_OK);
-  } else
-    TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
-
-  simpleXmlDestroyParser(parser);
-  free(xml_data);
-
-  /* load referenced tilesets */
-  TLN_Tileset tilesets[TMX_MAX_TILESET] = {0};
-  for (int c = 0; c < tmxinfo.num_tilesets; c += 1)
-    tilesets[c] = load_tileset(&tmxinfo, filename, c);
-
-  if (loader.data != NULL) {
-    /* correct with firstgid */
-    Tile *tile = (Tile *)loader.data;
-    for (uint32_t c = 0; c < loader.numtiles; c += 1, tile += 1) {
-      if (tile->index > 0)
-        correct_tile_firstgid(tile, &tmxinfo, tilesets);
-    }
-
-    /* create */
-    tilemap = TLN_CreateTilemap(loader.layer->height, loader.layer->width,
-                                (Tile *)loader.data, tmxinfo.bgcolor, NULL);
-    tilemap->id = loader.layer->id;
-    tilemap->visible = loader.layer->visible;
-    tilemap->num_tilesets = tmxinfo.num_tilesets < MAX_TILESETS
-                                ? tmxinfo.num_tilesets
-                                : MAX_TILESETS;
-    memcpy((void *)tilemap->tilesets, (const void *)tilesets,
-           sizeof(TLN_Tileset) * tilemap->num_tilesets);
-  }
-
+  const uint64_t trace = TraceBegin(TRACE_ALWAYS, 0);
+  TLN_Tilemap tilemap = load_tilemap(filename, layername);
+  TraceEndFile(trace, "LoadTilemap", filename);
   return tilemap;
 }
 
@@ -250,65 +286,9 @@ static void correct_tile_firstgid(Tile *tile, TMXInfo const *info,
     tile->index = 0;
 }
 
-/* read CSV string */
-static int csvdecode(char *in, uint32_t numtiles, uint32_t *data) {
-  uint32_t c;
-  char *saveptr;
-  char const *token = strtok_r(in, ",\n", &saveptr);
-
-  c = 0;
-  do {
-    if (token && token[0] != 0x0D)
-      data[c++] = (uint32_t)strtoul(token, NULL, 10);
-    token = strtok_r(NULL, ",\n", &saveptr);
-  } while (c < numtiles && token != NULL);
-
-  return 1;
-}
-
-/* decompress a zipped string */
-static int decompress(uint8_t *in, int in_size, uint8_t *out, int out_size) {
-  int ret;
-  z_stream strm;
-
-  /* allocate inflate state */
-  strm.zalloc = Z_NULL;
-  strm.zfree = Z_NULL;
-  strm.opaque = Z_NULL;
-  strm.avail_in = 0;
-  strm.next_in = Z_NULL;
-  ret = inflateInit(&strm);
-  if (ret != Z_OK)
-    return ret;
-
-  /* decompress until deflate stream ends or end of file */
-  do {
-    strm.avail_in = in_size;
-    strm.next_in = in;
-
-    /* run inflate() on input until output buffer not full */
-    do {
-      strm.avail_out = out_size;
-      strm.next_out = out;
-      ret = inflate(&strm, Z_NO_FLUSH);
-      assert(ret != Z_STREAM_ERROR); /* state not clobbered */
-      switch (ret) {
-        case Z_NEED_DICT:
-          ret = Z_DATA_ERROR;
-          [[fallthrough]];
-        case Z_DATA_ERROR:
-        case Z_MEM_ERROR:
-          inflateEnd(&strm);
-          return ret;
-        default:
-          break;
-      }
-    } while (strm.avail_out == 0);
-
-    /* done when inflate() says it's done */
-  } while (ret != Z_STREAM_END);
-
-  /* clean up and return */
-  inflateEnd(&strm);
-  return ret == Z_STREAM_END ? Z_OK : Z_DATA_ERROR;
+/* applies the merged tiles of a deduplicated tileset, see LoadTileset.c */
+static void remap_tile(Tile *tile, TLN_Tileset *tilesets) {
+  TLN_Tileset tileset = tilesets[tile->tileset];
+  if (tileset != NULL)
+    RemapTilesetTile(tileset, &tile->index, &tile->flags);
 }
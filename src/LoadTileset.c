@@ -12,10 +12,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "AssetCache.h"
+#include "LoadBitmap.h"
 #include "LoadFile.h"
 #include "Tilengine.h"
 #include "Tileset.h"
-#include "simplexml.h"
+#include "Trace.h"
+#include "XmlReader.h"
 
 /* properties */
 typedef enum {
@@ -31,8 +34,8 @@ typedef enum {
   CONTEXT_TILE,
 } ImageContext;
 
-/* load manager */
-static struct {
+/* load manager, passed to the parser as user data */
+typedef struct {
   char source[64];
   int tilecount;
   int tilewidth;
@@ -55,200 +58,317 @@ static struct {
     bool priority;     /* value of priority property */
     TLN_Bitmap bitmap; /* bitmap of image-based tile */
   } tile;
-} loader;
-
-static void handle_subtag(const char *szName) {
-  if (!strcasecmp(szName, "animation"))
-    loader.frame_count = 0;
-  else if (!strcasecmp(szName, "tileset"))
-    loader.context = CONTEXT_TILESET;
-  else if (!strcasecmp(szName, "tile"))
-    loader.context = CONTEXT_TILE;
+} Loader;
+
+static int intvalue(const char *value) { return (int)strtol(value, NULL, 10); }
+
+static void handle_subtag(Loader *loader, XmlKey tag) {
+  if (tag == XML_ANIMATION)
+    loader->frame_count = 0;
+  else if (tag == XML_TILESET)
+    loader->context = CONTEXT_TILESET;
+  else if (tag == XML_TILE)
+    loader->context = CONTEXT_TILE;
 }
 
-static void handle_tileset_attribute(const char *szAttribute, const char *szValue) {
-  if (!strcasecmp(szAttribute, "tilewidth"))
-    loader.tilewidth = (int)strtol(szValue, NULL, 10);
-  else if (!strcasecmp(szAttribute, "tileheight"))
-    loader.tileheight = (int)strtol(szValue, NULL, 10);
-  else if (!strcasecmp(szAttribute, "margin"))
-    loader.margin = (int)strtol(szValue, NULL, 10);
-  else if (!strcasecmp(szAttribute, "spacing"))
-    loader.spacing = (int)strtol(szValue, NULL, 10);
-  else if (!strcasecmp(szAttribute, "tilecount"))
-    loader.tilecount = (int)strtol(szValue, NULL, 10);
+static void handle_tileset_attribute(Loader *loader, XmlKey attribute,
+                                     const char *value) {
+  switch (attribute) {
+    case XML_TILEWIDTH:
+      loader->tilewidth = intvalue(value);
+      break;
+    case XML_TILEHEIGHT:
+      loader->tileheight = intvalue(value);
+      break;
+    case XML_MARGIN:
+      loader->margin = intvalue(value);
+      break;
+    case XML_SPACING:
+      loader->spacing = intvalue(value);
+      break;
+    case XML_TILECOUNT:
+      loader->tilecount = intvalue(value);
+      break;
+    default:
+      break;
+  }
 }
 
-static void handle_image_attribute(const char *szAttribute, const char *szValue) {
-  if (strcasecmp(szAttribute, "source") != 0)
+static void handle_image_attribute(Loader *loader, XmlKey attribute, const char *value) {
+  if (attribute != XML_SOURCE)
     return;
-  strncpy(loader.source, szValue, sizeof(loader.source));
-  loader.source[sizeof(loader.source) - 1] = '\0';
-  if (loader.context == CONTEXT_TILE) {
-    loader.tile.bitmap = TLN_LoadBitmap(loader.source);
-    loader.source[0] = 0;
+  strncpy(loader->source, value, sizeof(loader->source));
+  loader->source[sizeof(loader->source) - 1] = '\0';
+  if (loader->context == CONTEXT_TILE) {
+    loader->tile.bitmap = TLN_LoadBitmap(loader->source);
+    loader->source[0] = 0;
   }
 }
 
-static void handle_property_name(const char *szValue) {
-  if (!strcasecmp(szValue, "type"))
-    loader.tile.property = PROPERTY_TYPE;
-  else if (!strcasecmp(szValue, "priority"))
-    loader.tile.property = PROPERTY_PRIORITY;
+static void handle_property_name(Loader *loader, const char *value) {
+  if (!strcasecmp(value, "type"))
+    loader->tile.property = PROPERTY_TYPE;
+  else if (!strcasecmp(value, "priority"))
+    loader->tile.property = PROPERTY_PRIORITY;
   else
-    loader.tile.property = PROPERTY_NONE;
+    loader->tile.property = PROPERTY_NONE;
 }
 
-static void handle_property_value(const char *szValue) {
-  if (loader.tilecount == 0)
+static void handle_property_value(Loader *loader, const char *value) {
+  if (loader->tilecount == 0)
     return;
-  if (loader.tile.property == PROPERTY_TYPE)
-    loader.attributes[loader.tile.id].type = (uint8_t)strtol(szValue, NULL, 10);
-  else if (loader.tile.property == PROPERTY_PRIORITY)
-    loader.attributes[loader.tile.id].priority = !strcasecmp(szValue, "true");
+  if (loader->tile.property == PROPERTY_TYPE)
+    loader->attributes[loader->tile.id].type = (uint8_t)intvalue(value);
+  else if (loader->tile.property == PROPERTY_PRIORITY)
+    loader->attributes[loader->tile.id].priority = !strcasecmp(value, "true");
 }
 
-static void handle_property_attribute(const char *szAttribute, const char *szValue) {
-  if (!strcasecmp(szAttribute, "name"))
-    handle_property_name(szValue);
-  else if (!strcasecmp(szAttribute, "value"))
-    handle_property_value(szValue);
+static void handle_property_attribute(Loader *loader, XmlKey attribute,
+                                      const char *value) {
+  if (attribute == XML_NAME)
+    handle_property_name(loader, value);
+  else if (attribute == XML_VALUE)
+    handle_property_value(loader, value);
 }
 
-static void handle_add_attribute(const char *szName, const char *szAttribute, const char *szValue) {
-  if (!strcasecmp(szName, "tileset"))
-    handle_tileset_attribute(szAttribute, szValue);
-  else if (!strcasecmp(szName, "image"))
-    handle_image_attribute(szAttribute, szValue);
-  else if (!strcasecmp(szName, "tile")) {
-    if (!strcasecmp(szAttribute, "id"))
-      loader.tile.id = (int)strtol(szValue, NULL, 10);
-    else if (!strcasecmp(szAttribute, "type"))
-      loader.tile.type = (int)strtol(szValue, NULL, 10);
-  } else if (!strcasecmp(szName, "property"))
-    handle_property_attribute(szAttribute, szValue);
-  else if (!strcasecmp(szName, "frame")) {
-    if (!strcasecmp(szAttribute, "tileid"))
-      loader.frames[loader.frame_count].index = (int)strtol(szValue, NULL, 10) + 1;
-    else if (!strcasecmp(szAttribute, "duration"))
-      loader.frames[loader.frame_count].delay = (int)strtol(szValue, NULL, 10);
+static void handle_add_attribute(Loader *loader, XmlKey tag, XmlKey attribute,
+                                 const char *value) {
+  switch (tag) {
+    case XML_TILESET:
+      handle_tileset_attribute(loader, attribute, value);
+      break;
+    case XML_IMAGE:
+      handle_image_attribute(loader, attribute, value);
+      break;
+    case XML_TILE:
+      if (attribute == XML_ID)
+        loader->tile.id = intvalue(value);
+      else if (attribute == XML_TYPE)
+        loader->tile.type = intvalue(value);
+      break;
+    case XML_PROPERTY:
+      handle_property_attribute(loader, attribute, value);
+      break;
+    case XML_FRAME:
+      if (attribute == XML_TILEID)
+        loader->frames[loader->frame_count].index = intvalue(value) + 1;
+      else if (attribute == XML_DURATION)
+        loader->frames[loader->frame_count].delay = intvalue(value);
+      break;
+    default:
+      break;
   }
 }
 
-static void handle_finish_attributes(const char *szName) {
-  if (strcasecmp(szName, "tileset") != 0 || loader.tilecount == 0)
+static void handle_finish_attributes(Loader *loader, XmlKey tag) {
+  if (tag != XML_TILESET || loader->tilecount == 0)
     return;
-  loader.attributes = (TLN_TileAttributes *)calloc(loader.tilecount, sizeof(TLN_TileAttributes));
-  loader.images = (TLN_TileImage *)calloc(loader.tilecount, sizeof(TLN_TileImage));
-  loader.image = loader.images;
+  loader->attributes =
+      (TLN_TileAttributes *)calloc(loader->tilecount, sizeof(TLN_TileAttributes));
+  loader->images = (TLN_TileImage *)calloc(loader->tilecount, sizeof(TLN_TileImage));
+  loader->image = loader->images;
 }
 
-static void handle_finish_tile(void) {
-  if (loader.tilecount == 0)
+static void handle_finish_tile(Loader *loader) {
+  if (loader->tilecount == 0)
     return;
-  if (loader.context == CONTEXT_TILESET) {
-    TLN_TileAttributes *attribute = &loader.attributes[loader.tile.id];
-    attribute->priority = loader.tile.priority;
-    attribute->type = (uint8_t)loader.tile.type;
-  } else if (loader.context == CONTEXT_TILE) {
-    loader.image->bitmap = loader.tile.bitmap;
-    loader.image->id = (uint16_t)loader.tile.id;
-    loader.image->type = (uint8_t)loader.tile.type;
-    loader.image += 1;
+  if (loader->context == CONTEXT_TILESET) {
+    TLN_TileAttributes *attribute = &loader->attributes[loader->tile.id];
+    attribute->priority = loader->tile.priority;
+    attribute->type = (uint8_t)loader->tile.type;
+  } else if (loader->context == CONTEXT_TILE) {
+    loader->image->bitmap = loader->tile.bitmap;
+    loader->image->id = (uint16_t)loader->tile.id;
+    loader->image->type = (uint8_t)loader->tile.type;
+    loader->image += 1;
   }
 }
 
-static void handle_finish_animation(void) {
+static void handle_finish_animation(Loader *loader) {
   char seq_name[16];
-  snprintf(seq_name, sizeof(seq_name), "%d", loader.tile.id);
+  snprintf(seq_name, sizeof(seq_name), "%d", loader->tile.id);
   TLN_Sequence sequence =
-      TLN_CreateSequence(seq_name, loader.tile.id + 1, loader.frame_count, loader.frames);
-  if (loader.sp == NULL)
-    loader.sp = TLN_CreateSequencePack();
-  TLN_AddSequenceToPack(loader.sp, sequence);
+      TLN_CreateSequence(seq_name, loader->tile.id + 1, loader->frame_count, loader->frames);
+  if (loader->sp == NULL)
+    loader->sp = TLN_CreateSequencePack();
+  TLN_AddSequenceToPack(loader->sp, sequence);
 }
 
-static void handle_finish_tag(const char *szName) {
-  if (!strcasecmp(szName, "frame"))
-    loader.frame_count++;
-  else if (!strcasecmp(szName, "tile"))
-    handle_finish_tile();
-  else if (!strcasecmp(szName, "animation"))
-    handle_finish_animation();
+static void handle_finish_tag(Loader *loader, XmlKey tag) {
+  if (tag == XML_FRAME)
+    loader->frame_count++;
+  else if (tag == XML_TILE)
+    handle_finish_tile(loader);
+  else if (tag == XML_ANIMATION)
+    handle_finish_animation(loader);
 }
 
 /* XML parser callback */
-static void *handler(SimpleXmlParser parser [[maybe_unused]], SimpleXmlEvent evt,
-                     const char *szName, const char *szAttribute, const char *szValue) {
-  switch (evt) {
-  case ADD_SUBTAG:
-    handle_subtag(szName);
+static void handler(void *data, XmlEvent event, XmlKey tag, XmlKey attribute,
+                    const char *value) {
+  Loader *loader = (Loader *)data;
+  switch (event) {
+  case XML_START_TAG:
+    handle_subtag(loader, tag);
     break;
-  case ADD_ATTRIBUTE:
-    handle_add_attribute(szName, szAttribute, szValue);
+  case XML_ATTRIBUTE:
+    handle_add_attribute(loader, tag, attribute, value);
     break;
-  case FINISH_ATTRIBUTES:
-    handle_finish_attributes(szName);
+  case XML_END_ATTRIBUTES:
+    handle_finish_attributes(loader, tag);
     break;
-  case FINISH_TAG:
-    handle_finish_tag(szName);
+  case XML_END_TAG:
+    handle_finish_tag(loader, tag);
     break;
   default:
     break;
   }
-  return &handler;
 }
 
-/* cache section: keeps already loaded tilesets so it doesnt spawn multiple
- * instances of the same */
-#define CACHE_SIZE 16
-static int cache_entries = 0;
-static struct {
-  char name[200];
-  TLN_Tileset tileset;
-} cache[16];
-
-static TLN_Tileset search_cache(const char *name) {
-  for (int c = 0; c < cache_entries; c += 1) {
-    if (!strcmp(cache[c].name, name))
-      return cache[c].tileset;
+/* tiles merged by TLN_SetTileDeduplication() */
+static bool dedup_tiles = false;
+
+/* hash of a tile read with the given flips, so that a flipped duplicate hashes
+ * like the tile it duplicates */
+static uint32_t hash_tile(TLN_Tileset ts, int id, uint16_t flags) {
+  const int xmask = (flags & FLAG_FLIPX) ? ts->width - 1 : 0;
+  const int ymask = (flags & FLAG_FLIPY) ? ts->height - 1 : 0;
+  uint32_t hash = 2166136261u;
+  for (int y = 0; y < ts->height; y++) {
+    for (int x = 0; x < ts->width; x++)
+      hash = (hash ^ GetTilesetPixel(ts, id, x ^ xmask, y ^ ymask)) * 16777619u;
   }
-  return NULL;
+  return hash;
 }
 
-static void add_to_cache(const char *name, TLN_Tileset tileset) {
-  if (cache_entries < CACHE_SIZE - 1) {
-    strncpy(cache[cache_entries].name, name, sizeof(cache[0].name));
-    cache[cache_entries].tileset = tileset;
-    cache_entries += 1;
+/* tells if tile id read with the given flips matches tile other */
+static bool same_tile(TLN_Tileset ts, int id, int other, uint16_t flags) {
+  const int xmask = (flags & FLAG_FLIPX) ? ts->width - 1 : 0;
+  const int ymask = (flags & FLAG_FLIPY) ? ts->height - 1 : 0;
+  if (memcmp(&ts->attributes[id], &ts->attributes[other], sizeof(TLN_TileAttributes)) != 0)
+    return false;
+  for (int y = 0; y < ts->height; y++) {
+    for (int x = 0; x < ts->width; x++) {
+      if (GetTilesetPixel(ts, id, x ^ xmask, y ^ ymask) != GetTilesetPixel(ts, other, x, y))
+        return false;
+    }
   }
+  return true;
 }
 
-static TLN_Tileset load_tile_based_tileset(const char *filename) {
-  FileInfo fi = {0};
-  char imagepath[200];
+/* merges identical and flipped tiles, moving the kept ones to the front. The
+ * tileset gets a remap with the merged tile and flips of each original tile,
+ * that TMXCreateTilemap() applies to the loaded tilemaps */
+static TLN_Tileset dedup_tileset(TLN_Tileset ts) {
+  static const uint16_t flips[] = {0, FLAG_FLIPX, FLAG_FLIPY, FLAG_FLIPX | FLAG_FLIPY};
+  const int num_tiles = ts->numtiles;
+  int num_buckets = 1;
+  while (num_buckets < num_tiles * 2)
+    num_buckets <<= 1;
+
+  int *buckets = (int *)malloc((size_t)num_buckets * sizeof(int));
+  int *next = (int *)malloc((size_t)num_tiles * sizeof(int));
+  Tile *remap = (Tile *)calloc((size_t)num_tiles, sizeof(Tile));
+  if (buckets == NULL || next == NULL || remap == NULL) {
+    free(buckets);
+    free(next);
+    free(remap);
+    return ts;
+  }
+  memset(buckets, -1, (size_t)num_buckets * sizeof(int));
+
+  const size_t tile_size = (size_t)ts->width * (size_t)ts->height;
+  int kept = 0;
+  for (int id = 0; id < num_tiles; id++) {
+    int match = -1;
+    for (int f = 0; f < 4 && match == -1; f++) {
+      const int bucket = (int)(hash_tile(ts, id, flips[f]) & (uint32_t)(num_buckets - 1));
+      for (int k = buckets[bucket]; k != -1 && match == -1; k = next[k]) {
+        if (same_tile(ts, id, k, flips[f])) {
+          match = k;
+          remap[id].flags = flips[f];
+        }
+      }
+    }
 
-  SplitFilename(filename, &fi);
-  if (fi.path[0] != 0)
-    snprintf(imagepath, sizeof(imagepath), "%s/%s", fi.path, loader.source);
-  else
-    strncpy(imagepath, loader.source, sizeof(imagepath));
+    if (match == -1) {
+      const int bucket = (int)(hash_tile(ts, id, 0) & (uint32_t)(num_buckets - 1));
+      if (kept != id) {
+        memcpy(&GetTilesetPixel(ts, kept, 0, 0), &GetTilesetPixel(ts, id, 0, 0), tile_size);
+        memcpy(&ts->color_key[GetTilesetLine(ts, kept, 0)],
+               &ts->color_key[GetTilesetLine(ts, id, 0)], (size_t)ts->height);
+        ts->attributes[kept] = ts->attributes[id];
+      }
+      next[kept] = buckets[bucket];
+      buckets[bucket] = kept;
+      match = kept;
+      kept += 1;
+    }
+    remap[id].index = (uint16_t)(match + 1);
+  }
+  free(buckets);
+  free(next);
+
+  if (kept == num_tiles) {
+    free(remap);
+    return ts;
+  }
+  ts = ShrinkTileset(ts, kept);
+  ts->remap = remap;
+  ts->num_remap = num_tiles;
+  return ts;
+}
+
+/* decodes the rows of an indexed PNG straight into the tiles, without a
+ * temporary bitmap */
+static bool stream_tiles(Loader *loader, PNGReader *png, int width, int height,
+                         TLN_Tileset ts, int htiles) {
+  const int dx = loader->tilewidth + loader->spacing;
+  const int dy = loader->tileheight + loader->spacing;
+  uint8_t *row = (uint8_t *)malloc((size_t)width);
+  if (row == NULL)
+    return false;
+
+  for (int y = 0; y < height; y++) {
+    if (!ReadPNGRow(png, row)) {
+      free(row);
+      return false;
+    }
 
+    const int ty = (y - loader->margin) / dy;
+    const int line = (y - loader->margin) % dy;
+    if (y < loader->margin || line >= loader->tileheight)
+      continue;
+    for (int tx = 0; tx < htiles; tx++) {
+      const int id = ty * htiles + tx;
+      if (id >= ts->numtiles)
+        break;
+      uint8_t *dst = &GetTilesetPixel(ts, id, 0, line);
+      memcpy(dst, row + loader->margin + tx * dx, (size_t)ts->width);
+      ts->color_key[GetTilesetLine(ts, id, line)] = memchr(dst, 0, (size_t)ts->width) != NULL;
+    }
+  }
+  free(row);
+  return true;
+}
+
+/* copies the tiles of a whole loaded bitmap, for non-indexed or BMP images */
+static TLN_Tileset load_bitmap_tiles(Loader *loader, const char *imagepath) {
   TLN_Bitmap bitmap = TLN_LoadBitmap(imagepath);
   if (!bitmap) {
     TLN_SetLastError(TLN_ERR_FILE_NOT_FOUND);
     return NULL;
   }
 
-  int dx = loader.tilewidth + loader.spacing;
-  int dy = loader.tileheight + loader.spacing;
-  int htiles = (TLN_GetBitmapWidth(bitmap) - loader.margin * 2 + loader.spacing) / dx;
-  int vtiles = (TLN_GetBitmapHeight(bitmap) - loader.margin * 2 + loader.spacing) / dy;
-  int num_tiles = loader.tilecount != 0 ? loader.tilecount : htiles * vtiles;
+  int dx = loader->tilewidth + loader->spacing;
+  int dy = loader->tileheight + loader->spacing;
+  int htiles = (TLN_GetBitmapWidth(bitmap) - loader->margin * 2 + loader->spacing) / dx;
+  int vtiles = (TLN_GetBitmapHeight(bitmap) - loader->margin * 2 + loader->spacing) / dy;
+  int num_tiles = loader->tilecount != 0 ? loader->tilecount : htiles * vtiles;
 
-  TLN_Tileset ts = TLN_CreateTileset(num_tiles, loader.tilewidth, loader.tileheight,
-                                     TLN_ClonePalette(TLN_GetBitmapPalette(bitmap)), loader.sp,
-                                     loader.attributes);
+  TLN_Tileset ts = TLN_CreateTileset(num_tiles, loader->tilewidth, loader->tileheight,
+                                     TLN_ClonePalette(TLN_GetBitmapPalette(bitmap)), loader->sp,
+                                     loader->attributes);
   if (ts == NULL) {
     TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
     TLN_DeleteBitmap(bitmap);
@@ -259,7 +379,7 @@ static TLN_Tileset load_tile_based_tileset(const char *filename) {
   for (int id = 0, y = 0; y < vtiles; y++) {
     for (int x = 0; x < htiles; x++, id++) {
       uint8_t const *srcptr =
-          TLN_GetBitmapPtr(bitmap, loader.margin + x * dx, loader.margin + y * dy);
+          TLN_GetBitmapPtr(bitmap, loader->margin + x * dx, loader->margin + y * dy);
       if (id < num_tiles)
         TLN_SetTilesetPixels(ts, id, srcptr, pitch);
     }
@@ -269,64 +389,125 @@ static TLN_Tileset load_tile_based_tileset(const char *filename) {
   return ts;
 }
 
-static TLN_Tileset load_image_based_tileset(void) {
-  TLN_Tileset ts = TLN_CreateImageTileset(loader.tilecount, loader.images);
+static TLN_Tileset load_tile_based_tileset(Loader *loader, const char *filename) {
+  FileInfo fi = {0};
+  char imagepath[200];
+
+  SplitFilename(filename, &fi);
+  if (fi.path[0] != 0)
+    snprintf(imagepath, sizeof(imagepath), "%s/%s", fi.path, loader->source);
+  else
+    strncpy(imagepath, loader->source, sizeof(imagepath));
+
+  int width = 0;
+  int height = 0;
+  TLN_Palette palette = NULL;
+  TLN_Tileset ts = NULL;
+  PNGReader *png = OpenIndexedPNG(imagepath, &width, &height, &palette);
+  if (png != NULL) {
+    int htiles = (width - loader->margin * 2 + loader->spacing) /
+                 (loader->tilewidth + loader->spacing);
+    int vtiles = (height - loader->margin * 2 + loader->spacing) /
+                 (loader->tileheight + loader->spacing);
+    int num_tiles = loader->tilecount != 0 ? loader->tilecount : htiles * vtiles;
+    ts = TLN_CreateTileset(num_tiles, loader->tilewidth, loader->tileheight, palette, loader->sp,
+                           loader->attributes);
+    if (ts == NULL) {
+      TLN_DeletePalette(palette);
+      TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
+    } else if (!stream_tiles(loader, png, width, height, ts, htiles)) {
+      TLN_DeleteTileset(ts);
+      TLN_DeletePalette(palette);
+      TLN_SetLastError(TLN_ERR_WRONG_FORMAT);
+      ts = NULL;
+    } else
+      ts->tiles_per_row = htiles;
+    ClosePNG(png);
+  } else
+    ts = load_bitmap_tiles(loader, imagepath);
+
+  /* animations refer to the original tile indexes */
+  if (ts != NULL && dedup_tiles && loader->sp == NULL)
+    ts = dedup_tileset(ts);
+  return ts;
+}
+
+static TLN_Tileset load_image_based_tileset(Loader *loader) {
+  TLN_Tileset ts = TLN_CreateImageTileset(loader->tilecount, loader->images);
   if (ts == NULL)
     TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
   return ts;
 }
 
-/*!
- * \brief
- * Loads a tileset from a Tiled .tsx file
- *
- * \param filename
- * TSX file to load
- *
- * \returns
- * Reference to the newly loaded tileset or NULL if error
- *
- * \remarks
- * An associated palette is also created, it can be obtained calling
- * TLN_GetTilesetPalette()
- */
-TLN_Tileset TLN_LoadTileset(const char *filename) {
-  TLN_Tileset ts = search_cache(filename);
-  if (ts)
-    return ts;
-
+/* loads a tileset, traced by TLN_LoadTileset() */
+static TLN_Tileset load_tileset(const char *filename) {
   ssize_t size = 0;
-  uint8_t *data = (uint8_t *)LoadFile(filename, &size);
+  char *data = (char *)LoadFile(filename, &size);
   if (!data) {
     TLN_SetLastError(size == 0 ? TLN_ERR_FILE_NOT_FOUND : TLN_ERR_OUT_OF_MEMORY);
     return NULL;
   }
 
-  memset(&loader, 0, sizeof(loader));
-  SimpleXmlParser parser = simpleXmlCreateParser((char *)data, (long)size);
-  if (parser != NULL) {
-    if (simpleXmlParse(parser, handler) != 0) {
-      printf("parse error on line %li:\n%s\n", simpleXmlGetLineNumber(parser),
-             simpleXmlGetErrorDescription(parser));
-      simpleXmlDestroyParser(parser);
-      free(data);
-      TLN_SetLastError(TLN_ERR_WRONG_FORMAT);
-      return NULL;
-    }
-  } else
-    TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
-
-  simpleXmlDestroyParser(parser);
+  Loader loader = {0};
+  XmlError error;
+  if (!XmlParse(data, (size_t)size, handler, &loader, &error)) {
+    printf("parse error on line %i:\n%s\n", error.line, error.description);
+    free(data);
+    free(loader.attributes);
+    free(loader.images);
+    TLN_SetLastError(TLN_ERR_WRONG_FORMAT);
+    return NULL;
+  }
   free(data);
 
-  ts = loader.source[0] != 0 ? load_tile_based_tileset(filename) : load_image_based_tileset();
+  TLN_Tileset ts = loader.source[0] != 0
+                       ? load_tile_based_tileset(&loader, filename)
+                       : load_image_based_tileset(&loader);
 
   free(loader.attributes);
   free(loader.images);
 
-  if (ts != NULL) {
-    add_to_cache(filename, ts);
+  if (ts != NULL)
     TLN_SetLastError(TLN_ERR_OK);
-  }
   return ts;
 }
+
+/*!
+ * \brief
+ * Loads a tileset from a Tiled .tsx file
+ *
+ * \param filename
+ * TSX file to load
+ *
+ * \returns
+ * Reference to the newly loaded tileset or NULL if error
+ *
+ * \remarks
+ * An associated palette is also created, it can be obtained calling
+ * TLN_GetTilesetPalette(). Loading a file already loaded, directly or by
+ * TLN_LoadTilemap(), returns the same tileset. See TLN_SetAssetCacheBudget()
+ */
+TLN_Tileset TLN_LoadTileset(const char *filename) {
+  const uint64_t trace = TraceBegin(TRACE_ALWAYS, 0);
+  TLN_Tileset tileset = (TLN_Tileset)GetCachedAsset(OT_TILESET, filename);
+  if (tileset == NULL)
+    tileset = (TLN_Tileset)AddCachedAsset(OT_TILESET, filename, load_tileset(filename));
+  TraceEndFile(trace, "LoadTileset", filename);
+  return tileset;
+}
+
+/*!
+ * \brief
+ * Enables merging of duplicated tiles when loading tilesets
+ *
+ * \param enable
+ * true to merge identical tiles, including horizontally and vertically flipped
+ * duplicates. Disabled by default
+ *
+ * \remarks
+ * Merged tilesets hold less tiles, so tile indexes change: TLN_LoadTilemap()
+ * and TLN_LoadWorld() remap the tiles of the layers they load, but tilemaps
+ * built by hand must use the new indexes. Tilesets with animations are never
+ * merged. Already loaded tilesets are not affected
+ */
+void TLN_SetTileDeduplication(bool enable) { dedup_tiles = enable; }
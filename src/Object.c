@@ -10,14 +10,16 @@
 
 #include "Object.h"
 
+#include <SDL3/SDL_atomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include "Engine.h"
 
-static uint32_t numobjects = 0;
-static uint32_t numbytes = 0;
+/* atomic, as objects may be created in loader threads */
+static SDL_AtomicInt numobjects;
+static SDL_AtomicInt numbytes;
 
 static const char *object_types[] = {
     "none",   "palette",  "tilemap",       "tileset",     "spriteset",
@@ -35,11 +37,11 @@ void *CreateBaseObject(ObjectType type, size_t size) {
     object_t *object = (object_t *)malloc(size);
     if (object) {
         char trace_msg[255];
-        numobjects++;
-        numbytes += (uint32_t)size;
+        const int count = SDL_AddAtomicInt(&numobjects, 1) + 1;
+        SDL_AddAtomicInt(&numbytes, (int)size);
         memset(object, 0, size);
         object->type = type;
-        object->guid = numobjects;
+        object->guid = (uint32_t)count;
         object->size = (uint32_t)size;
         object->owner = 1;
         sprintf(trace_msg, "%s created at %p, %zu size", object_types[type], (void *)object, size);
@@ -64,12 +66,28 @@ void *CloneBaseObject(void *object) {
     return dst;
 }
 
+/* shrinks an object to a smaller size, returns its new address */
+void *ShrinkBaseObject(void *object, size_t size) {
+    const size_t old_size = ObjectSize(object);
+    object_t *resized;
+    if (size >= old_size) {
+        return object;
+    }
+    resized = (object_t *)realloc(object, size);
+    if (resized == NULL) {
+        return object;
+    }
+    SDL_AddAtomicInt(&numbytes, -(int)(old_size - size));
+    resized->size = (uint32_t)size;
+    return resized;
+}
+
 /* deletes object */
 void DeleteBaseObject(void *object) {
     if (object) {
         char trace_msg[255];
-        numobjects--;
-        numbytes -= ObjectSize(object);
+        SDL_AddAtomicInt(&numobjects, -1);
+        SDL_AddAtomicInt(&numbytes, -(int)ObjectSize(object));
         sprintf(trace_msg, "%s %p deleted", object_types[ObjectType(object)], object);
         tln_trace(TLN_LOG_VERBOSE, trace_msg);
         free(object);
@@ -89,9 +107,9 @@ bool CheckBaseObject(void *object, ObjectType type) {
     return false;
 }
 
-unsigned int GetNumObjects(void) { return numobjects; }
+unsigned int GetNumObjects(void) { return (unsigned int)SDL_GetAtomicInt(&numobjects); }
 
-unsigned int GetNumBytes(void) { return numbytes; }
+unsigned int GetNumBytes(void) { return (unsigned int)SDL_GetAtomicInt(&numbytes); }
 
 void CopyBaseObject(void *dstobject, const void *srcobject) {
     if (srcobject && dstobject) {
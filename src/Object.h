@@ -46,6 +46,7 @@ typedef struct {
 /* prototipos */
 void *CreateBaseObject(ObjectType type, size_t size);
 void *CloneBaseObject(void *object);
+void *ShrinkBaseObject(void *object, size_t size);
 void DeleteBaseObject(void *object);
 bool CheckBaseObject(void *object, ObjectType type);
 void CopyBaseObject(void *dstobject, const void *srcobject);
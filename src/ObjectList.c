@@ -14,12 +14,13 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "AssetCache.h"
 #include "Engine.h"
-#include "LoadFile.h"
 #include "LoadTMX.h"
 #include "Sprite.h"
 #include "Tilengine.h"
-#include "simplexml.h"
+#include "Tileset.h"
+#include "Trace.h"
 
 #define ODB(msg, ...)                                                                              \
     do {                                                                                           \
@@ -28,131 +29,9 @@
         tln_trace(TLN_LOG_VERBOSE, _odb_buf);                                                      \
     } while (0)
 
-/* properties */
-typedef enum {
-    PROPERTY_NONE,
-    PROPERTY_TYPE,
-    PROPERTY_PRIORITY,
-} Property;
-
-/* load manager */
-static struct {
-    TMXLayer *layer;
-    bool state;
-    TLN_ObjectList objects;
-    TLN_Object object;
-    Property property; /* current property */
-} loader;
-
 static bool CloneObjectToList(TLN_ObjectList list, TLN_Object const *data);
-static void resolve_object_tilesets(TMXInfo *info);
-static void handle_add_attribute(const char *szName, const char *szAttribute, const char *szValue);
-static void handle_finish_attributes(const char *szName);
-static void handle_finish_tag(const char *szName);
-
-static void handle_object_gid_attribute(const char *szValue) {
-    Tile tile;
-    tile.value = strtoul(szValue, NULL, 0);
-    loader.object.has_gid = true;
-    loader.object.flags = tile.flags;
-    loader.object.gid = tile.index;
-}
-
-static void handle_object_attribute(const char *szAttribute, const char *szValue) {
-    int intvalue = (int)strtol(szValue, NULL, 10);
-    if (!strcasecmp(szAttribute, "id")) {
-        loader.object.id = (uint16_t)intvalue;
-    } else if (!strcasecmp(szAttribute, "gid")) {
-        handle_object_gid_attribute(szValue);
-    } else if (!strcasecmp(szAttribute, "x")) {
-        loader.object.x = intvalue;
-    } else if (!strcasecmp(szAttribute, "y")) {
-        loader.object.y = intvalue;
-    } else if (!strcasecmp(szAttribute, "width")) {
-        loader.object.width = intvalue;
-    } else if (!strcasecmp(szAttribute, "height")) {
-        loader.object.height = intvalue;
-    } else if (!strcasecmp(szAttribute, "type")) {
-        loader.object.type = (uint8_t)intvalue;
-    } else if (!strcasecmp(szAttribute, "visible")) {
-        loader.object.visible = (bool)intvalue;
-    } else if (!strcasecmp(szAttribute, "name")) {
-        strncpy(loader.object.name, szValue, sizeof(loader.object.name) - 1);
-        loader.object.name[sizeof(loader.object.name) - 1] = '\0';
-    }
-}
-
-static void handle_property_attribute(const char *szAttribute, const char *szValue) {
-    if (!strcasecmp(szAttribute, "name")) {
-        loader.property = !strcasecmp(szValue, "priority") ? PROPERTY_PRIORITY : PROPERTY_NONE;
-    } else if (!strcasecmp(szAttribute, "value") && loader.property == PROPERTY_PRIORITY &&
-               !strcasecmp(szValue, "true")) {
-        loader.object.flags += FLAG_PRIORITY;
-    }
-}
-
-static void handle_add_attribute(const char *szName, const char *szAttribute, const char *szValue) {
-    if (!strcasecmp(szName, "objectgroup") && !strcasecmp(szAttribute, "name")) {
-        loader.state = ((!strcasecmp(szValue, loader.layer->name)) != 0);
-    } else if (!strcasecmp(szName, "object")) {
-        handle_object_attribute(szAttribute, szValue);
-    } else if (!strcasecmp(szName, "property")) {
-        handle_property_attribute(szAttribute, szValue);
-    }
-}
-
-static void handle_finish_attributes(const char *szName) {
-    if ((int)loader.state && !strcasecmp(szName, "objectgroup")) {
-        loader.objects = TLN_CreateObjectList();
-        loader.objects->id = loader.layer->id;
-        loader.objects->visible = loader.layer->visible;
-    }
-}
-
-static void handle_finish_tag(const char *szName) {
-    if (!loader.state) {
-        return;
-    }
-    if (!strcasecmp(szName, "objectgroup")) {
-        loader.state = false;
-    } else if (!strcasecmp(szName, "object")) {
-        if (loader.object.has_gid) {
-            loader.object.y -= loader.object.height;
-        }
-        CloneObjectToList(loader.objects, &loader.object);
-    }
-}
-
-/* XML parser callback */
-static void *handler(SimpleXmlParser parser [[maybe_unused]], SimpleXmlEvent evt,
-                     const char *szName, const char *szAttribute, const char *szValue) {
-    ODB("handler evt=%d szName=%s szAttr=%s szVal=%s", evt, szName ? szName : "(null)",
-        szAttribute ? szAttribute : "(null)", szValue ? szValue : "(null)");
-    switch (evt) {
-    case ADD_SUBTAG:
-        if (!strcasecmp(szName, "object")) {
-            memset(&loader.object, 0, sizeof(struct Object));
-            loader.object.visible = true;
-        }
-        break;
-    case ADD_ATTRIBUTE:
-        handle_add_attribute(szName, szAttribute, szValue);
-        break;
-    case FINISH_ATTRIBUTES:
-        handle_finish_attributes(szName);
-        break;
-    case FINISH_TAG:
-        handle_finish_tag(szName);
-        break;
-    default:
-        break;
-    }
-    union {
-        void *vp;
-        SimpleXmlTagHandler fp;
-    } u = {.fp = handler};
-    return u.vp;
-}
+static void resolve_object_tilesets(TLN_ObjectList list, TMXInfo const *info,
+                                    TLN_Tileset *tilesets);
 
 /*!
  * \brief Creates a TLN_ObjectList
@@ -244,76 +123,110 @@ bool TLN_AddTileObjectToList(TLN_ObjectList list, uint16_t id, uint16_t gid, uin
     return true;
 }
 
-/*!
- * \brief Loads an object list from a Tiled object layer
- *
- * \param filename Name of the .tmx file containing the list
- * \param layername Name of the layer to load
- * \return Reference to the loaded object or NULL if error
- */
-TLN_ObjectList TLN_LoadObjectList(const char *filename, const char *layername) {
-    SimpleXmlParser parser;
-    ssize_t size;
-    uint8_t *data;
-    TMXInfo tmxinfo = {0};
+/* creates the list of an object layer, taking the objects from its contents.
+ * Tilesets must be loaded by the caller, the one with the objects' gids is
+ * attached */
+TLN_ObjectList TMXCreateObjectList(TMXInfo const *info, TMXLayer const *layer,
+                                   TMXLayerData *data, TLN_Tileset *tilesets) {
+    TLN_ObjectList list = TLN_CreateObjectList();
+    if (list == NULL) {
+        return NULL;
+    }
+
+    list->id = layer->id;
+    list->visible = layer->visible;
+    list->list = data->objects;
+    list->last = data->last;
+    for (struct Object *item = list->list; item != NULL; item = item->next) {
+        list->num_items += 1;
+    }
+    data->objects = data->last = NULL;
+
+    resolve_object_tilesets(list, info, tilesets);
+    return list;
+}
+
+/* loads an object list, traced by TLN_LoadObjectList() */
+static TLN_ObjectList load_object_list(const char *filename, const char *layername) {
+    TMXDocument doc;
+    TLN_ObjectList list;
+    TMXLayer *layer;
+    int idx;
 
     ODB("LoadObjectList file=%s layer=%s", filename, layername);
 
-    /* load map info */
-    if (!TMXLoad(filename, &tmxinfo)) {
+    /* load map */
+    if (!TMXLoadDocument(filename, &doc)) {
         TLN_SetLastError(TLN_ERR_FILE_NOT_FOUND);
         return NULL;
     }
-    ODB("TMXLoad ok, num_layers=%d num_tilesets=%d", tmxinfo.num_layers, tmxinfo.num_tilesets);
+    ODB("TMXLoadDocument ok, num_layers=%d num_tilesets=%d", doc.info.num_layers,
+        doc.info.num_tilesets);
 
     /* get target layer */
-    memset(&loader, 0, sizeof(loader));
     if (layername) {
-        loader.layer = TMXGetLayer(&tmxinfo, layername);
+        layer = TMXGetLayer(&doc.info, layername);
     } else {
-        loader.layer = TMXGetFirstLayer(&tmxinfo, LAYER_OBJECT);
+        layer = TMXGetFirstLayer(&doc.info, LAYER_OBJECT);
     }
-    if (loader.layer == NULL) {
+    if (layer == NULL || layer->type != LAYER_OBJECT) {
+        TMXDeleteDocument(&doc);
         TLN_SetLastError(TLN_ERR_FILE_NOT_FOUND);
         return NULL;
     }
-    ODB("layer found: %s id=%d", loader.layer->name, loader.layer->id);
-
-    /* parse */
-    data = (uint8_t *)LoadFile(filename, &size);
-    ODB("loaded file, size=%zd data=%p", size, (void *)data);
-    parser = simpleXmlCreateParser((char *)data, (long)size);
-    ODB("parser=%p, starting parse...", (void *)parser);
-    if (parser != NULL) {
-        if (simpleXmlParse(parser, handler) != 0) {
-            printf("parse error on line %li:\n%s\n", simpleXmlGetLineNumber(parser),
-                   simpleXmlGetErrorDescription(parser));
-            TLN_SetLastError(TLN_ERR_WRONG_FORMAT);
-        } else {
-            TLN_SetLastError(TLN_ERR_OK);
+    ODB("layer found: %s id=%d", layer->name, layer->id);
+
+    /* load referenced tilesets when there are tile objects */
+    TMXLayerData *data = &doc.layers[layer - doc.info.layers];
+    TLN_Tileset tilesets[TMX_MAX_TILESET] = {0};
+    struct Object *item = data->objects;
+    while (item != NULL && item->gid == 0) {
+        item = item->next;
+    }
+    if (item != NULL) {
+        for (idx = 0; idx < doc.info.num_tilesets; idx += 1) {
+            ODB("  loading tileset[%d] source='%s'", idx, doc.info.tilesets[idx].source);
+            tilesets[idx] = TLN_LoadTileset(doc.info.tilesets[idx].source);
+            ODB("  tileset[%d]=%p", idx, (void *)tilesets[idx]);
         }
-    } else {
-        TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
     }
-    ODB("parse done, objects=%p", (void *)loader.objects);
 
-    simpleXmlDestroyParser(parser);
-    free(data);
+    list = TMXCreateObjectList(&doc.info, layer, data, tilesets);
+    ODB("objects=%p", (void *)list);
+    TMXDeleteDocument(&doc);
 
-    if (loader.objects != NULL) {
-        resolve_object_tilesets(&tmxinfo);
+    /* release loaded tilesets, the list references its own */
+    for (idx = 0; idx < doc.info.num_tilesets; idx += 1) {
+        if (tilesets[idx] != NULL) {
+            TLN_DeleteTileset(tilesets[idx]);
+        }
     }
+    return list;
+}
 
-    return loader.objects;
+/*!
+ * \brief Loads an object list from a Tiled object layer
+ *
+ * \param filename Name of the .tmx file containing the list
+ * \param layername Name of the layer to load
+ * \return Reference to the loaded object or NULL if error
+ */
+TLN_ObjectList TLN_LoadObjectList(const char *filename, const char *layername) {
+    const uint64_t trace = TraceBegin(TRACE_ALWAYS, 0);
+    TLN_ObjectList objects = load_object_list(filename, layername);
+    TraceEndFile(trace, "LoadObjectList", filename);
+    return objects;
 }
 
-static void resolve_object_tilesets(TMXInfo *info) {
+/* attaches the tileset of the gids in the list and corrects them with its
+ * firstgid */
+static void resolve_object_tilesets(TLN_ObjectList list, TMXInfo const *info,
+                                    TLN_Tileset *tilesets) {
     struct Object *item;
     int gid = 0;
-    int idx;
 
     /* find a gid to identify the suitable tileset */
-    item = loader.objects->list;
+    item = list->list;
     while (item != NULL && gid == 0) {
         if (item->gid > 0) {
             gid = item->gid;
@@ -329,45 +242,32 @@ static void resolve_object_tilesets(TMXInfo *info) {
 
     ODB("searching tilesets for gid=%d, num_tilesets=%d", gid, info->num_tilesets);
 
-    /* load referenced tilesets */
-    TLN_Tileset tilesets[TMX_MAX_TILESET] = {0};
-    for (idx = 0; idx < info->num_tilesets; idx += 1) {
-        ODB("  loading tileset[%d] source='%s'", idx, info->tilesets[idx].source);
-        tilesets[idx] = TLN_LoadTileset(info->tilesets[idx].source);
-        ODB("  tileset[%d]=%p", idx, (void *)tilesets[idx]);
-    }
-
     int suitable = TMXGetSuitableTileset(info, gid, tilesets);
     ODB("suitable=%d", suitable);
     if (suitable < 0 || suitable >= info->num_tilesets) {
         ODB("ERROR: suitable out of range! num_tilesets=%d", info->num_tilesets);
-        for (idx = 0; idx < info->num_tilesets; idx += 1) {
-            TLN_DeleteTileset(tilesets[idx]);
-        }
         return;
     }
 
     TMXTileset const *tmxtileset = &info->tilesets[suitable];
 
-    /* correct gids with firstgid offset */
-    item = loader.objects->list;
+    /* correct gids with firstgid offset, then with merged tiles when the
+     * tileset was deduplicated */
+    item = list->list;
     while (item != NULL) {
         if (item->gid > 0) {
-            item->gid = (uint16_t)(item->gid - tmxtileset->firstgid);
+            uint16_t index = (uint16_t)(item->gid - tmxtileset->firstgid + 1);
+            RemapTilesetTile(tilesets[suitable], &index, &item->flags);
+            item->gid = (uint16_t)(index - 1);
         }
         item = item->next;
     }
 
-    /* delete unused tilesets */
-    for (idx = 0; idx < info->num_tilesets; idx += 1) {
-        if (idx != suitable) {
-            TLN_DeleteTileset(tilesets[idx]);
-        }
-    }
-
-    loader.objects->tileset = tilesets[suitable];
-    loader.objects->width = info->width * info->tilewidth;
-    loader.objects->height = info->height * info->tileheight;
+    /* the list keeps its own reference, released by TLN_DeleteObjectList() */
+    list->tileset = tilesets[suitable];
+    RetainAsset(list->tileset);
+    list->width = info->width * info->tilewidth;
+    list->height = info->height * info->tileheight;
 }
 
 /*!
@@ -472,6 +372,9 @@ bool TLN_DeleteObjectList(TLN_ObjectList list) {
     if (!CheckBaseObject(list, OT_OBJECTLIST)) {
         return false;
     }
+    if (ObjectOwner(list) && list->tileset != NULL) {
+        TLN_DeleteTileset(list->tileset);
+    }
 
     /* delete nodes */
     obj_node = list->list;
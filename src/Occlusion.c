@@ -0,0 +1,255 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* occlusion culling: before composing a scanline, walks the layers front to
+ * back collecting the spans covered by solid tiles, so that the layers behind
+ * them and the background only draw the spans that remain visible. Only plain
+ * tiled layers take part, the rest are drawn as usual */
+
+#include "Occlusion.h"
+
+#include <string.h>
+
+#include "Draw.h"
+#include "Engine.h"
+#include "Tilemap.h"
+#include "Tilengine.h"
+#include "Tileset.h"
+
+/* returns true if the layer is drawn straight to the framebuffer by
+ * DrawTiledScanline(), so it can be limited to spans */
+static bool is_cullable(ScanContext const *ctx, Layer const *layer) {
+    if (!layer->flags.ok || layer->flags.priority || layer->flags.is_blend_source) {
+        return false;
+    }
+    if (layer->type != LAYER_TILE || layer->render.mode != MODE_NORMAL) {
+        return false;
+    }
+    if (layer->mosaic.h != 0 || layer->column != NULL) {
+        return false;
+    }
+    return layer->blend_mask_layer < 0 || ctx->blend_mask == NULL;
+}
+
+/* appends [x1, x2) to a sorted span list, joining it with the last span when
+ * contiguous */
+static inline void add_span(Span *spans, int *count, int x1, int x2) {
+    if (*count > 0 && spans[*count - 1].x2 == x1) {
+        spans[*count - 1].x2 = x2;
+    } else {
+        spans[*count].x1 = x1;
+        spans[*count].x2 = x2;
+        *count += 1;
+    }
+}
+
+/* merges two sorted span lists into dst, joining overlapping spans */
+static int merge_spans(Span const *a, int num_a, Span const *b, int num_b, Span *dst) {
+    int count = 0;
+    int c = 0;
+    int d = 0;
+    while (c < num_a || d < num_b) {
+        Span const *span;
+        if (d == num_b || (c < num_a && a[c].x1 <= b[d].x1)) {
+            span = &a[c++];
+        } else {
+            span = &b[d++];
+        }
+        if (count > 0 && dst[count - 1].x2 >= span->x1) {
+            if (span->x2 > dst[count - 1].x2) {
+                dst[count - 1].x2 = span->x2;
+            }
+        } else {
+            dst[count++] = *span;
+        }
+    }
+    return count;
+}
+
+/* writes the gaps of a sorted span list within [0, width) to dst */
+static int invert_spans(Span const *spans, int num_spans, int width, Span *dst) {
+    int count = 0;
+    int x = 0;
+    for (int c = 0; c < num_spans; c++) {
+        if (spans[c].x1 > x) {
+            dst[count].x1 = x;
+            dst[count].x2 = spans[c].x1;
+            count += 1;
+        }
+        x = spans[c].x2;
+    }
+    if (x < width) {
+        dst[count].x1 = x;
+        dst[count].x2 = width;
+        count += 1;
+    }
+    return count;
+}
+
+/* returns true if the given line of a tile has no transparent pixels. Rotated
+ * tiles map the line to a column and are never considered solid */
+static bool is_solid_tile_line(struct Tilemap const *tilemap, Tile const *tile, int srcy) {
+    const struct Tileset *tileset = tilemap->tilesets[tile->tileset];
+    if (tileset->color_key == NULL || (tile->flags & FLAG_ROTATE)) {
+        return false;
+    }
+
+    /* same line selection as DrawTiledScanline() */
+    if (tile->flags & FLAG_FLIPY) {
+        srcy = tilemap->tilesets[0]->width - srcy - 1;
+    }
+    const int tile_index = tileset->tiles[tile->index] - 1;
+    return !tileset->color_key[GetTilesetLine(tileset, tile_index, srcy)];
+}
+
+/* collects the solid and the priority tile spans of a layer within [tx1, tx2)
+ * walking the tilemap like DrawTiledScanline() */
+static void scan_layer_tiles(Layer const *layer, int line, int tx1, int tx2, Span *solid,
+                             int *num_solid, Span *priority, int *num_priority) {
+    const struct Tilemap *tilemap = layer->tilemap;
+    const struct Tileset *tileset = tilemap->tilesets[0];
+    const int ypos = (layer->vstart + line) % layer->height;
+    const int ytile = ypos >> tileset->vshift;
+    const int srcy = ypos & GetTilesetVMask(tileset);
+    const int xpos = (layer->hstart + tx1) % layer->width;
+    int xtile = xpos >> tileset->hshift;
+    int srcx = xpos & GetTilesetHMask(tileset);
+    int x = tx1;
+
+    while (x < tx2) {
+        const Tile *tile = &tilemap->tiles[((ptrdiff_t)ytile * tilemap->cols) + xtile];
+        int x1 = x + tileset->width - srcx;
+        if (x1 > tx2) {
+            x1 = tx2;
+        }
+
+        if (tile->index != 0) {
+            if (tile->flags & FLAG_PRIORITY) {
+                add_span(priority, num_priority, x, x1);
+            } else if (is_solid_tile_line(tilemap, tile, srcy)) {
+                add_span(solid, num_solid, x, x1);
+            }
+        } else {
+            const int run = GetTilemapEmptyRun(tilemap, ytile, xtile);
+            if (run > 1) {
+                x1 += (run - 1) * tileset->width;
+                if (x1 > tx2) {
+                    x1 = tx2;
+                }
+                xtile += run - 1;
+            }
+        }
+
+        x = x1;
+        if (++xtile >= tilemap->cols) {
+            xtile = 0;
+        }
+        srcx = 0;
+    }
+}
+
+/* returns the spans of a scanline drawn by a layer window, in the same way as
+ * draw_window_region() */
+static int get_window_spans(Layer const *layer, int line, int width, Span *spans) {
+    LayerWindow const *window = &layer->window;
+    const bool inside = line >= window->y1 && line <= window->y2;
+    int count = 0;
+    if (!window->invert) {
+        if (inside && window->x1 < window->x2) {
+            spans[count++] = (Span){window->x1, window->x2};
+        }
+    } else if (inside) {
+        if (window->x1 > 0) {
+            spans[count++] = (Span){0, window->x1};
+        }
+        if (window->x2 < width) {
+            spans[count++] = (Span){window->x2, width};
+        }
+    } else {
+        spans[count++] = (Span){0, width};
+    }
+    return count;
+}
+
+/* computes the visible spans of each layer and the background for the given
+ * scanline. Returns false when nothing is covered and the scanline must be
+ * drawn as usual */
+bool CullScanline(ScanContext *ctx, int line) {
+    const int width = engine->framebuffer.width;
+    const int max_spans = ctx->max_spans;
+    Span *cover = ctx->cover;
+    Span *solid = ctx->spans;
+    Span *priority = solid + max_spans;
+    Span *tmp = priority + max_spans;
+    int num_cover = 0;
+
+    if (cover == NULL) {
+        return false;
+    }
+
+    /* layer 0 is the frontmost one */
+    for (int c = 0; c < engine->numlayers; c++) {
+        Layer const *layer = &ctx->view->layers[c];
+        Span window[2];
+        int num_solid = 0;
+        int num_priority = 0;
+
+        ctx->num_visible[c] = -1;
+        if (!is_cullable(ctx, layer)) {
+            continue;
+        }
+
+        const int num_window = get_window_spans(layer, line, width, window);
+        for (int w = 0; w < num_window; w++) {
+            scan_layer_tiles(layer, line, window[w].x1, window[w].x2, solid, &num_solid,
+                             priority, &num_priority);
+        }
+
+        /* priority tiles end up in front of everything, keep them */
+        if (num_cover > 0) {
+            const int num_tmp = invert_spans(cover, num_cover, width, tmp);
+            ctx->num_visible[c] = merge_spans(tmp, num_tmp, priority, num_priority,
+                                              &ctx->visible[c * max_spans]);
+        }
+
+        /* blended layers don't hide what's behind them */
+        if (num_solid > 0 && layer->render.blend == NULL) {
+            num_cover = merge_spans(cover, num_cover, solid, num_solid, tmp);
+            memcpy(cover, tmp, (size_t)num_cover * sizeof(Span));
+        }
+    }
+
+    ctx->num_visible[engine->numlayers] =
+        invert_spans(cover, num_cover, width, &ctx->visible[engine->numlayers * max_spans]);
+    return num_cover > 0;
+}
+
+/*!
+ * \brief
+ * Enables or disables occlusion culling
+ *
+ * \param enable
+ * true to enable culling, false to disable it (default)
+ *
+ * \remarks
+ * Before composing each scanline the engine finds the spans covered by solid
+ * tiles, that is tiles whose current line has no transparent pixels, in
+ * unblended tiled layers. Layers behind them and the background skip these
+ * spans. The output is identical, it only pays off when front layers are
+ * mostly solid. Tilesets must have their pixels set before use: solid lines
+ * are found when pixels are loaded with TLN_SetTilesetPixels(). The pixels
+ * skipped are reported in culled_pixels by TLN_GetFrameStats().
+ *
+ * \see
+ * TLN_SetTilesetPixels()
+ */
+void TLN_SetOcclusionCulling(bool enable) {
+    engine->occlusion_culling = enable;
+}
@@ -0,0 +1,279 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* overdraw debug mode: while a scanline is composed, its scan context points
+ * at the line of the engine per-pixel counters, so threads drawing different
+ * lines never share them. Per-source costs are counted privately and merged
+ * by MergeScanContext(), like sprite collisions */
+
+#include "Overdraw.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Draw.h"
+#include "Engine.h"
+#include "Tilengine.h"
+
+/* heatmap colors by number of writes, the last one for more */
+static const uint32_t heatmap[] = {
+    0xFF000000, /* none */
+    0xFF0000A0, /* 1 */
+    0xFF0070FF, /* 2 */
+    0xFF00C000, /* 3 */
+    0xFFFFFF00, /* 4 */
+    0xFFFF8000, /* 5 */
+    0xFFFF0000, /* 6 */
+    0xFFFFFFFF, /* 7 or more */
+};
+
+#define HEATMAP_SIZE (int)(sizeof(heatmap) / sizeof(heatmap[0]))
+
+static inline int get_num_sources(Engine const *context) {
+    return 1 + context->numlayers + context->numsprites;
+}
+
+/* allocates per-source cost counters of a scan context */
+bool CreateScanOverdraw(ScanOverdraw *overdraw, int num_sources) {
+    memset(overdraw, 0, sizeof(ScanOverdraw));
+    overdraw->cost = (uint32_t *)calloc((size_t)num_sources, sizeof(uint32_t));
+    return overdraw->cost != NULL;
+}
+
+/* frees counters allocated by CreateScanOverdraw() */
+void DeleteScanOverdraw(ScanOverdraw *overdraw) {
+    free(overdraw->cost);
+    memset(overdraw, 0, sizeof(ScanOverdraw));
+}
+
+/* adds the per-source costs of a scan context to the engine and clears them */
+void MergeScanOverdraw(ScanOverdraw *overdraw) {
+    if (!overdraw->pending) {
+        return;
+    }
+    const int num_sources = get_num_sources(engine);
+    if (engine->overdraw.cost != NULL) {
+        for (int c = 0; c < num_sources; c++) {
+            engine->overdraw.cost[c] += overdraw->cost[c];
+        }
+    }
+    memset(overdraw->cost, 0, (size_t)num_sources * sizeof(uint32_t));
+    overdraw->pending = false;
+}
+
+/* starts counting the writes to a line when overdraw mode is enabled */
+void BeginOverdrawLine(ScanContext *ctx, int line) {
+    ScanOverdraw *overdraw = &ctx->overdraw;
+    if (engine->overdraw.mode == TLN_OVERDRAW_NONE) {
+        overdraw->writes = NULL;
+        return;
+    }
+    const int width = engine->framebuffer.width;
+    overdraw->writes = engine->overdraw.writes + ((ptrdiff_t)line * width);
+    overdraw->sources = engine->overdraw.sources + ((ptrdiff_t)line * width);
+    memset(overdraw->writes, 0, (size_t)width * sizeof(uint16_t));
+    memset(overdraw->sources, -1, (size_t)width * sizeof(int32_t));
+}
+
+/* stops counting, and replaces the line with its heatmap when requested.
+ * Mosaic lines built ahead of a band aren't counted */
+void EndOverdrawLine(ScanContext *ctx, int line) {
+    ScanOverdraw *overdraw = &ctx->overdraw;
+    if (overdraw->writes == NULL) {
+        return;
+    }
+    if (engine->overdraw.mode == TLN_OVERDRAW_HEATMAP) {
+        uint32_t *scan = GetFramebufferLine(line);
+        for (int c = 0; c < engine->framebuffer.width; c++) {
+            const int writes = overdraw->writes[c];
+            scan[c] = heatmap[writes < HEATMAP_SIZE ? writes : HEATMAP_SIZE - 1];
+        }
+    }
+    overdraw->writes = NULL;
+    overdraw->sources = NULL;
+}
+
+/* clears per-source costs for a new frame */
+void BeginOverdrawFrame(void) {
+    if (engine->overdraw.cost != NULL) {
+        memset(engine->overdraw.cost, 0, (size_t)get_num_sources(engine) * sizeof(uint32_t));
+    }
+}
+
+/* frees overdraw buffers of an engine */
+void DeleteOverdraw(Engine *context) {
+    free(context->overdraw.writes);
+    free(context->overdraw.sources);
+    free(context->overdraw.cost);
+    memset(&context->overdraw, 0, sizeof(EngineOverdraw));
+}
+
+/*!
+ * \brief
+ * Enables the overdraw debug mode
+ *
+ * \param mode
+ * TLN_OVERDRAW_NONE to disable (default), TLN_OVERDRAW_COUNT to count the
+ * writes to each pixel, or TLN_OVERDRAW_HEATMAP to also replace the frame by
+ * a heatmap of them
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * Each span of pixels processed by a blitter counts as written, including
+ * transparent pixels, as they take the same time. Layers drawn to an
+ * intermediate buffer (transform, mosaic, blend mask) count once more when
+ * composed. The heatmap goes from black (not written) through blue, cyan,
+ * green, yellow, orange and red to white (7 writes or more). Counts are
+ * queried after drawing a frame with TLN_GetPixelOverdraw(),
+ * TLN_GetLayerPixelCost() and TLN_GetSpritePixelCost().
+ *
+ * \see
+ * TLN_GetPixelOverdraw()
+ */
+bool TLN_SetOverdrawMode(TLN_OverdrawMode mode) {
+    if (mode < TLN_OVERDRAW_NONE || mode > TLN_OVERDRAW_HEATMAP) {
+        TLN_SetLastError(TLN_ERR_UNSUPPORTED);
+        return false;
+    }
+
+    EngineOverdraw *overdraw = &engine->overdraw;
+    if (mode == TLN_OVERDRAW_NONE) {
+        DeleteOverdraw(engine);
+    } else if (overdraw->writes == NULL) {
+        const size_t size = (size_t)engine->framebuffer.width * (size_t)engine->framebuffer.height;
+        overdraw->writes = (uint16_t *)calloc(size, sizeof(uint16_t));
+        overdraw->sources = (int32_t *)malloc(size * sizeof(int32_t));
+        overdraw->cost = (uint32_t *)calloc((size_t)get_num_sources(engine), sizeof(uint32_t));
+        if (!overdraw->writes || !overdraw->sources || !overdraw->cost) {
+            DeleteOverdraw(engine);
+            TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
+            return false;
+        }
+        memset(overdraw->sources, -1, size * sizeof(int32_t));
+    }
+    overdraw->mode = mode;
+    TLN_SetLastError(TLN_ERR_OK);
+    return true;
+}
+
+/*!
+ * \brief
+ * Returns how many times a pixel was written in the last frame, and by whom
+ *
+ * \param x
+ * Horizontal position in the framebuffer
+ *
+ * \param y
+ * Vertical position in the framebuffer
+ *
+ * \param info
+ * Pointer to a TLN_PixelOverdraw struct to fill
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * Requires the overdraw mode enabled with TLN_SetOverdrawMode(). A pixel last
+ * written by the background has both layer and sprite set to -1.
+ *
+ * \see
+ * TLN_SetOverdrawMode()
+ */
+bool TLN_GetPixelOverdraw(int x, int y, TLN_PixelOverdraw *info) {
+    if (info == NULL) {
+        TLN_SetLastError(TLN_ERR_NULL_POINTER);
+        return false;
+    }
+    memset(info, 0, sizeof(TLN_PixelOverdraw));
+    info->layer = info->sprite = -1;
+    if (engine->overdraw.writes == NULL) {
+        TLN_SetLastError(TLN_ERR_UNSUPPORTED);
+        return false;
+    }
+    if (x < 0 || y < 0 || x >= engine->framebuffer.width || y >= engine->framebuffer.height) {
+        TLN_SetLastError(TLN_ERR_WRONG_SIZE);
+        return false;
+    }
+
+    const ptrdiff_t offset = ((ptrdiff_t)y * engine->framebuffer.width) + x;
+    const int source = engine->overdraw.sources[offset];
+    info->writes = engine->overdraw.writes[offset];
+    if (source >= OVERDRAW_SPRITE(0)) {
+        info->sprite = source - OVERDRAW_SPRITE(0);
+    } else if (source >= OVERDRAW_LAYER(0)) {
+        info->layer = source - OVERDRAW_LAYER(0);
+    }
+    TLN_SetLastError(TLN_ERR_OK);
+    return true;
+}
+
+/*!
+ * \brief
+ * Returns the number of pixels written by a layer in the last frame
+ *
+ * \param nlayer
+ * Layer index [0, num_layers - 1]
+ *
+ * \returns
+ * pixels written, counting overdraw, or -1 if error
+ *
+ * \remarks
+ * Requires the overdraw mode enabled with TLN_SetOverdrawMode(). A layer
+ * writing many more pixels than it shows is a candidate to be culled or
+ * reordered.
+ *
+ * \see
+ * TLN_GetSpritePixelCost()
+ */
+int TLN_GetLayerPixelCost(int nlayer) {
+    if (nlayer < 0 || nlayer >= engine->numlayers) {
+        TLN_SetLastError(TLN_ERR_IDX_LAYER);
+        return -1;
+    }
+    if (engine->overdraw.cost == NULL) {
+        TLN_SetLastError(TLN_ERR_UNSUPPORTED);
+        return -1;
+    }
+    TLN_SetLastError(TLN_ERR_OK);
+    return (int)engine->overdraw.cost[OVERDRAW_LAYER(nlayer)];
+}
+
+/*!
+ * \brief
+ * Returns the number of pixels written by a sprite in the last frame
+ *
+ * \param nsprite
+ * Sprite index [0, num_sprites - 1]
+ *
+ * \returns
+ * pixels written, counting transparent ones, or -1 if error
+ *
+ * \remarks
+ * Requires the overdraw mode enabled with TLN_SetOverdrawMode(). Sprites
+ * costing much more than their visible area have transparent borders worth
+ * trimming.
+ *
+ * \see
+ * TLN_GetLayerPixelCost()
+ */
+int TLN_GetSpritePixelCost(int nsprite) {
+    if (nsprite < 0 || nsprite >= engine->numsprites) {
+        TLN_SetLastError(TLN_ERR_IDX_SPRITE);
+        return -1;
+    }
+    if (engine->overdraw.cost == NULL) {
+        TLN_SetLastError(TLN_ERR_UNSUPPORTED);
+        return -1;
+    }
+    TLN_SetLastError(TLN_ERR_OK);
+    return (int)engine->overdraw.cost[OVERDRAW_SPRITE(nsprite)];
+}
@@ -0,0 +1,72 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* overdraw debug mode (see TLN_SetOverdrawMode). Drawing code reports each
+ * span written by a blitter with CountOverdraw(), which does nothing unless
+ * the mode is enabled */
+
+#ifndef OVERDRAW_H
+#define OVERDRAW_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "Tilengine.h"
+
+typedef struct ScanContext ScanContext;
+
+/* sources that write pixels: the background, then layers, then sprites */
+#define OVERDRAW_BACKGROUND 0
+#define OVERDRAW_LAYER(nlayer) (1 + (nlayer))
+#define OVERDRAW_SPRITE(nsprite) (1 + engine->numlayers + (nsprite))
+
+/* overdraw counters of a scan context */
+typedef struct {
+    uint16_t *writes;  /* writes to each pixel of the line, NULL when not counting */
+    int32_t *sources;  /* source that last wrote each pixel of the line */
+    uint32_t *cost;    /* pixels written by each source, pending merge */
+    bool pending;      /* cost has counts to merge */
+} ScanOverdraw;
+
+/* overdraw state of an engine */
+typedef struct {
+    TLN_OverdrawMode mode;
+    uint16_t *writes; /* writes to each framebuffer pixel */
+    int32_t *sources; /* source that last wrote each framebuffer pixel, -1 if none */
+    uint32_t *cost;   /* pixels written by each source in the frame */
+} EngineOverdraw;
+
+/* counts a span of width pixels from x written by source */
+static inline void CountOverdraw(ScanOverdraw *overdraw, int source, int x, int width) {
+    if (overdraw->writes == NULL || width <= 0) {
+        return;
+    }
+    uint16_t *writes = overdraw->writes + x;
+    int32_t *sources = overdraw->sources + x;
+    for (int c = 0; c < width; c++) {
+        if (writes[c] != UINT16_MAX) {
+            writes[c] += 1;
+        }
+        sources[c] = source;
+    }
+    overdraw->cost[source] += (uint32_t)width;
+    overdraw->pending = true;
+}
+
+bool CreateScanOverdraw(ScanOverdraw *overdraw, int num_sources);
+void DeleteScanOverdraw(ScanOverdraw *overdraw);
+void MergeScanOverdraw(ScanOverdraw *overdraw);
+void BeginOverdrawLine(ScanContext *ctx, int line);
+void EndOverdrawLine(ScanContext *ctx, int line);
+void BeginOverdrawFrame(void);
+void DeleteOverdraw(struct Engine *context);
+
+#endif
@@ -13,7 +13,10 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "AssetCache.h"
+#include "RasterCapture.h"
 #include "Tables.h"
+#include "TileCache.h"
 #include "Tilengine.h"
 
 /*!
@@ -34,6 +37,7 @@ TLN_Palette TLN_CreatePalette(int entries) {
     palette = (TLN_Palette)CreateBaseObject(OT_PALETTE, size);
     if (palette) {
         palette->entries = entries;
+        palette->version = NewTileCacheVersion();
         TLN_SetLastError(TLN_ERR_OK);
         return palette;
     }
@@ -62,6 +66,7 @@ TLN_Palette TLN_ClonePalette(TLN_Palette src) {
 
     palette = (TLN_Palette)CloneBaseObject(src);
     if (palette) {
+        palette->version = NewTileCacheVersion();
         TLN_SetLastError(TLN_ERR_OK);
         return palette;
     }
@@ -80,6 +85,10 @@ TLN_Palette TLN_ClonePalette(TLN_Palette src) {
  */
 bool TLN_DeletePalette(TLN_Palette palette) {
     if (CheckBaseObject(palette, OT_PALETTE)) {
+        if (ReleaseAsset(palette)) {
+            TLN_SetLastError(TLN_ERR_OK);
+            return true;
+        }
         DeleteBaseObject(palette);
         TLN_SetLastError(TLN_ERR_OK);
         return true;
@@ -108,6 +117,7 @@ bool TLN_DeletePalette(TLN_Palette palette) {
  */
 bool TLN_SetPaletteColor(TLN_Palette palette, int index, uint8_t r, uint8_t g, uint8_t b) {
     if ((int)CheckBaseObject(palette, OT_PALETTE) && index < palette->entries) {
+        TouchPalette(palette);
         Color *color = (Color *)GetPaletteData(palette, index);
         if (index == 0) {
             color->value = 0;
@@ -135,6 +145,10 @@ bool TLN_SetPaletteColor(TLN_Palette palette, int index, uint8_t r, uint8_t g, u
  *
  * \returns
  * 32-bit integer with the packed color in internal pixel format RGBA
+ *
+ * \remarks
+ * Colors written through the returned pointer must be followed by a call to
+ * TLN_UpdatePalette() before the next frame is drawn.
  */
 uint8_t *TLN_GetPaletteData(TLN_Palette palette, int index) {
     if (!CheckBaseObject(palette, OT_PALETTE)) {
@@ -177,9 +191,9 @@ bool TLN_MixPalettes(TLN_Palette src1, TLN_Palette src2, TLN_Palette dst, uint8_
         return false;
     }
 
-    src1ptr = TLN_GetPaletteData(src1, 0);
-    src2ptr = TLN_GetPaletteData(src2, 0);
-    dstptr = TLN_GetPaletteData(dst, 0);
+    src1ptr = (uint8_t const *)GetPaletteData(src1, 0);
+    src2ptr = (uint8_t const *)GetPaletteData(src2, 0);
+    dstptr = (uint8_t *)GetPaletteData(dst, 0);
     blend_table = SelectBlendTable(BLEND_MOD);
 
     if (src1->entries > src2->entries) {
@@ -187,6 +201,7 @@ bool TLN_MixPalettes(TLN_Palette src1, TLN_Palette src2, TLN_Palette dst, uint8_
     } else {
         count = src2->entries;
     }
+    TouchPalette(dst);
 
     for (int c = 0; c < count; c++) {
         dstptr[0] = blendfunc(blend_table, src2ptr[0], factor) +
@@ -204,6 +219,38 @@ bool TLN_MixPalettes(TLN_Palette src1, TLN_Palette src2, TLN_Palette dst, uint8_
     return true;
 }
 
+/*!
+ * \brief
+ * Notifies that the colors of a palette have been modified
+ *
+ * \param palette
+ * Reference to the modified palette
+ *
+ * \remarks
+ * Call it after writing colors through the pointer returned by
+ * TLN_GetPaletteData(), so that tiles cached with the previous colors are
+ * discarded. Inside the raster callback in capture mode, call it before
+ * writing instead, so that the previous colors are recorded.
+ *
+ * \see
+ * TLN_GetPaletteData(), TLN_SetRasterCapture()
+ */
+bool TLN_UpdatePalette(TLN_Palette palette) {
+    if (!CheckBaseObject(palette, OT_PALETTE)) {
+        return false;
+    }
+    TouchPalette(palette);
+    TLN_SetLastError(TLN_ERR_OK);
+    return true;
+}
+
+/* marks palette colors as about to be modified: tracks them for raster capture
+ * and invalidates the tiles cached with the current colors */
+void TouchPalette(TLN_Palette palette) {
+    CaptureRasterState(&palette->version, (palette->entries + 1) * (int)sizeof(uint32_t));
+    palette->version = NewTileCacheVersion();
+}
+
 /* edits color range according to blend table */
 static bool EditPaletteColor(TLN_Palette palette, uint8_t const *blend_table, uint8_t r, uint8_t g,
                              uint8_t b, uint8_t start, uint8_t num) {
@@ -224,7 +271,8 @@ static bool EditPaletteColor(TLN_Palette palette, uint8_t const *blend_table, ui
         end = palette->entries - 1;
     }
 
-    color_ptr = TLN_GetPaletteData(palette, start);
+    TouchPalette(palette);
+    color_ptr = (uint8_t *)GetPaletteData(palette, start);
     for (int c = start; c <= end; c++) {
         color_ptr[0] = blendfunc(blend_table, color_ptr[0], r);
         color_ptr[1] = blendfunc(blend_table, color_ptr[1], g);
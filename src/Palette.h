@@ -12,6 +12,7 @@
 #define PALETTE_H
 
 #include "Object.h"
+#include "Tilengine.h"
 
 /* color definition */
 typedef union {
@@ -27,13 +28,16 @@ typedef union {
 /* palette object */
 struct Palette {
     DEFINE_OBJECT;
-    int entries;     /* number of colors */
-    uint32_t data[]; /* variable size Color array */
+    int entries;      /* number of colors */
+    uint32_t version; /* changes with colors, see TileCache.c. Precedes data */
+    uint32_t data[];  /* variable size Color array */
 };
 
 /* returns pointer to specified index color definition */
 #define GetPaletteData(palette, index) &(palette)->data[index]
 
+void TouchPalette(TLN_Palette palette);
+
 #define PackRGB32(r, g, b) (uint32_t)(0xFF000000 | ((r) << 16) | ((g) << 8) | (b))
 
 #endif
@@ -0,0 +1,185 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* frame statistics: each scan context counts privately while drawing, and
+ * MergeScanContext() adds its counters to the engine. When the frame ends they
+ * become the statistics of the last frame, with times converted to ns */
+
+#include "Profile.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "Engine.h"
+#include "Tilengine.h"
+
+#ifdef TLN_PROFILE
+
+/* allocates per-layer counters */
+bool CreateFrameCounters(FrameCounters *counters, int numlayers) {
+    memset(counters, 0, sizeof(FrameCounters));
+    if (numlayers > 0) {
+        counters->layers = (TLN_LayerStats *)calloc((size_t)numlayers, sizeof(TLN_LayerStats));
+        return counters->layers != NULL;
+    }
+    return true;
+}
+
+/* frees counters allocated by CreateFrameCounters() */
+void DeleteFrameCounters(FrameCounters *counters) {
+    free(counters->layers);
+    memset(counters, 0, sizeof(FrameCounters));
+}
+
+/* adds src counters to dst and clears them */
+void MergeFrameCounters(FrameCounters *dst, FrameCounters *src, int numlayers) {
+    uint64_t *dstvalue = (uint64_t *)&dst->frame;
+    uint64_t *srcvalue = (uint64_t *)&src->frame;
+    for (size_t c = 0; c < sizeof(TLN_FrameStats) / sizeof(uint64_t); c++) {
+        dstvalue[c] += srcvalue[c];
+    }
+    memset(&src->frame, 0, sizeof(TLN_FrameStats));
+
+    if (src->layers == NULL || dst->layers == NULL) {
+        return;
+    }
+    dstvalue = (uint64_t *)dst->layers;
+    srcvalue = (uint64_t *)src->layers;
+    const size_t count = (size_t)numlayers * sizeof(TLN_LayerStats) / sizeof(uint64_t);
+    for (size_t c = 0; c < count; c++) {
+        dstvalue[c] += srcvalue[c];
+    }
+    memset(src->layers, 0, (size_t)numlayers * sizeof(TLN_LayerStats));
+}
+
+/* starts counting a new frame */
+void BeginFrameStats(void) {
+    EngineStats *stats = &engine->stats;
+    memset(&stats->current.frame, 0, sizeof(TLN_FrameStats));
+    if (stats->current.layers != NULL) {
+        memset(stats->current.layers, 0, (size_t)engine->numlayers * sizeof(TLN_LayerStats));
+    }
+    stats->start = SDL_GetPerformanceCounter();
+}
+
+/* converts performance counter ticks to ns */
+static inline uint64_t ticks_to_ns(uint64_t ticks, uint64_t frequency) {
+    const uint64_t ns = 1000000000ULL;
+    return ((ticks / frequency) * ns) + ((ticks % frequency) * ns / frequency);
+}
+
+/* ends the frame: layer counters are added to frame totals, and all become
+ * the statistics of the last frame */
+void EndFrameStats(void) {
+    EngineStats *stats = &engine->stats;
+    TLN_FrameStats *frame = &stats->current.frame;
+    const uint64_t frequency = SDL_GetPerformanceFrequency();
+
+    frame->frame_ns = SDL_GetPerformanceCounter() - stats->start;
+    frame->frame_ns = ticks_to_ns(frame->frame_ns, frequency);
+    frame->raster_ns = ticks_to_ns(frame->raster_ns, frequency);
+    frame->background_ns = ticks_to_ns(frame->background_ns, frequency);
+    frame->layers_ns = ticks_to_ns(frame->layers_ns, frequency);
+    frame->sprites_ns = ticks_to_ns(frame->sprites_ns, frequency);
+    frame->priority_ns = ticks_to_ns(frame->priority_ns, frequency);
+    frame->blend_mask_ns = ticks_to_ns(frame->blend_mask_ns, frequency);
+
+    for (int c = 0; c < engine->numlayers && stats->current.layers != NULL; c++) {
+        TLN_LayerStats *layer = &stats->current.layers[c];
+        layer->time_ns = ticks_to_ns(layer->time_ns, frequency);
+        frame->pixels += layer->pixels;
+        frame->culled_pixels += layer->culled_pixels;
+        frame->tiles += layer->tiles;
+        frame->empty_tiles += layer->empty_tiles;
+        frame->blits += layer->blits;
+    }
+
+    /* swap buffers instead of copying layers */
+    FrameCounters last = stats->last;
+    stats->last = stats->current;
+    stats->current = last;
+}
+
+#endif
+
+/*!
+ * \brief
+ * Returns statistics of the last frame drawn
+ *
+ * \param stats
+ * Pointer to a TLN_FrameStats struct to fill
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * Statistics are only collected when the library is built with TLN_PROFILE
+ * defined (CMake option TLN_PROFILE), otherwise this function fails with
+ * TLN_ERR_UNSUPPORTED and drawing has no profiling overhead. Times of the
+ * drawing phases are added across render threads, so with more than one
+ * thread their sum may exceed frame_ns.
+ *
+ * \see
+ * TLN_GetLayerStats(), TLN_UpdateFrame()
+ */
+bool TLN_GetFrameStats(TLN_FrameStats *stats) {
+    if (stats == NULL) {
+        TLN_SetLastError(TLN_ERR_NULL_POINTER);
+        return false;
+    }
+#ifdef TLN_PROFILE
+    *stats = engine->stats.last.frame;
+    TLN_SetLastError(TLN_ERR_OK);
+    return true;
+#else
+    memset(stats, 0, sizeof(TLN_FrameStats));
+    TLN_SetLastError(TLN_ERR_UNSUPPORTED);
+    return false;
+#endif
+}
+
+/*!
+ * \brief
+ * Returns statistics of a layer in the last frame drawn
+ *
+ * \param nlayer
+ * Layer index [0, num_layers - 1]
+ *
+ * \param stats
+ * Pointer to a TLN_LayerStats struct to fill
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * Like TLN_GetFrameStats(), requires the library built with TLN_PROFILE
+ *
+ * \see
+ * TLN_GetFrameStats()
+ */
+bool TLN_GetLayerStats(int nlayer, TLN_LayerStats *stats) {
+    if (stats == NULL) {
+        TLN_SetLastError(TLN_ERR_NULL_POINTER);
+        return false;
+    }
+    memset(stats, 0, sizeof(TLN_LayerStats));
+    if (nlayer < 0 || nlayer >= engine->numlayers) {
+        TLN_SetLastError(TLN_ERR_IDX_LAYER);
+        return false;
+    }
+#ifdef TLN_PROFILE
+    *stats = engine->stats.last.layers[nlayer];
+    TLN_SetLastError(TLN_ERR_OK);
+    return true;
+#else
+    TLN_SetLastError(TLN_ERR_UNSUPPORTED);
+    return false;
+#endif
+}
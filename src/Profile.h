@@ -0,0 +1,69 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* frame statistics for TLN_GetFrameStats(). Only collected when the library
+ * is built with TLN_PROFILE defined, otherwise the PROFILE_* macros expand to
+ * nothing and drawing doesn't read any clock */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "Tilengine.h"
+
+/* counters gathered by a scan context or an engine. Times are kept in
+ * performance counter ticks until the frame ends */
+typedef struct {
+    TLN_FrameStats frame;
+    TLN_LayerStats *layers; /* one per engine layer */
+} FrameCounters;
+
+#ifdef TLN_PROFILE
+
+#include <SDL3/SDL_timer.h>
+
+/* declares a variable holding the current time in ticks */
+#define PROFILE_TICKS(name) const uint64_t name = SDL_GetPerformanceCounter()
+
+/* adds value to a frame counter of ctx */
+#define PROFILE_COUNT(ctx, field, value) ((ctx)->stats.frame.field += (uint64_t)(value))
+
+/* adds value to a layer counter of ctx */
+#define PROFILE_LAYER(ctx, nlayer, field, value)                                                 \
+    ((ctx)->stats.layers[nlayer].field += (uint64_t)(value))
+
+bool CreateFrameCounters(FrameCounters *counters, int numlayers);
+void DeleteFrameCounters(FrameCounters *counters);
+void MergeFrameCounters(FrameCounters *dst, FrameCounters *src, int numlayers);
+void BeginFrameStats(void);
+void EndFrameStats(void);
+
+#else
+
+#define PROFILE_TICKS(name)
+#define PROFILE_COUNT(ctx, field, value) ((void)0)
+#define PROFILE_LAYER(ctx, nlayer, field, value) ((void)0)
+
+static inline bool CreateFrameCounters(FrameCounters *counters [[maybe_unused]],
+                                       int numlayers [[maybe_unused]]) {
+    return true;
+}
+static inline void DeleteFrameCounters(FrameCounters *counters [[maybe_unused]]) {}
+static inline void MergeFrameCounters(FrameCounters *dst [[maybe_unused]],
+                                      FrameCounters *src [[maybe_unused]],
+                                      int numlayers [[maybe_unused]]) {}
+static inline void BeginFrameStats(void) {}
+static inline void EndFrameStats(void) {}
+
+#endif
+
+#endif
@@ -0,0 +1,453 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* raster capture: runs the raster callback for all scanlines before drawing and
+ * records the state changes it makes as a per-line stream of commands, each one
+ * a byte range patch of a tracked state region. Replaying the stream over a
+ * private copy of the engine state reproduces the state each scanline must be
+ * drawn with, so scanlines can be drawn in any order, in parallel, or drawn
+ * again without calling back into the application */
+
+#include "RasterCapture.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Draw.h"
+#include "Engine.h"
+#include "RenderThreads.h"
+#include "Tilengine.h"
+#include "Trace.h"
+
+#define MAX_GAP 8 /* unchanged bytes merged into a single command */
+
+/* owner of a tracked state region */
+typedef enum {
+    REGION_ENGINE,   /* field of Engine struct, index is offset */
+    REGION_LAYER,    /* Layer struct, index is layer number */
+    REGION_EXTERNAL, /* object data shared with application, like palette colors */
+} RegionOwner;
+
+typedef struct {
+    RegionOwner owner;
+    int index;
+    uint8_t *ptr;     /* live state */
+    int size;         /* size in bytes */
+    uint8_t *initial; /* state at frame start */
+    uint8_t *shadow;  /* state after last captured line */
+    bool changed;     /* has commands in current stream */
+} RasterRegion;
+
+/* patch of a state region applied before drawing a scanline */
+typedef struct {
+    uint16_t line;
+    uint16_t region;
+    uint32_t offset;
+    uint32_t size;
+    uint32_t data; /* offset in data pool */
+} RasterCommand;
+
+typedef struct RasterCapture {
+    bool capturing;
+    bool valid; /* stream holds a complete frame */
+    bool failed;
+    int num_fixed; /* engine regions, tracked from creation */
+    int num_regions;
+    int max_regions;
+    RasterRegion *regions;
+    int num_commands;
+    int max_commands;
+    RasterCommand *commands;
+    uint32_t data_size;
+    uint32_t max_data;
+    uint8_t *data;
+    int *line_start; /* first command of each line, plus end of stream */
+} RasterCapture;
+
+/* starts tracking a state region */
+static bool add_region(RasterCapture *cap, RegionOwner owner, int index, void *ptr, int size) {
+    if (cap->num_regions == cap->max_regions) {
+        int max_regions = cap->max_regions ? cap->max_regions * 2 : 16;
+        RasterRegion *regions =
+            (RasterRegion *)realloc(cap->regions, (size_t)max_regions * sizeof(RasterRegion));
+        if (regions == NULL) {
+            return false;
+        }
+        cap->regions = regions;
+        cap->max_regions = max_regions;
+    }
+
+    RasterRegion *region = &cap->regions[cap->num_regions];
+    region->initial = (uint8_t *)malloc((size_t)size * 2);
+    if (region->initial == NULL) {
+        return false;
+    }
+    region->owner = owner;
+    region->index = index;
+    region->ptr = (uint8_t *)ptr;
+    region->size = size;
+    region->shadow = region->initial + size;
+    region->changed = false;
+    memcpy(region->initial, ptr, (size_t)size);
+    memcpy(region->shadow, ptr, (size_t)size);
+    cap->num_regions += 1;
+    return true;
+}
+
+/* stops tracking regions added after index */
+static void remove_regions(RasterCapture *cap, int index) {
+    while (cap->num_regions > index) {
+        cap->num_regions -= 1;
+        free(cap->regions[cap->num_regions].initial);
+    }
+}
+
+/* returns region storage inside the given engine state */
+static uint8_t *get_region_ptr(RasterRegion const *region, Engine *view) {
+    switch (region->owner) {
+    case REGION_ENGINE:
+        return (uint8_t *)view + region->index;
+    case REGION_LAYER:
+        return (uint8_t *)&view->layers[region->index];
+    default:
+        return region->ptr;
+    }
+}
+
+/* appends a command patching size bytes of region at offset */
+static bool add_command(RasterCapture *cap, int line, int nregion, int offset, int size) {
+    RasterRegion *region = &cap->regions[nregion];
+
+    if (cap->num_commands == cap->max_commands) {
+        int max_commands = cap->max_commands ? cap->max_commands * 2 : 256;
+        RasterCommand *commands =
+            (RasterCommand *)realloc(cap->commands, (size_t)max_commands * sizeof(RasterCommand));
+        if (commands == NULL) {
+            return false;
+        }
+        cap->commands = commands;
+        cap->max_commands = max_commands;
+    }
+    if (cap->data_size + (uint32_t)size > cap->max_data) {
+        uint32_t max_data = cap->max_data ? cap->max_data : 4096;
+        while (cap->data_size + (uint32_t)size > max_data) {
+            max_data *= 2;
+        }
+        uint8_t *data = (uint8_t *)realloc(cap->data, max_data);
+        if (data == NULL) {
+            return false;
+        }
+        cap->data = data;
+        cap->max_data = max_data;
+    }
+
+    RasterCommand *command = &cap->commands[cap->num_commands];
+    command->line = (uint16_t)line;
+    command->region = (uint16_t)nregion;
+    command->offset = (uint32_t)offset;
+    command->size = (uint32_t)size;
+    command->data = cap->data_size;
+    memcpy(cap->data + cap->data_size, region->ptr + offset, (size_t)size);
+    memcpy(region->shadow + offset, region->ptr + offset, (size_t)size);
+    cap->data_size += (uint32_t)size;
+    cap->num_commands += 1;
+    region->changed = true;
+    return true;
+}
+
+/* records the changes of a region since the previous line */
+static bool capture_region(RasterCapture *cap, int line, int nregion) {
+    RasterRegion const *region = &cap->regions[nregion];
+    uint8_t const *live = region->ptr;
+    uint8_t const *shadow = region->shadow;
+
+    if (memcmp(live, shadow, (size_t)region->size) == 0) {
+        return true;
+    }
+
+    int offset = 0;
+    while (offset < region->size) {
+        if (live[offset] == shadow[offset]) {
+            offset += 1;
+            continue;
+        }
+
+        /* extend run until MAX_GAP consecutive unchanged bytes */
+        int end = offset + 1;
+        int gap = 0;
+        while (end + gap < region->size && gap < MAX_GAP) {
+            if (live[end + gap] != shadow[end + gap]) {
+                end += gap + 1;
+                gap = 0;
+            } else {
+                gap += 1;
+            }
+        }
+        if (!add_command(cap, line, nregion, offset, end - offset)) {
+            return false;
+        }
+        offset = end;
+    }
+    return true;
+}
+
+/* runs the raster callback for all lines recording the state it modifies */
+static bool capture_frame(RasterCapture *cap) {
+    const int height = engine->framebuffer.height;
+
+    remove_regions(cap, cap->num_fixed);
+    for (int c = 0; c < cap->num_regions; c++) {
+        RasterRegion *region = &cap->regions[c];
+        memcpy(region->initial, region->ptr, (size_t)region->size);
+        memcpy(region->shadow, region->ptr, (size_t)region->size);
+        region->changed = false;
+    }
+    cap->num_commands = 0;
+    cap->data_size = 0;
+    cap->valid = false;
+    cap->failed = false;
+
+    cap->capturing = true;
+    for (int line = 0; line < height && !cap->failed; line++) {
+        cap->line_start[line] = cap->num_commands;
+        engine->timing.line = line;
+        const uint64_t trace = TraceBegin(TRACE_LINE, line);
+        PROFILE_TICKS(t0);
+        engine->callbacks.raster(line);
+        PROFILE_TICKS(t1);
+        PROFILE_COUNT(&engine->scan, raster_ns, t1 - t0);
+        TraceEnd(trace, "RasterCallback", "line", line);
+        PrepareScanlines();
+        for (int c = 0; c < cap->num_regions && !cap->failed; c++) {
+            cap->failed = !capture_region(cap, line, c);
+        }
+    }
+    cap->line_start[height] = cap->num_commands;
+    cap->capturing = false;
+    cap->valid = !cap->failed;
+    return cap->valid;
+}
+
+/* applies the commands of a line to the given engine state */
+static void apply_line(RasterCapture const *cap, Engine *view, int line) {
+    for (int c = cap->line_start[line]; c < cap->line_start[line + 1]; c++) {
+        RasterCommand const *command = &cap->commands[c];
+        uint8_t *dst = get_region_ptr(&cap->regions[command->region], view);
+        memcpy(dst + command->offset, cap->data + command->data, command->size);
+    }
+}
+
+/* draws scanlines [line1, line2) of the captured frame. Engine state is
+ * rewound to frame start in a private copy, and fast-forwarded to line1 */
+static void replay_scanlines(ScanContext *ctx, int line1, int line2) {
+    RasterCapture const *cap = engine->capture;
+    Engine *view = ctx->replay;
+    Layer *layers = (Layer *)(view + 1);
+
+    memcpy(view, engine, sizeof(Engine));
+    view->layers = layers;
+    for (int c = 0; c < cap->num_regions; c++) {
+        RasterRegion const *region = &cap->regions[c];
+        if (region->owner != REGION_EXTERNAL) {
+            memcpy(get_region_ptr(region, view), region->initial, (size_t)region->size);
+        }
+    }
+
+    ctx->view = view;
+    for (int line = 0; line < line1; line++) {
+        apply_line(cap, view, line);
+        PrimeMosaicLines(ctx, line, line1);
+    }
+    for (int line = line1; line < line2; line++) {
+        apply_line(cap, view, line);
+        ComposeScanline(ctx, line);
+    }
+    ctx->view = engine;
+}
+
+/* draws the captured frame, in parallel when the stream only touches
+ * engine-owned state that can be copied per thread */
+static void replay_frame(RasterCapture *cap) {
+    bool external = false;
+    for (int c = cap->num_fixed; c < cap->num_regions; c++) {
+        external |= cap->regions[c].changed;
+    }
+    if (!external && DrawBandsThreaded(replay_scanlines)) {
+        return;
+    }
+
+    /* external state is live: keep current value and rewind to frame start */
+    for (int c = cap->num_fixed; c < cap->num_regions; c++) {
+        RasterRegion *region = &cap->regions[c];
+        memcpy(region->shadow, region->ptr, (size_t)region->size);
+        memcpy(region->ptr, region->initial, (size_t)region->size);
+    }
+    replay_scanlines(&engine->scan, 0, engine->framebuffer.height);
+    MergeScanContext(&engine->scan);
+    for (int c = cap->num_fixed; c < cap->num_regions; c++) {
+        RasterRegion *region = &cap->regions[c];
+        memcpy(region->ptr, region->shadow, (size_t)region->size);
+    }
+    engine->timing.line = engine->framebuffer.height;
+}
+
+/* draws the frame capturing the raster callback when capture is enabled.
+ * Returns false if the frame must be drawn the regular way */
+bool DrawFrameCaptured(void) {
+    RasterCapture *cap = engine->capture;
+    if (cap == NULL || engine->callbacks.raster == NULL) {
+        return false;
+    }
+    if (!capture_frame(cap)) {
+        TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
+        return false;
+    }
+    replay_frame(cap);
+    return true;
+}
+
+/* starts tracking state outside the engine that is about to be modified
+ * while the raster callback is being captured */
+void CaptureRasterState(void *ptr, int size) {
+    if (engine == NULL || engine->capture == NULL || !engine->capture->capturing) {
+        return;
+    }
+
+    RasterCapture *cap = engine->capture;
+    for (int c = cap->num_fixed; c < cap->num_regions; c++) {
+        if (cap->regions[c].ptr == ptr) {
+            return;
+        }
+    }
+    if (!add_region(cap, REGION_EXTERNAL, 0, ptr, size)) {
+        cap->failed = true;
+    }
+}
+
+/* releases raster capture owned by context, if any */
+void DeleteRasterCapture(Engine *context) {
+    RasterCapture *cap = context->capture;
+    if (cap == NULL) {
+        return;
+    }
+    remove_regions(cap, 0);
+    free(cap->regions);
+    free(cap->commands);
+    free(cap->data);
+    free(cap->line_start);
+    free(cap);
+    context->capture = NULL;
+}
+
+/* creates raster capture tracking all engine-owned raster state */
+static RasterCapture *create_capture(void) {
+    RasterCapture *cap = (RasterCapture *)calloc(1, sizeof(RasterCapture));
+    if (cap == NULL) {
+        return NULL;
+    }
+    engine->capture = cap;
+
+    bool ok = true;
+    cap->line_start = (int *)calloc((size_t)engine->framebuffer.height + 1, sizeof(int));
+    ok &= cap->line_start != NULL;
+    ok &= add_region(cap, REGION_ENGINE, offsetof(Engine, bg), &engine->bg,
+                     sizeof(engine->bg));
+    ok &= add_region(cap, REGION_ENGINE, offsetof(Engine, palettes), engine->palettes,
+                     sizeof(engine->palettes));
+    ok &= add_region(cap, REGION_ENGINE, offsetof(Engine, sprite_mask), &engine->sprite_mask,
+                     sizeof(engine->sprite_mask));
+    for (int c = 0; c < engine->numlayers && ok; c++) {
+        ok &= add_region(cap, REGION_LAYER, c, &engine->layers[c], sizeof(Layer));
+    }
+    if (!ok) {
+        DeleteRasterCapture(engine);
+        return NULL;
+    }
+    cap->num_fixed = cap->num_regions;
+    return cap;
+}
+
+/*!
+ * \brief
+ * Enables or disables raster capture mode
+ *
+ * \param enable
+ * true to enable capture, false to disable
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * In capture mode TLN_UpdateFrame() runs the raster callback for all scanlines
+ * before drawing, and records the changes it makes to layers, background,
+ * sprite mask, global palettes and palette colors into a per-line command
+ * stream. The frame is then drawn replaying the stream, in parallel when
+ * TLN_SetRenderThreads() is set and no palette colors were modified. Sprite
+ * changes and direct writes to user memory like column offset tables are not
+ * recorded: they take effect for the whole frame.
+ *
+ * \see
+ * TLN_ReplayFrame(), TLN_SetRasterCallback()
+ */
+bool TLN_SetRasterCapture(bool enable) {
+    if (!enable) {
+        DeleteRasterCapture(engine);
+    } else if (engine->capture == NULL && create_capture() == NULL) {
+        TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
+        return false;
+    }
+    TLN_SetLastError(TLN_ERR_OK);
+    return true;
+}
+
+/*!
+ * \brief
+ * Draws again the last captured frame without calling the raster callback
+ *
+ * \returns
+ * true if success or false if there isn't any captured frame
+ *
+ * \remarks
+ * Layers, background, sprite mask and palettes are drawn as they were when
+ * the frame was captured, the rest of the state is the current one. Engine
+ * state is not modified. Palettes modified by the raster callback must not be
+ * deleted while the captured frame may be replayed.
+ *
+ * \see
+ * TLN_SetRasterCapture()
+ */
+bool TLN_ReplayFrame(void) {
+    RasterCapture *cap = engine->capture;
+    if (cap == NULL || !cap->valid) {
+        TLN_SetLastError(TLN_ERR_UNSUPPORTED);
+        return false;
+    }
+
+    if (engine->numsprites > 0) {
+        int index = engine->list_sprites.first;
+        while (index != -1) {
+            Sprite *sprite = &engine->sprites[index];
+            SetSpriteFlag(sprite, SPRITE_FLAG_COLLISION, false);
+            index = sprite->list_node.next;
+        }
+    }
+
+    SampleTraceFrame();
+    const uint64_t trace = TraceBegin(TRACE_FRAME, 0);
+    BeginFrameStats();
+    BeginOverdrawFrame();
+    PrepareScanlines();
+    replay_frame(cap);
+    EndFrameStats();
+    TraceEnd(trace, "ReplayFrame", NULL, 0);
+    TLN_SetLastError(TLN_ERR_OK);
+    return true;
+}
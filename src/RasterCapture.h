@@ -0,0 +1,22 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+#ifndef RASTERCAPTURE_H
+#define RASTERCAPTURE_H
+
+#include <stdbool.h>
+
+struct Engine;
+
+bool DrawFrameCaptured(void);
+void CaptureRasterState(void *ptr, int size);
+void DeleteRasterCapture(struct Engine *context);
+
+#endif
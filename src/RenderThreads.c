@@ -0,0 +1,244 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* band renderer: splits the frame in horizontal bands that are composed in
+ * parallel by the calling thread and a pool of persistent worker threads. Each
+ * thread owns a private ScanContext, shared engine state is only read */
+
+#include "RenderThreads.h"
+
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_cpuinfo.h>
+#include <SDL3/SDL_mutex.h>
+#include <SDL3/SDL_thread.h>
+#include <stdlib.h>
+
+#include "Draw.h"
+#include "Engine.h"
+#include "Tilengine.h"
+
+#define BANDS_PER_THREAD 4 /* finer split balances uneven scanline cost */
+#define MIN_BAND_HEIGHT 8  /* amortizes mosaic priming at band start */
+
+typedef struct RenderPool RenderPool;
+
+typedef struct {
+    SDL_Thread *thread;
+    SDL_Semaphore *start; /* signaled once per frame */
+    RenderPool *pool;
+    ScanContext scan;
+} RenderWorker;
+
+struct RenderPool {
+    int num_workers;
+    RenderWorker *workers;
+    SDL_Semaphore *done; /* signaled by each worker when out of bands */
+    SDL_AtomicInt next_band;
+    int band_height;
+    BandDrawPtr draw; /* band draw procedure for current frame */
+    bool quit;
+};
+
+/* draws bands until the frame is exhausted */
+static void draw_bands(RenderPool *pool, ScanContext *scan) {
+    const int height = engine->framebuffer.height;
+    while (true) {
+        const int line1 = SDL_AddAtomicInt(&pool->next_band, 1) * pool->band_height;
+        if (line1 >= height) {
+            return;
+        }
+        int line2 = line1 + pool->band_height;
+        if (line2 > height) {
+            line2 = height;
+        }
+        pool->draw(scan, line1, line2);
+    }
+}
+
+static int RenderWorkerThread(void *data) {
+    RenderWorker *worker = (RenderWorker *)data;
+    RenderPool *pool = worker->pool;
+    while (true) {
+        SDL_WaitSemaphore(worker->start);
+        if (pool->quit) {
+            break;
+        }
+        draw_bands(pool, &worker->scan);
+        SDL_SignalSemaphore(pool->done);
+    }
+    return 0;
+}
+
+/* stops worker threads and frees pool */
+static void delete_pool(RenderPool *pool) {
+    pool->quit = true;
+    for (int c = 0; c < pool->num_workers; c++) {
+        RenderWorker *worker = &pool->workers[c];
+        if (worker->thread != NULL) {
+            SDL_SignalSemaphore(worker->start);
+            SDL_WaitThread(worker->thread, NULL);
+        }
+        if (worker->start != NULL) {
+            SDL_DestroySemaphore(worker->start);
+        }
+        DeleteScanContext(&worker->scan);
+    }
+    if (pool->done != NULL) {
+        SDL_DestroySemaphore(pool->done);
+    }
+    free(pool->workers);
+    free(pool);
+}
+
+/* creates pool with num_workers threads besides the calling one */
+static RenderPool *create_pool(int num_workers) {
+    RenderPool *pool = (RenderPool *)calloc(1, sizeof(RenderPool));
+    if (pool == NULL) {
+        return NULL;
+    }
+
+    const int height = engine->framebuffer.height;
+    const int num_bands = (num_workers + 1) * BANDS_PER_THREAD;
+    pool->band_height = (height + num_bands - 1) / num_bands;
+    if (pool->band_height < MIN_BAND_HEIGHT) {
+        pool->band_height = MIN_BAND_HEIGHT;
+    }
+
+    pool->workers = (RenderWorker *)calloc((size_t)num_workers, sizeof(RenderWorker));
+    pool->done = SDL_CreateSemaphore(0);
+    if (pool->workers == NULL || pool->done == NULL) {
+        delete_pool(pool);
+        return NULL;
+    }
+
+    for (int c = 0; c < num_workers; c++) {
+        RenderWorker *worker = &pool->workers[c];
+        pool->num_workers += 1;
+        worker->pool = pool;
+        if (!CreateScanContext(&worker->scan, engine)) {
+            delete_pool(pool);
+            return NULL;
+        }
+        worker->start = SDL_CreateSemaphore(0);
+        if (worker->start != NULL) {
+            worker->thread = SDL_CreateThread(RenderWorkerThread, "TLN_Render", worker);
+        }
+        if (worker->thread == NULL) {
+            delete_pool(pool);
+            return NULL;
+        }
+    }
+    return pool;
+}
+
+/* draws the whole frame in bands shared between the calling thread and the
+ * worker pool. Returns false if there's no pool */
+bool DrawBandsThreaded(BandDrawPtr draw) {
+    RenderPool *pool = engine->pool;
+    if (pool == NULL) {
+        return false;
+    }
+
+    pool->draw = draw;
+    SDL_SetAtomicInt(&pool->next_band, 0);
+    for (int c = 0; c < pool->num_workers; c++) {
+        SDL_SignalSemaphore(pool->workers[c].start);
+    }
+    draw_bands(pool, &engine->scan);
+    for (int c = 0; c < pool->num_workers; c++) {
+        SDL_WaitSemaphore(pool->done);
+    }
+
+    /* sprite collisions gathered by each thread are ORed into sprite flags */
+    MergeScanContext(&engine->scan);
+    for (int c = 0; c < pool->num_workers; c++) {
+        MergeScanContext(&pool->workers[c].scan);
+    }
+    engine->timing.line = engine->framebuffer.height;
+    return true;
+}
+
+/* draws the whole frame with the worker pool. Returns false when the frame
+ * must be drawn serially with DrawScanline(): no pool, or a raster callback
+ * is set, as it may modify any state between two scanlines */
+bool DrawFrameThreaded(void) {
+    if (engine->pool == NULL || engine->callbacks.raster != NULL) {
+        return false;
+    }
+    PrepareScanlines();
+    return DrawBandsThreaded(DrawScanlines);
+}
+
+/* releases worker pool owned by context, if any */
+void DeleteRenderThreads(Engine *context) {
+    if (context->pool != NULL) {
+        delete_pool(context->pool);
+        context->pool = NULL;
+    }
+}
+
+/*!
+ * \brief
+ * Sets the number of threads used to draw each frame
+ *
+ * \param num_threads
+ * Total number of threads including the caller of TLN_UpdateFrame(). 1 draws
+ * serially in the calling thread (default), 0 uses one thread per CPU core
+ *
+ * \returns
+ * true if success or false if threads couldn't be created
+ *
+ * \remarks
+ * The frame is split in horizontal bands drawn in parallel, the output is
+ * identical to serial rendering. Frames with a raster callback set are drawn
+ * serially, as the callback may change any state between scanlines, unless
+ * raster capture is enabled: then the callback runs for all scanlines first
+ * and the recorded changes are replayed by each thread on its bands, see
+ * TLN_SetRasterCapture().
+ * Sprite collisions found by each thread are merged when the frame completes.
+ *
+ * \see
+ * TLN_GetRenderThreads(), TLN_UpdateFrame(), TLN_SetRasterCapture()
+ */
+bool TLN_SetRenderThreads(int num_threads) {
+    if (num_threads < 0) {
+        TLN_SetLastError(TLN_ERR_WRONG_SIZE);
+        return false;
+    }
+    if (num_threads == 0) {
+        num_threads = SDL_GetNumLogicalCPUCores();
+    }
+
+    DeleteRenderThreads(engine);
+    if (num_threads > 1) {
+        engine->pool = create_pool(num_threads - 1);
+        if (engine->pool == NULL) {
+            TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
+            return false;
+        }
+    }
+    TLN_SetLastError(TLN_ERR_OK);
+    return true;
+}
+
+/*!
+ * \brief
+ * Returns the number of threads used to draw each frame
+ *
+ * \see
+ * TLN_SetRenderThreads()
+ */
+int TLN_GetRenderThreads(void) {
+    TLN_SetLastError(TLN_ERR_OK);
+    if (engine->pool == NULL) {
+        return 1;
+    }
+    return engine->pool->num_workers + 1;
+}
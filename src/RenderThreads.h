@@ -0,0 +1,26 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+#ifndef RENDERTHREADS_H
+#define RENDERTHREADS_H
+
+#include <stdbool.h>
+
+struct Engine;
+typedef struct ScanContext ScanContext;
+
+/* draws scanlines [line1, line2) of a band */
+typedef void (*BandDrawPtr)(ScanContext *scan, int line1, int line2);
+
+bool DrawBandsThreaded(BandDrawPtr draw);
+bool DrawFrameThreaded(void);
+void DeleteRenderThreads(struct Engine *context);
+
+#endif
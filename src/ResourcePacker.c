@@ -15,12 +15,25 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(_WIN32)
+#include <io.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Crypto.h"
 #include "aes.h"
-#include "crc32.h"
 #include "md5.h"
+#include "zlib.h"
 
 #define KEY_SIZE 128
 #define FILE_ID "ResPack"
+#define RESPACK_VERSION 2 /* 0 = original format without compression */
+#define V1_ENTRY_SIZE (5 * sizeof(uint32_t))
 
 static uint8_t iv[AES_BLOCK_SIZE] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
                                      0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
@@ -32,29 +45,28 @@ typedef struct {
     uint32_t data_size; /* actual size of asset */
     uint32_t pack_size; /* size padded to 16-byte boundary, required by AES */
     uint32_t offset;    /* start of asset content */
+    uint32_t comp_size; /* size of zlib stream, 0 if stored uncompressed. Not in version 0 */
 } ResEntry;
 
 /* ResPack file header*/
 typedef struct {
     char id[8];        /* file header, must be "ResPack" null-terminated */
-    uint32_t reserved; /* reserved, for future usage */
+    uint32_t version;  /* format version, 0 or RESPACK_VERSION */
     uint32_t num_regs; /* number of assets */
 } ResHeader;
 
 /* private ResPack memory handler */
 struct ResPack {
-    FILE *pf;             /* file handler */
-    uint32_t key[60];     /* scheduled AES key*/
+    FILE *pf;             /* file handler, NULL if mapped */
+    const uint8_t *data;  /* whole pack mapped in memory, only when not encrypted */
+    size_t size;          /* size of mapped pack */
+    void *mapping;        /* platform mapping handle */
+    DecryptKey key;       /* AES round keys for decryption */
     uint32_t num_entries; /* number of assets */
     bool encrypted;       /* true if pack is encrypted */
-    ResEntry entries[];   /* array of ResEntry fields */
-};
-
-/* private opened asset memory handler */
-struct ResAsset {
-    FILE *pf;          /* file handler */
-    uint32_t size;     /* actual size of asset */
-    char filename[32]; /* temp filename */
+    uint32_t *buckets;    /* hash index of entries, index + 1 or 0 if empty */
+    uint32_t mask;        /* number of buckets - 1 */
+    ResEntry entries[];   /* array of ResEntry fields, followed by buckets */
 };
 
 /* lowercases path and uses forward slash */
@@ -74,7 +86,29 @@ static uint32_t path2_crc32(const char *filename) {
     strncpy(path, filename, sizeof(path));
     path[sizeof(path) - 1] = 0;
     normalize_path(path);
-    return crc32(0, path, strlen(path));
+    return (uint32_t)crc32(0, (const Bytef *)path, (uInt)strlen(path));
+}
+
+/* bucket of the hash index where the search of an id starts. Ids are already
+ * hashes of paths, mixing spreads those that only differ in high bits */
+static inline uint32_t get_bucket(ResPack respack, uint32_t id) {
+    return (id * 0x9E3779B1u >> 16) & respack->mask;
+}
+
+/* builds the hash index, with open addressing and linear probing. Entries
+ * with a duplicated id aren't added, as the first one would be found */
+static void build_index(ResPack respack) {
+    for (uint32_t c = 0; c < respack->num_entries; c++) {
+        const uint32_t id = respack->entries[c].id;
+        uint32_t bucket = get_bucket(respack, id);
+        while (respack->buckets[bucket] != 0 &&
+               respack->entries[respack->buckets[bucket] - 1].id != id) {
+            bucket = (bucket + 1) & respack->mask;
+        }
+        if (respack->buckets[bucket] == 0) {
+            respack->buckets[bucket] = c + 1;
+        }
+    }
 }
 
 /* finds given entry inside a resource pack */
@@ -86,62 +120,77 @@ static ResEntry *find_entry(ResPack respack, const char *filename) {
         return NULL;
     }
 
-    /* find entry */
+    /* find entry, the first one added wins on duplicated ids */
     id = path2_crc32(filename);
-    for (uint32_t c = 0; c < respack->num_entries; c++) {
-        if (respack->entries[c].id == id) {
-            return &respack->entries[c];
+    for (uint32_t bucket = get_bucket(respack, id); respack->buckets[bucket] != 0;
+         bucket = (bucket + 1) & respack->mask) {
+        ResEntry *entry = &respack->entries[respack->buckets[bucket] - 1];
+        if (entry->id == id) {
+            return entry;
         }
     }
     return NULL;
 }
 
-/* CBC decryption using block-level aes_decrypt */
-static void aes_decrypt_cbc(const uint8_t *in, size_t in_len, uint8_t *out, const WORD *key,
-                            int keysize, const uint8_t *init_vec) {
-    uint8_t prev[AES_BLOCK_SIZE];
-    uint8_t temp[AES_BLOCK_SIZE];
-    memcpy(prev, init_vec, AES_BLOCK_SIZE);
-    for (size_t i = 0; i + AES_BLOCK_SIZE <= in_len; i += AES_BLOCK_SIZE) {
-        aes_decrypt(in + i, temp, key, keysize);
-        for (size_t j = 0; j < AES_BLOCK_SIZE; j++) {
-            out[i + j] = temp[j] ^ prev[j];
+/* reads stored content of an asset, decrypted. Returns a pointer inside the
+ * mapped pack, or a buffer to free returned in temp too */
+static const uint8_t *read_stored(ResPack respack, ResEntry const *entry, uint8_t **temp) {
+    *temp = NULL;
+    if (respack->data != NULL) {
+        if (entry->offset > respack->size || entry->pack_size > respack->size - entry->offset) {
+            return NULL;
         }
-        memcpy(prev, in + i, AES_BLOCK_SIZE);
+        return respack->data + entry->offset;
+    }
+
+    uint8_t *stored = (uint8_t *)malloc(entry->pack_size + 1);
+    if (stored == NULL) {
+        return NULL;
     }
+    fseek(respack->pf, (long)entry->offset, SEEK_SET);
+    if (fread(stored, 1, entry->pack_size, respack->pf) != entry->pack_size) {
+        free(stored);
+        return NULL;
+    }
+    if (respack->encrypted) {
+        uint8_t *plaintext = (uint8_t *)malloc(entry->pack_size + 1);
+        if (plaintext != NULL) {
+            DecryptCBC(&respack->key, iv, stored, plaintext, entry->pack_size);
+        }
+        free(stored);
+        stored = plaintext;
+    }
+    *temp = stored;
+    return stored;
 }
 
 /* loads given asset to memory buffer */
 static void *load_asset(ResPack respack, ResEntry const *entry) {
-    uint32_t crc;
+    uint8_t *temp;
+    bool ok;
     uint8_t *buffer = (uint8_t *)malloc(entry->data_size + 1);
     if (buffer == NULL) {
         return NULL;
     }
 
-    fseek(respack->pf, (long)entry->offset, SEEK_SET);
-    if (respack->encrypted) {
-        void *cyphertext = malloc(entry->pack_size);
-        void *plaintext = malloc(entry->pack_size);
-        if (cyphertext != NULL && plaintext != NULL) {
-            fread(cyphertext, entry->pack_size, 1, respack->pf);
-            aes_decrypt_cbc((uint8_t *)cyphertext, entry->pack_size, (uint8_t *)plaintext,
-                            respack->key, KEY_SIZE, iv);
-            memcpy(buffer, plaintext, entry->data_size);
-        }
-        if (plaintext != NULL) {
-            free(plaintext);
-        }
-        if (cyphertext != NULL) {
-            free(cyphertext);
-        }
+    const uint8_t *stored = read_stored(respack, entry, &temp);
+    if (stored == NULL) {
+        ok = false;
+    } else if (entry->comp_size != 0) {
+        uLongf size = entry->data_size;
+        ok = entry->comp_size <= entry->pack_size &&
+             uncompress(buffer, &size, stored, entry->comp_size) == Z_OK &&
+             size == entry->data_size;
     } else {
-        fread(buffer, entry->data_size, 1, respack->pf);
+        ok = entry->data_size <= entry->pack_size;
+        if (ok) {
+            memcpy(buffer, stored, entry->data_size);
+        }
     }
+    free(temp);
 
     /* validate integrity */
-    crc = crc32(0, buffer, entry->data_size);
-    if (crc == entry->crc) {
+    if (ok && Crc32(0, buffer, entry->data_size) == entry->crc) {
         buffer[entry->data_size] = 0; // NULL-terminated string
     } else {
         free(buffer);
@@ -161,12 +210,63 @@ static void build_key(const char *passphrase, uint32_t *key) {
     aes_key_setup(md5_result, key, KEY_SIZE);
 }
 
+/* maps a whole pack read-only into memory, keeps the file handler on failure */
+static void map_pack(ResPack respack) {
+#if defined(_WIN32)
+    HANDLE hfile = (HANDLE)_get_osfhandle(_fileno(respack->pf));
+    LARGE_INTEGER size;
+    if (hfile == INVALID_HANDLE_VALUE || !GetFileSizeEx(hfile, &size) || size.QuadPart <= 0) {
+        return;
+    }
+    HANDLE mapping = CreateFileMappingA(hfile, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        return;
+    }
+    respack->data = (const uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (respack->data == NULL) {
+        CloseHandle(mapping);
+        return;
+    }
+    respack->size = (size_t)size.QuadPart;
+    respack->mapping = mapping;
+#else
+    struct stat st;
+    const int fd = fileno(respack->pf);
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        return;
+    }
+    void *data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (data == MAP_FAILED) {
+        return;
+    }
+    respack->data = (const uint8_t *)data;
+    respack->size = (size_t)st.st_size;
+    respack->mapping = data;
+#endif
+    fclose(respack->pf);
+    respack->pf = NULL;
+}
+
+/* releases a pack mapped with map_pack() */
+static void unmap_pack(ResPack respack) {
+#if defined(_WIN32)
+    UnmapViewOfFile(respack->data);
+    CloseHandle(respack->mapping);
+#else
+    munmap(respack->mapping, respack->size);
+#endif
+    respack->data = NULL;
+    respack->mapping = NULL;
+}
+
 /* opens a resource pack */
 ResPack ResPack_Open(const char *filename, const char *passphrase) {
     ResPack respack = NULL;
     ResHeader res_header;
     FILE *pf;
-    uint32_t size;
+    size_t size;
+    long file_size;
+    uint32_t num_buckets;
 
     /* open file */
     pf = fopen(filename, "rb");
@@ -174,15 +274,25 @@ ResPack ResPack_Open(const char *filename, const char *passphrase) {
         return NULL;
     }
 
-    /* check header */
-    fread(&res_header, sizeof(res_header), 1, pf);
-    if (strcmp(res_header.id, FILE_ID) != 0) {
+    /* check header, the index must fit in the file */
+    fseek(pf, 0, SEEK_END);
+    file_size = ftell(pf);
+    fseek(pf, 0, SEEK_SET);
+    if (fread(&res_header, sizeof(res_header), 1, pf) != 1 ||
+        strncmp(res_header.id, FILE_ID, sizeof(res_header.id)) != 0 ||
+        (res_header.version != 0 && res_header.version != RESPACK_VERSION) ||
+        file_size < 0 || res_header.num_regs > (size_t)file_size / V1_ENTRY_SIZE) {
         fclose(pf);
         return NULL;
     }
 
-    /* create object */
-    size = sizeof(struct ResPack) + (sizeof(ResEntry) * res_header.num_regs);
+    /* create object, with at least twice as many buckets as entries */
+    num_buckets = 16;
+    while (num_buckets < res_header.num_regs * 2) {
+        num_buckets *= 2;
+    }
+    size = sizeof(struct ResPack) + (sizeof(ResEntry) * res_header.num_regs) +
+           (sizeof(uint32_t) * num_buckets);
     respack = (ResPack)calloc(size, 1);
     if (respack == NULL) {
         fclose(pf);
@@ -191,15 +301,31 @@ ResPack ResPack_Open(const char *filename, const char *passphrase) {
 
     respack->num_entries = res_header.num_regs;
     respack->pf = pf;
+    respack->buckets = (uint32_t *)&respack->entries[respack->num_entries];
+    respack->mask = num_buckets - 1;
 
     /* prepare AES-128 key*/
     if (passphrase != NULL) {
-        build_key(passphrase, respack->key);
+        uint32_t key[60];
+        build_key(passphrase, key);
+        SetupDecryptKey(&respack->key, key, KEY_SIZE);
         respack->encrypted = true;
     }
 
-    /* load index */
-    fread(respack->entries, sizeof(ResEntry), respack->num_entries, pf);
+    /* load index, original entries lack comp_size */
+    if (res_header.version == RESPACK_VERSION) {
+        fread(respack->entries, sizeof(ResEntry), respack->num_entries, pf);
+    } else {
+        for (uint32_t c = 0; c < respack->num_entries; c++) {
+            fread(&respack->entries[c], V1_ENTRY_SIZE, 1, pf);
+        }
+    }
+    build_index(respack);
+
+    /* plain assets are read in place */
+    if (!respack->encrypted) {
+        map_pack(respack);
+    }
     return respack;
 }
 
@@ -209,6 +335,9 @@ void ResPack_Close(ResPack respack) {
         if (respack->pf != NULL) {
             fclose(respack->pf);
         }
+        if (respack->data != NULL) {
+            unmap_pack(respack);
+        }
         free(respack);
     }
 }
@@ -233,71 +362,29 @@ void *ResPack_LoadAsset(ResPack respack, const char *filename, uint32_t *size) {
     return asset;
 }
 
-/* creates a temporal file and opens it */
-ResAsset ResPack_OpenAsset(ResPack respack, const char *filename) {
+/* returns contents of an asset inside a mapped pack, without copying */
+const void *ResPack_MapAsset(ResPack respack, const char *filename, uint32_t *size) {
     ResEntry const *entry = NULL;
-    ResAsset asset;
-    void const *content;
 
     /* validate & find */
-    entry = find_entry(respack, filename);
-    if (entry == NULL) {
+    if (respack == NULL || respack->data == NULL) {
         return NULL;
     }
-
-    content = load_asset(respack, entry);
-    if (content == NULL) {
-        return NULL;
-    }
-
-    asset = (ResAsset)malloc(sizeof(struct ResAsset));
-    if (asset == NULL) {
+    entry = find_entry(respack, filename);
+    if (entry == NULL || entry->comp_size != 0 || entry->offset > respack->size ||
+        entry->data_size > respack->size - entry->offset) {
         return NULL;
     }
 
-    snprintf(asset->filename, sizeof(asset->filename), "_tmp%u", entry->id);
-    asset->pf = fopen(asset->filename, "wb");
-    if (asset->pf == NULL) {
-        free(asset);
-        return NULL;
-    }
-    fwrite(content, entry->data_size, 1, asset->pf);
-    fclose(asset->pf);
-    asset->pf = fopen(asset->filename, "rb");
-    if (asset->pf == NULL) {
-        remove(asset->filename);
-        free(asset);
+    /* validate integrity */
+    const uint8_t *data = respack->data + entry->offset;
+    if (Crc32(0, data, entry->data_size) != entry->crc) {
         return NULL;
     }
-    asset->size = entry->data_size;
-    return asset;
-}
-
-/* returns file handler of an opened asset */
-FILE *ResPack_GetAssetFile(ResAsset asset) {
-    if (asset != NULL) {
-        return asset->pf;
-    }
-    return NULL;
-}
-
-/* returns actual size of an opened asset */
-uint32_t ResPack_GetAssetSize(struct ResAsset const *asset) {
-    if (asset != NULL) {
-        return asset->size;
-    }
-    return 0;
-}
-
-/* closes asset, deletes temporal filename */
-void ResPack_CloseAsset(ResAsset asset) {
-    if (asset != NULL) {
-        if (asset->pf != NULL) {
-            fclose(asset->pf);
-        }
-        remove(asset->filename);
-        free(asset);
+    if (size != NULL) {
+        *size = entry->data_size;
     }
+    return data;
 }
 
 #ifdef RESPACK_LIB
@@ -329,10 +416,10 @@ static void *load_file(const char *filename, uint32_t *data_size) {
 }
 
 /* builds a resource pack, returns number of assets */
-int ResPack_Build(const char *filelist, const char *passphrase) {
+int ResPack_Build(const char *filelist, const char *passphrase, bool compression) {
     FILE *pf_list;
     FILE *pf_output;
-    ResHeader res_header = {FILE_ID, 0};
+    ResHeader res_header = {FILE_ID, RESPACK_VERSION, 0};
     ResEntry *res_entries = NULL;
     char *dot;
     char filename[100];
@@ -397,22 +484,40 @@ int ResPack_Build(const char *filelist, const char *passphrase) {
         entry->pack_size = entry->data_size;
         entry->offset = offset;
         entry->id = path2_crc32(line);
-        entry->crc = _crc32(0, content, entry->data_size);
+        entry->crc = Crc32(0, content, entry->data_size);
         count += 1;
 
+        /* optional compression, kept only when it saves space */
+        if (compression) {
+            uLongf comp_size = compressBound(entry->data_size);
+            uint8_t *compressed = (uint8_t *)malloc(comp_size);
+            if (compressed != NULL &&
+                compress2(compressed, &comp_size, content, entry->data_size,
+                          Z_BEST_COMPRESSION) == Z_OK &&
+                comp_size < entry->data_size) {
+                free(content);
+                content = compressed;
+                entry->comp_size = (uint32_t)comp_size;
+                entry->pack_size = entry->comp_size;
+            } else {
+                free(compressed);
+            }
+        }
+
         /* optional encryption */
         if (passphrase != NULL) {
             /* calc full block size */
-            uint32_t pack_size = (entry->data_size + AES_BLOCK_SIZE - 1) & ~(AES_BLOCK_SIZE - 1);
-            if (pack_size == entry->data_size)
+            uint32_t stored_size = entry->pack_size;
+            uint32_t pack_size = (stored_size + AES_BLOCK_SIZE - 1) & ~(AES_BLOCK_SIZE - 1);
+            if (pack_size == stored_size)
                 pack_size += AES_BLOCK_SIZE;
             entry->pack_size = pack_size;
 
             /* allocate & fill with PKCS#7 padding value*/
             uint8_t *plaintext = (uint8_t *)malloc(pack_size);
-            uint32_t pkcs7_value = pack_size - entry->data_size;
-            memcpy(plaintext, content, entry->data_size);
-            memset(&plaintext[entry->data_size], pkcs7_value, pkcs7_value);
+            uint32_t pkcs7_value = pack_size - stored_size;
+            memcpy(plaintext, content, stored_size);
+            memset(&plaintext[stored_size], pkcs7_value, pkcs7_value);
             free(content);
 
             /* encrypt & discard plaintext */
@@ -422,7 +527,7 @@ int ResPack_Build(const char *filelist, const char *passphrase) {
             free(plaintext);
         }
 
-        // printf("%s id=%08X, size=%d, pack_size=%d, _crc32=%08X\n", line,
+        // printf("%s id=%08X, size=%d, pack_size=%d, crc32=%08X\n", line,
         // entry->id, entry->data_size, entry->pack_size, entry->crc);
 
         /* write to file */
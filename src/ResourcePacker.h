@@ -16,7 +16,6 @@
 #include <stdio.h>
 
 typedef struct ResPack *ResPack;
-typedef struct ResAsset *ResAsset;
 
 #ifdef __cplusplus
 extern "C" {
@@ -32,21 +31,14 @@ void ResPack_Close(ResPack respack);
 /* loads contents of asset to memory, returns buffer and actual size */
 void *ResPack_LoadAsset(ResPack respack, const char *filename, uint32_t *size);
 
-/* creates a temporal file and opens it, returns asset handler */
-ResAsset ResPack_OpenAsset(ResPack respack, const char *filename);
-
-/* returns file handler of an opened asset with ResPack_OpenAsset() */
-FILE *ResPack_GetAssetFile(ResAsset asset);
-
-/* returns actual size of an opened asset with ResPack_OpenAsset() */
-uint32_t ResPack_GetAssetSize(struct ResAsset const *asset);
-
-/* closes opened asset, deletes temporal file */
-void ResPack_CloseAsset(ResAsset asset);
+/* returns contents of an asset without copying, valid until the pack is
+ * closed. Only for packs without encryption and assets stored uncompressed,
+ * returns NULL otherwise */
+const void *ResPack_MapAsset(ResPack respack, const char *filename, uint32_t *size);
 
 /* builds a resource pack from "filelist" to "filelist.dat", returns number of
- * assets */
-int ResPack_Build(const char *filelist, const char *passphrase);
+ * assets. Compression stores assets with zlib when it makes them smaller */
+int ResPack_Build(const char *filelist, const char *passphrase, bool compression);
 
 #ifdef __cplusplus
 }
@@ -12,6 +12,7 @@
 
 #include <string.h>
 
+#include "AssetCache.h"
 #include "Object.h"
 #include "Sequence.h"
 #include "crc32.h"
@@ -185,6 +186,10 @@ bool TLN_DeleteSequencePack(TLN_SequencePack sp) {
     if (!CheckBaseObject(sp, OT_SEQPACK)) {
         return false;
     }
+    if (ReleaseAsset(sp)) {
+        TLN_SetLastError(TLN_ERR_OK);
+        return true;
+    }
 
     if (ObjectOwner(sp)) {
         TLN_Sequence sequence = sp->sequences;
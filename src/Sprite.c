@@ -72,6 +72,7 @@ bool TLN_SetSpriteSet(int nsprite, TLN_Spriteset spriteset) {
   /* sprite enabled: add to the end */
   if (!enabled && GetSpriteFlag(sprite, SPRITE_FLAG_OK)) {
     ListAppendNode(&engine->list_sprites, nsprite);
+    UpdateSpriteRender(sprite);
   }
 
   return GetSpriteFlag(sprite, SPRITE_FLAG_OK);
@@ -94,6 +95,7 @@ bool TLN_EnableSpriteFlag(int nsprite, uint32_t flag, bool enable) {
   } else {
     engine->sprites[nsprite].flags &= ~flag;
   }
+  UpdateSpriteRender(&engine->sprites[nsprite]);
 
   TLN_SetLastError(TLN_ERR_OK);
   return true;
@@ -275,7 +277,8 @@ int TLN_GetSpriteY(int nsprite) {
  *
  * \remarks
  * The rendering of a sprite with scaling enabled requires somewhat more CPU
- * power than a regular sprite.
+ * power than a regular sprite. Scaling is combined with the rotation set by
+ * TLN_SetSpriteRotation()
  *
  * \see
  * TLN_ResetSpriteScaling()
@@ -290,7 +293,7 @@ bool TLN_SetSpriteScaling(int nsprite, float sx, float sy) {
   sprite = &engine->sprites[nsprite];
   sprite->scale.x = sx;
   sprite->scale.y = sy;
-  sprite->mode = MODE_SCALING;
+  sprite->mode = sprite->angle != 0.0F ? MODE_TRANSFORM : MODE_SCALING;
   sprite->funcs.draw = GetSpriteDraw(sprite->mode);
   UpdateSprite(sprite);
   SelectSpriteBlitter(sprite);
@@ -316,7 +319,7 @@ bool TLN_ResetSpriteScaling(int nsprite) {
 
   sprite = &engine->sprites[nsprite];
   sprite->scale.x = sprite->scale.y = 1.0F;
-  sprite->mode = MODE_NORMAL;
+  sprite->mode = sprite->angle != 0.0F ? MODE_TRANSFORM : MODE_NORMAL;
   sprite->funcs.draw = GetSpriteDraw(sprite->mode);
   UpdateSprite(sprite);
 
@@ -325,151 +328,76 @@ bool TLN_ResetSpriteScaling(int nsprite) {
   return true;
 }
 
-typedef struct {
-  fix_t x;
-  fix_t y;
-  fix_t dx;
-  fix_t dy;
-} Vector2D;
-
-/* sets fixed-point 2D vector */
-static void Vector2DSet(Vector2D *vector, Point2D const *src, Point2D const *dst, int len) {
-  int dstw = (int)(dst->x - src->x);
-  int dsth = (int)(dst->y - src->y);
-  vector->x = float2fix(src->x);
-  vector->y = float2fix(src->y);
-  vector->dx = int2fix(dstw) / len;
-  vector->dy = int2fix(dsth) / len;
-}
-
-static inline void Vector2DAdvance(Vector2D *vector) {
-  vector->x += vector->dx;
-  vector->y += vector->dy;
-}
-
+/*!
+ * \brief
+ * Rotates a sprite around its pivot
+ *
+ * \param nsprite
+ * Id of the sprite [0, num_sprites - 1]
+ *
+ * \param angle
+ * Rotation angle in degrees
+ *
+ * \remarks
+ * Rotation is combined with the scaling factor set by TLN_SetSpriteScaling(),
+ * and the sprite rotates around the pivot set by TLN_SetSpritePivot(). Each
+ * scanline is sampled straight from the spriteset, so the angle can change
+ * every frame at no extra cost. Call TLN_ResetSpriteRotation() to disable
+ * rotation
+ *
+ * \see
+ * TLN_ResetSpriteRotation(), TLN_SetSpriteScaling(), TLN_SetSpritePivot()
+ */
 bool TLN_SetSpriteRotation(int nsprite, float angle) {
   Sprite *sprite;
-  Matrix3 transform;
-  Matrix3 matrix;
-  fix_t dx;
-  fix_t dy;
-  Point2D corners[4];
-  rect_t *rect;
-  Vector2D xvect;
-  Vector2D yvect;
-  TLN_Bitmap rotated;
-  int spr_w;
-  int spr_h;
-  int c;
-
   if (nsprite >= engine->numsprites) {
     TLN_SetLastError(TLN_ERR_IDX_SPRITE);
     return false;
   }
 
   sprite = &engine->sprites[nsprite];
-
-  /* delete previous rotation bitmap */
-  if (sprite->rotation_bitmap != NULL) {
-    TLN_DeleteBitmap(sprite->rotation_bitmap);
-  }
-
-  /* calculate 4 corners */
-  spr_w = sprite->info->w;
-  spr_h = sprite->info->h;
-  Point2DSet(&corners[0], (math2d_t)sprite->pos.x, (math2d_t)sprite->pos.y);
-  Point2DSet(&corners[1], (math2d_t)sprite->pos.x + (math2d_t)spr_w - 1, (math2d_t)sprite->pos.y);
-  Point2DSet(&corners[2], (math2d_t)sprite->pos.x + (math2d_t)spr_w - 1,
-             (math2d_t)sprite->pos.y + (math2d_t)spr_h - 1);
-  Point2DSet(&corners[3], (math2d_t)sprite->pos.x, (math2d_t)sprite->pos.y + (math2d_t)spr_h - 1);
-
-  /* calculate rotation matrix from the center */
-  dx = sprite->pos.x - (spr_w >> 1);
-  dy = sprite->pos.y - (spr_h >> 1);
-  Matrix3SetIdentity(&matrix);
-  Matrix3SetTranslation(&transform, (math2d_t)-dx, (math2d_t)-dy);
-  Matrix3Multiply(&matrix, &transform);
-  Matrix3SetRotation(&transform, fmodf(angle, 360.0F));
-  Matrix3Multiply(&matrix, &transform);
-  Matrix3SetTranslation(&transform, (math2d_t)dx, (math2d_t)dy);
-  Matrix3Multiply(&matrix, &transform);
-
-  /* multiply points by the matrix */
-  for (c = 0; c < 4; c++) {
-    Point2DMultiply(&corners[c], &matrix);
-    corners[c].x = roundf(corners[c].x);
-    corners[c].y = roundf(corners[c].y);
-  }
-
-  /* get bounding rectangle on screen */
-  rect = &sprite->dstrect;
-  rect->x1 = rect->x2 = (int)corners[0].x;
-  rect->y1 = rect->y2 = (int)corners[0].y;
-  for (c = 1; c < 4; c++) {
-    Point2D const *point = &corners[c];
-    if ((math2d_t)rect->x1 > point->x) {
-      rect->x1 = (int)point->x;
-    }
-    if ((math2d_t)rect->x2 < point->x) {
-      rect->x2 = (int)point->x;
-    }
-    if ((math2d_t)rect->y1 > point->y) {
-      rect->y1 = (int)point->y;
-    }
-    if ((math2d_t)rect->y2 < point->y) {
-      rect->y2 = (int)point->y;
-    }
-  }
-
-  /* adjust point array to origin (0,0) to obtain size */
-  for (c = 0; c < 4; c++) {
-    corners[c].x -= (math2d_t)rect->x1;
-    corners[c].y -= (math2d_t)rect->y1;
-  }
-
-  rotated = TLN_CreateBitmap(rect->x2 - rect->x1 + 1, rect->y2 - rect->y1 + 1, 8);
-
-  /* initialize scan vectors */
-  Vector2DSet(&xvect, &corners[0], &corners[1], spr_w);
-  Vector2DSet(&yvect, &corners[0], &corners[3], spr_h);
-
-  /* draw rotated destination bitmap */
-  for (int y = 0; y < spr_h; y++) {
-    xvect.x = yvect.x;
-    xvect.y = yvect.y;
-    uint8_t const *srcptr = sprite->pixel_data.pixels + ((ptrdiff_t)y * sprite->pixel_data.pitch);
-    for (int x = 0; x < spr_w; x++) {
-      int tmpx = fix2int(xvect.x);
-      int tmpy = fix2int(xvect.y);
-      uint8_t *dstptr = get_bitmap_ptr(rotated, tmpx, tmpy);
-      *dstptr = *srcptr++;
-      Vector2DAdvance(&xvect);
-    }
-    Vector2DAdvance(&yvect);
-  }
-
-  sprite->rotation_bitmap = rotated;
+  sprite->angle = fmodf(angle, 360.0F);
   sprite->mode = MODE_TRANSFORM;
   sprite->funcs.draw = GetSpriteDraw(sprite->mode);
+  UpdateSprite(sprite);
+  SelectSpriteBlitter(sprite);
 
+  TLN_SetLastError(TLN_ERR_OK);
   return true;
 }
 
+/*!
+ * \brief
+ * Disables rotation for a given sprite
+ *
+ * \param nsprite
+ * Id of the sprite [0, num_sprites - 1]
+ *
+ * \remarks
+ * The scaling factor set by TLN_SetSpriteScaling() is kept
+ *
+ * \see
+ * TLN_SetSpriteRotation()
+ */
 bool TLN_ResetSpriteRotation(int nsprite) {
   Sprite *sprite;
-
   if (nsprite >= engine->numsprites) {
     TLN_SetLastError(TLN_ERR_IDX_SPRITE);
     return false;
   }
 
   sprite = &engine->sprites[nsprite];
-  if (sprite->rotation_bitmap != NULL) {
-    TLN_DeleteBitmap(sprite->rotation_bitmap);
+  sprite->angle = 0.0F;
+  if (sprite->scale.x != 1.0F || sprite->scale.y != 1.0F) {
+    sprite->mode = MODE_SCALING;
+  } else {
+    sprite->mode = MODE_NORMAL;
   }
-
-  sprite->mode = MODE_NORMAL;
   sprite->funcs.draw = GetSpriteDraw(sprite->mode);
+  UpdateSprite(sprite);
+  SelectSpriteBlitter(sprite);
+
+  TLN_SetLastError(TLN_ERR_OK);
   return true;
 }
 
@@ -595,6 +523,7 @@ bool TLN_DisableSprite(int nsprite) {
   if (enabled) {
     debugmsg("%s(%d)\t", __FUNCTION__, nsprite);
     ListUnlinkNode(&engine->list_sprites, nsprite);
+    engine->sprite_spans.dirty = true;
   }
 
   TLN_SetLastError(TLN_ERR_OK);
@@ -630,7 +559,7 @@ TLNAPI bool TLN_GetSpriteState(int nsprite, TLN_SpriteState *state) {
   if (sprite->info != NULL) {
     state->w = sprite->info->w;
     state->h = sprite->info->h;
-    if (sprite->mode == MODE_SCALING) {
+    if (sprite->mode != MODE_NORMAL) {
       state->w = (int)((float)state->w * sprite->scale.x);
       state->h = (int)((float)state->h * sprite->scale.y);
     }
@@ -676,6 +605,7 @@ bool TLN_SetFirstSprite(int nsprite) {
   ListLinkNodes(list, nsprite, list->first);
   ListLinkNodes(list, cut1, cut2);
   list->first = nsprite;
+  engine->sprite_spans.dirty = true;
 
   debugmsg("%s(%d)\t", __FUNCTION__, nsprite);
   ListPrint(list);
@@ -722,6 +652,7 @@ bool TLN_SetNextSprite(int nsprite, int next) {
   if (list->last == nsprite) {
     list->last = next;
   }
+  engine->sprite_spans.dirty = true;
 
   debugmsg("%s(%d,%d)\t", __FUNCTION__, nsprite, next);
   ListPrint(list);
@@ -759,6 +690,7 @@ bool TLN_SetSpritePivot(int nsprite, float px, float py) {
   nclamp(&py);
   sprite->pivot.x = px;
   sprite->pivot.y = py;
+  UpdateSprite(sprite);
   TLN_SetLastError(TLN_ERR_OK);
   return true;
 }
@@ -774,6 +706,70 @@ void TLN_SetSpritesMaskRegion(int top_line, int bottom_line) {
   engine->sprite_mask.bottom = bottom_line;
 }
 
+/* updates bounding rect and inverse mapping of a rotated and scaled sprite */
+static void UpdateAffineSprite(Sprite *sprite) {
+  const float angle = sprite->angle * (float)M_PI / 180.0F;
+  const float c = cosf(angle);
+  const float s = sinf(angle);
+  const float sx = sprite->scale.x;
+  const float sy = sprite->scale.y;
+  const float w = (float)sprite->info->w;
+  const float h = (float)sprite->info->h;
+  const float px = w * sprite->pivot.x;
+  const float py = h * sprite->pivot.y;
+  rect_t *rect = &sprite->dstrect;
+
+  if (sx == 0.0F || sy == 0.0F) {
+    MakeRect(rect, 0, 0, 0, 0);
+    return;
+  }
+
+  /* screen bounding box of the corners, rotating the same way as TLN_SetLayerTransform() */
+  float x1 = INFINITY;
+  float y1 = INFINITY;
+  float x2 = -INFINITY;
+  float y2 = -INFINITY;
+  for (int corner = 0; corner < 4; corner++) {
+    const float u = ((corner & 1) ? w - px : -px) * sx;
+    const float v = ((corner & 2) ? h - py : -py) * sy;
+    const float x = (c * u) + (s * v);
+    const float y = (c * v) - (s * u);
+    x1 = fminf(x1, x);
+    y1 = fminf(y1, y);
+    x2 = fmaxf(x2, x);
+    y2 = fmaxf(y2, y);
+  }
+  rect->x1 = sprite->pos.x + (int)floorf(x1);
+  rect->y1 = sprite->pos.y + (int)floorf(y1);
+  rect->x2 = sprite->pos.x + (int)ceilf(x2);
+  rect->y2 = sprite->pos.y + (int)ceilf(y2);
+
+  /* clipping */
+  if (rect->x1 < 0) {
+    rect->x1 = 0;
+  }
+  if (rect->y1 < 0) {
+    rect->y1 = 0;
+  }
+  if (rect->x2 > engine->framebuffer.width) {
+    rect->x2 = engine->framebuffer.width;
+  }
+  if (rect->y2 > engine->framebuffer.height) {
+    rect->y2 = engine->framebuffer.height;
+  }
+
+  /* inverse mapping, sampled at pixel centers */
+  const float dx = (float)(rect->x1 - sprite->pos.x) + 0.5F;
+  const float dy = (float)(rect->y1 - sprite->pos.y) + 0.5F;
+  SpriteAffine *affine = &sprite->affine;
+  affine->u = float2fix(px + (((c * dx) - (s * dy)) / sx));
+  affine->v = float2fix(py + (((s * dx) + (c * dy)) / sy));
+  affine->dudx = float2fix(c / sx);
+  affine->dvdx = float2fix(s / sy);
+  affine->dudy = float2fix(-s / sx);
+  affine->dvdy = float2fix(c / sy);
+}
+
 /* updates clipping rect cache */
 void UpdateSprite(Sprite *sprite) {
   int w;
@@ -863,9 +859,27 @@ void UpdateSprite(Sprite *sprite) {
       sprite->dstrect.x2 = engine->framebuffer.width;
     }
   }
+
+  /* rotation and scaling */
+  else if (sprite->mode == MODE_TRANSFORM) {
+    UpdateAffineSprite(sprite);
+  }
+  UpdateSpriteRender(sprite);
+}
+
+/* copies the state read by the scanline loops into the sprite render table */
+void UpdateSpriteRender(Sprite const *sprite) {
+  SpriteRender *render = &engine->sprite_render[sprite - engine->sprites];
+  render->dstrect = sprite->dstrect;
+  render->flags = sprite->flags;
+  render->clipped = sprite->dstrect.x2 < 0 || sprite->srcrect.x2 < 0 ||
+                    sprite->dstrect.x2 <= sprite->dstrect.x1;
+  render->draw = sprite->funcs.draw;
+  engine->sprite_spans.dirty = true;
 }
 
 static void SelectSpriteBlitter(Sprite *sprite) {
+  /* transformed sprites are sampled to a line of indices drawn with dx = 1 */
   const bool scaling = sprite->mode == MODE_SCALING;
   const bool blend = sprite->blend != NULL;
 
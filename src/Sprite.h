@@ -15,6 +15,7 @@
 #include "Blitters.h"
 #include "Draw.h"
 #include "List.h"
+#include "Math2D.h"
 #include "Spriteset.h"
 #include "Tilengine.h"
 
@@ -53,6 +54,14 @@ typedef struct {
   uint8_t *pixels;
   int pitch;
 } SpritePixelData;
+typedef struct {
+  fix_t u; /* source position at the center of the top left target pixel */
+  fix_t v;
+  fix_t dudx; /* source step per target pixel */
+  fix_t dvdx;
+  fix_t dudy; /* source step per target scanline */
+  fix_t dvdy;
+} SpriteAffine;
 typedef struct {
   ScanDrawPtr draw;
   ScanBlitPtr blitter;
@@ -95,11 +104,22 @@ typedef struct Sprite {
   uint8_t *blend;
   uint32_t flags;
   SpriteDrawFuncs funcs;
-  TLN_Bitmap rotation_bitmap;
+  float angle;         /* rotation in degrees around the pivot (TLN_SetSpriteRotation) */
+  SpriteAffine affine; /* inverse mapping of MODE_TRANSFORM, from target to source */
   ListNode list_node;
   Animation animation;
 } Sprite;
 
+/* packed copy of the sprite state read by the per-scanline sprite loops,
+ * stored contiguously in engine->sprite_render */
+typedef struct {
+  rect_t dstrect;   /* screen target rectangle */
+  uint32_t flags;   /* copy of Sprite.flags */
+  bool clipped;     /* fully clipped horizontally */
+  ScanDrawPtr draw; /* scanline draw function */
+} SpriteRender;
+
 extern void UpdateSprite(Sprite *sprite);
+extern void UpdateSpriteRender(Sprite const *sprite);
 
 #endif
\ No newline at end of file
@@ -12,6 +12,7 @@
 
 #include <string.h>
 
+#include "AssetCache.h"
 #include "Bitmap.h"
 #include "Tilengine.h"
 #include "crc32.h"
@@ -161,6 +162,10 @@ TLN_Spriteset TLN_CloneSpriteset(TLN_Spriteset src) {
  */
 bool TLN_DeleteSpriteset(TLN_Spriteset spriteset) {
     if (CheckBaseObject(spriteset, OT_SPRITESET)) {
+        if (ReleaseAsset(spriteset)) {
+            TLN_SetLastError(TLN_ERR_OK);
+            return true;
+        }
         if (ObjectOwner(spriteset)) {
             TLN_DeleteBitmap(spriteset->bitmap);
         }
@@ -14,8 +14,6 @@
 
 #include "Tilengine.h"
 
-#define BLEND_SIZE (1 << 16)
-
 static uint8_t *blend_tables[MAX_BLEND];
 static int instances = 0;
 
@@ -26,12 +24,14 @@ bool CreateBlendTables(void) {
         return true;
     }
 
-    /* get memory */
+    /* get memory. SIMD blitters read the tables with 32-bit gathers, so the
+     * last entry is followed by 3 readable bytes, the first one holds the mode */
     for (int c = BLEND_MIX25; c < MAX_BLEND; c++) {
-        blend_tables[c] = (uint8_t *)malloc(BLEND_SIZE);
+        blend_tables[c] = (uint8_t *)calloc(BLEND_SIZE + 3, 1);
         if (blend_tables[c] == NULL) {
             return false;
         }
+        blend_tables[c][BLEND_SIZE] = (uint8_t)c;
     }
 
     /* build tables */
@@ -41,9 +41,10 @@ bool CreateBlendTables(void) {
             blend_tables[BLEND_MIX25][offset] = (uint8_t)((a + b + b) / 3);
             blend_tables[BLEND_MIX50][offset] = (uint8_t)((a + b) >> 1);
             blend_tables[BLEND_MIX75][offset] = (uint8_t)((a + a + b) / 3);
+            blend_tables[BLEND_MIX90][offset] = (uint8_t)((a * 9 + b) / 10);
             blend_tables[BLEND_ADD][offset] = (a + b) > 255 ? 255 : (uint8_t)(a + b);
             blend_tables[BLEND_SUB][offset] = (a - b) < 0 ? 0 : (uint8_t)(a - b);
-            blend_tables[BLEND_MOD][offset] = (uint8_t)(a * b) / 255;
+            blend_tables[BLEND_MOD][offset] = (uint8_t)((a * b) / 255);
             blend_tables[BLEND_CUSTOM][offset] = (uint8_t)a;
         }
     }
@@ -27,6 +27,11 @@ uint8_t *SelectBlendTable(TLN_Blend mode);
 }
 #endif
 
+#define BLEND_SIZE (1 << 16)
+
 #define blendfunc(t, a, b) *((t) + ((a) << 8) + (b))
 
+/* returns the mode of a blend table, stored past its last entry */
+#define GetBlendMode(t) ((TLN_Blend)(t)[BLEND_SIZE])
+
 #endif
@@ -1,26 +1,740 @@
-/* Compile test without windowing component, not for real execution */
+/* Compile test without windowing component, not for real execution. Checks
+ * SIMD blitters against the scalar ones, run with "bench" argument to time
+ * them */
+#include <ctype.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
+#include <zlib.h>
+
+#include "Blend.h"
+#include "Blitters.h"
+#include "Crypto.h"
+#include "Math2D.h"
+#include "Palette.h"
+#include "ResourcePacker.h"
+#include "Tables.h"
 #include "Tilengine.h"
+#include "aes.h"
+#include "md5.h"
 
 #define WIDTH 400
 #define HEIGHT 240
+#define MAX_WIDTH 40
+#define FRAME_SIZE (WIDTH * HEIGHT * 4)
+#define FLIP_MASK (FLAG_FLIPX | FLAG_FLIPY | FLAG_ROTATE)
+#define NUM_SPRITES 4
+#define NUM_PACK_ASSETS 200 /* synthetic assets besides the map files */
+
+static uint8_t framebuffer[FRAME_SIZE];
+static uint8_t reference[FRAME_SIZE];
+
+static const char *const simd_names[MAX_SIMD] = {"scalar", "SSE2", "AVX2"};
+
+static uint32_t random_state = 12345;
+
+static uint32_t next_random(void) {
+    random_state ^= random_state << 13;
+    random_state ^= random_state >> 17;
+    random_state ^= random_state << 5;
+    return random_state;
+}
+
+/* fills buffer with random bytes, a quarter of them 0 */
+static void fill_random(uint8_t *data, int size) {
+    for (int c = 0; c < size; c++) {
+        const uint32_t value = next_random();
+        data[c] = (value & 0x300) ? (uint8_t)value : 0;
+    }
+}
+
+/* checks arithmetic blending against the blend tables for all channel values,
+ * with different values in the other channels */
+static int test_blend(void) {
+    int errors = 0;
+    for (int b = BLEND_MIX25; b < MAX_BLEND; b++) {
+        uint8_t const *table = SelectBlendTable((TLN_Blend)b);
+        for (int shift = 0; shift < 24; shift += 8) {
+            for (uint32_t src = 0; src < 256; src++) {
+                for (uint32_t dst = 0; dst < 256; dst++) {
+                    const uint32_t other = next_random() & RGB_MASK & ~(0xFFU << shift);
+                    const uint32_t srcpixel = (src << shift) | other | 0x80000000;
+                    const uint32_t dstpixel = (dst << shift) | (other ^ RGB_MASK) | 0x40000000;
+                    const uint32_t result = BlendPixel((TLN_Blend)b, table, srcpixel, dstpixel);
+                    uint32_t expected = dstpixel & ALPHA_MASK;
+                    for (int c = 0; c < 24; c += 8) {
+                        expected |= (uint32_t)blendfunc(table, (srcpixel >> c) & 0xFF,
+                                                        (dstpixel >> c) & 0xFF)
+                                    << c;
+                    }
+                    if (result != expected) {
+                        errors += 1;
+                    }
+                }
+            }
+        }
+        if (errors != 0) {
+            printf("blend mode %d doesn't match its table\n", b);
+            break;
+        }
+    }
+    return errors;
+}
+
+/* compares all blitters of a set with the scalar ones on random input */
+static int test_blitter_set(BlitterSet const *set, BlitterSet const *ref, TLN_Palette palette) {
+    static const int steps[] = {1, -1, 3};
+    static const int scales[] = {0x10000, 0x8000, 0x18000, 0x5432};
+    uint8_t src[MAX_WIDTH * 4 * 3];
+    uint32_t pixels[MAX_WIDTH];
+    uint32_t dst[2][MAX_WIDTH + 1];
+    int errors = 0;
+
+    fill_random((uint8_t *)palette->data, 256 * 4);
+    fill_random(src, sizeof(src));
+    fill_random((uint8_t *)pixels, sizeof(pixels));
+    for (int b = BLEND_NONE; b < MAX_BLEND; b++) {
+        uint8_t const *blend = b == BLEND_NONE ? NULL : SelectBlendTable((TLN_Blend)b);
+        for (int width = 0; width <= MAX_WIDTH; width++) {
+            /* 8 to 32 bpp */
+            for (int c = 0; c < 8; c++) {
+                if (((c >> BLIT_BLEND) & 1) != (blend != NULL)) {
+                    continue;
+                }
+                const bool scaling = (c >> BLIT_SCALING) & 1;
+                const int count = scaling ? 4 : 3;
+                for (int d = 0; d < count; d++) {
+                    const int dx = scaling ? scales[d] : steps[d];
+                    const int offset = scaling ? 0x1234 : 0;
+                    uint8_t const *start = &src[MAX_WIDTH * 3 / 2];
+                    fill_random((uint8_t *)dst[0], sizeof(dst[0]));
+                    memcpy(dst[1], dst[0], sizeof(dst[0]));
+                    ref->blitters[c](start, palette, dst[0], width, dx, offset, blend);
+                    set->blitters[c](start, palette, dst[1], width, dx, offset, blend);
+                    if (memcmp(dst[0], dst[1], sizeof(dst[0])) != 0) {
+                        printf("blitter %d blend %d width %d dx %d mismatch\n", c, b, width, dx);
+                        errors += 1;
+                    }
+                }
+            }
+
+            /* 32 bpp */
+            for (int c = 0; c < 10; c++) {
+                fill_random((uint8_t *)dst[0], sizeof(dst[0]));
+                memcpy(dst[1], dst[0], sizeof(dst[0]));
+                if (c == 0) {
+                    ref->color(dst[0], pixels[0], width, blend);
+                    set->color(dst[1], pixels[0], width, blend);
+                } else if (c == 1) {
+                    ref->blit32(pixels, dst[0], width, blend);
+                    set->blit32(pixels, dst[1], width, blend);
+                } else {
+                    ref->mosaic(pixels, dst[0], width, c * 2 - 3, blend);
+                    set->mosaic(pixels, dst[1], width, c * 2 - 3, blend);
+                }
+                if (memcmp(dst[0], dst[1], sizeof(dst[0])) != 0) {
+                    printf("32 bpp blitter %d blend %d width %d mismatch\n", c, b, width);
+                    errors += 1;
+                }
+            }
+        }
+    }
+    return errors;
+}
+
+/* times a blitter in megapixels per second */
+static double time_blitter(ScanBlitPtr blitter, TLN_Palette palette, int dx, bool blend) {
+    static uint8_t src[WIDTH * 2];
+    uint32_t *dst = (uint32_t *)framebuffer;
+    uint8_t const *table = blend ? SelectBlendTable(BLEND_MIX50) : NULL;
+    const int lines = 20000;
+
+    fill_random(src, sizeof(src));
+    const clock_t start = clock();
+    for (int c = 0; c < lines; c++) {
+        blitter(dx < 0 ? &src[WIDTH - 1] : src, palette, dst, WIDTH, dx, 0, table);
+    }
+    const double seconds = (double)(clock() - start) / CLOCKS_PER_SEC;
+    return seconds > 0 ? (double)WIDTH * lines / seconds / 1e6 : 0;
+}
+
+/* checks blitter sets supported by the CPU, optionally timing them */
+static int test_blitters(bool bench) {
+    static const char *const names[8] = {"fast",     "fast blend",    "fast scaling",
+                                         "fast blend scaling", "key", "key blend",
+                                         "key scaling", "key blend scaling"};
+    BlitterSet const *ref = GetBlitterSet(SIMD_NONE);
+    TLN_Palette palette = TLN_CreatePalette(256);
+    int errors = 0;
+
+    printf("Blitters in use: %s\n", simd_names[GetBlitterSIMD()]);
+    errors += test_blend();
+    for (int s = SIMD_NONE; s < MAX_SIMD; s++) {
+        BlitterSet const *set = GetBlitterSet((simd_t)s);
+        if (set == NULL) {
+            continue;
+        }
+        errors += test_blitter_set(set, ref, palette);
+        if (bench) {
+            for (int c = 0; c < 8; c++) {
+                const bool scaling = (c >> BLIT_SCALING) & 1;
+                const double mpix =
+                    time_blitter(set->blitters[c], palette, scaling ? 0x10000 : 1, c & 1);
+                printf("%-6s %-20s %8.1f Mpixel/s\n", simd_names[s], names[c], mpix);
+            }
+        }
+    }
+    TLN_DeletePalette(palette);
+    printf("Blitter test: %d errors\n", errors);
+    return errors;
+}
+
+/* draws a frame and tells if it doesn't match the reference one. Pixels
+ * left undrawn don't keep the values of the previous frame */
+static int check_frame(const char *name) {
+    memset(framebuffer, 0, FRAME_SIZE);
+    TLN_UpdateFrame(0);
+    if (memcmp(framebuffer, reference, FRAME_SIZE) != 0) {
+        printf("%s: frame doesn't match\n", name);
+        return 1;
+    }
+    return 0;
+}
+
+/* draws the reference frame */
+static void draw_reference(void) {
+    TLN_UpdateFrame(0);
+    memcpy(reference, framebuffer, FRAME_SIZE);
+}
+
+/* writes a map with every tile of a tileset under each combination of flips,
+ * and an object layer with some of them as tile objects */
+static bool write_flips_map(const char *filename, TLN_Tileset tileset, const char *source) {
+    const int size = TLN_GetTileWidth(tileset);
+    const int cols = WIDTH / size;
+    const int count = TLN_GetTilesetNumTiles(tileset) * 8;
+    const int rows = (count + cols - 1) / cols;
+    FILE *pf = fopen(filename, "wt");
+    if (pf == NULL) {
+        return false;
+    }
+
+    fprintf(pf, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf(pf, "<map version=\"1.10\" orientation=\"orthogonal\" width=\"%d\" height=\"%d\" "
+                "tilewidth=\"%d\" tileheight=\"%d\">\n", cols, rows, size, size);
+    fprintf(pf, " <tileset firstgid=\"1\" source=\"%s\"/>\n", source);
+    fprintf(pf, " <layer id=\"1\" name=\"Tiles\" width=\"%d\" height=\"%d\">\n", cols, rows);
+    fprintf(pf, "  <data encoding=\"csv\">\n");
+    for (int c = 0; c < cols * rows; c++) {
+        const uint32_t gid = c < count ? ((uint32_t)(c & 7) << 29) | (uint32_t)(c / 8 + 1) : 0;
+        fprintf(pf, "%u%s", gid, c < cols * rows - 1 ? "," : "\n");
+    }
+    fprintf(pf, "  </data>\n </layer>\n");
+    fprintf(pf, " <objectgroup id=\"2\" name=\"Objects\">\n");
+    for (int c = 0; c < count; c += 3) {
+        const uint32_t gid = ((uint32_t)(c & 7) << 29) | (uint32_t)(c / 8 + 1);
+        fprintf(pf, "  <object id=\"%d\" gid=\"%u\" x=\"%d\" y=\"%d\" width=\"%d\" "
+                    "height=\"%d\"/>\n", c + 1, gid, (c % cols) * size, (c / cols + 1) * size,
+                size, size);
+    }
+    fprintf(pf, " </objectgroup>\n</map>\n");
+    fclose(pf);
+    return true;
+}
+
+/* checks that tile objects got the same tiles as the tile layer */
+static int check_tile_objects(TLN_Tilemap tilemap, TLN_ObjectList list) {
+    const int cols = TLN_GetTilemapCols(tilemap);
+    TLN_ObjectInfo info;
+    int errors = 0;
+    bool more = TLN_GetListObject(list, &info);
+    while (more) {
+        const int c = info.id - 1;
+        Tile tile;
+        TLN_GetTilemapTile(tilemap, c / cols, c % cols, &tile);
+        if (info.gid != tile.index - 1 || (info.flags & FLIP_MASK) != (tile.flags & FLIP_MASK)) {
+            errors += 1;
+        }
+        more = TLN_GetListObject(list, NULL);
+    }
+    if (errors != 0) {
+        printf("tile deduplication: %d tile objects don't match\n", errors);
+    }
+    return errors;
+}
+
+/* draws a page of the flips map loaded with or without merging duplicated
+ * tiles, drawing the reference frame or comparing with it */
+static int check_flips_map(const char *filename, int page, bool dedup) {
+    int errors = 0;
+
+    TLN_SetTileDeduplication(dedup);
+    TLN_Tilemap tilemap = TLN_LoadTilemap(filename, "Tiles");
+    TLN_ObjectList list = TLN_LoadObjectList(filename, "Objects");
+    if (tilemap == NULL || list == NULL) {
+        printf("Cannot load %s\n", filename);
+        errors += 1;
+    } else {
+        TLN_SetLayerTilemap(0, tilemap);
+        TLN_SetLayerPosition(0, 0, page * HEIGHT);
+        if (dedup) {
+            errors += check_frame("tile deduplication");
+        } else {
+            draw_reference();
+        }
+        if (page == 0) {
+            errors += check_tile_objects(tilemap, list);
+        }
+        TLN_DisableLayer(0);
+    }
+    TLN_DeleteObjectList(list);
+    TLN_DeleteTilemap(tilemap);
+
+    /* next load reads the tileset again instead of sharing the cached one */
+    TLN_SetAssetCacheBudget(0);
+    TLN_SetAssetCacheBudget(32 << 20);
+    return errors;
+}
+
+/* returns number of tiles of a tileset loaded with or without merging
+ * duplicated tiles, writing the flips map for it */
+static int load_tileset(const char *source, bool dedup, const char *filename) {
+    int num_tiles = 0;
+    TLN_SetTileDeduplication(dedup);
+    TLN_Tileset tileset = TLN_LoadTileset(source);
+    if (tileset != NULL && (filename == NULL || write_flips_map(filename, tileset, source))) {
+        num_tiles = TLN_GetTilesetNumTiles(tileset);
+    }
+    TLN_DeleteTileset(tileset);
+    TLN_SetAssetCacheBudget(0);
+    TLN_SetAssetCacheBudget(32 << 20);
+    return num_tiles;
+}
+
+/* draws a map using every tile and flip of a tileset with flipped duplicates,
+ * loaded with and without merging of duplicated tiles */
+static int test_dedup(void) {
+    static const char *const filename = "dedup_test.tmx";
+    static const char *const source = "../assets/forest/tileset.tsx";
+    const int tile_size = 16; /* of the forest tileset */
+    int errors = 0;
+
+    TLN_SetLoadPath(".");
+    const int num_tiles = load_tileset(source, false, filename);
+    const int merged_tiles = load_tileset(source, true, NULL);
+    if (num_tiles == 0 || merged_tiles == 0) {
+        printf("Cannot write %s\n", filename);
+        errors += 1;
+    } else if (merged_tiles == num_tiles) {
+        printf("tile deduplication didn't merge any tile\n");
+        errors += 1;
+    } else {
+        const int cols = WIDTH / tile_size;
+        const int rows = (num_tiles * 8 + cols - 1) / cols;
+        for (int page = 0; page * HEIGHT < rows * tile_size; page++) {
+            errors += check_flips_map(filename, page, false);
+            errors += check_flips_map(filename, page, true);
+        }
+    }
+    TLN_SetTileDeduplication(false);
+    TLN_SetLoadPath("../assets/sonic");
+    remove(filename);
+    printf("Tile deduplication test: %d errors\n", errors);
+    return errors;
+}
+
+/* raster effect: waves the background layer and shades the background color */
+static void raster_effect(int line) {
+    TLN_SetLayerPosition(1, (line / 8) & 7, 0);
+    TLN_SetBGColor((uint8_t)line, 128, 238);
+}
+
+/* draws the scene with several threads, with and without a raster effect
+ * captured for replay, and compares with serial rendering */
+static int test_threads(void) {
+    static const int num_threads[] = {2, 4};
+    int errors = 0;
+
+    for (int raster = 0; raster < 2; raster++) {
+        TLN_SetRasterCallback(raster ? raster_effect : NULL);
+        TLN_SetRasterCapture(false);
+        TLN_SetRenderThreads(1);
+        draw_reference();
+        TLN_SetRasterCapture(raster);
+        for (int c = 0; c < (int)(sizeof(num_threads) / sizeof(num_threads[0])); c++) {
+            TLN_SetRenderThreads(num_threads[c]);
+            errors += check_frame(raster ? "band rendering with raster effect" : "band rendering");
+        }
+    }
+    TLN_SetRasterCallback(NULL);
+    TLN_SetRasterCapture(false);
+    TLN_SetRenderThreads(1);
+    TLN_SetLayerPosition(1, 0, 0);
+    TLN_SetBGColor(0, 128, 238);
+    printf("Band rendering test: %d errors\n", errors);
+    return errors;
+}
 
-static uint8_t framebuffer[WIDTH * HEIGHT * 4];
+/* draws the scene with and without occlusion culling of the layers behind
+ * solid tiles of the foreground */
+static int test_occlusion(void) {
+    int errors = 0;
 
-int main(void) {
+    TLN_SetOcclusionCulling(false);
+    draw_reference();
+    TLN_SetOcclusionCulling(true);
+    errors += check_frame("occlusion culling");
+    TLN_SetOcclusionCulling(false);
+    printf("Occlusion culling test: %d errors\n", errors);
+    return errors;
+}
+
+/* inverts the colors of a palette */
+static void invert_palette(TLN_Palette palette) {
+    const int num_colors = TLN_GetPaletteNumColors(palette);
+    for (int c = 1; c < num_colors; c++) {
+        uint8_t const *color = TLN_GetPaletteData(palette, c);
+        TLN_SetPaletteColor(palette, c, 255 - color[0], 255 - color[1], 255 - color[2]);
+    }
+}
+
+/* draws the scene with and without the tile cache, before and after
+ * modifying the palette of the cached tiles */
+static int test_tile_cache(void) {
+    TLN_Palette palette = TLN_GetLayerPalette(0);
+    int errors = 0;
+
+    TLN_SetTileCacheBudget(0);
+    draw_reference();
+    TLN_SetTileCacheBudget(1 << 20);
+    errors += check_frame("tile cache");
+
+    /* the frame drawn with the cache filled before the change is the reference,
+     * as changing the budget empties the cache */
+    invert_palette(palette);
+    draw_reference();
+    TLN_SetTileCacheBudget(0);
+    errors += check_frame("tile cache after palette change");
+    invert_palette(palette);
+    printf("Tile cache test: %d errors\n", errors);
+    return errors;
+}
+
+/* saves the foreground tilemap as a binary asset and draws it loaded twice
+ * from the file, sharing its tilesets, in place of the original one */
+static int test_binary_asset(TLN_Tilemap tilemap) {
+    static const char *const filename = "binary_test.bin";
+    int errors = 0;
+
+    draw_reference();
+    if (!TLN_SaveBinaryAsset(filename, tilemap)) {
+        printf("Cannot write %s\n", filename);
+        errors += 1;
+    } else {
+        TLN_SetLoadPath(".");
+        TLN_Tilemap loaded[2];
+        for (int c = 0; c < 2; c++) {
+            loaded[c] = (TLN_Tilemap)TLN_LoadBinaryAsset(filename);
+            if (loaded[c] == NULL) {
+                printf("Cannot load %s\n", filename);
+                errors += 1;
+            } else {
+                TLN_SetLayerTilemap(0, loaded[c]);
+                errors += check_frame("binary asset");
+            }
+        }
+        if (loaded[0] != NULL && loaded[1] != NULL &&
+            TLN_GetTilemapTileset(loaded[0]) != TLN_GetTilemapTileset(loaded[1])) {
+            printf("binary asset: tilesets aren't shared\n");
+            errors += 1;
+        }
+        TLN_SetLayerTilemap(0, tilemap);
+        for (int c = 0; c < 2; c++) {
+            TLN_DeleteTilemap(loaded[c]);
+        }
+        TLN_SetLoadPath("../assets/sonic");
+    }
+    remove(filename);
+    printf("Binary asset test: %d errors\n", errors);
+    return errors;
+}
+
+/* draws a sprite with rotations equivalent to plain drawing, scaling and
+ * flipping, and compares with them */
+static int test_sprite_rotation(int nsprite) {
+    int errors = 0;
+
+    draw_reference();
+    TLN_SetSpriteRotation(nsprite, 0);
+    errors += check_frame("sprite rotation 0");
+    TLN_SetSpriteRotation(nsprite, 360);
+    errors += check_frame("sprite rotation 360");
+    TLN_ResetSpriteRotation(nsprite);
+
+    TLN_SetSpriteScaling(nsprite, 2, 2);
+    draw_reference();
+    TLN_SetSpriteRotation(nsprite, 0);
+    errors += check_frame("scaled sprite rotation 0");
+    TLN_ResetSpriteRotation(nsprite);
+    TLN_ResetSpriteScaling(nsprite);
+
+    TLN_SetSpritePivot(nsprite, 0.5F, 0.5F);
+    TLN_EnableSpriteFlag(nsprite, FLAG_FLIPX | FLAG_FLIPY, true);
+    draw_reference();
+    TLN_EnableSpriteFlag(nsprite, FLAG_FLIPX | FLAG_FLIPY, false);
+    TLN_SetSpriteRotation(nsprite, 180);
+    errors += check_frame("sprite rotation 180");
+    TLN_ResetSpriteRotation(nsprite);
+    TLN_SetSpritePivot(nsprite, 0, 0);
+    printf("Sprite rotation test: %d errors\n", errors);
+    return errors;
+}
+
+/* asset of a test resource pack */
+typedef struct {
+    char name[64];
+    uint8_t *data;
+    uint32_t size;
+} PackAsset;
+
+/* resource pack format written by test_respack() */
+typedef struct {
+    const char *name;
+    uint32_t version; /* 0 for the original format */
+    const char *passphrase;
+    bool compression;
+} PackFormat;
+
+/* writes a resource pack as ResPack_Build() of the given version does: entries
+ * are found by the crc of their lowercase path. Version 0 entries lack the
+ * compressed size */
+static bool write_pack(const char *filename, PackFormat const *format, PackAsset const *assets,
+                       int count) {
+    static const uint8_t iv[AES_BLOCK_SIZE] = {0, 1, 2,  3,  4,  5,  6,  7,
+                                               8, 9, 10, 11, 12, 13, 14, 15};
+    const uint32_t num_fields = format->version == 0 ? 5 : 6;
+    const struct {
+        char id[8];
+        uint32_t version;
+        uint32_t num_regs;
+    } header = {"ResPack", format->version, (uint32_t)count};
+    uint32_t offset = (uint32_t)(sizeof(header) + ((size_t)count * num_fields * sizeof(uint32_t)));
+    uint32_t key[60];
+    bool ok = true;
+
+    FILE *pf = fopen(filename, "wb");
+    if (pf == NULL) {
+        return false;
+    }
+    if (format->passphrase != NULL) {
+        MD5_CTX md5c;
+        uint8_t digest[16];
+        MD5_Init(&md5c);
+        MD5_Update(&md5c, format->passphrase, strlen(format->passphrase));
+        MD5_Final(digest, &md5c);
+        aes_key_setup(digest, key, 128);
+    }
+
+    fwrite(&header, sizeof(header), 1, pf);
+    for (int c = 0; c < count && ok; c++) {
+        PackAsset const *asset = &assets[c];
+        uLongf comp_size = compressBound(asset->size);
+        uint8_t *stored = (uint8_t *)malloc(comp_size + AES_BLOCK_SIZE);
+        uint8_t *cyphertext = (uint8_t *)malloc(comp_size + AES_BLOCK_SIZE);
+        uint32_t entry[6] = {0};
+        char path[sizeof(asset->name)];
+        for (size_t d = 0; d < sizeof(path); d++) {
+            path[d] = (char)tolower(asset->name[d]);
+        }
+        entry[0] = (uint32_t)crc32(0, (const Bytef *)path, (uInt)strlen(path));
+        entry[1] = Crc32(0, asset->data, asset->size);
+        entry[2] = asset->size;
+        entry[4] = offset;
+        ok = stored != NULL && cyphertext != NULL;
+
+        /* compressed content is kept only when smaller */
+        uint32_t size = asset->size;
+        if (ok && format->compression &&
+            compress2(stored, &comp_size, asset->data, asset->size, Z_BEST_COMPRESSION) == Z_OK &&
+            comp_size < asset->size) {
+            size = (uint32_t)comp_size;
+            entry[5] = size;
+        } else if (ok) {
+            memcpy(stored, asset->data, size);
+        }
+
+        /* encryption pads to whole blocks with PKCS#7 */
+        uint8_t *content = stored;
+        if (ok && format->passphrase != NULL) {
+            const uint32_t padding = AES_BLOCK_SIZE - (size % AES_BLOCK_SIZE);
+            memset(stored + size, (int)padding, padding);
+            size += padding;
+            aes_encrypt_cbc(stored, size, cyphertext, key, 128, iv);
+            content = cyphertext;
+        }
+        entry[3] = size;
+
+        if (ok) {
+            fseek(pf, (long)(sizeof(header) + ((size_t)c * num_fields * sizeof(uint32_t))),
+                  SEEK_SET);
+            fwrite(entry, sizeof(uint32_t), num_fields, pf);
+            fseek(pf, (long)offset, SEEK_SET);
+            ok = fwrite(content, 1, size, pf) == size;
+            offset += size;
+        }
+        free(stored);
+        free(cyphertext);
+    }
+    fclose(pf);
+    return ok;
+}
+
+/* loads a whole file for a test resource pack */
+static bool read_pack_asset(const char *filename, PackAsset *asset) {
+    snprintf(asset->name, sizeof(asset->name), "%s", filename);
+    asset->data = NULL;
+    FILE *pf = fopen(filename, "rb");
+    if (pf == NULL) {
+        return false;
+    }
+    fseek(pf, 0, SEEK_END);
+    asset->size = (uint32_t)ftell(pf);
+    fseek(pf, 0, SEEK_SET);
+    asset->data = (uint8_t *)malloc(asset->size);
+    const bool ok = asset->data != NULL && fread(asset->data, 1, asset->size, pf) == asset->size;
+    fclose(pf);
+    return ok;
+}
+
+/* checks that every synthetic asset of a pack is found and loaded intact */
+static int check_pack_assets(const char *filename, PackFormat const *format,
+                             PackAsset const *assets, int count) {
+    int errors = 0;
+    ResPack respack = ResPack_Open(filename, format->passphrase);
+    if (respack == NULL) {
+        printf("resource pack %s: cannot open\n", format->name);
+        return 1;
+    }
+    for (int c = 0; c < count; c++) {
+        uint32_t size = 0;
+        uint8_t *data = (uint8_t *)ResPack_LoadAsset(respack, assets[c].name, &size);
+        if (data == NULL || size != assets[c].size || memcmp(data, assets[c].data, size) != 0) {
+            errors += 1;
+        }
+        free(data);
+    }
+    if (ResPack_LoadAsset(respack, "missing.txt", NULL) != NULL) {
+        errors += 1;
+    }
+    ResPack_Close(respack);
+    if (errors != 0) {
+        printf("resource pack %s: %d assets don't match\n", format->name, errors);
+    }
+    return errors;
+}
+
+/* builds resource packs of the original and the current format, stored and
+ * compressed, plain and encrypted, with the foreground map and many small
+ * assets. Checks the assets and draws the map loaded from each pack */
+static int test_respack(void) {
+    static const char *const filename = "respack_test.dat";
+    static const char *const map_files[] = {"Sonic_md_fg1.tmx", "Sonic_md_fg1.tsx",
+                                            "Sonic_md_fg1.png"};
+    static const PackFormat formats[] = {
+        {"v1", 0, NULL, false},
+        {"v1 encrypted", 0, "v1 passphrase", false},
+        {"v2", 2, NULL, false},
+        {"v2 compressed", 2, NULL, true},
+        {"v2 compressed encrypted", 2, "v2 passphrase", true},
+    };
+    const int num_map_files = (int)(sizeof(map_files) / sizeof(map_files[0]));
+    const int count = NUM_PACK_ASSETS + num_map_files;
+    PackAsset *assets = (PackAsset *)calloc((size_t)count, sizeof(PackAsset));
+    int errors = 0;
+    bool ok = assets != NULL;
+
+    /* compressible text, and random data kept uncompressed */
+    for (int c = 0; c < NUM_PACK_ASSETS && ok; c++) {
+        PackAsset *asset = &assets[c];
+        snprintf(asset->name, sizeof(asset->name), "../assets/sonic/pack/asset%d.txt", c);
+        asset->size = (uint32_t)(1 + (c * 37));
+        asset->data = (uint8_t *)malloc(asset->size);
+        ok = asset->data != NULL;
+        if (ok && (c & 3) == 0) {
+            fill_random(asset->data, (int)asset->size);
+        } else if (ok) {
+            for (uint32_t d = 0; d < asset->size; d++) {
+                asset->data[d] = (uint8_t)"<tile id=\"0\"/>\n"[(d + (uint32_t)c) % 15];
+            }
+        }
+    }
+    for (int c = 0; c < num_map_files && ok; c++) {
+        char path[64];
+        snprintf(path, sizeof(path), "../assets/sonic/%s", map_files[c]);
+        ok = read_pack_asset(path, &assets[NUM_PACK_ASSETS + c]);
+    }
+
+    for (int f = 0; f < (int)(sizeof(formats) / sizeof(formats[0])) && ok; f++) {
+        PackFormat const *format = &formats[f];
+        if (!write_pack(filename, format, assets, count)) {
+            printf("Cannot write %s\n", filename);
+            errors += 1;
+            break;
+        }
+        errors += check_pack_assets(filename, format, assets, NUM_PACK_ASSETS);
+
+        TLN_Tilemap tilemap = NULL;
+        if (TLN_OpenResourcePack(filename, format->passphrase)) {
+            tilemap = TLN_LoadTilemap(map_files[0], NULL);
+        }
+        if (tilemap == NULL) {
+            printf("resource pack %s: cannot load %s\n", format->name, map_files[0]);
+            errors += 1;
+        } else {
+            TLN_Tilemap foreground = TLN_GetLayerTilemap(0);
+            draw_reference();
+            TLN_SetLayerTilemap(0, tilemap);
+            errors += check_frame("resource pack");
+            TLN_SetLayerTilemap(0, foreground);
+            TLN_DeleteTilemap(tilemap);
+        }
+        TLN_CloseResourcePack();
+    }
+    if (!ok) {
+        printf("Cannot build %s\n", filename);
+        errors += 1;
+    }
+
+    for (int c = 0; c < count && assets != NULL; c++) {
+        free(assets[c].data);
+    }
+    free(assets);
+    remove(filename);
+    printf("Resource pack test: %d errors\n", errors);
+    return errors;
+}
+
+int main(int argc, char **argv) {
     int c;
     TLN_Tilemap tilemap = NULL;
     TLN_Spriteset spriteset = NULL;
 
     /* basic setup */
-    TLN_Init(WIDTH, HEIGHT, 1, 1, 1);
+    TLN_Init(WIDTH, HEIGHT, 2, NUM_SPRITES, 1);
     TLN_SetBGColor(0, 128, 238);
     TLN_SetRenderTarget(framebuffer, WIDTH * 4);
     TLN_SetLoadPath("../assets/sonic");
     TLN_SetLogLevel(TLN_LOG_VERBOSE);
     printf("Tilengine version %06X\n", TLN_GetVersion());
 
+    /* test blitters */
+    int errors = test_blitters(argc > 1 && strcmp(argv[1], "bench") == 0);
+
+    /* test loaders */
+    errors += test_dedup();
+
     /* test layer */
     for (c = 0; c < 2; c++) {
         TLN_SetLayerTilemap(0, tilemap);
@@ -35,7 +749,7 @@ int main(void) {
     for (c = 0; c < 2; c++) {
         TLN_SetSpriteSet(0, spriteset);
         if (spriteset == NULL) {
-            spriteset = TLN_LoadSpriteset("smw_sprite");
+            spriteset = TLN_LoadSpriteset("../smw/smw_sprite");
         }
     }
     TLN_SetSpritePosition(1, 10, 10);
@@ -43,8 +757,37 @@ int main(void) {
 
     TLN_UpdateFrame(0);
 
+    /* scene: foreground over the background layer, sprites crossing bands */
+    TLN_Tilemap foreground = TLN_LoadTilemap("Sonic_md_fg1.tmx", NULL);
+    TLN_SetLayerTilemap(0, foreground);
+    TLN_SetLayerTilemap(1, tilemap);
+    TLN_SetLayerPosition(0, 0, 32);
+    for (c = 1; c < NUM_SPRITES; c++) {
+        TLN_SetSpriteSet(c, spriteset);
+        TLN_SetSpritePosition(c, c * 90, (c * 67) - 20);
+    }
+
+    /* test binary assets */
+    errors += test_binary_asset(foreground);
+
+    /* test resource packs */
+    errors += test_respack();
+
+    /* test sprite rotation */
+    errors += test_sprite_rotation(2);
+
+    /* test band rendering */
+    errors += test_threads();
+
+    /* test occlusion culling */
+    errors += test_occlusion();
+
+    /* test tile cache */
+    errors += test_tile_cache();
+
     TLN_DeleteSpriteset(spriteset);
+    TLN_DeleteTilemap(foreground);
     TLN_DeleteTilemap(tilemap);
     TLN_Deinit();
-    return 0;
+    return errors != 0;
 }
@@ -0,0 +1,256 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* tile cache: keeps tiles expanded to RGBA with the palette they're drawn
+ * with, so that tiled layers copy colors instead of looking up the palette for
+ * each pixel. Entries are keyed by tileset, tile and palette, and tagged with
+ * the versions of the tileset and palette. Versions come from a global
+ * sequence and change whenever pixels or colors are modified, so stale entries
+ * and entries of deleted objects whose memory was reused never match */
+
+#include "TileCache.h"
+
+#include <SDL3/SDL_atomic.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Engine.h"
+#include "Palette.h"
+#include "Tilengine.h"
+#include "Tileset.h"
+
+#define MIN_BUCKETS 64
+#define MAX_BUCKETS 65536
+#define BUCKET_BYTES 1024 /* one hash chain per 1 KB of budget */
+
+static SDL_AtomicInt last_version; /* atomic, as loader threads create tilesets */
+
+/* returns a new version to tag modified tileset or palette contents */
+uint32_t NewTileCacheVersion(void) {
+    uint32_t version;
+    do {
+        version = (uint32_t)SDL_AddAtomicInt(&last_version, 1) + 1;
+    } while (version == 0);
+    return version;
+}
+
+static inline int get_bucket(TileCache const *cache, struct Tileset const *tileset, int tile,
+                             struct Palette const *palette) {
+    uintptr_t hash = ((uintptr_t)tileset >> 4) ^ ((uintptr_t)palette >> 4) * 31;
+    hash = (hash * 2654435761U) ^ (uintptr_t)tile * 40503U;
+    return (int)(hash & (uintptr_t)(cache->num_buckets - 1));
+}
+
+/* removes entry from the cache and releases its pixels */
+static void remove_entry(TileCache *cache, int index) {
+    TileCacheEntry *entry = &cache->entries[index];
+    int *link = &cache->buckets[get_bucket(cache, entry->tileset, entry->tile, entry->palette)];
+    while (*link != index) {
+        link = &cache->entries[*link].next;
+    }
+    *link = entry->next;
+    if (cache->last == index) {
+        cache->last = -1;
+    }
+
+    cache->size -= entry->size;
+    free(entry->pixels);
+    entry->pixels = NULL;
+    entry->size = 0;
+    entry->next = cache->free_entry;
+    cache->free_entry = index;
+}
+
+/* evicts the first entry not hit since the clock hand last passed it */
+static void evict_entry(TileCache *cache) {
+    while (true) {
+        if (cache->hand >= cache->num_entries) {
+            cache->hand = 0;
+        }
+        TileCacheEntry *entry = &cache->entries[cache->hand];
+        cache->hand += 1;
+        if (entry->size == 0) {
+            continue;
+        }
+        if (!entry->used) {
+            remove_entry(cache, cache->hand - 1);
+            return;
+        }
+        entry->used = false;
+    }
+}
+
+/* returns an unused entry, or -1 */
+static int alloc_entry(TileCache *cache) {
+    if (cache->free_entry != -1) {
+        const int index = cache->free_entry;
+        cache->free_entry = cache->entries[index].next;
+        return index;
+    }
+    if (cache->num_entries == cache->max_entries) {
+        const int max_entries = cache->max_entries ? cache->max_entries * 2 : 256;
+        TileCacheEntry *entries = (TileCacheEntry *)realloc(
+            cache->entries, (size_t)max_entries * sizeof(TileCacheEntry));
+        if (entries == NULL) {
+            return -1;
+        }
+        cache->entries = entries;
+        cache->max_entries = max_entries;
+    }
+    return cache->num_entries++;
+}
+
+/* expands tile pixels to palette colors and opacity mask */
+static void resolve_tile(TileCacheEntry *entry) {
+    struct Tileset const *tileset = entry->tileset;
+    uint8_t const *src = &GetTilesetPixel(tileset, entry->tile, 0, 0);
+    const int count = tileset->width * tileset->height;
+    for (int c = 0; c < count; c++) {
+        entry->pixels[c] = entry->palette->data[src[c]];
+        entry->mask[c] = src[c] != 0;
+    }
+}
+
+/* empties the cache and sets its maximum size. A budget of 0 frees all
+ * memory */
+void SetTileCacheBudget(TileCache *cache, size_t budget) {
+    for (int c = 0; c < cache->num_entries; c++) {
+        free(cache->entries[c].pixels);
+    }
+    free(cache->entries);
+    free(cache->buckets);
+    memset(cache, 0, sizeof(TileCache));
+    cache->free_entry = -1;
+    cache->last = -1;
+    if (budget == 0) {
+        return;
+    }
+
+    int num_buckets = MIN_BUCKETS;
+    while (num_buckets < MAX_BUCKETS && (size_t)num_buckets * BUCKET_BYTES < budget) {
+        num_buckets *= 2;
+    }
+    cache->buckets = (int *)malloc((size_t)num_buckets * sizeof(int));
+    if (cache->buckets == NULL) {
+        return;
+    }
+    memset(cache->buckets, -1, (size_t)num_buckets * sizeof(int));
+    cache->num_buckets = num_buckets;
+    cache->budget = budget;
+}
+
+/* returns the given tile resolved with palette, resolving it on miss and
+ * evicting tiles not recently used to stay within budget. Returns NULL if the
+ * tile can't be cached */
+TileCacheEntry const *GetCachedTile(TileCache *cache, struct Tileset const *tileset, int tile,
+                                    struct Palette const *palette) {
+    if (cache->budget == 0) {
+        return NULL;
+    }
+
+    /* consecutive tiles often repeat */
+    if (cache->last != -1) {
+        TileCacheEntry *entry = &cache->entries[cache->last];
+        if (entry->tileset == tileset && entry->tile == tile && entry->palette == palette &&
+            entry->tileset_version == tileset->version &&
+            entry->palette_version == palette->version) {
+            return entry;
+        }
+    }
+
+    /* lookup */
+    const int bucket = get_bucket(cache, tileset, tile, palette);
+    int index = cache->buckets[bucket];
+    while (index != -1) {
+        TileCacheEntry *entry = &cache->entries[index];
+        if (entry->tileset == tileset && entry->tile == tile && entry->palette == palette) {
+            if (entry->tileset_version == tileset->version &&
+                entry->palette_version == palette->version) {
+                entry->used = true;
+                cache->last = index;
+                return entry;
+            }
+            remove_entry(cache, index);
+            break;
+        }
+        index = entry->next;
+    }
+
+    /* make room */
+    const size_t pixels = (size_t)tileset->width * (size_t)tileset->height;
+    const size_t size = pixels * (sizeof(uint32_t) + sizeof(uint8_t));
+    if (size > cache->budget) {
+        return NULL;
+    }
+    while (cache->size + size > cache->budget) {
+        evict_entry(cache);
+    }
+    index = alloc_entry(cache);
+    if (index == -1) {
+        return NULL;
+    }
+
+    TileCacheEntry *entry = &cache->entries[index];
+    entry->pixels = (uint32_t *)malloc(size);
+    if (entry->pixels == NULL) {
+        entry->size = 0;
+        entry->next = cache->free_entry;
+        cache->free_entry = index;
+        return NULL;
+    }
+    entry->mask = (uint8_t *)(entry->pixels + pixels);
+    entry->tileset = tileset;
+    entry->palette = palette;
+    entry->tileset_version = tileset->version;
+    entry->palette_version = palette->version;
+    entry->tile = tile;
+    entry->size = size;
+    entry->used = true;
+    resolve_tile(entry);
+
+    entry->next = cache->buckets[bucket];
+    cache->buckets[bucket] = index;
+    cache->size += size;
+    cache->last = index;
+    return entry;
+}
+
+/*!
+ * \brief
+ * Sets the memory budget of the tile cache
+ *
+ * \param size
+ * Maximum size in bytes of each cache, or 0 to disable caching (default)
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * The tile cache keeps tiles of tiled layers expanded to RGBA with the palette
+ * they're drawn with, so solid tile lines are drawn with a plain copy instead
+ * of a palette lookup per pixel. Tiles not used recently are discarded when the
+ * budget is exceeded. Each render thread keeps its own cache. Tiles are
+ * resolved again after the tileset or palette are modified through the API,
+ * including palette animations; colors written through the pointer returned
+ * by TLN_GetPaletteData() are only seen after TLN_UpdatePalette().
+ * Only unblended layers without scaling or affine transform use the cache.
+ *
+ * \see
+ * TLN_SetRenderThreads()
+ */
+bool TLN_SetTileCacheBudget(int size) {
+    if (size < 0) {
+        TLN_SetLastError(TLN_ERR_WRONG_SIZE);
+        return false;
+    }
+    engine->tile_cache_budget = (size_t)size;
+    TLN_SetLastError(TLN_ERR_OK);
+    return true;
+}
@@ -0,0 +1,55 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+#ifndef TILECACHE_H
+#define TILECACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct Tileset;
+struct Palette;
+
+/* tile of a tileset resolved to RGBA with a given palette */
+typedef struct {
+    struct Tileset const *tileset;
+    struct Palette const *palette;
+    uint32_t tileset_version; /* tileset->version when resolved */
+    uint32_t palette_version; /* palette->version when resolved */
+    int tile;                 /* tile index in tileset pixels */
+    int next;                 /* next entry in hash chain, or free list */
+    bool used;                /* hit since the clock hand last passed */
+    size_t size;              /* bytes of pixels and mask, 0 if unused */
+    uint32_t *pixels;         /* tile colors, same layout as tileset pixels */
+    uint8_t *mask;            /* non-zero for opaque pixels, follows pixels */
+} TileCacheEntry;
+
+/* bounded cache of resolved tiles with clock (second chance) eviction, owned
+ * by a ScanContext */
+typedef struct {
+    size_t budget;  /* maximum bytes used by tiles, 0 = disabled */
+    size_t size;    /* bytes used by tiles */
+    TileCacheEntry *entries;
+    int max_entries;
+    int num_entries;
+    int free_entry; /* first entry of free list, or -1 */
+    int *buckets;   /* first entry of each hash chain, or -1 */
+    int num_buckets;
+    int hand; /* next entry checked for eviction */
+    int last; /* entry returned by the last lookup, or -1 */
+} TileCache;
+
+uint32_t NewTileCacheVersion(void);
+void SetTileCacheBudget(TileCache *cache, size_t budget);
+TileCacheEntry const *GetCachedTile(TileCache *cache, struct Tileset const *tileset, int tile,
+                                    struct Palette const *palette);
+
+#endif
@@ -58,7 +58,10 @@ typedef struct {
 TLN_Tilemap TLN_CreateTilemap(int rows, int cols, Tile const *tiles, uint32_t bgcolor,
                               TLN_Tileset tileset) {
     TLN_Tilemap tilemap = NULL;
-    size_t size = sizeof(struct Tilemap) + ((size_t)rows * (size_t)cols * sizeof(Tile));
+    const size_t size_tiles = (size_t)rows * (size_t)cols * sizeof(Tile);
+    const int occupancy_pitch = (cols + 31) >> 5;
+    size_t size = sizeof(struct Tilemap) + size_tiles +
+                  ((size_t)rows * (size_t)occupancy_pitch * sizeof(uint32_t));
 
     tilemap = (TLN_Tilemap)CreateBaseObject(OT_TILEMAP, size);
     if (!tilemap) {
@@ -70,9 +73,12 @@ TLN_Tilemap TLN_CreateTilemap(int rows, int cols, Tile const *tiles, uint32_t bg
     tilemap->bgcolor = (int)bgcolor;
     tilemap->tilesets[0] = tileset;
     tilemap->visible = true;
+    tilemap->occupancy_pitch = occupancy_pitch;
+    tilemap->occupancy_valid = true;
 
     if (tiles) {
-        memcpy(tilemap->tiles, tiles, tilemap->size - sizeof(struct Tilemap));
+        memcpy(tilemap->tiles, tiles, size_tiles);
+        UpdateTilemapOccupancy(tilemap, 0, rows * cols);
     }
 
     TLN_SetLastError(TLN_ERR_OK);
@@ -206,6 +212,33 @@ bool TLN_SetTilemapTileset2(TLN_Tilemap tilemap, TLN_Tileset tileset, int index)
     return true;
 }
 
+/* updates the occupancy bits of tiles [first, last) in storage order */
+void UpdateTilemapOccupancy(struct Tilemap *tilemap, int first, int last) {
+    const int num_tiles = tilemap->rows * tilemap->cols;
+    if (last > num_tiles) {
+        last = num_tiles;
+    }
+    if (first >= last) {
+        return;
+    }
+
+    int col = first % tilemap->cols;
+    uint32_t *occupancy = GetTilemapOccupancy(tilemap, first / tilemap->cols);
+    Tile const *tile = &tilemap->tiles[first];
+    for (int c = first; c < last; c++, tile++) {
+        const uint32_t mask = 1U << (col & 31);
+        if (tile->index != 0) {
+            occupancy[col >> 5] |= mask;
+        } else {
+            occupancy[col >> 5] &= ~mask;
+        }
+        if (++col == tilemap->cols) {
+            col = 0;
+            occupancy += tilemap->occupancy_pitch;
+        }
+    }
+}
+
 static TLN_Tile GetTilemapPtr(TLN_Tilemap tilemap, int row, int col) {
     if (row < tilemap->rows && col < tilemap->cols) {
         return &tilemap->tiles[(row * tilemap->cols) + col];
@@ -267,6 +300,8 @@ bool TLN_SetTilemapTile(TLN_Tilemap tilemap, int row, int col, Tile const *tile)
         TLN_Tile dsttile = GetTilemapPtr(tilemap, row, col);
         if (dsttile != NULL) {
             dsttile->value = tile->value;
+            const int index = (row * tilemap->cols) + col;
+            UpdateTilemapOccupancy(tilemap, index, index + 1);
             TLN_SetLastError(TLN_ERR_OK);
             return true;
         }
@@ -285,12 +320,15 @@ bool TLN_SetTilemapTile(TLN_Tilemap tilemap, int row, int col, Tile const *tile)
  * \remarks Having direct access to internal memory is convenient for
  * performance reasons when lots of tiles must be updated at runtime, but wrong
  * manipulation can lead to memory corruption or crashes. Use with caution!
+ * Tiles written this way aren't tracked, so the tilemap doesn't skip runs of
+ * empty tiles when drawn anymore.
  */
 TLN_Tile TLN_GetTilemapTiles(TLN_Tilemap tilemap, int row, int col) {
     if (!CheckBaseObject(tilemap, OT_TILEMAP)) {
         return NULL;
     }
 
+    tilemap->occupancy_valid = false;
     return GetTilemapPtr(tilemap, row, col);
 }
 
@@ -311,6 +349,12 @@ bool TLN_DeleteTilemap(TLN_Tilemap tilemap) {
     if (CheckBaseObject(tilemap, OT_TILEMAP)) {
         if (ObjectOwner(tilemap)) {
             TLN_DeleteTileset(tilemap->tilesets[0]);
+            /* loaded tilemaps hold a reference to each of their tilesets */
+            for (int c = 1; c < tilemap->num_tilesets; c++) {
+                if (tilemap->tilesets[c] != NULL) {
+                    TLN_DeleteTileset(tilemap->tilesets[c]);
+                }
+            }
         }
         DeleteBaseObject(tilemap);
         TLN_SetLastError(TLN_ERR_OK);
@@ -374,6 +418,8 @@ bool TLN_CopyTiles(TLN_Tilemap src, TLN_Rect const *src_rect, TLN_Tilemap dst, i
             Tile *dsttile = GetTilemapPtr(dst, y + dstrow, dstcol);
             if (srctile && dsttile) {
                 memcpy(dsttile, srctile, (size_t)size);
+                const int index = (int)(dsttile - dst->tiles);
+                UpdateTilemapOccupancy(dst, index, index + tgtrect.w);
             } else {
                 TLN_SetLastError(TLN_ERR_WRONG_SIZE);
                 return false;
@@ -14,6 +14,10 @@
 #include "Object.h"
 #include "Tileset.h"
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #define MAX_TILESETS 16
 
 /* mapa */
@@ -26,7 +30,47 @@ struct Tilemap {
     bool visible;                           /* visible property */
     struct Tileset *tilesets[MAX_TILESETS]; /* attached tilesets */
     int num_tilesets;                       /* actual amount of tilesets */
-    Tile tiles[];
+    int occupancy_pitch;                    /* 32-bit words per row of occupancy bitmap */
+    bool occupancy_valid; /* occupancy is exact, false after TLN_GetTilemapTiles() */
+    Tile tiles[];         /* rows*cols tiles, followed by the occupancy bitmap */
 };
 
+/* index of the lowest bit set in a non-zero word */
+static inline int bit_scan_forward(uint32_t value) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return (int)index;
+#else
+    return __builtin_ctz(value);
+#endif
+}
+
+/* per-row bitmap with a bit set for each non-empty tile */
+static inline uint32_t *GetTilemapOccupancy(struct Tilemap const *tilemap, int row) {
+    uint32_t *occupancy = (uint32_t *)&tilemap->tiles[tilemap->rows * tilemap->cols];
+    return occupancy + ((ptrdiff_t)row * tilemap->occupancy_pitch);
+}
+
+/* returns the number of consecutive empty tiles in a row starting at col,
+ * up to the end of the row. Returns 0 if the tile at col isn't empty or the
+ * occupancy bitmap isn't valid */
+static inline int GetTilemapEmptyRun(struct Tilemap const *tilemap, int row, int col) {
+    if (!tilemap->occupancy_valid) {
+        return 0;
+    }
+    uint32_t const *occupancy = GetTilemapOccupancy(tilemap, row);
+    int word = col >> 5;
+    uint32_t bits = occupancy[word] & (~0U << (col & 31));
+    while (bits == 0) {
+        if (++word >= tilemap->occupancy_pitch) {
+            return tilemap->cols - col;
+        }
+        bits = occupancy[word];
+    }
+    return (word << 5) + bit_scan_forward(bits) - col;
+}
+
+void UpdateTilemapOccupancy(struct Tilemap *tilemap, int first, int last);
+
 #endif
@@ -14,16 +14,23 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "AsyncLoad.h"
 #include "Bitmap.h"
+#include "Blitters.h"
 #include "Engine.h"
 #include "Layer.h"
 #include "LoadTMX.h"
+#include "Overdraw.h"
 #include "Palette.h"
+#include "Profile.h"
+#include "RasterCapture.h"
+#include "RenderThreads.h"
 #include "SequencePack.h"
 #include "Sprite.h"
 #include "Tables.h"
 #include "Tilemap.h"
 #include "Tileset.h"
+#include "Trace.h"
 
 /* magic number to recognize context object */
 #define ID_CONTEXT 0x7E5D0AB1
@@ -82,6 +89,9 @@ static TLN_Engine create_context(int hres, int vres, int numlayers, int numsprit
 
   TLN_SetLastError(TLN_ERR_OK);
 
+  /* blitters stored below and in layers and sprites come from the best set */
+  InitBlitters();
+
   /* create framebuffer */
   context = (TLN_Engine)calloc(1, sizeof(Engine));
   context->header = ID_CONTEXT;
@@ -100,23 +110,17 @@ static TLN_Engine create_context(int hres, int vres, int numlayers, int numsprit
       return NULL;
     }
     for (c = 0; c < context->numlayers; c++) {
-      context->layers[c].mosaic.buffer = (uint32_t *)calloc(hres, sizeof(uint32_t));
       context->layers[c].blend_mask_layer = -1;
     }
-
-    /* buffer for intermediate scanline output */
-    context->linebuffer = (uint32_t *)calloc(hres, sizeof(uint32_t));
-    context->water_render = (uint32_t *)calloc(hres, sizeof(uint32_t));
     context->blend_source_layer = -1;
-    context->priority = (uint32_t *)malloc(hres * sizeof(uint32_t));
-    context->blend_mask = (uint8_t *)calloc(hres, sizeof(uint8_t));
   }
 
   /* create static sprites */
   if (numsprites > 0) {
     context->numsprites = numsprites;
     context->sprites = (Sprite *)calloc(numsprites, sizeof(Sprite));
-    if (!context->sprites) {
+    context->sprite_render = (SpriteRender *)calloc(numsprites, sizeof(SpriteRender));
+    if (!context->sprites || !context->sprite_render) {
       TLN_DeleteContext(context);
       TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
       return NULL;
@@ -126,12 +130,30 @@ static TLN_Engine create_context(int hres, int vres, int numlayers, int numsprit
       sprite->funcs.draw = GetSpriteDraw(MODE_NORMAL);
       sprite->funcs.blitter = SelectBlitter(true, false, false);
       sprite->scale.x = sprite->scale.y = 1.0f;
+      context->sprite_render[c].draw = sprite->funcs.draw;
     }
     ListInit(&context->list_sprites, &context->sprites[0].list_node, sizeof(Sprite),
              context->numsprites);
 
-    /* sprite collision buffer */
-    context->collision = (uint16_t *)calloc(hres, sizeof(uint16_t));
+    /* per-scanline sprite buckets, entries grow on demand */
+    const size_t num_offsets = (size_t)(vres + 1) * MAX_SPAN_CLASS;
+    context->sprite_spans.offsets = (int *)malloc(num_offsets * sizeof(int));
+    context->sprite_spans.order = (int *)malloc((size_t)numsprites * sizeof(int));
+    if (!context->sprite_spans.offsets || !context->sprite_spans.order) {
+      TLN_DeleteContext(context);
+      TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
+      return NULL;
+    }
+    context->sprite_spans.dirty = true;
+  }
+
+  /* intermediate scanline buffers */
+  if (!CreateScanContext(&context->scan, context) ||
+      !CreateFrameCounters(&context->stats.current, numlayers) ||
+      !CreateFrameCounters(&context->stats.last, numlayers)) {
+    TLN_DeleteContext(context);
+    TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
+    return NULL;
   }
 
   /* create static animations */
@@ -207,6 +229,7 @@ TLN_Engine TLN_GetContext(void) { return engine; }
  * Deinitialises current engine context and frees used resources
  */
 void TLN_Deinit(void) {
+  DeleteLoaderThreads();
   if (engine != NULL) {
     TLN_DeleteContext(engine);
     engine = NULL;
@@ -226,44 +249,31 @@ bool TLN_DeleteContext(TLN_Engine context) {
     return false;
   }
 
+  DeleteRenderThreads(context);
+  DeleteRasterCapture(context);
   DeleteBlendTables();
-
-  for (int c = 0; c < context->numlayers; c++) {
-    free(context->layers[c].mosaic.buffer);
-  }
+  DeleteScanContext(&context->scan);
+  DeleteFrameCounters(&context->stats.current);
+  DeleteFrameCounters(&context->stats.last);
+  DeleteOverdraw(context);
 
   if (context->sprites) {
     free(context->sprites);
   }
 
+  free(context->sprite_render);
+  free(context->sprite_spans.offsets);
+  free(context->sprite_spans.entries);
+  free(context->sprite_spans.order);
+
   if (context->layers) {
     free(context->layers);
   }
 
-  if (context->priority) {
-    free(context->priority);
-  }
-
   if (context->anim.items) {
     free(context->anim.items);
   }
 
-  if (context->collision) {
-    free(context->collision);
-  }
-
-  if (context->blend_mask) {
-    free(context->blend_mask);
-  }
-
-  if (context->water_render) {
-    free(context->water_render);
-  }
-
-  if (context->linebuffer) {
-    free(context->linebuffer);
-  }
-
   free(context);
   return true;
 }
@@ -486,16 +496,24 @@ static void BeginFrame(int frame) {
   engine->timing.frame += 1;
 
   /* update active animations */
+  uint64_t trace = TraceBegin(TRACE_FRAME, 0);
   update_color_cycle_animations(frame);
+  TraceEnd(trace, "ColorCycleAnimations", NULL, 0);
   /* sprite animation delays count raw game frames so animation speed scales
    * with TARGET_FPS, matching the fps-dependent game logic */
+  trace = TraceBegin(TRACE_FRAME, 0);
   update_sprite_animations(raw_frame);
+  TraceEnd(trace, "SpriteAnimations", NULL, 0);
+  trace = TraceBegin(TRACE_FRAME, 0);
   update_tileset_animations(frame);
+  TraceEnd(trace, "TilesetAnimations", NULL, 0);
 
   /* frame callback */
   engine->timing.line = 0;
   if (engine->callbacks.frame) {
+    trace = TraceBegin(TRACE_FRAME, 0);
     engine->callbacks.frame(engine->timing.frame);
+    TraceEnd(trace, "FrameCallback", NULL, 0);
   }
 }
 
@@ -506,15 +524,31 @@ static void BeginFrame(int frame) {
  * \param frame Optional frame number. Set to 0 to autoincrement from previous
  * value
  *
+ * \remarks
+ * Callbacks of asynchronous loads completed since the previous frame are
+ * called first
+ *
  * \see
- * TLN_SetRenderTarget()
+ * TLN_SetRenderTarget(), TLN_LoadBitmapAsync()
  */
 void TLN_UpdateFrame(int frame) {
+  DispatchLoadCallbacks();
+  SampleTraceFrame();
+  uint64_t trace = TraceBegin(TRACE_FRAME, 0);
+  BeginFrameStats();
+  BeginOverdrawFrame();
   BeginFrame(frame);
-  while (DrawScanline()) {
-    /* DrawScanline() performs all rendering work and returns false when
-     * complete */
+  TraceEnd(trace, "BeginFrame", NULL, 0);
+
+  trace = TraceBegin(TRACE_FRAME, 0);
+  if (!DrawFrameCaptured() && !DrawFrameThreaded()) {
+    while (DrawScanline()) {
+      /* DrawScanline() performs all rendering work and returns false when
+       * complete */
+    }
   }
+  EndFrameStats();
+  TraceEnd(trace, "DrawFrame", NULL, 0);
   TLN_SetLastError(TLN_ERR_OK);
 }
 
@@ -799,6 +833,11 @@ const char *const errornames[] = {"No error",
  * TLN_GetLastError()
  */
 void TLN_SetLastError(TLN_Error error) {
+  TLN_Error *load_error = GetLoadError();
+  if (load_error != NULL) {
+    *load_error = error;
+    return;
+  }
   if (check_context(engine)) {
     engine->error = error;
     if (error != TLN_ERR_OK) {
@@ -237,6 +237,7 @@ typedef struct Sequence *TLN_Sequence;         /*!< Opaque sequence reference */
 typedef struct SequencePack *TLN_SequencePack; /*!< Opaque sequence pack reference */
 typedef struct Bitmap *TLN_Bitmap;             /*!< Opaque bitmap reference */
 typedef struct ObjectList *TLN_ObjectList;     /*!< Opaque object list reference */
+typedef struct AsyncLoad *TLN_AsyncLoad;       /*!< Opaque asynchronous load reference */
 
 /*! Image Tile items for TLN_CreateImageTileset() */
 typedef struct {
@@ -245,6 +246,60 @@ typedef struct {
   uint8_t type;
 } TLN_TileImage;
 
+/*! Per-layer statistics of the last frame for TLN_GetLayerStats() */
+typedef struct {
+  uint64_t time_ns;       /*!< time drawing the layer */
+  uint64_t pixels;        /*!< pixels drawn */
+  uint64_t culled_pixels; /*!< pixels skipped by occlusion culling */
+  uint64_t tiles;         /*!< tiles drawn */
+  uint64_t empty_tiles;   /*!< empty tiles skipped */
+  uint64_t blits;         /*!< blitter calls */
+} TLN_LayerStats;
+
+/*! Statistics of the last frame for TLN_GetFrameStats() */
+typedef struct {
+  uint64_t frame_ns;       /*!< total time of the frame */
+  uint64_t raster_ns;      /*!< time in the raster callback */
+  uint64_t background_ns;  /*!< time culling, drawing background and background sprites */
+  uint64_t layers_ns;      /*!< time drawing regular layers */
+  uint64_t sprites_ns;     /*!< time drawing regular sprites */
+  uint64_t priority_ns;    /*!< time drawing priority tiles, sprites and layers */
+  uint64_t blend_mask_ns;  /*!< part of layers_ns compositing layer blend masks */
+  uint64_t pixels;         /*!< pixels drawn by background, layers and sprites */
+  uint64_t culled_pixels;  /*!< pixels skipped by occlusion culling */
+  uint64_t tiles;          /*!< tiles drawn */
+  uint64_t empty_tiles;    /*!< empty tiles skipped */
+  uint64_t blits;          /*!< blitter calls */
+  uint64_t sprites_tested; /*!< sprite scanlines tested for drawing */
+  uint64_t sprites_drawn;  /*!< sprite scanlines drawn */
+} TLN_FrameStats;
+
+/*! Asset cache statistics for TLN_GetAssetCacheStats() */
+typedef struct {
+  uint64_t hits;        /*!< loads that returned a cached asset */
+  uint64_t misses;      /*!< loads that read the file */
+  uint64_t evictions;   /*!< unused assets deleted to fit the budget */
+  uint32_t num_assets;  /*!< assets in the cache */
+  uint32_t num_unused;  /*!< assets deleted by all their loads */
+  uint64_t size;        /*!< approximate bytes used by all assets */
+  uint64_t unused_size; /*!< approximate bytes used by unused assets */
+  uint64_t budget;      /*!< maximum bytes of unused assets */
+} TLN_AssetCacheStats;
+
+/*! Overdraw debug mode for TLN_SetOverdrawMode() */
+typedef enum {
+  TLN_OVERDRAW_NONE,    /*!< Disabled (default) */
+  TLN_OVERDRAW_COUNT,   /*!< Counts writes to each pixel, frame drawn normally */
+  TLN_OVERDRAW_HEATMAP, /*!< Counts writes and draws them as a heatmap */
+} TLN_OverdrawMode;
+
+/*! Overdraw of a pixel in the last frame for TLN_GetPixelOverdraw() */
+typedef struct {
+  int writes; /*!< times the pixel was written */
+  int layer;  /*!< layer that wrote it last, or -1 */
+  int sprite; /*!< sprite that wrote it last, or -1 */
+} TLN_PixelOverdraw;
+
 /*! Sprite state */
 typedef struct {
   int x;                   /*!< Screen position x */
@@ -264,6 +319,7 @@ typedef union SDL_Event SDL_Event;
 typedef void (*TLN_VideoCallback)(int scanline);
 typedef uint8_t (*TLN_BlendFunction)(uint8_t src, uint8_t dst);
 typedef void (*TLN_SDLCallback)(SDL_Event *);
+typedef void (*TLN_LoadCallback)(TLN_AsyncLoad load, void *asset, void *data);
 
 /*! Player index for input assignment functions */
 typedef enum {
@@ -388,11 +444,28 @@ TLNAPI void TLN_SetRasterCallback(TLN_VideoCallback /*callback*/);
 TLNAPI void TLN_SetFrameCallback(TLN_VideoCallback /*callback*/);
 TLNAPI void TLN_SetRenderTarget(uint8_t *data, int pitch);
 TLNAPI void TLN_UpdateFrame(int frame);
+TLNAPI bool TLN_SetRenderThreads(int num_threads);
+TLNAPI int TLN_GetRenderThreads(void);
+TLNAPI bool TLN_SetRasterCapture(bool enable);
+TLNAPI bool TLN_ReplayFrame(void);
+TLNAPI void TLN_SetOcclusionCulling(bool enable);
+TLNAPI bool TLN_SetTileCacheBudget(int size);
+TLNAPI bool TLN_GetFrameStats(TLN_FrameStats *stats);
+TLNAPI bool TLN_GetLayerStats(int nlayer, TLN_LayerStats *stats);
+TLNAPI bool TLN_SetTraceBuffer(int num_events);
+TLNAPI bool TLN_SetTraceSampling(int frame_interval, int line_interval);
+TLNAPI bool TLN_SaveTrace(const char *filename);
+TLNAPI bool TLN_SetOverdrawMode(TLN_OverdrawMode mode);
+TLNAPI bool TLN_GetPixelOverdraw(int x, int y, TLN_PixelOverdraw *info);
+TLNAPI int TLN_GetLayerPixelCost(int nlayer);
+TLNAPI int TLN_GetSpritePixelCost(int nsprite);
 TLNAPI void TLN_SetLoadPath(const char *path);
 TLNAPI void TLN_SetCustomBlendFunction(TLN_BlendFunction /*blend_function*/);
 TLNAPI void TLN_SetLogLevel(TLN_LogLevel log_level);
 TLNAPI bool TLN_OpenResourcePack(const char *filename, const char *key);
 TLNAPI void TLN_CloseResourcePack(void);
+TLNAPI bool TLN_SetAssetCacheBudget(int size);
+TLNAPI bool TLN_GetAssetCacheStats(TLN_AssetCacheStats *stats);
 TLNAPI TLN_Palette TLN_GetGlobalPalette(int index);
 /**@}*/
 
@@ -458,6 +531,7 @@ TLNAPI TLN_Tileset TLN_CreateTileset(int numtiles, int width, int height, TLN_Pa
                                      TLN_SequencePack sp, TLN_TileAttributes const *attributes);
 TLNAPI TLN_Tileset TLN_CreateImageTileset(int numtiles, TLN_TileImage const *images);
 TLNAPI TLN_Tileset TLN_LoadTileset(const char *filename);
+TLNAPI void TLN_SetTileDeduplication(bool enable);
 TLNAPI TLN_Tileset TLN_CloneTileset(TLN_Tileset src);
 TLNAPI bool TLN_SetTilesetPixels(TLN_Tileset tileset, int entry, uint8_t const *srcdata,
                                  int srcpitch);
@@ -507,6 +581,7 @@ TLNAPI bool TLN_SubPaletteColor(TLN_Palette palette, uint8_t r, uint8_t g, uint8
 TLNAPI bool TLN_ModPaletteColor(TLN_Palette palette, uint8_t r, uint8_t g, uint8_t b, uint8_t start,
                                 uint8_t num);
 TLNAPI uint8_t *TLN_GetPaletteData(TLN_Palette palette, int index);
+TLNAPI bool TLN_UpdatePalette(TLN_Palette palette);
 TLNAPI int TLN_GetPaletteNumColors(TLN_Palette palette);
 TLNAPI bool TLN_DeletePalette(TLN_Palette palette);
 /**@}*/
@@ -598,6 +673,8 @@ TLNAPI bool TLN_SetSpritePicture(int nsprite, int entry);
 TLNAPI bool TLN_SetSpritePalette(int nsprite, TLN_Palette palette);
 TLNAPI bool TLN_SetSpriteScaling(int nsprite, float sx, float sy);
 TLNAPI bool TLN_ResetSpriteScaling(int nsprite);
+TLNAPI bool TLN_SetSpriteRotation(int nsprite, float angle);
+TLNAPI bool TLN_ResetSpriteRotation(int nsprite);
 TLNAPI int TLN_GetSpritePicture(int nsprite);
 TLNAPI int TLN_GetSpriteX(int nsprite);
 TLNAPI int TLN_GetSpriteY(int nsprite);
@@ -667,6 +744,34 @@ TLNAPI bool TLN_SetSpriteWorldPosition(int nsprite, int x, int y);
 TLNAPI void TLN_ReleaseWorld(void);
 /**@}*/
 
+/**
+ * \defgroup asyncload
+ * \brief Asynchronous asset loading
+ * @{ */
+TLNAPI bool TLN_SetLoaderThreads(int num_threads);
+TLNAPI TLN_AsyncLoad TLN_LoadTilemapAsync(const char *filename, const char *layername,
+                                          TLN_LoadCallback callback, void *data);
+TLNAPI TLN_AsyncLoad TLN_LoadTilesetAsync(const char *filename, TLN_LoadCallback callback,
+                                          void *data);
+TLNAPI TLN_AsyncLoad TLN_LoadSpritesetAsync(const char *name, TLN_LoadCallback callback,
+                                            void *data);
+TLNAPI TLN_AsyncLoad TLN_LoadBitmapAsync(const char *filename, TLN_LoadCallback callback,
+                                         void *data);
+TLNAPI TLN_AsyncLoad TLN_LoadSequencePackAsync(const char *filename, TLN_LoadCallback callback,
+                                               void *data);
+TLNAPI bool TLN_IsLoadDone(TLN_AsyncLoad load);
+TLNAPI void *TLN_WaitLoad(TLN_AsyncLoad load);
+TLNAPI bool TLN_DeleteAsyncLoad(TLN_AsyncLoad load);
+/**@}*/
+
+/**
+ * \defgroup binary
+ * \brief Precompiled binary assets
+ * @{ */
+TLNAPI bool TLN_SaveBinaryAsset(const char *filename, void *asset);
+TLNAPI void *TLN_LoadBinaryAsset(const char *filename);
+/**@}*/
+
 #ifdef __cplusplus
 }
 #endif
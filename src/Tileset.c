@@ -14,7 +14,9 @@
 #include <stdlib.h>
 #include <string.h>
 
+#include "AssetCache.h"
 #include "SequencePack.h"
+#include "TileCache.h"
 #include "Tilengine.h"
 
 static bool HasTransparentPixels(uint8_t const *src, int width);
@@ -86,6 +88,7 @@ TLN_Tileset TLN_CreateTileset(int numtiles, int width, int height, TLN_Palette p
     }
 
     tileset->tstype = TILESET_TILES;
+    tileset->version = NewTileCacheVersion();
     tileset->width = width;
     tileset->height = height;
     tileset->hshift = hshift;
@@ -185,6 +188,7 @@ bool TLN_SetTilesetPixels(TLN_Tileset tileset, int entry, uint8_t const *srcdata
         return false;
     }
 
+    tileset->version = NewTileCacheVersion();
     line = entry * tileset->height;
     dstdata = tileset->data + ((ptrdiff_t)entry * tileset->width * tileset->height);
     for (int c = 0; c < tileset->height; c++) {
@@ -237,6 +241,9 @@ TLN_Tileset TLN_CloneTileset(TLN_Tileset src) {
         return NULL;
     }
 
+    tileset->version = NewTileCacheVersion();
+    tileset->remap = NULL;
+    tileset->num_remap = 0;
     memcpy(tileset->tiles, src->tiles, size_tiles);
     memcpy(tileset->color_key, src->color_key, size_color);
     memcpy(tileset->attributes, src->attributes, size_attributes);
@@ -260,12 +267,17 @@ TLN_Tileset TLN_CloneTileset(TLN_Tileset src) {
 bool TLN_DeleteTileset(TLN_Tileset tileset) {
     if (!CheckBaseObject(tileset, OT_TILESET)) {
         return false;
-}
+    }
+    if (ReleaseAsset(tileset)) {
+        TLN_SetLastError(TLN_ERR_OK);
+        return true;
+    }
 
     free(tileset->tiles);
     free(tileset->color_key);
     free(tileset->attributes);
     free(tileset->animations);
+    free(tileset->remap);
     DeleteBaseObject(tileset);
     TLN_SetLastError(TLN_ERR_OK);
     return true;
@@ -365,6 +377,58 @@ TLN_SequencePack TLN_GetTilesetSequencePack(TLN_Tileset tileset) {
         return NULL;
 }
 
+/* for tile-based tilesets: keeps only the first numtiles tiles, returns the
+ * new address of the tileset */
+TLN_Tileset ShrinkTileset(TLN_Tileset tileset, int numtiles) {
+    void *resized;
+    if (numtiles <= 0 || numtiles >= tileset->numtiles) {
+        return tileset;
+    }
+
+    const size_t size_tiles = (size_t)tileset->width * (size_t)tileset->height * (size_t)numtiles;
+    tileset = (TLN_Tileset)ShrinkBaseObject(tileset, sizeof(struct Tileset) + size_tiles);
+    tileset->numtiles = numtiles;
+
+    /* tile indexes are the identity until animated, so they stay valid */
+    resized = realloc(tileset->color_key, (size_t)numtiles * (size_t)tileset->height);
+    if (resized != NULL) {
+        tileset->color_key = (bool *)resized;
+    }
+    resized = realloc(tileset->attributes, (size_t)numtiles * sizeof(TLN_TileAttributes));
+    if (resized != NULL) {
+        tileset->attributes = (TLN_TileAttributes *)resized;
+    }
+    resized = realloc(tileset->tiles, ((size_t)numtiles + 1) * sizeof(uint16_t));
+    if (resized != NULL) {
+        tileset->tiles = (uint16_t *)resized;
+    }
+    return tileset;
+}
+
+/* number of tiles the tileset had when loaded, before merging duplicates.
+ * Tile indexes of tmx files refer to these */
+int GetTilesetOriginalTiles(TLN_Tileset tileset) {
+    return tileset->remap != NULL ? tileset->num_remap : tileset->numtiles;
+}
+
+/* replaces an original tile index (starting at 1) and its flags with the
+ * merged tile of a deduplicated tileset. FLAG_FLIPX and FLAG_FLIPY act on
+ * swapped axes of tiles with FLAG_ROTATE, so their merge flips are swapped */
+void RemapTilesetTile(TLN_Tileset tileset, uint16_t *index, uint16_t *flags) {
+    if (tileset->remap == NULL || *index == 0 || *index > tileset->num_remap) {
+        return;
+    }
+
+    Tile const *remap = &tileset->remap[*index - 1];
+    uint16_t flips = remap->flags;
+    if (*flags & FLAG_ROTATE) {
+        flips = (uint16_t)(((flips & FLAG_FLIPX) ? FLAG_FLIPY : 0) |
+                           ((flips & FLAG_FLIPY) ? FLAG_FLIPX : 0));
+    }
+    *index = remap->index;
+    *flags ^= flips;
+}
+
 /* for image-based tilesets: returns bitmap with matching tileid */
 TLN_Bitmap GetTilesetBitmap(TLN_Tileset tileset, int tileid) {
     if (!CheckBaseObject(tileset, OT_TILESET) || tileset->tstype != TILESET_IMAGES) {
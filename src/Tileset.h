@@ -32,6 +32,7 @@ struct Tileset {
     int vshift;                     /* vertical shift */
     int size_tiles;                 /* size of tiles collection section */
     int tiles_per_row;              /* number of tiles per row */
+    uint32_t version;               /* changes with pixels, see TileCache.c */
     TLN_Palette palette;            /* palette */
     TLN_SequencePack sp;            /* associated sequences (if any) */
     Animation *animations;          /* active tile animations */
@@ -39,6 +40,8 @@ struct Tileset {
     TLN_TileAttributes *attributes; /* attribute array */
     bool *color_key;                /* array telling if each line has color key or is solid */
     uint16_t *tiles;                /* tile indexes for animation */
+    Tile *remap;                    /* merged tile of each original one, if deduplicated */
+    int num_remap;                  /* number of original tiles */
     uint8_t data[];                 /* variable size data for images[], attributes[], color_key[]
                                        and pixels */
 };
@@ -52,5 +55,8 @@ struct Tileset {
     tileset->data[((((index) << (tileset)->vshift) + (y)) << (tileset)->hshift) + (x)]
 
 TLN_Bitmap GetTilesetBitmap(TLN_Tileset tileset, int tileid);
+TLN_Tileset ShrinkTileset(TLN_Tileset tileset, int numtiles);
+int GetTilesetOriginalTiles(TLN_Tileset tileset);
+void RemapTilesetTile(TLN_Tileset tileset, uint16_t *index, uint16_t *flags);
 
 #endif
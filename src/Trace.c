@@ -0,0 +1,271 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* timeline tracer: events are written without locks to a ring buffer shared by
+ * all threads. Writers claim a slot with an atomic counter and tag it with its
+ * sequence number once complete, so TLN_SaveTrace() skips slots being written
+ * or not written yet. When the ring is full the oldest events are overwritten,
+ * so it can run continuously and be saved when something goes wrong */
+
+#include "Trace.h"
+
+#include <SDL3/SDL_atomic.h>
+#include <SDL3/SDL_thread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "Tilengine.h"
+
+#define MIN_EVENTS 1024
+#define MAX_EVENTS (1 << 24)
+#define FILE_SIZE 48 /* characters of loaded file names kept */
+
+typedef struct {
+    SDL_AtomicInt sequence; /* index + 1 of the event, 0 while being written */
+    char const *name;
+    char const *argname; /* name of arg, or NULL */
+    int arg;
+    uint64_t start;
+    uint64_t duration;
+    uint64_t thread;
+    char file[FILE_SIZE]; /* loaded file, or empty */
+} TraceEvent;
+
+static struct {
+    TraceEvent *events;
+    uint32_t mask; /* number of events - 1, a power of two */
+    SDL_AtomicInt next;
+    int frame_interval;
+    int frame_count;
+} ring = {.frame_interval = 1};
+
+TraceState trace_state = {.line_interval = 1};
+
+/* claims the next slot of the ring and fills the common fields */
+static TraceEvent *begin_event(uint64_t start, char const *name, uint32_t *index) {
+    const uint64_t now = SDL_GetTicksNS();
+    *index = (uint32_t)SDL_AddAtomicInt(&ring.next, 1);
+    TraceEvent *event = &ring.events[*index & ring.mask];
+    SDL_SetAtomicInt(&event->sequence, 0);
+    event->name = name;
+    event->start = start;
+    event->duration = now > start ? now - start : 0;
+    event->thread = (uint64_t)SDL_GetCurrentThreadID();
+    event->argname = NULL;
+    event->file[0] = 0;
+    return event;
+}
+
+/* marks the event complete */
+static inline void end_event(TraceEvent *event, uint32_t index) {
+    SDL_SetAtomicInt(&event->sequence, (int)(index + 1));
+}
+
+/* records an event started with TraceBegin(), with an optional integer
+ * argument named argname */
+void TraceEnd(uint64_t start, char const *name, char const *argname, int arg) {
+    if (start == 0) {
+        return;
+    }
+    uint32_t index;
+    TraceEvent *event = begin_event(start, name, &index);
+    event->argname = argname;
+    event->arg = arg;
+    end_event(event, index);
+}
+
+/* records an event started with TraceBegin() loading the given file. Keeps
+ * the end of long paths, as it tells files apart */
+void TraceEndFile(uint64_t start, char const *name, char const *filename) {
+    if (start == 0) {
+        return;
+    }
+    uint32_t index;
+    TraceEvent *event = begin_event(start, name, &index);
+    if (filename != NULL) {
+        size_t size = strlen(filename);
+        if (size >= FILE_SIZE) {
+            filename += size - (FILE_SIZE - 1);
+            size = FILE_SIZE - 1;
+        }
+        /* keep the JSON valid without escaping */
+        for (size_t c = 0; c < size; c++) {
+            const char chr = filename[c];
+            event->file[c] = (chr == '\\') ? '/' : (chr == '"' || chr < ' ') ? '_' : chr;
+        }
+        event->file[size] = 0;
+    }
+    end_event(event, index);
+}
+
+/* decides if the frame about to be drawn is traced */
+void SampleTraceFrame(void) {
+    trace_state.frame = trace_state.enabled && ring.frame_count == 0;
+    ring.frame_count = (ring.frame_count + 1) % ring.frame_interval;
+}
+
+/*!
+ * \brief
+ * Enables tracing of the render pipeline and asset loading
+ *
+ * \param num_events
+ * Number of events kept, 0 to disable tracing and free the buffer. Rounded up
+ * to a power of two, minimum 1024
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * Events are kept in a ring buffer that overwrites the oldest events, so
+ * tracing can be left running and saved with TLN_SaveTrace() when needed. Each
+ * event takes about 100 bytes. Setting the buffer discards previous events.
+ * Don't call it while frames are drawn or assets are loaded in other threads.
+ *
+ * \see
+ * TLN_SetTraceSampling(), TLN_SaveTrace()
+ */
+bool TLN_SetTraceBuffer(int num_events) {
+    if (num_events < 0 || num_events > MAX_EVENTS) {
+        TLN_SetLastError(TLN_ERR_WRONG_SIZE);
+        return false;
+    }
+
+    trace_state.enabled = false;
+    trace_state.frame = false;
+    free(ring.events);
+    ring.events = NULL;
+    ring.mask = 0;
+    SDL_SetAtomicInt(&ring.next, 0);
+
+    if (num_events > 0) {
+        uint32_t size = MIN_EVENTS;
+        while (size < (uint32_t)num_events) {
+            size <<= 1;
+        }
+        ring.events = (TraceEvent *)calloc(size, sizeof(TraceEvent));
+        if (ring.events == NULL) {
+            TLN_SetLastError(TLN_ERR_OUT_OF_MEMORY);
+            return false;
+        }
+        ring.mask = size - 1;
+        trace_state.enabled = true;
+    }
+    TLN_SetLastError(TLN_ERR_OK);
+    return true;
+}
+
+/*!
+ * \brief
+ * Sets how often frames and scanlines are traced
+ *
+ * \param frame_interval
+ * Traces one of every frame_interval frames, 1 traces all
+ *
+ * \param line_interval
+ * Traces one of every line_interval scanlines of a traced frame, 1 traces all
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * Frame steps (animations, callbacks, windowing) are traced once per traced
+ * frame, and scanline steps (raster callback, drawing phases and layers) once
+ * per traced scanline. Asset loading is always traced. Sampling keeps the
+ * overhead and buffer usage low when tracing runs continuously.
+ *
+ * \see
+ * TLN_SetTraceBuffer()
+ */
+bool TLN_SetTraceSampling(int frame_interval, int line_interval) {
+    if (frame_interval < 1 || line_interval < 1) {
+        TLN_SetLastError(TLN_ERR_WRONG_SIZE);
+        return false;
+    }
+    ring.frame_interval = frame_interval;
+    ring.frame_count = 0;
+    trace_state.line_interval = line_interval;
+    TLN_SetLastError(TLN_ERR_OK);
+    return true;
+}
+
+/*!
+ * \brief
+ * Saves the traced events to a file
+ *
+ * \param filename
+ * File to write, in Chrome trace event JSON format
+ *
+ * \returns
+ * true if success or false if error
+ *
+ * \remarks
+ * The file can be opened in Perfetto (ui.perfetto.dev) or chrome://tracing.
+ * Events stay in the buffer, so a later call saves them again along with
+ * newer ones. Times are in microseconds since the library started, and each
+ * thread drawing or loading gets its own track.
+ *
+ * \see
+ * TLN_SetTraceBuffer()
+ */
+bool TLN_SaveTrace(const char *filename) {
+    if (filename == NULL) {
+        TLN_SetLastError(TLN_ERR_NULL_POINTER);
+        return false;
+    }
+    if (ring.events == NULL) {
+        TLN_SetLastError(TLN_ERR_UNSUPPORTED);
+        return false;
+    }
+
+    FILE *pf = fopen(filename, "wt");
+    if (pf == NULL) {
+        TLN_SetLastError(TLN_ERR_FILE_NOT_FOUND);
+        return false;
+    }
+
+    /* oldest to newest, skipping slots not written or overwritten meanwhile */
+    const uint32_t size = ring.mask + 1;
+    const uint32_t last = (uint32_t)SDL_GetAtomicInt(&ring.next);
+    bool first = true;
+    fputs("{\"traceEvents\":[", pf);
+    for (uint32_t index = last - size; index != last; index++) {
+        TraceEvent *slot = &ring.events[index & ring.mask];
+        const int sequence = (int)(index + 1);
+        if (sequence == 0 || SDL_GetAtomicInt(&slot->sequence) != sequence) {
+            continue;
+        }
+        TraceEvent event;
+        memcpy(&event, slot, sizeof(TraceEvent));
+        if (SDL_GetAtomicInt(&slot->sequence) != sequence) {
+            continue;
+        }
+
+        fprintf(pf,
+                "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%llu,\"ts\":%llu.%03u,"
+                "\"dur\":%llu.%03u",
+                first ? "" : ",", event.name, (unsigned long long)event.thread,
+                (unsigned long long)(event.start / 1000), (unsigned)(event.start % 1000),
+                (unsigned long long)(event.duration / 1000), (unsigned)(event.duration % 1000));
+        if (event.argname != NULL) {
+            fprintf(pf, ",\"args\":{\"%s\":%d}", event.argname, event.arg);
+        } else if (event.file[0] != 0) {
+            fprintf(pf, ",\"args\":{\"file\":\"%s\"}", event.file);
+        }
+        fputc('}', pf);
+        first = false;
+    }
+    fputs("\n],\"displayTimeUnit\":\"ns\"}\n", pf);
+
+    const bool ok = ferror(pf) == 0;
+    fclose(pf);
+    TLN_SetLastError(ok ? TLN_ERR_OK : TLN_ERR_FILE_NOT_FOUND);
+    return ok;
+}
@@ -0,0 +1,51 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* timeline tracer for TLN_SaveTrace(). Events are timed with TraceBegin() and
+ * recorded with TraceEnd(), which is skipped when TraceBegin() returns 0
+ * because tracing is off or the frame or scanline isn't sampled */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <SDL3/SDL_timer.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/* sampling of an event */
+typedef enum {
+    TRACE_ALWAYS, /* asset loading, traced while tracing is on */
+    TRACE_FRAME,  /* frame steps, traced in sampled frames */
+    TRACE_LINE,   /* scanline steps, traced in sampled lines of sampled frames */
+} TraceLevel;
+
+/* read before each event, written between frames */
+typedef struct {
+    bool enabled;      /* a trace buffer is set */
+    bool frame;        /* current frame is sampled */
+    int line_interval; /* one of every line_interval scanlines is sampled */
+} TraceState;
+
+extern TraceState trace_state;
+
+/* returns the start time in ns of an event, or 0 if it isn't sampled */
+static inline uint64_t TraceBegin(TraceLevel level, int line) {
+    if (!trace_state.enabled || (level != TRACE_ALWAYS && !trace_state.frame) ||
+        (level == TRACE_LINE && line % trace_state.line_interval != 0)) {
+        return 0;
+    }
+    return SDL_GetTicksNS() | 1; /* odd, never 0 */
+}
+
+void TraceEnd(uint64_t start, char const *name, char const *argname, int arg);
+void TraceEndFile(uint64_t start, char const *name, char const *filename);
+void SampleTraceFrame(void);
+
+#endif
@@ -23,6 +23,7 @@
 
 #include "Engine.h"
 #include "Tilengine.h"
+#include "Trace.h"
 #include "crt.h"
 
 static SDL_Window *window;
@@ -984,7 +985,9 @@ static void EndWindowFrame(void) {
   }
 
   if ((int)crt_params.enable && crt != NULL && flags.factor > 1) {
+    const uint64_t trace = TraceBegin(TRACE_FRAME, 0);
     CRTDraw(crt, rt_pixels, rt_pitch, &dstrect);
+    TraceEnd(trace, "CRTDraw", NULL, 0);
 
   } else {
     SDL_UnlockTexture(backbuffer);
@@ -1078,7 +1081,9 @@ static void EndWindowFrame(void) {
 void TLN_DrawFrame(int frame) {
   BeginWindowFrame();
   TLN_UpdateFrame(frame);
+  const uint64_t trace = TraceBegin(TRACE_FRAME, 0);
   EndWindowFrame();
+  TraceEnd(trace, "EndWindowFrame", NULL, 0);
 }
 
 /*!
@@ -1,11 +1,15 @@
 #include <stddef.h>
+#include <string.h>
 
+#include "AsyncLoad.h"
 #include "Engine.h"
 #include "Layer.h"
 #include "LoadTMX.h"
+#include "ObjectList.h"
 #include "Palette.h"
 #include "Sprite.h"
 #include "Tilengine.h"
+#include "Trace.h"
 
 #define MAX_TMX_ITEM 100
 
@@ -13,41 +17,89 @@
 static TMXInfo tmxinfo;
 static int first;
 
-/*!
- * \brief Loads and assigns complete TMX file
- * \param filename TMX file to load
- * \param first_layer Starting layer number where place the loaded tmx
- */
-bool TLN_LoadWorld(const char *filename, int first_layer) {
-  if (!TMXLoad(filename, &tmxinfo)) {
-    return NULL;
+static void *decode_tiles(void *data) {
+  return TMXDecodeTiles((TMXLayerData const *)data);
+}
+
+/* waits for a load queued by load_world() and releases its handle */
+static void *wait_load(TLN_AsyncLoad load) {
+  void *asset = TLN_WaitLoad(load);
+  TLN_DeleteAsyncLoad(load);
+  return asset;
+}
+
+/* loads a world, traced by TLN_LoadWorld(). The tmx file is parsed once, then
+ * tilesets, images and tile data load in loader threads while layers are
+ * assigned in order. Loads that can't be queued run in place */
+static bool load_world(const char *filename, int first_layer) {
+  TMXDocument doc;
+  TMXInfo *info = &doc.info;
+  if (!TMXLoadDocument(filename, &doc)) {
+    return false;
+  }
+
+  if (info->num_layers > MAX_TMX_ITEM) {
+    info->num_layers = MAX_TMX_ITEM;
   }
 
-  if (tmxinfo.num_layers > MAX_TMX_ITEM) {
-    tmxinfo.num_layers = MAX_TMX_ITEM;
+  /* queue tilesets, images and tile data */
+  TLN_AsyncLoad tileset_loads[TMX_MAX_TILESET] = {0};
+  TLN_AsyncLoad layer_loads[TMX_MAX_LAYER] = {0};
+  char tsxpath[200];
+  for (int c = 0; c < info->num_tilesets; c += 1) {
+    TMXGetTilesetPath(info, c, tsxpath, sizeof(tsxpath));
+    tileset_loads[c] = TLN_LoadTilesetAsync(tsxpath, NULL, NULL);
+  }
+  for (int c = 0; c < info->num_layers; c += 1) {
+    TMXLayer const *tmxlayer = &info->layers[c];
+    if (tmxlayer->type == LAYER_TILE) {
+      layer_loads[c] = QueueLoadJob(decode_tiles, &doc.layers[c]);
+    } else if (tmxlayer->type == LAYER_BITMAP) {
+      layer_loads[c] = TLN_LoadBitmapAsync(tmxlayer->image, NULL, NULL);
+    }
   }
 
-  /* load and assign each layer type */
+  /* tilesets are shared by all tile and object layers, each one takes its
+   * own reference */
+  TLN_Tileset tilesets[TMX_MAX_TILESET] = {0};
+  for (int c = 0; c < info->num_tilesets; c += 1) {
+    if (tileset_loads[c] != NULL) {
+      tilesets[c] = (TLN_Tileset)wait_load(tileset_loads[c]);
+    } else {
+      TMXGetTilesetPath(info, c, tsxpath, sizeof(tsxpath));
+      tilesets[c] = TLN_LoadTileset(tsxpath);
+    }
+  }
+
+  /* assign each layer type */
   first = first_layer;
-  for (int c = 0; c < tmxinfo.num_layers; c += 1) {
-    TMXLayer const *tmxlayer = &tmxinfo.layers[c];
-    const int layerindex = tmxinfo.num_layers - c - 1 + first;
+  for (int c = 0; c < info->num_layers; c += 1) {
+    TMXLayer const *tmxlayer = &info->layers[c];
+    const int layerindex = info->num_layers - c - 1 + first;
     switch (tmxlayer->type) {
     case LAYER_NONE:
       break;
 
     case LAYER_TILE: {
-      TLN_Tilemap tilemap = TLN_LoadTilemap(filename, tmxlayer->name);
+      TLN_Tilemap tilemap = layer_loads[c] != NULL
+                                ? (TLN_Tilemap)wait_load(layer_loads[c])
+                                : TMXDecodeTiles(&doc.layers[c]);
+      if (tilemap != NULL) {
+        TMXCreateTilemap(info, tmxlayer, tilemap, tilesets);
+      }
       TLN_SetLayerTilemap(layerindex, tilemap);
     } break;
 
     case LAYER_OBJECT: {
-      TLN_ObjectList objectlist = TLN_LoadObjectList(filename, tmxlayer->name);
+      TLN_ObjectList objectlist =
+          TMXCreateObjectList(info, tmxlayer, &doc.layers[c], tilesets);
       TLN_SetLayerObjects(layerindex, objectlist, NULL);
     } break;
 
     case LAYER_BITMAP: {
-      TLN_Bitmap bitmap = TLN_LoadBitmap(tmxlayer->image);
+      TLN_Bitmap bitmap = layer_loads[c] != NULL
+                              ? (TLN_Bitmap)wait_load(layer_loads[c])
+                              : TLN_LoadBitmap(tmxlayer->image);
       TLN_SetLayerBitmap(layerindex, bitmap);
     } break;
     }
@@ -65,17 +117,43 @@ bool TLN_LoadWorld(const char *filename, int first_layer) {
     }
   }
 
+  /* drop the references of the loads, tilesets not used by any layer stay
+   * cached as unused */
+  for (int c = 0; c < info->num_tilesets; c += 1) {
+    if (tilesets[c] != NULL) {
+      TLN_DeleteTileset(tilesets[c]);
+    }
+  }
+
   /* sets background color if defined */
-  if (tmxinfo.bgcolor != 0) {
+  if (info->bgcolor != 0) {
     Color bgcolor;
-    bgcolor.value = tmxinfo.bgcolor;
+    bgcolor.value = info->bgcolor;
     TLN_SetBGColor(bgcolor.r, bgcolor.g, bgcolor.b);
   } else {
     TLN_DisableBGColor();
   }
+
+  memcpy(&tmxinfo, info, sizeof(TMXInfo));
+  TMXDeleteDocument(&doc);
   return true;
 }
 
+/*!
+ * \brief Loads and assigns complete TMX file
+ * \param filename TMX file to load
+ * \param first_layer Starting layer number where place the loaded tmx
+ * \remarks The file is parsed once, and its tilesets, images and tile layers
+ * are loaded in parallel by the loader threads set with
+ * TLN_SetLoaderThreads(). The function returns when all layers are assigned
+ */
+bool TLN_LoadWorld(const char *filename, int first_layer) {
+  const uint64_t trace = TraceBegin(TRACE_ALWAYS, 0);
+  const bool ok = load_world(filename, first_layer);
+  TraceEndFile(trace, "LoadWorld", filename);
+  return ok;
+}
+
 /*!
  * \brief Releases world resources loaded with TLN_LoadWorld
  */
@@ -158,6 +236,7 @@ bool TLN_SetSpriteWorldPosition(int nsprite, int x, int y) {
   sprite->world_pos.y = y;
   SetSpriteFlag(sprite, SPRITE_FLAG_WORLD_SPACE, true);
   SetSpriteFlag(sprite, SPRITE_FLAG_DIRTY, true);
+  engine->sprite_spans.dirty = true;
 
   TLN_SetLastError(TLN_ERR_OK);
   return true;
@@ -0,0 +1,408 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+#include "XmlReader.h"
+
+#include <string.h>
+#include <strings.h>
+
+#define MAX_DEPTH 32
+
+/* known names, sorted for binary search */
+static const struct {
+    char const *name;
+    XmlKey key;
+} names[] = {
+    {"animation", XML_ANIMATION},
+    {"backgroundcolor", XML_BACKGROUNDCOLOR},
+    {"chunk", XML_CHUNK},
+    {"compression", XML_COMPRESSION},
+    {"count", XML_COUNT},
+    {"cycle", XML_CYCLE},
+    {"data", XML_DATA},
+    {"delay", XML_DELAY},
+    {"dir", XML_DIR},
+    {"duration", XML_DURATION},
+    {"encoding", XML_ENCODING},
+    {"first", XML_FIRST},
+    {"firstgid", XML_FIRSTGID},
+    {"frame", XML_FRAME},
+    {"gid", XML_GID},
+    {"height", XML_HEIGHT},
+    {"id", XML_ID},
+    {"image", XML_IMAGE},
+    {"imagelayer", XML_IMAGELAYER},
+    {"layer", XML_LAYER},
+    {"map", XML_MAP},
+    {"margin", XML_MARGIN},
+    {"name", XML_NAME},
+    {"object", XML_OBJECT},
+    {"objectgroup", XML_OBJECTGROUP},
+    {"offsetx", XML_OFFSETX},
+    {"offsety", XML_OFFSETY},
+    {"opacity", XML_OPACITY},
+    {"parallaxx", XML_PARALLAXX},
+    {"parallaxy", XML_PARALLAXY},
+    {"property", XML_PROPERTY},
+    {"sequence", XML_SEQUENCE},
+    {"source", XML_SOURCE},
+    {"spacing", XML_SPACING},
+    {"strip", XML_STRIP},
+    {"target", XML_TARGET},
+    {"tile", XML_TILE},
+    {"tilecount", XML_TILECOUNT},
+    {"tileheight", XML_TILEHEIGHT},
+    {"tileid", XML_TILEID},
+    {"tileset", XML_TILESET},
+    {"tilewidth", XML_TILEWIDTH},
+    {"tintcolor", XML_TINTCOLOR},
+    {"type", XML_TYPE},
+    {"value", XML_VALUE},
+    {"visible", XML_VISIBLE},
+    {"width", XML_WIDTH},
+    {"x", XML_X},
+    {"y", XML_Y},
+};
+
+/* parsing state */
+typedef struct {
+    char *ptr;
+    char *end;
+    XmlHandler handler;
+    void *data;
+    char const *error;
+    char *error_ptr;
+    int depth;
+    struct {
+        char const *name; /* name of open tags, to match the closing ones */
+        size_t length;
+        XmlKey key;
+    } tags[MAX_DEPTH];
+} Parser;
+
+static XmlKey intern(char const *name, size_t length) {
+    int lo = 0;
+    int hi = (int)(sizeof(names) / sizeof(names[0])) - 1;
+    while (lo <= hi) {
+        const int mid = (lo + hi) / 2;
+        int cmp = strncasecmp(name, names[mid].name, length);
+        if (cmp == 0 && names[mid].name[length] != 0) {
+            cmp = -1; /* name is a prefix of the entry */
+        }
+        if (cmp == 0) {
+            return names[mid].key;
+        } else if (cmp < 0) {
+            hi = mid - 1;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return XML_UNKNOWN;
+}
+
+static bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+static bool is_name_char(char c) {
+    return !is_space(c) && c != '/' && c != '>' && c != '=' && c != '<' && c != '"' &&
+           c != '\'';
+}
+
+static bool fail(Parser *parser, char const *error) {
+    parser->error = error;
+    parser->error_ptr = parser->ptr;
+    return false;
+}
+
+static void skip_spaces(Parser *parser) {
+    while (parser->ptr < parser->end && is_space(*parser->ptr)) {
+        parser->ptr++;
+    }
+}
+
+/* moves past the given terminator, returns its start or NULL if not found */
+static char *skip_past(Parser *parser, char const *terminator) {
+    const size_t length = strlen(terminator);
+    char *ptr = parser->ptr;
+    while (ptr + length <= parser->end) {
+        ptr = (char *)memchr(ptr, terminator[0], (size_t)(parser->end - ptr));
+        if (ptr == NULL || ptr + length > parser->end) {
+            break;
+        }
+        if (!memcmp(ptr, terminator, length)) {
+            parser->ptr = ptr + length;
+            return ptr;
+        }
+        ptr++;
+    }
+    return NULL;
+}
+
+/* replaces entities between start and end, null-terminates and returns the
+ * result. There is always room for the terminator, as end isn't part of the
+ * text and entities only shrink */
+static char *decode_text(char *start, char *end) {
+    char *src = (char *)memchr(start, '&', (size_t)(end - start));
+    if (src == NULL) {
+        *end = 0;
+        return start;
+    }
+
+    static const struct {
+        char const *entity;
+        char value;
+    } entities[] = {{"&amp;", '&'}, {"&lt;", '<'}, {"&gt;", '>'}, {"&quot;", '"'}, {"&apos;", '\''}};
+    char *dst = src;
+    while (src < end) {
+        bool found = false;
+        if (*src == '&') {
+            for (size_t c = 0; c < sizeof(entities) / sizeof(entities[0]) && !found; c++) {
+                const size_t length = strlen(entities[c].entity);
+                if (src + length <= end && !memcmp(src, entities[c].entity, length)) {
+                    *dst++ = entities[c].value;
+                    src += length;
+                    found = true;
+                }
+            }
+            if (!found && src + 2 < end && src[1] == '#') {
+                char *semicolon = (char *)memchr(src, ';', (size_t)(end - src));
+                if (semicolon != NULL) {
+                    const bool hex = src[2] == 'x' || src[2] == 'X';
+                    unsigned value = 0;
+                    for (char const *digit = src + (hex ? 3 : 2); digit < semicolon; digit++) {
+                        value = value * (hex ? 16u : 10u) +
+                                (unsigned)(*digit <= '9' ? *digit - '0' : (*digit | 0x20) - 'a' + 10);
+                    }
+                    *dst++ = (char)(value < 128 ? value : '?');
+                    src = semicolon + 1;
+                    found = true;
+                }
+            }
+        }
+        if (!found) {
+            *dst++ = *src++;
+        }
+    }
+    *dst = 0;
+    return start;
+}
+
+static bool parse_attributes(Parser *parser, XmlKey tag) {
+    for (;;) {
+        skip_spaces(parser);
+        if (parser->ptr >= parser->end) {
+            return fail(parser, "unexpected end of file inside tag");
+        }
+
+        /* end of tag */
+        if (*parser->ptr == '>' || *parser->ptr == '/') {
+            return true;
+        }
+
+        /* name */
+        char *name = parser->ptr;
+        while (parser->ptr < parser->end && is_name_char(*parser->ptr)) {
+            parser->ptr++;
+        }
+        const XmlKey key = intern(name, (size_t)(parser->ptr - name));
+        if (parser->ptr == name) {
+            return fail(parser, "attribute name expected");
+        }
+
+        /* = "value" */
+        skip_spaces(parser);
+        if (parser->ptr >= parser->end || *parser->ptr != '=') {
+            return fail(parser, "'=' expected after attribute name");
+        }
+        parser->ptr++;
+        skip_spaces(parser);
+        if (parser->ptr >= parser->end || (*parser->ptr != '"' && *parser->ptr != '\'')) {
+            return fail(parser, "quoted attribute value expected");
+        }
+        char *value = parser->ptr + 1;
+        char *quote = (char *)memchr(value, *parser->ptr, (size_t)(parser->end - value));
+        if (quote == NULL) {
+            return fail(parser, "unterminated attribute value");
+        }
+        parser->ptr = quote + 1;
+        parser->handler(parser->data, XML_ATTRIBUTE, tag, key, decode_text(value, quote));
+    }
+}
+
+static bool parse_start_tag(Parser *parser) {
+    char *name = parser->ptr;
+    while (parser->ptr < parser->end && is_name_char(*parser->ptr)) {
+        parser->ptr++;
+    }
+    if (parser->ptr == name) {
+        return fail(parser, "tag name expected");
+    }
+    if (parser->depth == MAX_DEPTH) {
+        return fail(parser, "tags nested too deep");
+    }
+
+    const size_t length = (size_t)(parser->ptr - name);
+    const XmlKey key = intern(name, length);
+    parser->handler(parser->data, XML_START_TAG, key, XML_UNKNOWN, NULL);
+    if (!parse_attributes(parser, key)) {
+        return false;
+    }
+    parser->handler(parser->data, XML_END_ATTRIBUTES, key, XML_UNKNOWN, NULL);
+
+    /* empty tag */
+    if (*parser->ptr == '/') {
+        parser->ptr++;
+        if (parser->ptr >= parser->end || *parser->ptr != '>') {
+            return fail(parser, "'>' expected after '/'");
+        }
+        parser->ptr++;
+        parser->handler(parser->data, XML_END_TAG, key, XML_UNKNOWN, NULL);
+        return true;
+    }
+
+    parser->ptr++;
+    parser->tags[parser->depth].name = name;
+    parser->tags[parser->depth].length = length;
+    parser->tags[parser->depth].key = key;
+    parser->depth += 1;
+    return true;
+}
+
+static bool parse_end_tag(Parser *parser) {
+    char *name = parser->ptr;
+    while (parser->ptr < parser->end && is_name_char(*parser->ptr)) {
+        parser->ptr++;
+    }
+    const size_t length = (size_t)(parser->ptr - name);
+    skip_spaces(parser);
+    if (parser->ptr >= parser->end || *parser->ptr != '>') {
+        return fail(parser, "'>' expected in closing tag");
+    }
+    if (parser->depth == 0 || parser->tags[parser->depth - 1].length != length ||
+        memcmp(parser->tags[parser->depth - 1].name, name, length) != 0) {
+        return fail(parser, "closing tag doesn't match the open tag");
+    }
+
+    parser->ptr++;
+    parser->depth -= 1;
+    parser->handler(parser->data, XML_END_TAG, parser->tags[parser->depth].key, XML_UNKNOWN,
+                    NULL);
+    return true;
+}
+
+/* parses what follows a '<' */
+static bool parse_markup(Parser *parser) {
+    const size_t left = (size_t)(parser->end - parser->ptr);
+    if (left >= 3 && !memcmp(parser->ptr, "!--", 3)) {
+        return skip_past(parser, "-->") != NULL || fail(parser, "unterminated comment");
+    }
+    if (left >= 8 && !memcmp(parser->ptr, "![CDATA[", 8)) {
+        char *text = parser->ptr + 8;
+        parser->ptr = text;
+        char *end = skip_past(parser, "]]>");
+        if (end == NULL) {
+            return fail(parser, "unterminated CDATA section");
+        }
+        if (parser->depth > 0) {
+            *end = 0;
+            parser->handler(parser->data, XML_CONTENT, parser->tags[parser->depth - 1].key,
+                            XML_UNKNOWN, text);
+        }
+        return true;
+    }
+    if (left >= 1 && parser->ptr[0] == '?') {
+        return skip_past(parser, "?>") != NULL || fail(parser, "unterminated declaration");
+    }
+    if (left >= 1 && parser->ptr[0] == '!') {
+        return skip_past(parser, ">") != NULL || fail(parser, "unterminated declaration");
+    }
+    if (left >= 1 && parser->ptr[0] == '/') {
+        parser->ptr++;
+        return parse_end_tag(parser);
+    }
+    return parse_start_tag(parser);
+}
+
+/* text up to the next tag. The '<' that follows is overwritten by the null
+ * terminator, so it is consumed here */
+static bool parse_text(Parser *parser) {
+    char *text = parser->ptr;
+    char *lt = (char *)memchr(text, '<', (size_t)(parser->end - text));
+    char *end = lt != NULL ? lt : parser->end;
+
+    char *ptr = text;
+    while (ptr < end && is_space(*ptr)) {
+        ptr++;
+    }
+    if (ptr < end && parser->depth == 0) {
+        return fail(parser, "text outside of the root tag");
+    }
+
+    parser->ptr = end;
+    if (lt != NULL) {
+        parser->ptr++;
+    }
+    if (ptr < end) {
+        parser->handler(parser->data, XML_CONTENT, parser->tags[parser->depth - 1].key,
+                        XML_UNKNOWN, decode_text(text, end));
+    }
+    return lt == NULL || parse_markup(parser);
+}
+
+static int line_of(char const *start, char const *ptr) {
+    int line = 1;
+    while (start < ptr) {
+        if (*start++ == '\n') {
+            line += 1;
+        }
+    }
+    return line;
+}
+
+/* parses size bytes of buffer, that is modified in place, and calls handler
+ * with each event. Returns false on syntax errors, described in error */
+bool XmlParse(char *buffer, size_t size, XmlHandler handler, void *data, XmlError *error) {
+    Parser parser = {.ptr = buffer, .end = buffer + size, .handler = handler, .data = data};
+
+    /* UTF-8 byte order mark */
+    if (size >= 3 && !memcmp(buffer, "\xEF\xBB\xBF", 3)) {
+        parser.ptr += 3;
+    }
+
+    /* text is terminated at the next '<', that must be in the buffer */
+    if (size > 0 && buffer[size - 1] != '>') {
+        char *last = buffer + size;
+        while (last > buffer && is_space(last[-1])) {
+            last--;
+        }
+        if (last == buffer || last[-1] != '>') {
+            parser.ptr = last;
+            fail(&parser, "unexpected end of file");
+        }
+        parser.end = last;
+    }
+
+    while (parser.error == NULL && parser.ptr < parser.end) {
+        if (*parser.ptr == '<') {
+            parser.ptr++;
+            parse_markup(&parser);
+        } else {
+            parse_text(&parser);
+        }
+    }
+    if (parser.error == NULL && parser.depth > 0) {
+        fail(&parser, "unexpected end of file, tags left open");
+    }
+
+    if (parser.error != NULL && error != NULL) {
+        error->line = line_of(buffer, parser.error_ptr);
+        error->description = parser.error;
+    }
+    return parser.error == NULL;
+}
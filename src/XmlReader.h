@@ -0,0 +1,95 @@
+/*
+ * Tilengine - The 2D retro graphics engine with raster effects
+ * Copyright (C) 2015-2019 Marc Palacios Domenech <mailto:megamarc@hotmail.com>
+ * All rights reserved
+ *
+ * This Source Code Form is subject to the terms of the Mozilla Public
+ * License, v. 2.0. If a copy of the MPL was not distributed with this
+ * file, You can obtain one at http://mozilla.org/MPL/2.0/.
+ * */
+
+/* in-situ XML tokenizer for the tmx, tsx and sqx loaders. Tag and attribute
+ * names are interned to XmlKey values, and values are null-terminated in place
+ * inside the parsed buffer, so parsing doesn't allocate */
+
+#ifndef XMLREADER_H
+#define XMLREADER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* tag and attribute names known by the loaders */
+typedef enum {
+    XML_UNKNOWN,
+    XML_ANIMATION,
+    XML_BACKGROUNDCOLOR,
+    XML_CHUNK,
+    XML_COMPRESSION,
+    XML_COUNT,
+    XML_CYCLE,
+    XML_DATA,
+    XML_DELAY,
+    XML_DIR,
+    XML_DURATION,
+    XML_ENCODING,
+    XML_FIRST,
+    XML_FIRSTGID,
+    XML_FRAME,
+    XML_GID,
+    XML_HEIGHT,
+    XML_ID,
+    XML_IMAGE,
+    XML_IMAGELAYER,
+    XML_LAYER,
+    XML_MAP,
+    XML_MARGIN,
+    XML_NAME,
+    XML_OBJECT,
+    XML_OBJECTGROUP,
+    XML_OFFSETX,
+    XML_OFFSETY,
+    XML_OPACITY,
+    XML_PARALLAXX,
+    XML_PARALLAXY,
+    XML_PROPERTY,
+    XML_SEQUENCE,
+    XML_SOURCE,
+    XML_SPACING,
+    XML_STRIP,
+    XML_TARGET,
+    XML_TILE,
+    XML_TILECOUNT,
+    XML_TILEHEIGHT,
+    XML_TILEID,
+    XML_TILESET,
+    XML_TILEWIDTH,
+    XML_TINTCOLOR,
+    XML_TYPE,
+    XML_VALUE,
+    XML_VISIBLE,
+    XML_WIDTH,
+    XML_X,
+    XML_Y,
+} XmlKey;
+
+typedef enum {
+    XML_START_TAG,      /* tag opened, before its attributes */
+    XML_ATTRIBUTE,      /* attribute of the open tag */
+    XML_END_ATTRIBUTES, /* all attributes of the open tag given */
+    XML_CONTENT,        /* text inside the open tag, not just whitespace */
+    XML_END_TAG,        /* tag closed */
+} XmlEvent;
+
+/* receives the events of XmlParse(). value points inside the parsed buffer,
+ * valid until it is freed */
+typedef void (*XmlHandler)(void *data, XmlEvent event, XmlKey tag, XmlKey attribute,
+                           char const *value);
+
+typedef struct {
+    int line;                /* line of the error */
+    char const *description; /* what went wrong */
+} XmlError;
+
+bool XmlParse(char *buffer, size_t size, XmlHandler handler, void *data, XmlError *error);
+
+#endif